@@ -0,0 +1,44 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "sandbox.h"
+#include "cgroup.h"
+
+#define BATCH_MAX_JOBS 256
+
+struct batch_opts {
+    char *const *inputs;  /* sample files, directories, or @listfile (@- = stdin) */
+    int ninputs;
+    char *const *args;    /* extra argv for every sample (after argv[0]) */
+    int nargs;
+    int jobs;             /* concurrent children (<= 0: one per online CPU) */
+    long budget_bytes;    /* caps jobs at budget / per-child memory; 0 = none */
+    struct limits lim;
+    struct cg_limits cg;  /* per-sample cgroup limits */
+    const char *cgroup_parent;  /* delegated cgroup to work under; NULL = our own */
+    int no_net;
+    int use_jail;
+    int fork_each;        /* classic fork + full setup per sample instead of the prepared path */
+};
+
+struct batch_stats {
+    unsigned long runs;
+    unsigned long failed;   /* nonzero exit, signal or spawn error */
+    unsigned long timeouts;
+    int jobs;               /* concurrency actually used */
+    int cgroups;            /* 1 = cgroup v2 limits, 0 = fell back to setrlimit */
+};
+
+/*
+ * Detonation farm: run every sample in its own sandboxed child, up to
+ * `jobs` at once, all watched by one supervisor event loop. Each child gets
+ * its own cgroup (memory, CPU and pids limits) when the cgroup v2 setup
+ * works; otherwise the per-process rlimits apply and a warning says so.
+ * One NDJSON record per sample on stdout, in completion order; the
+ * samples' own output goes to /dev/null. Limits, seccomp and the jail are
+ * prepared once (sandbox_prepare) and every sample is vfork()ed from that;
+ * its "setup_us" is what the launch itself cost.
+ */
+int batch_run(const struct batch_opts *opt, struct batch_stats *st);
+
+#endif
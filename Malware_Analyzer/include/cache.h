@@ -0,0 +1,55 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "elfx.h"
+#include "sandbox.h"
+
+/*
+ * Content-addressed result cache.
+ *
+ * One fixed-size index file, mmapped shared, organised as a set-associative
+ * table: the first bytes of the key pick a set, the set's ways are scanned,
+ * and the least recently used way is evicted when the set is full. Lookups
+ * and inserts are O(1) and the file never grows, so the size cap is the
+ * table size ($MALX_CACHE_ENTRIES, default 32768, rounded to whole sets;
+ * it only sizes a new index, an existing one keeps its size).
+ *
+ * Keys are the sample's SHA-256. The header records the analyzer version
+ * and record layout; on a mismatch a fresh index is renamed over the old
+ * one (never resized in place, which would fault processes that still have
+ * it mapped). A second record kind maps
+ * (dev, inode, size, mtime, ctime) to the SHA-256, so an unchanged file is
+ * answered without being read at all.
+ *
+ * Location: $MALX_CACHE_DIR, else $XDG_CACHE_HOME/malx, else ~/.cache/malx.
+ * Safe for concurrent use by threads and processes (mutex + flock).
+ */
+
+struct malx_cache;
+
+/* NULL (with a reason in err) when no cache could be opened; callers just go uncached. */
+struct malx_cache *cache_open(char *err, size_t errlen);
+void cache_close(struct malx_cache *c);
+
+/* stat fingerprint -> sha256 hex */
+int  cache_get_hash(struct malx_cache *c, const struct stat *st, char sha_hex[65]);
+void cache_put_hash(struct malx_cache *c, const struct stat *st, const char sha_hex[65]);
+
+/* Static pass result. elf_ok = 0 stores a negative result with its error text. */
+int  cache_get_static(struct malx_cache *c, const char sha_hex[65], int *elf_ok,
+                      struct elf_summary *s, char *err, size_t errlen);
+void cache_put_static(struct malx_cache *c, const char sha_hex[65], int elf_ok,
+                      const struct elf_summary *s, const char *err);
+
+/* Run result for one sample under one configuration (see cache_tag). */
+int  cache_get_run(struct malx_cache *c, const char sha_hex[65], uint64_t tag, struct run_result *r);
+void cache_put_run(struct malx_cache *c, const char sha_hex[65], uint64_t tag, const struct run_result *r);
+
+/* Fold bytes into a configuration tag (FNV-1a 64); start from 0. */
+uint64_t cache_tag(uint64_t tag, const void *p, size_t n);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <limits.h>
+#include <stddef.h>
+
+/*
+ * Per-sample cgroup v2 limits. One parent cgroup per malx process
+ * (malx.<pid>, under our own cgroup or a delegated directory), one child
+ * cgroup per sample under it. The sample joins its cgroup between fork and
+ * exec, so every descendant it spawns is charged and limited there too,
+ * and teardown can kill the lot with cgroup.kill.
+ */
+
+struct cg_limits {
+    long mem_bytes;     /* memory.max (swap is turned off); 0 = unlimited */
+    int  cpu_pct;       /* cpu.max as percent of one CPU; 0 = unlimited */
+    int  pids;          /* pids.max; 0 = unlimited */
+};
+
+struct cg_root {
+    char path[PATH_MAX];
+    char self[PATH_MAX];    /* leaf malx moved itself into, "" if it didn't */
+    unsigned ctl_mask;      /* controllers enabled in our own cgroup after the move */
+};
+
+struct cgroup {
+    char path[PATH_MAX];
+    int  procs_fd;      /* cgroup.procs, O_CLOEXEC; the child writes "0" to it */
+};
+
+/*
+ * Creates the parent cgroup and enables the controllers the limits need.
+ * parent NULL = the cgroup we run in. cgroup v2's no-internal-process
+ * rule keeps a cgroup with member processes from enabling controllers for
+ * children, so when malx is the only member (systemd-run --user -p
+ * Delegate=yes --scope) it first moves itself into a leaf, malx.<pid>.self,
+ * and cg_root_close() moves it back. From a login shell's scope (other
+ * members) this fails. -1 with a reason in err (no cgroup2 mount, no
+ * delegation, a controller that can't be enabled, ...).
+ */
+int  cg_root_open(struct cg_root *root, const char *parent, const struct cg_limits *lim,
+                  char *err, size_t errlen);
+void cg_root_close(struct cg_root *root);
+
+int  cg_create(const struct cg_root *root, const char *name, const struct cg_limits *lim,
+               struct cgroup *cg, char *err, size_t errlen);
+/* Child side, after fork(): move the calling process in. Async-signal-safe. */
+int  cg_enter(const struct cgroup *cg);
+/* memory.events oom_kill > 0 */
+int  cg_oom_killed(const struct cgroup *cg);
+/* cpu.stat (usage/user/system/throttled usec) and memory.peak (Linux >= 5.19)
+   into u, read before cg_destroy(); what the kernel doesn't have is left alone. */
+struct run_usage;
+void cg_usage(const struct cgroup *cg, struct run_usage *u);
+/* Kills anything left inside and removes the cgroup, waiting up to ~100 ms
+   for stragglers to leave. */
+void cg_destroy(struct cgroup *cg);
+/*
+ * The same without waiting, for event loops: 0 = removed (or gone). 1 = still
+ * populated: *events_fd is its cgroup.events, which polls POLLPRI when the
+ * population changes; call cg_remove_if_empty(cg->path, fd) then (1 =
+ * removed) and close the fd. cg->path is left for the caller to copy.
+ */
+int  cg_release(struct cgroup *cg, int *events_fd);
+int  cg_remove_if_empty(const char *path, int events_fd);
+
+#endif
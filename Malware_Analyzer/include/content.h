@@ -0,0 +1,82 @@
+#ifndef CONTENT_H
+#define CONTENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Content signals for the static pass: windowed entropy and byte-pattern
+ * rules, computed chunk by chunk in the same sweep that hashes the file.
+ *
+ * Rules are YARA-style strings, one per line:
+ *
+ *     upx       = "UPX!"
+ *     mz_stub   = { 4D 5A ?? 00 }       hex bytes, ?? = any byte
+ *     push_imm  = { 6? ?? ?? ?? ?? C3 } nibble wildcards too
+ *
+ * '#' starts a comment. Text strings take \\ \" \n \r \t \0 and \xHH.
+ * Every rule's longest run of fixed bytes goes into one Aho-Corasick
+ * automaton; a hit on that anchor is then checked against the whole
+ * pattern in place (the view is one contiguous mapping, so nothing is
+ * buffered or copied).
+ *
+ * Entropy uses 4 KiB blocks; each window is two adjacent blocks (8 KiB,
+ * sliding by 4 KiB). Windows above CONTENT_HIGH_ENTROPY bits/byte are
+ * "high" and the longest run of them is reported: a packed or encrypted
+ * payload shows up as one long run.
+ */
+
+#define CONTENT_BLOCK         4096
+#define CONTENT_WINDOW        (2 * CONTENT_BLOCK)
+#define CONTENT_HIGH_ENTROPY  7.2
+#define CONTENT_MAX_PATTERN   256
+
+struct rule_set;
+
+struct rule_set *rules_new(void);
+void rules_free(struct rule_set *rs);
+/* spec is "text" or { hex }. -1 with a reason in err on a bad spec. */
+int  rules_add(struct rule_set *rs, const char *name, const char *spec, char *err, size_t errlen);
+/* name = spec lines; -1 (err names the line) on the first bad one. */
+int  rules_add_file(struct rule_set *rs, const char *path, char *err, size_t errlen);
+/* the built-in set: packers, embedded executables, ICS/OT and miner strings */
+int  rules_add_builtin(struct rule_set *rs);
+/* Build the automaton; after the last rules_add*() and before scanning. */
+int  rules_compile(struct rule_set *rs, char *err, size_t errlen);
+size_t rules_count(const struct rule_set *rs);
+const char *rules_name(const struct rule_set *rs, size_t i);
+
+struct content_report {
+    uint64_t bytes;
+    double   entropy;               /* whole file */
+    double   max_window;            /* highest window entropy ... */
+    uint64_t max_window_off;        /* ... and where that window starts */
+    uint64_t windows, high_windows;
+    uint64_t run_off, run_len;      /* longest stretch covered by high windows */
+    size_t   nrules;
+    uint64_t *hits;                 /* per rule: match count ... */
+    uint64_t *first;                /* ... and first match offset */
+};
+
+/* Streaming state; feed it the view in order, one chunk at a time. */
+struct content_scan {
+    const struct rule_set *rules;
+    struct content_report rep;
+    const unsigned char *base;      /* start of the view (for pattern checks) */
+    uint64_t base_len;
+    uint32_t state;                 /* automaton state (row offset) carried across chunks */
+    uint64_t hist[256];             /* whole-file histogram */
+    uint16_t prev[256];             /* previous block's histogram */
+    uint32_t prev_n;
+    uint64_t cur_off, cur_len;      /* open run of high windows */
+};
+
+/* rules may be NULL (entropy only). -1 if allocation fails. */
+int  content_begin(struct content_scan *cs, const struct rule_set *rules,
+                   const unsigned char *base, size_t len);
+/* [off, off+n) of the base view; chunks must be CONTENT_BLOCK multiples except the last */
+void content_feed(struct content_scan *cs, size_t off, size_t n);
+void content_end(struct content_scan *cs);
+void content_free(struct content_scan *cs);
+
+#endif
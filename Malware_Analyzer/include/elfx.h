@@ -22,5 +22,100 @@ struct elf_summary {
  * Returns 0 on success, -1 on failure (error message in errbuf)
  */
 int elf_summarize(const char *path, struct elf_summary *out, char *errbuf, size_t errlen);
+/* Same, over bytes the caller already has (e.g. a map_file() view). */
+int elf_summarize_buf(const unsigned char *buf, size_t len, struct elf_summary *out,
+                      char *errbuf, size_t errlen);
+
+/*
+ * Lazy view over an ELF image held in memory (normally a map_file() view).
+ *
+ * elf_open() decodes the file header only. Section headers, program
+ * headers, symbols, dynamic entries and notes are decoded one entry at a
+ * time when asked for, straight out of the buffer: nothing is copied and
+ * nothing is allocated. Either byte order works on either host; fields are
+ * swapped as they are read. Every offset is bounds-checked against the
+ * buffer, so a truncated or hostile file yields errors, never wild reads.
+ *
+ * Names point into the buffer and are always NUL-terminated there ("" when
+ * the string table is missing or the name runs off its end).
+ */
+struct elf_view {
+    const unsigned char *buf;
+    size_t len;
+    bool is64;
+    bool swap;                  /* file byte order != host byte order */
+    uint8_t data;               /* ELFDATA2LSB / ELFDATA2MSB */
+    uint16_t type, machine;
+    uint64_t entry;
+    uint64_t phoff, shoff;
+    uint16_t phentsize, shentsize;
+    uint32_t phnum, shnum;      /* extended numbering resolved; 0 if the table is unusable */
+    uint32_t shstrndx;
+    const char *shstr;          /* section name table, NULL if unusable */
+    size_t shstr_len;
+};
+
+struct elf_section {
+    const char *name;
+    uint32_t type;
+    uint64_t flags, addr, offset, size, entsize, addralign;
+    uint32_t link, info;
+    const unsigned char *data;  /* NULL for SHT_NOBITS or out-of-file ranges */
+};
+
+struct elf_segment {
+    uint32_t type, flags;
+    uint64_t offset, vaddr, filesz, memsz, align;
+    const unsigned char *data;  /* file bytes, NULL when out of range */
+};
+
+/* A symbol table section plus the string table its names live in. */
+struct elf_symtab {
+    const unsigned char *data;
+    size_t count, entsize;
+    const char *strtab;
+    size_t strtab_len;
+};
+
+struct elf_symbol {
+    const char *name;
+    uint64_t value, size;
+    uint8_t bind, type;         /* STB_*, STT_* */
+    uint16_t shndx;             /* SHN_UNDEF = imported */
+};
+
+struct elf_note {
+    const char *name;           /* "GNU", "Go", ... */
+    uint32_t type;
+    const unsigned char *desc;
+    uint32_t descsz;
+};
+
+/* 0 on success; -1 with a reason in err when the header itself is bad. */
+int elf_open(struct elf_view *v, const unsigned char *buf, size_t len, char *err, size_t errlen);
+
+/* Section i (0 <= i < v->shnum); -1 when the header is out of the file. */
+int elf_section(const struct elf_view *v, uint32_t i, struct elf_section *out);
+/* First section of the given SHT_* type; its index, or -1. */
+int elf_find_section(const struct elf_view *v, uint32_t type, struct elf_section *out);
+/* Program header i (0 <= i < v->phnum). */
+int elf_segment(const struct elf_view *v, uint32_t i, struct elf_segment *out);
+
+/* SHT_SYMTAB or SHT_DYNSYM; -1 when the file has no such table. */
+int elf_symtab_open(const struct elf_view *v, uint32_t type, struct elf_symtab *st);
+int elf_symbol(const struct elf_view *v, const struct elf_symtab *st, size_t i, struct elf_symbol *out);
+
+/*
+ * DT_NEEDED entries, in file order. Uses the dynamic section when there is
+ * one and falls back to PT_DYNAMIC + DT_STRTAB (section-stripped samples).
+ * The callback returns nonzero to stop. Returns the number visited.
+ */
+int elf_foreach_needed(const struct elf_view *v, int (*cb)(const char *lib, void *ctx), void *ctx);
+/* Notes from SHT_NOTE sections, or PT_NOTE segments when there are none. */
+int elf_foreach_note(const struct elf_view *v, int (*cb)(const struct elf_note *n, void *ctx), void *ctx);
+
+const char *elf_section_type_name(uint32_t type);
+const char *elf_segment_type_name(uint32_t type);
+const char *elf_machine_name(uint16_t machine);
 
 #endif
@@ -11,4 +11,23 @@ struct jail_opts {
 int jail_enter(const struct jail_opts *opt, char *err, size_t errlen);
 /* Call in the CHILD before exec(): unshare ns, setup mounts, chroot, chdir("/") */
 
+/* A jail built once and entered by many children. jail_prepare() builds
+ * the namespace and bind tree in a short-lived helper and keeps a handle
+ * to its mount namespace. jail_attach() is the per-child part: setns,
+ * a private tmpfs /tmp, then chroot. It is only syscalls, so it is safe in
+ * a vfork()ed child. */
+struct jail_prep {
+    int mnt_fd;       /* /proc/<helper>/ns/mnt */
+    int net_fd;       /* /proc/<helper>/ns/net, or -1 */
+    char root[256];
+    char tmp[272];    /* root + "/tmp" */
+};
+
+int  jail_prepare(const struct jail_opts *opt, struct jail_prep *jp, char *err, size_t errlen);
+int  jail_attach(const struct jail_prep *jp);   /* -1 with errno */
+/* Drops the namespace and removes the empty root. Only once every child
+   is gone: removing a directory also detaches what other namespaces have
+   mounted on it. */
+void jail_release(struct jail_prep *jp);
+
 #endif
@@ -0,0 +1,26 @@
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+/*
+ * Hardware counters for the next child this process starts. The events are
+ * opened on ourselves, disabled, with inherit and enable_on_exec: a child
+ * forked (or vforked) afterwards gets its own copy, which starts counting at
+ * its exec, and what it and its descendants counted is added back to ours
+ * as they exit. We never exec, so our own copy stays at zero.
+ *
+ * Only user space is counted, which perf_event_paranoid 2 (the common
+ * default) still allows. Every child started while the events are open is
+ * included, so this only fits one sample at a time (malx run, not batches).
+ */
+
+struct perf_counters {
+    int cycles_fd, instr_fd;    /* -1 = not available */
+};
+
+/* Best effort: either fd may be -1 (no PMU in a VM, perf_event_paranoid 3, ...). */
+void perf_child_open(struct perf_counters *pc);
+/* Totals once the child is reaped; -1 for a counter that isn't there. */
+void perf_child_read(const struct perf_counters *pc, long long *cycles, long long *instructions);
+void perf_child_close(struct perf_counters *pc);
+
+#endif
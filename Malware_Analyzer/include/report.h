@@ -2,7 +2,9 @@
 #define REPORT_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "elfx.h"  // <-- important
+#include "content.h"
 
 struct report_opts {
     bool json;
@@ -12,5 +14,33 @@ struct report_opts {
 void print_static_report(const char *file, const char sha256[65],
                          const struct elf_summary *s,
                          const struct report_opts *opt);
+/*
+ * Same, plus sections/segments/imports/notes decoded from deep, and the
+ * entropy/rule results in content (either may be NULL; rules names the hits).
+ * s may be NULL for a file that isn't ELF: "elf": null / "ELF: none".
+ */
+void print_static_report_ex(const char *file, const char sha256[65],
+                            const struct elf_summary *s, const struct elf_view *deep,
+                            const struct content_report *content, const struct rule_set *rules,
+                            const struct report_opts *opt);
+
+/* JSON string literal (quotes included) with control bytes escaped */
+void json_write_str(FILE *out, const char *s);
+
+/*
+ * "usage":{...} for a run (rusage, cgroup, perf; unavailable ones are null).
+ * indent NULL = one line, else one key per line starting with indent.
+ */
+struct run_usage;
+void json_write_usage(FILE *out, const struct run_usage *u, const char *indent);
+
+/*
+ * One NDJSON record per file for `malx scan`:
+ *   {"file":...,"sha256":...,"elf":{...}}              on success
+ *   {"file":...,"sha256":...|null,"elf":null,"error":...,"stage":...}
+ * sha256 and s may be NULL. Writes a single line; the caller serializes.
+ */
+void print_scan_record(FILE *out, const char *file, const char *sha256,
+                       const struct elf_summary *s, const char *stage, const char *error);
 
 #endif
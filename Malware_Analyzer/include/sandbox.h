@@ -1,6 +1,8 @@
 #ifndef SANDBOX_H
 #define SANDBOX_H
 
+#include <sys/types.h>
+
 struct limits {
     int  timeout_sec;   /* wall-clock timeout */
     long mem_bytes;     /* RLIMIT_AS   */
@@ -8,13 +10,61 @@ struct limits {
     int  nofile;        /* RLIMIT_NOFILE */
 };
 
+/* What a run cost; -1 wherever that source was not available. */
+struct run_usage {
+    /* rusage from reaping it: the sample plus the descendants it waited for */
+    long utime_us, stime_us;
+    long maxrss_kb;
+    long minflt, majflt;
+    long nvcsw, nivcsw;     /* voluntary / involuntary context switches */
+    /* cgroup v2 cpu.stat and memory.peak: everything that ran in its cgroup */
+    long long cg_usage_us, cg_user_us, cg_system_us, cg_throttled_us;
+    long long cg_mem_peak;  /* bytes */
+    /* perf_event_open, user space only (malx run) */
+    long long cycles, instructions;
+};
+
 struct run_result {
     int  exit_code;
     int  term_signal;
     int  killed_by_timeout;
     long elapsed_ms;
+    long setup_us;      /* spawn until the sample's exec (jail, limits, seccomp) */
+    struct run_usage usage;
+};
+
+struct sandbox_prep;
+struct sock_fprog;
+
+/* Knobs for sandbox_spawn(); run_in_sandbox() is spawn + wait. */
+struct spawn_opts {
+    const struct limits *lim;
+    int no_net;
+    int use_jail;
+    int cgroup_fd;      /* cgroup.procs to join before anything else, -1 = none;
+                           the cgroup's memory.max replaces RLIMIT_AS */
+    int quiet;          /* stdin/stdout/stderr on /dev/null */
+    const struct sandbox_prep *prep;  /* from sandbox_prepare(); NULL = fork and set up from scratch */
+    int traceme;        /* PTRACE_TRACEME first: the child stops at its exec SIGTRAP
+                           for the caller, who sets the ptrace options there */
+    const struct sock_fprog *filter;  /* extra seccomp program, loaded last (NULL = none) */
 };
 
+/* Start the sandboxed child and return once it has exec'd (or failed to:
+   it then exits 127); the caller reaps it, or with traceme traces it.
+   setup_us (may be NULL) gets the time that took. */
+int sandbox_spawn(const char *path, char *const argv[], const struct spawn_opts *o,
+                  pid_t *pid, long *setup_us);
+
+/* Everything about a launch that does not change from sample to sample,
+   done once: the rlimit table, the no-net seccomp program compiled to BPF,
+   /dev/null, and a prepared jail (namespace and bind tree, see jail.h).
+   Children started with it are clone(CLONE_VM|CLONE_VFORK)ed and only
+   apply the result, so they cost neither a page-table copy nor jail setup.
+   NULL with a reason in err. */
+struct sandbox_prep *sandbox_prepare(const struct spawn_opts *o, char *err, size_t errlen);
+void sandbox_prep_free(struct sandbox_prep *p);
+
 int run_in_sandbox(const char *path, char *const argv[],
                    const struct limits *lim, int no_net,
                    int use_jail,                /* Phase 4: NEW */
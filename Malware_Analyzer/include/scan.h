@@ -0,0 +1,31 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+#include "cache.h"
+
+struct scan_opts {
+    char *const *roots;   /* directories, files, or @listfile (@- = stdin) */
+    int nroots;
+    int jobs;             /* worker threads (<= 0: one per online CPU) */
+    struct malx_cache *cache;   /* NULL = uncached */
+};
+
+struct scan_stats {
+    unsigned long files;
+    unsigned long errors; /* records that carry an "error" */
+    unsigned long not_elf;/* ...of which the file was fine, just not ELF */
+};
+
+/*
+ * Batch triage: walk every root and run the static pass (ELF summary +
+ * SHA-256) on a worker pool, one NDJSON record per file on stdout.
+ * Paths flow through a bounded queue, so the walker blocks when the
+ * workers fall behind and memory stays flat however big the tree is.
+ * Per-file failures become records with "error"; only setup failures
+ * make this return -1.
+ */
+int scan_run(const struct scan_opts *opt, struct scan_stats *st);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef STATIC_H
+#define STATIC_H
+
+#include "elfx.h"
+#include "cache.h"
+#include "content.h"
+
+struct static_result {
+    char sha256[65];        /* "" when the file couldn't be read */
+    int  elf_ok;
+    struct elf_summary sum; /* valid when elf_ok */
+    char err[256];
+    const char *stage;      /* "open" / "elf" / "hash" / "content" on failure, else NULL */
+    int  cached;            /* answered from the cache */
+};
+
+/*
+ * The static pass shared by `static` and `scan`: map once, summarize the
+ * ELF, stream the SHA-256. With a cache, an unchanged file (same inode,
+ * size and times) is answered without reading it, and a file whose
+ * SHA-256 is known (a copy under another name) is hashed but not parsed
+ * again. Returns 0 when the file is a parsable ELF.
+ */
+int static_analyze(const char *path, struct malx_cache *cache, struct static_result *r);
+/*
+ * Same, plus entropy windows and rule matches (rules may be NULL) computed
+ * in the hashing sweep; the caller content_free()s cs. This always reads
+ * the file (no stat shortcut); the static result is still cached.
+ */
+int static_analyze_content(const char *path, struct malx_cache *cache, const struct rule_set *rules,
+                           struct content_scan *cs, struct static_result *r);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SUPERVISE_H
+#define SUPERVISE_H
+
+#include <sys/types.h>
+
+#include "sandbox.h"
+
+/*
+ * Event-driven supervision of any number of sandboxed children.
+ *
+ * Each watched child gets a pidfd (readable once it exits) and, with a
+ * timeout, a timerfd; both sit in one epoll set, so the supervisor sleeps
+ * until something actually happens. A timer expiry SIGKILLs the child
+ * through its pidfd (no pid-reuse race); the child is then reaped through
+ * the pidfd as usual and reported with killed_by_timeout set.
+ *
+ * Needs Linux >= 5.3 (pidfd_open, waitid(P_PIDFD)).
+ */
+
+struct supervisor;
+
+struct sup_exit {
+    pid_t pid;
+    void *tag;                  /* as given to sup_watch() */
+    struct run_result res;
+};
+
+struct supervisor *sup_open(void);
+/* Kills and reaps whatever is still running. */
+void sup_close(struct supervisor *s);
+
+/* Watch a child of this process; timeout_sec <= 0 = no limit. -1 + errno. */
+int sup_watch(struct supervisor *s, pid_t pid, int timeout_sec, void *tag);
+/* Children still running. */
+int sup_count(const struct supervisor *s);
+/* Blocks until a child exits: 1 with *out filled, 0 when none are left, -1 + errno. */
+int sup_next(struct supervisor *s, struct sup_exit *out);
+
+/*
+ * Tear down a finished sample's cgroup without blocking the loop: cgroup.kill,
+ * then the rmdir happens from sup_next() when cgroup.events reports
+ * "populated 0" (sup_close() waits up to a second for what is left). cg is
+ * done with on return. 0, or -1 when it had to wait inline after all.
+ */
+struct cgroup;
+int sup_reap_cgroup(struct supervisor *s, struct cgroup *cg);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef SYSCALLS_H
+#define SYSCALLS_H
+
+/* Syscall number <-> name for the traced ABI (x86_64 only for now). */
+
+#define SYSCALL_MAX 512     /* numbers at or above this are never named */
+
+const char *syscall_name(long nr);          /* NULL if unknown */
+long syscall_number(const char *name);      /* name or decimal number; -1 if unknown */
+/* Bit i set: argument i is a NUL-terminated path or string (execve, openat, ...). */
+unsigned syscall_string_args(long nr);
+
+#endif
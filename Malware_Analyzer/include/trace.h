@@ -6,9 +6,18 @@ struct trace_opts {
     int max_events;
     int json;     /* 1=JSON, else text */
     int pretty;  /* pretty JSON */
+    int ndjson;  /* with json: one event per line, no wrapper object */
     int jail;    /* 1=enter jail before exec */
+    int summary; /* aggregate per syscall (strace -c style) instead of logging events */
+    /* Filtered mode: a seccomp filter stops the tracee only on these
+       syscall numbers; everything else runs untraced at native speed.
+       NULL/0 = stop on every syscall (the original behaviour). */
+    const long *syscalls;
+    int nsyscalls;
 };
 
+#define TRACE_MAX_FILTER 200   /* BPF jump offsets are 8 bits */
+
 /* argv: child argv vector (path must be argv[0]); pass NULL for just path */
 int trace_process(const char *path, char *const argv[], const struct trace_opts *opt);
 
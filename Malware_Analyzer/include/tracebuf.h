@@ -0,0 +1,48 @@
+#ifndef TRACEBUF_H
+#define TRACEBUF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Trace events go through a preallocated ring of fixed-size binary records.
+ * The tracer only fills a record while the tracee is stopped (registers
+ * plus any string arguments, copied out of the tracee); a writer thread
+ * drains the ring in batches and does all of the formatting, so stdout
+ * speed never stretches a ptrace stop.
+ *
+ * The ring never grows. When it is full the tracer waits for the writer,
+ * so the memory used is TRACE_RING_EVENTS records whatever the trace length.
+ */
+
+#define TRACE_RING_EVENTS 4096
+#define TRACE_STR_LEN     128     /* per decoded string, NUL included; longer ones end in "..." */
+#define TRACE_STR_SLOTS   2       /* string arguments kept per event */
+
+enum { TRACE_ENTER = 0, TRACE_EXIT = 1 };
+enum { TRACE_OUT_TEXT = 0, TRACE_OUT_JSON = 1, TRACE_OUT_NDJSON = 2 };
+
+struct trace_event {
+    uint64_t t_ns;                        /* since the trace started */
+    int32_t  tid;
+    uint8_t  kind;                        /* TRACE_ENTER / TRACE_EXIT */
+    uint8_t  nstr;                        /* strings decoded (enter only) */
+    uint8_t  str_arg[TRACE_STR_SLOTS];    /* which argument each string is */
+    int64_t  nr;
+    int64_t  args[6];                     /* enter */
+    int64_t  ret, dur_ns;                 /* exit */
+    char     str[TRACE_STR_SLOTS][TRACE_STR_LEN];
+};
+
+struct trace_ring;
+
+/* Starts the writer on its own buffered stream over stdout; NULL on failure. */
+struct trace_ring *ring_open(int format, int pretty);
+/* Next free record, waiting for the writer if the ring is full. */
+struct trace_event *ring_reserve(struct trace_ring *r);
+/* Publishes the record returned by the last ring_reserve(). */
+void ring_commit(struct trace_ring *r);
+/* Drains what is left, closes the document and joins the writer. */
+void ring_close(struct trace_ring *r);
+
+#endif
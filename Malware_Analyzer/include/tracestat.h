@@ -0,0 +1,44 @@
+#ifndef TRACESTAT_H
+#define TRACESTAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "syscalls.h"
+
+/*
+ * `malx trace --summary`: instead of logging events, the tracer aggregates
+ * them in place, like strace -c. One fixed slot per syscall number (plus
+ * one for numbers past SYSCALL_MAX), so memory is the same for a 10 ms
+ * run and for one that uses the whole timeout, and nothing is written
+ * until the trace ends.
+ *
+ * Latency is kept as a log2 histogram in microseconds: hist[0] counts
+ * calls under 1 us, hist[i] those in [2^(i-1), 2^i) us, and the last
+ * bucket everything from 2^(TRACE_HIST_BUCKETS-2) us up.
+ */
+
+#define TRACE_HIST_BUCKETS 24     /* last bucket: 4.2 s and longer */
+
+struct trace_stat {
+    uint64_t calls;           /* entries seen */
+    uint64_t done;            /* exits seen: calls that never return (exit_group) don't have one */
+    uint64_t errors;          /* exits with -4095..-1 */
+    uint64_t total_ns, max_ns;
+    uint64_t hist[TRACE_HIST_BUCKETS];
+};
+
+struct trace_summary {
+    struct trace_stat sc[SYSCALL_MAX + 1];
+    uint64_t tasks;           /* tasks followed: the sample plus every fork/clone */
+    long t_start, t_end;      /* CLOCK_MONOTONIC ns */
+};
+
+/* One syscall entry / exit (ret = rax, dur_ns since its entry) */
+void summary_enter(struct trace_summary *s, long nr);
+void summary_exit(struct trace_summary *s, long nr, int64_t ret, int64_t dur_ns);
+
+/* The whole table, busiest (total time) first; format is a TRACE_OUT_* */
+void summary_print(FILE *out, const struct trace_summary *s, int format, int pretty);
+
+#endif
@@ -3,8 +3,31 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/*
+ * Read-only view of a whole file. Regular files are mmapped (nothing is
+ * copied; pages come in on demand); anything else (pipes, /dev/stdin) is
+ * read into a heap buffer so callers see the same thing either way.
+ */
+struct file_view {
+    const unsigned char *data;
+    size_t len;
+    int mapped;     /* 1 = munmap on release, 0 = free() */
+};
+
+int  map_file(const char *path, struct file_view *fv, char *err, size_t errlen);
+void unmap_file(struct file_view *fv);
+
 int read_file(const char *path, unsigned char **buf, size_t *len, char *err, size_t errlen);
 int sha256_hex(const unsigned char *buf, size_t len, char out_hex[65]);
+/* Hash a view chunk by chunk, dropping mapped pages behind the cursor so
+   resident memory stays flat regardless of file size. */
+int sha256_hex_view(const struct file_view *fv, char out_hex[65]);
+/* Same, calling chunk(ctx, off, n) on each 64 KiB slice right after it is
+   hashed, while it is still in cache, so other passes ride on the same read. */
+int sha256_hex_view_cb(const struct file_view *fv, char out_hex[65],
+                       void (*chunk)(void *ctx, size_t off, size_t n), void *ctx);
 
-#endif
+/* Shannon entropy in bits per byte (0..8); packed/encrypted data sits near 8. */
+double byte_entropy(const unsigned char *p, size_t n);
 
+#endif
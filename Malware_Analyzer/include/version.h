@@ -0,0 +1,8 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+#ifndef MALX_VERSION
+#define MALX_VERSION "1.0.0"
+#endif
+
+#endif
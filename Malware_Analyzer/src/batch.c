@@ -0,0 +1,220 @@
+#include <errno.h>
+#include <ftw.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "report.h"
+#include "supervise.h"
+
+/* -------- sample list -------- */
+struct path_list {
+    char **v;
+    size_t n, cap;
+};
+static struct path_list *g_list;     /* nftw() callbacks take no user pointer */
+
+static int list_add(struct path_list *l, const char *p) {
+    if (l->n == l->cap) {
+        size_t nc = l->cap ? l->cap * 2 : 64;
+        char **nv = realloc(l->v, nc * sizeof *nv);
+        if (!nv) return -1;
+        l->v = nv;
+        l->cap = nc;
+    }
+    if (!(l->v[l->n] = strdup(p))) return -1;
+    l->n++;
+    return 0;
+}
+
+static void emit_error(const char *file, const char *stage, const char *err) {
+    fputs("{\"file\":", stdout);
+    json_write_str(stdout, file);
+    fputs(",\"error\":", stdout);
+    json_write_str(stdout, err);
+    fprintf(stdout, ",\"stage\":\"%s\"}\n", stage);
+    fflush(stdout);
+}
+
+static int walk_cb(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st; (void)ftw;
+    if (type == FTW_F && list_add(g_list, path) != 0) return -1;
+    if (type == FTW_DNR) emit_error(path, "walk", "cannot read directory");
+    return 0;
+}
+
+static void collect(const char *root) {
+    if (nftw(root, walk_cb, 32, FTW_PHYS) != 0) emit_error(root, "walk", strerror(errno));
+}
+
+/* @list: one path per line; blank lines and '#' comments skipped */
+static void collect_list(const char *list) {
+    FILE *f = strcmp(list, "-") ? fopen(list, "r") : stdin;
+    if (!f) { emit_error(list, "list", strerror(errno)); return; }
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        while (n > 0 && (line[n-1] == '\n' || line[n-1] == '\r')) line[--n] = '\0';
+        if (n == 0 || line[0] == '#') continue;
+        collect(line);
+    }
+    free(line);
+    if (f != stdin) fclose(f);
+}
+
+/* -------- jobs -------- */
+struct job {
+    const char *path;
+    struct cgroup cg;
+    int has_cg;
+    long setup_us;
+};
+
+static void emit_run(const struct job *j, const struct run_result *r, int oom, int cgroups) {
+    fputs("{\"file\":", stdout);
+    json_write_str(stdout, j->path);
+    fprintf(stdout, ",\"run\":{\"exit_code\":%d,\"term_signal\":%d,\"timeout\":%s,\"oom\":%s,\"elapsed_ms\":%ld,"
+                    "\"setup_us\":%ld,",
+            r->exit_code, r->term_signal, r->killed_by_timeout ? "true" : "false", oom ? "true" : "false",
+            r->elapsed_ms, j->setup_us);
+    json_write_usage(stdout, &r->usage, NULL);
+    fprintf(stdout, "},\"limits\":\"%s\"}\n", cgroups ? "cgroup" : "rlimit");
+    fflush(stdout);
+}
+
+static int pick_jobs(const struct batch_opts *o) {
+    int jobs = o->jobs;
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long per = o->cg.mem_bytes > 0 ? o->cg.mem_bytes : o->lim.mem_bytes;
+    if (o->budget_bytes > 0 && per > 0 && o->budget_bytes / per < jobs) jobs = (int)(o->budget_bytes / per);
+    if (jobs < 1) jobs = 1;
+    if (jobs > BATCH_MAX_JOBS) jobs = BATCH_MAX_JOBS;
+    return jobs;
+}
+
+/* 0 = running and watched; -1 = failed, already reported */
+static int launch(struct supervisor *sup, const struct batch_opts *o, const struct cg_root *root,
+                  const struct sandbox_prep *prep, struct job *j, char **argv, unsigned long seq) {
+    char err[256];
+    if (access(j->path, X_OK) != 0) { emit_error(j->path, "spawn", strerror(errno)); return -1; }
+
+    j->has_cg = 0;
+    if (root) {
+        char name[32];
+        snprintf(name, sizeof name, "s%lu", seq);
+        if (cg_create(root, name, &o->cg, &j->cg, err, sizeof err) != 0) { emit_error(j->path, "cgroup", err); return -1; }
+        j->has_cg = 1;
+    }
+
+    argv[0] = (char *)j->path;
+    struct spawn_opts so = { .lim = &o->lim, .no_net = o->no_net, .use_jail = o->use_jail,
+                             .cgroup_fd = j->has_cg ? j->cg.procs_fd : -1, .quiet = 1, .prep = prep };
+    pid_t pid;
+    if (sandbox_spawn(j->path, argv, &so, &pid, &j->setup_us) != 0) {
+        emit_error(j->path, "spawn", strerror(errno));
+        if (j->has_cg) cg_destroy(&j->cg);
+        return -1;
+    }
+    if (sup_watch(sup, pid, o->lim.timeout_sec, j) != 0) {
+        emit_error(j->path, "spawn", strerror(errno));
+        kill(pid, SIGKILL);
+        (void)waitpid(pid, NULL, 0);
+        if (j->has_cg) cg_destroy(&j->cg);
+        return -1;
+    }
+    return 0;
+}
+
+int batch_run(const struct batch_opts *o, struct batch_stats *st) {
+    struct path_list list = {0};
+    g_list = &list;
+    for (int i = 0; i < o->ninputs; ++i) {
+        const char *r = o->inputs[i];
+        if (r[0] == '@') collect_list(r + 1);
+        else collect(r);
+    }
+    g_list = NULL;
+
+    memset(st, 0, sizeof *st);
+    st->jobs = pick_jobs(o);
+
+    struct cg_root root;
+    char err[256];
+    int use_cg = o->cg.mem_bytes > 0 || o->cg.cpu_pct > 0 || o->cg.pids > 0;
+    if (use_cg && cg_root_open(&root, o->cgroup_parent, &o->cg, err, sizeof err) != 0) {
+        fprintf(stderr, "run-batch: cgroup limits unavailable (%s); using rlimits\n", err);
+        use_cg = 0;
+    }
+    st->cgroups = use_cg;
+
+    struct sandbox_prep *prep = NULL;
+    if (!o->fork_each) {
+        struct spawn_opts so = { .lim = &o->lim, .no_net = o->no_net, .use_jail = o->use_jail,
+                                 .cgroup_fd = -1, .quiet = 1 };
+        if (!(prep = sandbox_prepare(&so, err, sizeof err)))
+            fprintf(stderr, "run-batch: cannot prepare the sandbox (%s); forking per sample\n", err);
+    }
+
+    struct supervisor *sup = sup_open();
+    struct job *jobs = calloc((size_t)st->jobs, sizeof *jobs);
+    char **argv = calloc((size_t)o->nargs + 2, sizeof *argv);
+    if (!sup || !jobs || !argv) {
+        perror("run-batch");
+        sup_close(sup); free(jobs); free(argv);
+        sandbox_prep_free(prep);
+        if (use_cg) cg_root_close(&root);
+        for (size_t i = 0; i < list.n; ++i) free(list.v[i]);
+        free(list.v);
+        return -1;
+    }
+    for (int i = 0; i < o->nargs; ++i) argv[1 + i] = o->args[i];
+
+    /* free job slots are those with no path */
+    size_t next = 0;
+    for (;;) {
+        for (int k = 0; k < st->jobs && next < list.n; ++k) {
+            if (jobs[k].path) continue;
+            jobs[k].path = list.v[next];
+            if (launch(sup, o, use_cg ? &root : NULL, prep, &jobs[k], argv, (unsigned long)next) != 0) {
+                jobs[k].path = NULL;
+                st->runs++;
+                st->failed++;
+            }
+            next++;
+        }
+        if (sup_count(sup) == 0) {
+            if (next < list.n) continue;
+            break;
+        }
+
+        struct sup_exit ex;
+        int rc = sup_next(sup, &ex);
+        if (rc < 0) { perror("run-batch: supervisor"); break; }
+        if (rc == 0) continue;
+
+        struct job *j = ex.tag;
+        int oom = j->has_cg && cg_oom_killed(&j->cg);
+        if (j->has_cg) cg_usage(&j->cg, &ex.res.usage);
+        emit_run(j, &ex.res, oom, use_cg);
+        st->runs++;
+        if (ex.res.killed_by_timeout) st->timeouts++;
+        if (ex.res.exit_code != 0 || ex.res.term_signal != 0) st->failed++;
+        if (j->has_cg) (void)sup_reap_cgroup(sup, &j->cg);
+        j->path = NULL;
+    }
+
+    sup_close(sup);                       /* kills anything left after an error, drains the cgroups */
+    for (int k = 0; k < st->jobs; ++k) if (jobs[k].path && jobs[k].has_cg) cg_destroy(&jobs[k].cg);
+    sandbox_prep_free(prep);              /* after the children: it unmounts the jail */
+    if (use_cg) cg_root_close(&root);
+    free(jobs);
+    free(argv);
+    for (size_t i = 0; i < list.n; ++i) free(list.v[i]);
+    free(list.v);
+    return 0;
+}
@@ -0,0 +1,321 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "version.h"
+
+#define CACHE_MAGIC    "MALXC\0\0\1"
+#define CACHE_WAYS     8
+#define CACHE_DEFAULT  32768
+#define CACHE_ERRLEN   96
+
+enum { K_EMPTY = 0, K_HASH = 1, K_STATIC = 2, K_RUN = 3 };
+
+struct cache_entry {
+    uint8_t  kind;
+    uint8_t  elf_ok;
+    uint8_t  pad[6];
+    uint8_t  key[32];       /* sha256, or digest of the stat fingerprint */
+    uint64_t tag;           /* K_RUN: configuration */
+    uint64_t last_used;     /* LRU tick */
+    union {
+        char sha_hex[65];
+        struct { struct elf_summary s; char err[CACHE_ERRLEN]; } st;
+        struct run_result run;
+    } u;
+};
+
+struct cache_header {
+    char     magic[8];
+    char     version[48];   /* analyzer version + record layout */
+    uint64_t nsets;
+    uint64_t tick;
+};
+
+struct malx_cache {
+    int fd;
+    void *map;
+    size_t map_len;
+    struct cache_header *hdr;
+    struct cache_entry *ents;
+    pthread_mutex_t mu;
+};
+
+static void layout_version(char out[48]) {
+    memset(out, 0, 48);
+    snprintf(out, 48, "%s/e%zu/s%zu/r%zu", MALX_VERSION, sizeof(struct cache_entry),
+             sizeof(struct elf_summary), sizeof(struct run_result));
+}
+
+static int mkdir_p(char *path) {
+    for (char *p = path + 1; *p; ++p) {
+        if (*p != '/') continue;
+        *p = '\0';
+        int rc = mkdir(path, 0700);
+        *p = '/';
+        if (rc != 0 && errno != EEXIST) return -1;
+    }
+    return (mkdir(path, 0700) == 0 || errno == EEXIST) ? 0 : -1;
+}
+
+static int cache_dir(char *out, size_t n) {
+    const char *d = getenv("MALX_CACHE_DIR");
+    if (d && *d) return snprintf(out, n, "%s", d) < (int)n ? 0 : -1;
+    d = getenv("XDG_CACHE_HOME");
+    if (d && *d) return snprintf(out, n, "%s/malx", d) < (int)n ? 0 : -1;
+    d = getenv("HOME");
+    if (d && *d) return snprintf(out, n, "%s/.cache/malx", d) < (int)n ? 0 : -1;
+    return -1;
+}
+
+static size_t index_len(uint64_t nsets) {
+    return sizeof(struct cache_header) + (size_t)nsets * CACHE_WAYS * sizeof(struct cache_entry);
+}
+
+/* nsets of the index open on fd, 0 when it isn't one of ours (other
+   version, wrong size, empty) */
+static uint64_t index_valid(int fd, const char ver[48]) {
+    struct cache_header h;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || pread(fd, &h, sizeof h, 0) != (ssize_t)sizeof h) return 0;
+    if (memcmp(h.magic, CACHE_MAGIC, 8) || memcmp(h.version, ver, 48)) return 0;
+    if (h.nsets < 1 || h.nsets > (SIZE_MAX / 2) / (CACHE_WAYS * sizeof(struct cache_entry))) return 0;
+    return (size_t)st.st_size == index_len(h.nsets) ? h.nsets : 0;
+}
+
+/* A fresh, empty index under a temp name, renamed over path. The old file
+   is never resized or cleared in place: another malx may still have it
+   mapped, and shrinking it under them would SIGBUS. */
+static int index_replace(const char *path, uint64_t nsets, const char ver[48], char *err, size_t errlen) {
+    char tmp[4300];
+    snprintf(tmp, sizeof tmp, "%s.tmp.%ld", path, (long)getpid());
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) { snprintf(err, errlen, "open %s: %s", tmp, strerror(errno)); return -1; }
+    struct cache_header h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, CACHE_MAGIC, 8);
+    memcpy(h.version, ver, 48);
+    h.nsets = nsets;
+    int rc = ftruncate(fd, (off_t)index_len(nsets)) == 0 &&
+             pwrite(fd, &h, sizeof h, 0) == (ssize_t)sizeof h ? 0 : -1;
+    if (rc == 0 && rename(tmp, path) != 0) rc = -1;
+    if (rc != 0) { snprintf(err, errlen, "create %s: %s", path, strerror(errno)); unlink(tmp); }
+    close(fd);
+    return rc;
+}
+
+struct malx_cache *cache_open(char *err, size_t errlen) {
+    char dir[4096], path[4200];
+    if (cache_dir(dir, sizeof dir) != 0) { snprintf(err, errlen, "no cache directory"); return NULL; }
+    if (mkdir_p(dir) != 0) { snprintf(err, errlen, "mkdir %s: %s", dir, strerror(errno)); return NULL; }
+    snprintf(path, sizeof path, "%s/index", dir);
+
+    unsigned long want = CACHE_DEFAULT;
+    const char *e = getenv("MALX_CACHE_ENTRIES");
+    if (e && *e) want = strtoul(e, NULL, 10);
+    uint64_t want_sets = (want + CACHE_WAYS - 1) / CACHE_WAYS;
+    if (want_sets < 1) want_sets = 1;
+
+    char ver[48];
+    layout_version(ver);
+    int fd = -1;
+    uint64_t nsets = 0;
+    for (int attempt = 0; attempt < 4 && !nsets; ++attempt) {
+        if (fd >= 0) close(fd);
+        fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) { snprintf(err, errlen, "open %s: %s", path, strerror(errno)); return NULL; }
+        if (flock(fd, LOCK_EX) != 0) { snprintf(err, errlen, "flock: %s", strerror(errno)); close(fd); return NULL; }
+
+        /* someone may have renamed a new index in while we waited for the lock */
+        struct stat a, b;
+        if (fstat(fd, &a) != 0 || stat(path, &b) != 0 || a.st_ino != b.st_ino || a.st_dev != b.st_dev)
+            continue;
+        /* an existing index keeps its size: $MALX_CACHE_ENTRIES only sizes a new one */
+        if ((nsets = index_valid(fd, ver)) != 0) break;
+        if (index_replace(path, want_sets, ver, err, errlen) != 0) { close(fd); return NULL; }
+    }
+    if (!nsets) { snprintf(err, errlen, "%s keeps changing", path); close(fd); return NULL; }
+
+    size_t len = index_len(nsets);
+    void *m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    flock(fd, LOCK_UN);
+    if (m == MAP_FAILED) {
+        snprintf(err, errlen, "mmap: %s", strerror(errno));
+        close(fd); return NULL;
+    }
+    struct cache_header *h = m;
+
+    struct malx_cache *c = calloc(1, sizeof *c);
+    if (!c) { munmap(m, len); close(fd); snprintf(err, errlen, "calloc failed"); return NULL; }
+    c->fd = fd;
+    c->map = m;
+    c->map_len = len;
+    c->hdr = h;
+    c->ents = (struct cache_entry *)(h + 1);
+    pthread_mutex_init(&c->mu, NULL);
+    return c;
+}
+
+void cache_close(struct malx_cache *c) {
+    if (!c) return;
+    munmap(c->map, c->map_len);
+    close(c->fd);
+    pthread_mutex_destroy(&c->mu);
+    free(c);
+}
+
+/* flock() is per open file, so threads of one process also need the mutex */
+static void lock(struct malx_cache *c)   { pthread_mutex_lock(&c->mu); (void)flock(c->fd, LOCK_EX); }
+static void unlock(struct malx_cache *c) { (void)flock(c->fd, LOCK_UN); pthread_mutex_unlock(&c->mu); }
+
+static int hex_to_key(const char sha_hex[65], uint8_t key[32]) {
+    for (int i = 0; i < 32; ++i) {
+        unsigned v = 0;
+        for (int k = 0; k < 2; ++k) {
+            char ch = sha_hex[i*2 + k];
+            v <<= 4;
+            if (ch >= '0' && ch <= '9') v |= (unsigned)(ch - '0');
+            else if (ch >= 'a' && ch <= 'f') v |= (unsigned)(ch - 'a' + 10);
+            else return -1;
+        }
+        key[i] = (uint8_t)v;
+    }
+    return 0;
+}
+
+uint64_t cache_tag(uint64_t tag, const void *p, size_t n) {
+    if (!tag) tag = 1469598103934665603ULL;
+    const unsigned char *b = p;
+    for (size_t i = 0; i < n; ++i) { tag ^= b[i]; tag *= 1099511628211ULL; }
+    return tag;
+}
+
+static struct cache_entry *set_of(struct malx_cache *c, const uint8_t key[32]) {
+    uint64_t k;
+    memcpy(&k, key, sizeof k);
+    return c->ents + (k % c->hdr->nsets) * CACHE_WAYS;
+}
+
+/* caller holds the lock */
+static struct cache_entry *find(struct malx_cache *c, int kind, const uint8_t key[32], uint64_t tag) {
+    struct cache_entry *set = set_of(c, key);
+    for (int w = 0; w < CACHE_WAYS; ++w) {
+        struct cache_entry *e = &set[w];
+        if (e->kind == kind && e->tag == tag && !memcmp(e->key, key, 32)) {
+            e->last_used = ++c->hdr->tick;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* existing entry for the key, else an empty way, else the set's LRU way */
+static struct cache_entry *slot_for(struct malx_cache *c, int kind, const uint8_t key[32], uint64_t tag) {
+    struct cache_entry *e = find(c, kind, key, tag);
+    if (e) return e;
+    struct cache_entry *set = set_of(c, key), *victim = &set[0];
+    for (int w = 0; w < CACHE_WAYS; ++w) {
+        if (set[w].kind == K_EMPTY) { victim = &set[w]; break; }
+        if (set[w].last_used < victim->last_used) victim = &set[w];
+    }
+    memset(victim, 0, sizeof *victim);
+    victim->kind = (uint8_t)kind;
+    memcpy(victim->key, key, 32);
+    victim->tag = tag;
+    victim->last_used = ++c->hdr->tick;
+    return victim;
+}
+
+/* -------- stat fingerprint -> sha256 -------- */
+
+static void stat_key(const struct stat *st, uint8_t key[32]) {
+    uint64_t f[7] = {
+        (uint64_t)st->st_dev, (uint64_t)st->st_ino, (uint64_t)st->st_size,
+        (uint64_t)st->st_mtim.tv_sec, (uint64_t)st->st_mtim.tv_nsec,
+        (uint64_t)st->st_ctim.tv_sec, (uint64_t)st->st_ctim.tv_nsec,
+    };
+    for (int i = 0; i < 4; ++i) {                 /* 4 independent lanes, 256 bits */
+        uint64_t h = cache_tag(0x9e3779b97f4a7c15ULL * (uint64_t)(i + 1), f, sizeof f);
+        memcpy(key + i * 8, &h, 8);
+    }
+}
+
+int cache_get_hash(struct malx_cache *c, const struct stat *st, char sha_hex[65]) {
+    if (!c) return 0;
+    uint8_t key[32];
+    stat_key(st, key);
+    lock(c);
+    struct cache_entry *e = find(c, K_HASH, key, 0);
+    if (e) { memcpy(sha_hex, e->u.sha_hex, 64); sha_hex[64] = '\0'; }
+    unlock(c);
+    return e != NULL;
+}
+
+void cache_put_hash(struct malx_cache *c, const struct stat *st, const char sha_hex[65]) {
+    if (!c) return;
+    uint8_t key[32];
+    stat_key(st, key);
+    lock(c);
+    struct cache_entry *e = slot_for(c, K_HASH, key, 0);
+    memcpy(e->u.sha_hex, sha_hex, 65);
+    unlock(c);
+}
+
+/* -------- static results -------- */
+
+int cache_get_static(struct malx_cache *c, const char sha_hex[65], int *elf_ok,
+                     struct elf_summary *s, char *err, size_t errlen) {
+    uint8_t key[32];
+    if (!c || hex_to_key(sha_hex, key) != 0) return 0;
+    lock(c);
+    struct cache_entry *e = find(c, K_STATIC, key, 0);
+    if (e) {
+        *elf_ok = e->elf_ok;
+        *s = e->u.st.s;
+        if (err && errlen) snprintf(err, errlen, "%s", e->u.st.err);
+    }
+    unlock(c);
+    return e != NULL;
+}
+
+void cache_put_static(struct malx_cache *c, const char sha_hex[65], int elf_ok,
+                      const struct elf_summary *s, const char *err) {
+    uint8_t key[32];
+    if (!c || hex_to_key(sha_hex, key) != 0) return;
+    lock(c);
+    struct cache_entry *e = slot_for(c, K_STATIC, key, 0);
+    e->elf_ok = (uint8_t)(elf_ok != 0);
+    if (elf_ok && s) e->u.st.s = *s;
+    snprintf(e->u.st.err, sizeof e->u.st.err, "%s", err ? err : "");
+    unlock(c);
+}
+
+/* -------- run results -------- */
+
+int cache_get_run(struct malx_cache *c, const char sha_hex[65], uint64_t tag, struct run_result *r) {
+    uint8_t key[32];
+    if (!c || hex_to_key(sha_hex, key) != 0) return 0;
+    lock(c);
+    struct cache_entry *e = find(c, K_RUN, key, tag);
+    if (e) *r = e->u.run;
+    unlock(c);
+    return e != NULL;
+}
+
+void cache_put_run(struct malx_cache *c, const char sha_hex[65], uint64_t tag, const struct run_result *r) {
+    uint8_t key[32];
+    if (!c || hex_to_key(sha_hex, key) != 0) return;
+    lock(c);
+    struct cache_entry *e = slot_for(c, K_RUN, key, tag);
+    e->u.run = *r;
+    unlock(c);
+}
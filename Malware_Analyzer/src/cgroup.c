@@ -0,0 +1,286 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cgroup.h"
+#include "sandbox.h"
+
+static int write_file(const char *dir, const char *file, const char *val) {
+    char p[PATH_MAX + 64];
+    snprintf(p, sizeof p, "%s/%s", dir, file);
+    int fd = open(p, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = write(fd, val, strlen(val));
+    int e = errno;
+    close(fd);
+    errno = e;
+    return n == (ssize_t)strlen(val) ? 0 : -1;
+}
+
+static int read_file(const char *dir, const char *file, char *buf, size_t n) {
+    char p[PATH_MAX + 64];
+    snprintf(p, sizeof p, "%s/%s", dir, file);
+    int fd = open(p, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t k = read(fd, buf, n - 1);
+    close(fd);
+    if (k < 0) return -1;
+    buf[k] = '\0';
+    return 0;
+}
+
+/* mount point of the cgroup2 hierarchy, from mountinfo */
+static int cg2_mount(char *out, size_t n) {
+    FILE *f = fopen("/proc/self/mountinfo", "r");
+    if (!f) return -1;
+    char line[4096];
+    int found = -1;
+    while (found && fgets(line, sizeof line, f)) {
+        char *sep = strstr(line, " - ");
+        if (!sep || strncmp(sep + 3, "cgroup2 ", 8)) continue;
+        char mnt[PATH_MAX];
+        if (sscanf(line, "%*s %*s %*s %*s %4095s", mnt) == 1 && strlen(mnt) < n) {
+            strcpy(out, mnt);
+            found = 0;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/* our cgroup v2 path ("0::/...") */
+static int own_cgroup(char *out, size_t n) {
+    FILE *f = fopen("/proc/self/cgroup", "r");
+    if (!f) return -1;
+    char line[PATH_MAX + 16];
+    int found = -1;
+    while (found && fgets(line, sizeof line, f)) {
+        if (strncmp(line, "0::", 3)) continue;
+        line[strcspn(line, "\n")] = '\0';
+        if (strlen(line + 3) < n) { strcpy(out, line + 3); found = 0; }
+    }
+    fclose(f);
+    return found;
+}
+
+static int has_word(const char *list, const char *w) {
+    size_t n = strlen(w);
+    for (const char *p = list; (p = strstr(p, w)) != NULL; p += n)
+        if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\n' || p[n] == '\0')) return 1;
+    return 0;
+}
+
+static const char *const ctl_names[3] = { "memory", "cpu", "pids" };
+
+/* Enables the controllers in mask for base's children and root's; errno of
+   the first base write that failed, 0 if none did. */
+static int enable(const char *base, const char *root, unsigned mask) {
+    int base_errno = 0;
+    char ctl[16];
+    for (int i = 0; i < 3; ++i) {                /* one at a time: one the parent lacks must not hide the others */
+        if (!(mask & (1u << i))) continue;
+        snprintf(ctl, sizeof ctl, "+%s", ctl_names[i]);
+        if (write_file(base, "cgroup.subtree_control", ctl) != 0 && !base_errno) base_errno = errno;
+        (void)write_file(root, "cgroup.subtree_control", ctl);
+    }
+    return base_errno;
+}
+
+/* We are the only process in our own cgroup (a scope or service started for
+   malx, e.g. systemd-run --user -p Delegate=yes): move into a leaf of it,
+   so the cgroup itself is empty and may enable controllers. */
+static int move_aside(struct cg_root *root, const char *base) {
+    char procs[256], me[32];
+    snprintf(me, sizeof me, "%d\n", (int)getpid());
+    if (read_file(base, "cgroup.procs", procs, sizeof procs) != 0 || strcmp(procs, me)) return -1;
+    if (snprintf(root->self, sizeof root->self, "%s/malx.%d.self", base, (int)getpid()) >= (int)sizeof root->self ||
+        (mkdir(root->self, 0755) != 0 && errno != EEXIST)) {
+        root->self[0] = '\0';
+        return -1;
+    }
+    if (write_file(root->self, "cgroup.procs", "0") != 0) {
+        rmdir(root->self);
+        root->self[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
+
+/* undo move_aside(): controllers off again (a cgroup with processes can't
+   have any on), back into base, remove the leaf */
+static void move_back(struct cg_root *root) {
+    char base[PATH_MAX], ctl[16];
+    snprintf(base, sizeof base, "%s", root->self);
+    char *slash = strrchr(base, '/');
+    if (slash) *slash = '\0';
+    for (int i = 0; i < 3; ++i) {
+        if (!(root->ctl_mask & (1u << i))) continue;
+        snprintf(ctl, sizeof ctl, "-%s", ctl_names[i]);
+        (void)write_file(base, "cgroup.subtree_control", ctl);
+    }
+    if (write_file(base, "cgroup.procs", "0") == 0) rmdir(root->self);
+    root->self[0] = '\0';
+}
+
+int cg_root_open(struct cg_root *root, const char *parent, const struct cg_limits *lim,
+                 char *err, size_t errlen) {
+    char base[PATH_MAX];
+    root->self[0] = '\0';
+    root->ctl_mask = 0;
+    if (parent) {
+        if (snprintf(base, sizeof base, "%s", parent) >= (int)sizeof base) { snprintf(err, errlen, "path too long"); return -1; }
+    } else {
+        char mnt[PATH_MAX], own[PATH_MAX];
+        if (cg2_mount(mnt, sizeof mnt) != 0) { snprintf(err, errlen, "no cgroup2 mount"); return -1; }
+        if (own_cgroup(own, sizeof own) != 0) { snprintf(err, errlen, "no cgroup v2 entry in /proc/self/cgroup"); return -1; }
+        if (snprintf(base, sizeof base, "%s%s", mnt, strcmp(own, "/") ? own : "") >= (int)sizeof base) {
+            snprintf(err, errlen, "path too long"); return -1;
+        }
+    }
+    if (snprintf(root->path, sizeof root->path, "%s/malx.%d", base, (int)getpid()) >= (int)sizeof root->path) {
+        snprintf(err, errlen, "path too long"); return -1;
+    }
+    if (mkdir(root->path, 0755) != 0 && errno != EEXIST) {
+        snprintf(err, errlen, "mkdir %s: %s", root->path, strerror(errno)); return -1;
+    }
+
+    unsigned need = (lim->mem_bytes > 0 ? 1u : 0u) | (lim->cpu_pct > 0 ? 2u : 0u) | (lim->pids > 0 ? 4u : 0u);
+    int base_errno = enable(base, root->path, need);
+    /* no internal processes: a cgroup with member processes can't hand
+       controllers down. Fine if the only member is us. */
+    if (base_errno == EBUSY && !parent && move_aside(root, base) == 0) {
+        root->ctl_mask = need;
+        base_errno = enable(base, root->path, need);
+    }
+
+    char have[512];
+    if (read_file(root->path, "cgroup.subtree_control", have, sizeof have) != 0) have[0] = '\0';
+    for (int i = 0; i < 3; ++i) {
+        if ((need & (1u << i)) && !has_word(have, ctl_names[i])) {
+            if (base_errno == EBUSY && !parent)
+                snprintf(err, errlen, "%s controller not available under %s: other processes live in it "
+                         "(a login shell's scope?); run malx under systemd-run --user -p Delegate=yes --scope, "
+                         "or pass --cgroup DIR", ctl_names[i], base);
+            else
+                snprintf(err, errlen, "%s controller not available under %s%s%s", ctl_names[i], base,
+                         base_errno ? ": " : "", base_errno ? strerror(base_errno) : "");
+            rmdir(root->path);
+            if (root->self[0]) move_back(root);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void cg_root_close(struct cg_root *root) {
+    if (root->path[0]) rmdir(root->path);
+    root->path[0] = '\0';
+    if (root->self[0]) move_back(root);
+}
+
+int cg_create(const struct cg_root *root, const char *name, const struct cg_limits *lim,
+              struct cgroup *cg, char *err, size_t errlen) {
+    cg->procs_fd = -1;
+    if (snprintf(cg->path, sizeof cg->path, "%s/%s", root->path, name) >= (int)sizeof cg->path) {
+        snprintf(err, errlen, "path too long"); return -1;
+    }
+    if (mkdir(cg->path, 0755) != 0) { snprintf(err, errlen, "mkdir %s: %s", cg->path, strerror(errno)); return -1; }
+
+    char v[64];
+    const char *what = NULL;
+    if (lim->mem_bytes > 0) {
+        snprintf(v, sizeof v, "%ld", lim->mem_bytes);
+        if (write_file(cg->path, "memory.max", v) != 0) what = "memory.max";
+        (void)write_file(cg->path, "memory.swap.max", "0");   /* absent without swap accounting */
+    }
+    if (!what && lim->cpu_pct > 0) {
+        snprintf(v, sizeof v, "%ld 100000", (long)lim->cpu_pct * 1000L);
+        if (write_file(cg->path, "cpu.max", v) != 0) what = "cpu.max";
+    }
+    if (!what && lim->pids > 0) {
+        snprintf(v, sizeof v, "%d", lim->pids);
+        if (write_file(cg->path, "pids.max", v) != 0) what = "pids.max";
+    }
+    if (!what) {
+        char p[PATH_MAX + 16];
+        snprintf(p, sizeof p, "%s/cgroup.procs", cg->path);
+        if ((cg->procs_fd = open(p, O_WRONLY | O_CLOEXEC)) < 0) what = "cgroup.procs";
+    }
+    if (what) {
+        snprintf(err, errlen, "%s: %s", what, strerror(errno));
+        rmdir(cg->path);
+        return -1;
+    }
+    return 0;
+}
+
+int cg_enter(const struct cgroup *cg) {
+    return write(cg->procs_fd, "0", 1) == 1 ? 0 : -1;
+}
+
+int cg_oom_killed(const struct cgroup *cg) {
+    char buf[512];
+    if (read_file(cg->path, "memory.events", buf, sizeof buf) != 0) return 0;
+    const char *p = strstr(buf, "oom_kill ");
+    return p && strtol(p + 9, NULL, 10) > 0;
+}
+
+static void stat_key(const char *buf, const char *key, long long *out) {
+    size_t n = strlen(key);
+    for (const char *p = buf; (p = strstr(p, key)); p += n)
+        if ((p == buf || p[-1] == '\n') && p[n] == ' ') { *out = strtoll(p + n + 1, NULL, 10); return; }
+}
+
+void cg_usage(const struct cgroup *cg, struct run_usage *u) {
+    char buf[1024];
+    if (read_file(cg->path, "cpu.stat", buf, sizeof buf) == 0) {
+        stat_key(buf, "usage_usec", &u->cg_usage_us);
+        stat_key(buf, "user_usec", &u->cg_user_us);
+        stat_key(buf, "system_usec", &u->cg_system_us);
+        stat_key(buf, "throttled_usec", &u->cg_throttled_us);  /* only with the cpu controller */
+    }
+    if (read_file(cg->path, "memory.peak", buf, sizeof buf) == 0) u->cg_mem_peak = strtoll(buf, NULL, 10);
+}
+
+int cg_release(struct cgroup *cg, int *events_fd) {
+    *events_fd = -1;
+    if (cg->procs_fd >= 0) close(cg->procs_fd);
+    cg->procs_fd = -1;
+    if (!cg->path[0]) return 0;
+    (void)write_file(cg->path, "cgroup.kill", "1");       /* Linux >= 5.14 */
+    if (rmdir(cg->path) == 0 || errno != EBUSY) return 0;
+
+    /* stragglers take a moment to leave after the kill: the kernel flags
+       cgroup.events (POLLPRI) when "populated" drops to 0 */
+    char p[PATH_MAX + 16];
+    snprintf(p, sizeof p, "%s/cgroup.events", cg->path);
+    int fd = open(p, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    if (cg_remove_if_empty(cg->path, fd)) { close(fd); return 0; }
+    *events_fd = fd;
+    return 1;
+}
+
+int cg_remove_if_empty(const char *path, int events_fd) {
+    char buf[256];
+    ssize_t n = pread(events_fd, buf, sizeof buf - 1, 0);   /* also re-arms the notification */
+    if (n < 0) return rmdir(path) == 0 || errno != EBUSY;
+    buf[n] = '\0';
+    if (strstr(buf, "populated 1")) return 0;
+    return rmdir(path) == 0 || errno != EBUSY;
+}
+
+void cg_destroy(struct cgroup *cg) {
+    int fd;
+    if (cg_release(cg, &fd) == 1) {
+        struct pollfd pf = { .fd = fd, .events = POLLPRI };
+        for (int i = 0; i < 10 && !cg_remove_if_empty(cg->path, fd); ++i) (void)poll(&pf, 1, 10);
+        close(fd);
+    }
+    cg->path[0] = '\0';
+}
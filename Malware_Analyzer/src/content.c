@@ -0,0 +1,440 @@
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "content.h"
+
+struct rule {
+    char name[64];
+    unsigned char val[CONTENT_MAX_PATTERN];
+    unsigned char msk[CONTENT_MAX_PATTERN];   /* 0xff exact, 0xf0/0x0f nibble, 0 any */
+    size_t len;
+    size_t anchor_off, anchor_len;            /* longest run of exact bytes */
+    int next_same;                            /* next rule whose anchor ends in the same state */
+};
+
+struct rule_set {
+    struct rule *rules;
+    size_t n, cap;
+    /* compiled anchors: dense DFA over byte classes */
+    uint16_t cls[256];
+    size_t nclasses;
+    uint32_t *next;         /* nstates * nclasses; once compiled, entries are state * nclasses */
+    int *first_rule;        /* per state: first rule ending here, -1 if none */
+    uint32_t *olink;        /* per state: nearest failure ancestor with rules, 0 = none */
+    uint8_t *emit;          /* while compiling: this state or an ancestor ends a rule */
+    uint32_t emit_from;     /* compiled: (pre-multiplied) states >= this end some rule */
+    uint8_t leaves_root[256];   /* byte moves the root anywhere */
+    size_t nstates;
+    int compiled;
+};
+
+/* -------- rule parsing -------- */
+
+struct rule_set *rules_new(void) {
+    return calloc(1, sizeof(struct rule_set));
+}
+
+void rules_free(struct rule_set *rs) {
+    if (!rs) return;
+    free(rs->rules);
+    free(rs->next);
+    free(rs->first_rule);
+    free(rs->olink);
+    free(rs->emit);
+    free(rs);
+}
+
+size_t rules_count(const struct rule_set *rs) { return rs ? rs->n : 0; }
+const char *rules_name(const struct rule_set *rs, size_t i) { return rs->rules[i].name; }
+
+static int hexval(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* "text": returns a pointer past the closing quote, NULL on error */
+static const char *parse_text(const char *p, struct rule *r, char *err, size_t errlen) {
+    for (++p; *p && *p != '"'; ++p) {
+        int c = (unsigned char)*p;
+        if (c == '\\') {
+            switch (*++p) {
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case '0': c = 0; break;
+            case '\\': c = '\\'; break;
+            case '"': c = '"'; break;
+            case 'x':
+                if (hexval(p[1]) < 0 || hexval(p[2]) < 0) { snprintf(err, errlen, "bad \\x escape"); return NULL; }
+                c = hexval(p[1]) * 16 + hexval(p[2]);
+                p += 2;
+                break;
+            default: snprintf(err, errlen, "unknown escape \\%c", *p ? *p : '0'); return NULL;
+            }
+        }
+        if (r->len == CONTENT_MAX_PATTERN) { snprintf(err, errlen, "pattern longer than %d bytes", CONTENT_MAX_PATTERN); return NULL; }
+        r->val[r->len] = (unsigned char)c;
+        r->msk[r->len++] = 0xff;
+    }
+    if (*p != '"') { snprintf(err, errlen, "unterminated string"); return NULL; }
+    return p + 1;
+}
+
+/* { 4D 5A ?? 4? }: returns a pointer past the closing brace, NULL on error */
+static const char *parse_hex(const char *p, struct rule *r, char *err, size_t errlen) {
+    for (++p;; ) {
+        while (isspace((unsigned char)*p)) ++p;
+        if (*p == '}') return p + 1;
+        if (!p[0] || !p[1]) { snprintf(err, errlen, "unterminated hex string"); return NULL; }
+        int hi = p[0] == '?' ? -2 : hexval(p[0]);
+        int lo = p[1] == '?' ? -2 : hexval(p[1]);
+        if (hi == -1 || lo == -1) { snprintf(err, errlen, "bad hex byte '%c%c'", p[0], p[1]); return NULL; }
+        if (r->len == CONTENT_MAX_PATTERN) { snprintf(err, errlen, "pattern longer than %d bytes", CONTENT_MAX_PATTERN); return NULL; }
+        r->val[r->len] = (unsigned char)(((hi < 0 ? 0 : hi) << 4) | (lo < 0 ? 0 : lo));
+        r->msk[r->len++] = (unsigned char)((hi < 0 ? 0 : 0xf0) | (lo < 0 ? 0 : 0x0f));
+        p += 2;
+    }
+}
+
+static const char *parse_spec(const char *spec, struct rule *r, char *err, size_t errlen) {
+    while (isspace((unsigned char)*spec)) ++spec;
+    if (*spec == '"') return parse_text(spec, r, err, errlen);
+    if (*spec == '{') return parse_hex(spec, r, err, errlen);
+    snprintf(err, errlen, "expected \"text\" or { hex }");
+    return NULL;
+}
+
+int rules_add(struct rule_set *rs, const char *name, const char *spec, char *err, size_t errlen) {
+    struct rule r;
+    memset(&r, 0, sizeof r);
+    size_t nl = strlen(name);
+    if (!nl || nl >= sizeof r.name) { snprintf(err, errlen, "bad rule name"); return -1; }
+    for (size_t i = 0; i < nl; ++i)
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_') { snprintf(err, errlen, "bad rule name '%s'", name); return -1; }
+    memcpy(r.name, name, nl + 1);
+
+    const char *end = parse_spec(spec, &r, err, errlen);
+    if (!end) return -1;
+    while (isspace((unsigned char)*end)) ++end;
+    if (*end && *end != '#') { snprintf(err, errlen, "trailing text after pattern"); return -1; }
+    if (!r.len) { snprintf(err, errlen, "empty pattern"); return -1; }
+
+    for (size_t i = 0; i < r.len; ) {
+        if (r.msk[i] != 0xff) { ++i; continue; }
+        size_t j = i;
+        while (j < r.len && r.msk[j] == 0xff) ++j;
+        if (j - i > r.anchor_len) { r.anchor_off = i; r.anchor_len = j - i; }
+        i = j;
+    }
+    if (!r.anchor_len) { snprintf(err, errlen, "rule '%s' needs at least one fixed byte", name); return -1; }
+
+    if (rs->n == rs->cap) {
+        size_t nc = rs->cap ? rs->cap * 2 : 16;
+        struct rule *nr = realloc(rs->rules, nc * sizeof *nr);
+        if (!nr) { snprintf(err, errlen, "realloc failed"); return -1; }
+        rs->rules = nr;
+        rs->cap = nc;
+    }
+    rs->rules[rs->n++] = r;
+    rs->compiled = 0;
+    return 0;
+}
+
+int rules_add_file(struct rule_set *rs, const char *path, char *err, size_t errlen) {
+    FILE *f = fopen(path, "r");
+    if (!f) { snprintf(err, errlen, "%s: cannot open", path); return -1; }
+    char line[4096], why[160];
+    int lineno = 0, added = 0;
+    while (fgets(line, sizeof line, f)) {
+        ++lineno;
+        char *p = line;
+        while (isspace((unsigned char)*p)) ++p;
+        if (!*p || *p == '#') continue;
+        char *eq = strchr(p, '=');
+        if (!eq) { snprintf(err, errlen, "%s:%d: expected name = pattern", path, lineno); fclose(f); return -1; }
+        char *ne = eq;
+        while (ne > p && isspace((unsigned char)ne[-1])) --ne;
+        *ne = '\0';
+        eq[1 + strcspn(eq + 1, "\r\n")] = '\0';
+        if (rules_add(rs, p, eq + 1, why, sizeof why) != 0) {
+            snprintf(err, errlen, "%s:%d: %s", path, lineno, why);
+            fclose(f);
+            return -1;
+        }
+        ++added;
+    }
+    fclose(f);
+    return added;
+}
+
+int rules_add_builtin(struct rule_set *rs) {
+    static const char *const builtin[][2] = {
+        { "upx_magic",      "\"UPX!\"" },
+        { "upx_section",    "\"UPX0\"" },
+        { "pe_dos_stub",    "\"This program cannot be run in DOS mode\"" },
+        { "serial_device",  "\"/dev/ttyS\"" },
+        { "modbus",         "\"modbus\"" },
+        { "miner_stratum",  "\"stratum+tcp://\"" },
+        { "miner_xmrig",    "\"xmrig\"" },
+        { "reverse_shell",  "\"/bin/sh -i\"" },
+        { "ld_preload",     "\"/etc/ld.so.preload\"" },
+        { "cron_persist",   "\"/etc/cron.d/\"" },
+        { "ssh_keys",       "\"authorized_keys\"" },
+    };
+    char err[160];
+    for (size_t i = 0; i < sizeof builtin / sizeof builtin[0]; ++i)
+        if (rules_add(rs, builtin[i][0], builtin[i][1], err, sizeof err) != 0) return -1;
+    return 0;
+}
+
+/* -------- automaton over the anchors -------- */
+
+int rules_compile(struct rule_set *rs, char *err, size_t errlen) {
+    free(rs->next); free(rs->first_rule); free(rs->olink); free(rs->emit);
+    rs->next = NULL; rs->first_rule = NULL; rs->olink = NULL; rs->emit = NULL;
+
+    /* class 0 = every byte no anchor uses */
+    memset(rs->cls, 0, sizeof rs->cls);
+    rs->nclasses = 1;
+    size_t total = 1;
+    for (size_t r = 0; r < rs->n; ++r) {
+        const struct rule *ru = &rs->rules[r];
+        for (size_t k = 0; k < ru->anchor_len; ++k) {
+            unsigned char b = ru->val[ru->anchor_off + k];
+            if (!rs->cls[b]) rs->cls[b] = (uint16_t)rs->nclasses++;
+        }
+        total += ru->anchor_len;
+    }
+    size_t nc = rs->nclasses;
+    rs->next = calloc(total * nc, sizeof *rs->next);
+    rs->first_rule = malloc(total * sizeof *rs->first_rule);
+    rs->olink = calloc(total, sizeof *rs->olink);
+    rs->emit = calloc(total, 1);
+    uint32_t *fail = calloc(total, sizeof *fail), *queue = malloc(total * sizeof *queue);
+    if (!rs->next || !rs->first_rule || !rs->olink || !rs->emit || !fail || !queue) {
+        free(fail); free(queue);
+        snprintf(err, errlen, "out of memory compiling rules");
+        return -1;
+    }
+    for (size_t s = 0; s < total; ++s) rs->first_rule[s] = -1;
+
+    /* trie; 0 in next[] means "no edge" until the BFS fills it in */
+    rs->nstates = 1;
+    for (size_t r = 0; r < rs->n; ++r) {
+        struct rule *ru = &rs->rules[r];
+        uint32_t s = 0;
+        for (size_t k = 0; k < ru->anchor_len; ++k) {
+            uint32_t *e = &rs->next[s * nc + rs->cls[ru->val[ru->anchor_off + k]]];
+            if (!*e) *e = (uint32_t)rs->nstates++;
+            s = *e;
+        }
+        ru->next_same = rs->first_rule[s];
+        rs->first_rule[s] = (int)r;
+    }
+
+    /* BFS: failure links, then complete the goto function */
+    size_t qh = 0, qt = 0;
+    for (size_t c = 0; c < nc; ++c) {
+        uint32_t t = rs->next[c];
+        if (t) { fail[t] = 0; queue[qt++] = t; }
+    }
+    while (qh < qt) {
+        uint32_t s = queue[qh++];
+        uint32_t f = fail[s];
+        rs->olink[s] = rs->first_rule[f] >= 0 ? f : rs->olink[f];
+        rs->emit[s] = rs->first_rule[s] >= 0 || rs->emit[f];
+        for (size_t c = 0; c < nc; ++c) {
+            uint32_t *e = &rs->next[s * nc + c];
+            if (*e) { fail[*e] = rs->next[f * nc + c]; queue[qt++] = *e; }
+            else *e = rs->next[f * nc + c];
+        }
+    }
+    free(fail);
+    free(queue);
+
+    /*
+     * Renumber so every emitting state comes after every silent one, and
+     * store transitions pre-multiplied by the row width. The scan loop is
+     * then one dependent load per byte and a compare against emit_from.
+     */
+    size_t ns = rs->nstates;
+    uint32_t *id = malloc(ns * sizeof *id), *trans = malloc(ns * nc * sizeof *trans);
+    int *first = malloc(ns * sizeof *first);
+    uint32_t *olink = malloc(ns * sizeof *olink);
+    if (!id || !trans || !first || !olink) {
+        free(id); free(trans); free(first); free(olink);
+        snprintf(err, errlen, "out of memory compiling rules");
+        return -1;
+    }
+    uint32_t k = 0;
+    for (size_t s = 0; s < ns; ++s) if (!rs->emit[s]) id[s] = k++;    /* root stays 0 */
+    rs->emit_from = k * (uint32_t)nc;
+    for (size_t s = 0; s < ns; ++s) if (rs->emit[s]) id[s] = k++;
+    for (size_t s = 0; s < ns; ++s) {
+        for (size_t c = 0; c < nc; ++c) trans[id[s] * nc + c] = id[rs->next[s * nc + c]] * (uint32_t)nc;
+        first[id[s]] = rs->first_rule[s];
+        olink[id[s]] = id[rs->olink[s]];
+    }
+    free(id);
+    free(rs->next); free(rs->first_rule); free(rs->olink); free(rs->emit);
+    rs->next = trans;
+    rs->first_rule = first;
+    rs->olink = olink;
+    rs->emit = NULL;
+    for (int b = 0; b < 256; ++b) rs->leaves_root[b] = trans[rs->cls[b]] != 0;
+    rs->compiled = 1;
+    return 0;
+}
+
+/* -------- entropy -------- */
+
+static float clog_tab[CONTENT_WINDOW + 1];   /* c * log2(c) */
+static pthread_once_t clog_once = PTHREAD_ONCE_INIT;
+
+static void clog_init(void) {
+    for (int c = 1; c <= CONTENT_WINDOW; ++c) clog_tab[c] = (float)(c * log2((double)c));
+}
+
+/* bits per byte of a histogram holding n bytes */
+static double hist_entropy(const uint16_t *a, const uint16_t *b, uint32_t n) {
+    if (!n) return 0.0;
+    double s = 0.0;
+    for (int i = 0; i < 256; ++i) s += clog_tab[a[i] + (b ? b[i] : 0)];
+    return log2((double)n) - s / n;
+}
+
+/*
+ * Byte histogram, 8 bytes per load into four interleaved tables so that
+ * consecutive equal bytes don't serialize on one counter's store-to-load
+ * chain; the tables are summed at the end. This is the part of the pass
+ * that competes with SHA-256 for cycles.
+ */
+static void block_hist(const unsigned char *p, size_t n, uint16_t out[256]) {
+    uint16_t t[4][256];
+    memset(t, 0, sizeof t);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        t[0][w & 0xff]++;         t[1][(w >> 8) & 0xff]++;
+        t[2][(w >> 16) & 0xff]++; t[3][(w >> 24) & 0xff]++;
+        t[0][(w >> 32) & 0xff]++; t[1][(w >> 40) & 0xff]++;
+        t[2][(w >> 48) & 0xff]++; t[3][w >> 56]++;
+    }
+    for (; i < n; ++i) t[0][p[i]]++;
+    for (int b = 0; b < 256; ++b) out[b] = (uint16_t)(t[0][b] + t[1][b] + t[2][b] + t[3][b]);
+}
+
+static void close_run(struct content_scan *cs) {
+    if (cs->cur_len > cs->rep.run_len) { cs->rep.run_off = cs->cur_off; cs->rep.run_len = cs->cur_len; }
+    cs->cur_len = 0;
+}
+
+static void window(struct content_scan *cs, uint64_t off, const uint16_t *a, const uint16_t *b, uint32_t n) {
+    double h = hist_entropy(a, b, n);
+    cs->rep.windows++;
+    if (h > cs->rep.max_window || cs->rep.windows == 1) { cs->rep.max_window = h; cs->rep.max_window_off = off; }
+    if (h > CONTENT_HIGH_ENTROPY) {
+        cs->rep.high_windows++;
+        if (cs->cur_len && off <= cs->cur_off + cs->cur_len) cs->cur_len = off + n - cs->cur_off;
+        else { close_run(cs); cs->cur_off = off; cs->cur_len = n; }
+    } else {
+        close_run(cs);
+    }
+}
+
+/* -------- streaming -------- */
+
+int content_begin(struct content_scan *cs, const struct rule_set *rules,
+                  const unsigned char *base, size_t len) {
+    memset(cs, 0, sizeof *cs);
+    pthread_once(&clog_once, clog_init);
+    cs->rules = rules && rules->compiled && rules->n ? rules : NULL;
+    cs->base = base;
+    cs->base_len = len;
+    cs->rep.nrules = cs->rules ? cs->rules->n : 0;
+    if (cs->rep.nrules) {
+        cs->rep.hits = calloc(cs->rep.nrules, sizeof *cs->rep.hits);
+        cs->rep.first = calloc(cs->rep.nrules, sizeof *cs->rep.first);
+        if (!cs->rep.hits || !cs->rep.first) { content_free(cs); return -1; }
+    }
+    return 0;
+}
+
+/* an anchor ended at `end` (exclusive): check every rule hanging off state s */
+static void check_rules(struct content_scan *cs, uint32_t s, uint64_t end) {
+    const struct rule_set *rs = cs->rules;
+    for (s /= (uint32_t)rs->nclasses; s; s = rs->olink[s]) {
+        for (int r = rs->first_rule[s]; r >= 0; r = rs->rules[r].next_same) {
+            const struct rule *ru = &rs->rules[r];
+            uint64_t back = ru->anchor_off + ru->anchor_len;
+            if (end < back) continue;
+            uint64_t start = end - back;
+            if (ru->len > cs->base_len - start) continue;
+            const unsigned char *p = cs->base + start;
+            size_t k = 0;
+            while (k < ru->len && (p[k] & ru->msk[k]) == ru->val[k]) ++k;
+            if (k < ru->len) continue;
+            if (!cs->rep.hits[r]++) cs->rep.first[r] = start;
+        }
+    }
+}
+
+static void scan_block(struct content_scan *cs, const unsigned char *p, size_t n, uint64_t off) {
+    const struct rule_set *rs = cs->rules;
+    const uint32_t *next = rs->next;
+    const uint16_t *cls = rs->cls;
+    const uint32_t emit_from = rs->emit_from;
+    const uint8_t *leaves = rs->leaves_root;
+    uint32_t s = cs->state;
+    for (size_t i = 0; i < n; ++i) {
+        /* at the root, skip bytes that can't start an anchor: independent
+           loads instead of the dependent state chain */
+        if (!s) {
+            while (i + 8 <= n && !(leaves[p[i]] | leaves[p[i+1]] | leaves[p[i+2]] | leaves[p[i+3]] |
+                                   leaves[p[i+4]] | leaves[p[i+5]] | leaves[p[i+6]] | leaves[p[i+7]])) i += 8;
+            while (i < n && !leaves[p[i]]) ++i;
+            if (i == n) break;
+        }
+        s = next[s + cls[p[i]]];
+        if (s >= emit_from) check_rules(cs, s, off + i + 1);
+    }
+    cs->state = s;
+}
+
+void content_feed(struct content_scan *cs, size_t off, size_t n) {
+    for (size_t o = off; o < off + n; o += CONTENT_BLOCK) {
+        size_t bn = off + n - o < CONTENT_BLOCK ? off + n - o : CONTENT_BLOCK;
+        const unsigned char *p = cs->base + o;
+        uint16_t h[256];
+        block_hist(p, bn, h);
+        for (int b = 0; b < 256; ++b) cs->hist[b] += h[b];
+        if (cs->prev_n) window(cs, o - cs->prev_n, cs->prev, h, cs->prev_n + (uint32_t)bn);
+        memcpy(cs->prev, h, sizeof h);
+        cs->prev_n = (uint32_t)bn;
+        if (cs->rules) scan_block(cs, p, bn, o);
+    }
+    cs->rep.bytes = off + n;
+}
+
+void content_end(struct content_scan *cs) {
+    if (!cs->rep.windows && cs->prev_n) window(cs, 0, cs->prev, NULL, cs->prev_n);   /* under one block */
+    close_run(cs);
+    double s = 0.0, n = (double)cs->rep.bytes;
+    for (int b = 0; b < 256; ++b)
+        if (cs->hist[b]) s += (double)cs->hist[b] * log2((double)cs->hist[b]);
+    cs->rep.entropy = cs->rep.bytes ? log2(n) - s / n : 0.0;
+}
+
+void content_free(struct content_scan *cs) {
+    free(cs->rep.hits);
+    free(cs->rep.first);
+    cs->rep.hits = NULL;
+    cs->rep.first = NULL;
+}
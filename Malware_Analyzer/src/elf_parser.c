@@ -1,63 +1,384 @@
 #include "elfx.h"
 #include "utils.h"
 #include <elf.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-static const char* machine_name(uint16_t m) {
+
+const char *elf_machine_name(uint16_t m) {
     switch (m) {
         case EM_X86_64: return "x86_64";
         case EM_386:    return "x86";
         case EM_AARCH64:return "aarch64";
         case EM_ARM:    return "arm";
+        case EM_MIPS:   return "mips";
+        case EM_PPC:    return "ppc";
+        case EM_PPC64:  return "ppc64";
+        case EM_S390:   return "s390";
+        case EM_SPARC:  return "sparc";
+        case EM_SPARCV9:return "sparc64";
+        case EM_SH:     return "sh";
+        case EM_RISCV:  return "riscv";
         default:        return "unknown";
     }
 }
 
-int elf_summarize(const char *path, struct elf_summary *out, char *err, size_t errlen) {
-    unsigned char *buf=NULL; size_t len=0; int rc=-1;
-    if (read_file(path, &buf, &len, err, errlen) != 0) return -1;
-    if (len < 4 || memcmp(buf, "\x7f""ELF", 4) != 0) { snprintf(err, errlen, "not an ELF file"); goto done; }
-
-    unsigned char ei_class = buf[EI_CLASS];
-    unsigned char ei_data  = buf[EI_DATA];
-
-    if (ei_class == ELFCLASS64) {
-        if (len < sizeof(Elf64_Ehdr)) { snprintf(err, errlen, "truncated ELF64 header"); goto done; }
-        const Elf64_Ehdr *eh = (const Elf64_Ehdr*)buf;
-        snprintf(out->class_str, sizeof out->class_str, "ELF64");
-        snprintf(out->endian_str, sizeof out->endian_str, (ei_data==ELFDATA2LSB)?"LE":(ei_data==ELFDATA2MSB?"BE":"?"));
-        snprintf(out->machine, sizeof out->machine, "%s", machine_name(eh->e_machine));
-        out->entry = eh->e_entry;
-        out->pie = (eh->e_type == ET_DYN);
-        out->has_symtab = false;
-        if (eh->e_shoff && eh->e_shentsize == sizeof(Elf64_Shdr) &&
-            eh->e_shnum*sizeof(Elf64_Shdr) + eh->e_shoff <= len) {
-            const Elf64_Shdr *sh = (const Elf64_Shdr*)(buf + eh->e_shoff);
-            for (int i = 0; i < eh->e_shnum; ++i) if (sh[i].sh_type == SHT_SYMTAB) { out->has_symtab = true; break; }
-        }
-        rc = 0;
-    } else if (ei_class == ELFCLASS32) {
-        if (len < sizeof(Elf32_Ehdr)) { snprintf(err, errlen, "truncated ELF32 header"); goto done; }
-        const Elf32_Ehdr *eh = (const Elf32_Ehdr*)buf;
-        snprintf(out->class_str, sizeof out->class_str, "ELF32");
-        snprintf(out->endian_str, sizeof out->endian_str, (ei_data==ELFDATA2LSB)?"LE":(ei_data==ELFDATA2MSB?"BE":"?"));
-        snprintf(out->machine, sizeof out->machine, "%s", machine_name(eh->e_machine));
-        out->entry = eh->e_entry;
-        out->pie = (eh->e_type == ET_DYN);
-        out->has_symtab = false;
-        if (eh->e_shoff && eh->e_shentsize == sizeof(Elf32_Shdr) &&
-            (size_t)eh->e_shnum*sizeof(Elf32_Shdr) + eh->e_shoff <= len) {
-            const Elf32_Shdr *sh = (const Elf32_Shdr*)(buf + eh->e_shoff);
-            for (int i = 0; i < eh->e_shnum; ++i) if (sh[i].sh_type == SHT_SYMTAB) { out->has_symtab = true; break; }
-        }
-        rc = 0;
+/* section table fits inside the file (no overflow in the multiply) */
+static bool table_fits(unsigned long long off, unsigned long long num, size_t entsz, size_t len) {
+    return off && off <= len && num <= (len - off) / entsz;
+}
+
+/* -------- byte-order aware field reads -------- */
+
+static const bool host_be = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+
+static uint16_t rd16(const struct elf_view *v, const unsigned char *p) {
+    uint16_t x; memcpy(&x, p, sizeof x);
+    return v->swap ? __builtin_bswap16(x) : x;
+}
+static uint32_t rd32(const struct elf_view *v, const unsigned char *p) {
+    uint32_t x; memcpy(&x, p, sizeof x);
+    return v->swap ? __builtin_bswap32(x) : x;
+}
+static uint64_t rd64(const struct elf_view *v, const unsigned char *p) {
+    uint64_t x; memcpy(&x, p, sizeof x);
+    return v->swap ? __builtin_bswap64(x) : x;
+}
+/* address-sized field: Elf64_Addr/Off/Xword or their 32-bit counterparts */
+static uint64_t rdw(const struct elf_view *v, const unsigned char *p) {
+    return v->is64 ? rd64(v, p) : rd32(v, p);
+}
+
+#define F16(p, T, f) rd16(v, (p) + offsetof(T, f))
+#define F32(p, T, f) rd32(v, (p) + offsetof(T, f))
+#define FW(v64, v32, p, f) (v->is64 ? rd64(v, (p) + offsetof(v64, f)) : rd32(v, (p) + offsetof(v32, f)))
+
+/* [off, off+n) inside the buffer, else NULL */
+static const unsigned char *span(const struct elf_view *v, uint64_t off, uint64_t n) {
+    if (off > v->len || n > v->len - off) return NULL;
+    return v->buf + off;
+}
+
+static const char *str_at(const char *tab, size_t len, uint64_t off) {
+    if (!tab || off >= len) return "";
+    return memchr(tab + off, '\0', len - off) ? tab + off : "";
+}
+
+/* -------- header -------- */
+
+int elf_open(struct elf_view *v, const unsigned char *buf, size_t len, char *err, size_t errlen) {
+    memset(v, 0, sizeof *v);
+    if (len < 4 || memcmp(buf, "\x7f""ELF", 4) != 0) { snprintf(err, errlen, "not an ELF file"); return -1; }
+    if (len <= EI_DATA) { snprintf(err, errlen, "truncated ELF header"); return -1; }
+
+    v->buf = buf;
+    v->len = len;
+    v->data = buf[EI_DATA];
+    /* an unknown encoding is read as host order, as before */
+    v->swap = (v->data == ELFDATA2MSB && !host_be) || (v->data == ELFDATA2LSB && host_be);
+
+    size_t shdr_sz, phdr_sz;
+    const unsigned char *h = buf;
+    if (buf[EI_CLASS] == ELFCLASS64) {
+        if (len < sizeof(Elf64_Ehdr)) { snprintf(err, errlen, "truncated ELF64 header"); return -1; }
+        v->is64 = true;
+        shdr_sz = sizeof(Elf64_Shdr);
+        phdr_sz = sizeof(Elf64_Phdr);
+    } else if (buf[EI_CLASS] == ELFCLASS32) {
+        if (len < sizeof(Elf32_Ehdr)) { snprintf(err, errlen, "truncated ELF32 header"); return -1; }
+        shdr_sz = sizeof(Elf32_Shdr);
+        phdr_sz = sizeof(Elf32_Phdr);
     } else {
         snprintf(err, errlen, "unknown ELF class");
+        return -1;
+    }
+
+    /* e_type/e_machine sit at the same offsets in both classes */
+    v->type      = F16(h, Elf64_Ehdr, e_type);
+    v->machine   = F16(h, Elf64_Ehdr, e_machine);
+    v->entry     = FW(Elf64_Ehdr, Elf32_Ehdr, h, e_entry);
+    v->phoff     = FW(Elf64_Ehdr, Elf32_Ehdr, h, e_phoff);
+    v->shoff     = FW(Elf64_Ehdr, Elf32_Ehdr, h, e_shoff);
+    v->phentsize = v->is64 ? F16(h, Elf64_Ehdr, e_phentsize) : F16(h, Elf32_Ehdr, e_phentsize);
+    v->shentsize = v->is64 ? F16(h, Elf64_Ehdr, e_shentsize) : F16(h, Elf32_Ehdr, e_shentsize);
+    uint32_t phnum = v->is64 ? F16(h, Elf64_Ehdr, e_phnum) : F16(h, Elf32_Ehdr, e_phnum);
+    uint32_t shnum = v->is64 ? F16(h, Elf64_Ehdr, e_shnum) : F16(h, Elf32_Ehdr, e_shnum);
+    uint32_t shstrndx = v->is64 ? F16(h, Elf64_Ehdr, e_shstrndx) : F16(h, Elf32_Ehdr, e_shstrndx);
+
+    /* extended numbering: the real counts live in section header 0 */
+    bool sh_ok = v->shentsize >= shdr_sz && table_fits(v->shoff, 1, v->shentsize, len);
+    if (sh_ok && (shnum == 0 || shstrndx == SHN_XINDEX || phnum == PN_XNUM)) {
+        const unsigned char *s0 = buf + v->shoff;
+        if (shnum == 0)              shnum    = (uint32_t)FW(Elf64_Shdr, Elf32_Shdr, s0, sh_size);
+        if (shstrndx == SHN_XINDEX)  shstrndx = v->is64 ? F32(s0, Elf64_Shdr, sh_link) : F32(s0, Elf32_Shdr, sh_link);
+        if (phnum == PN_XNUM)        phnum    = v->is64 ? F32(s0, Elf64_Shdr, sh_info) : F32(s0, Elf32_Shdr, sh_info);
+    }
+    if (sh_ok && table_fits(v->shoff, shnum, v->shentsize, len)) v->shnum = shnum;
+    if (v->phentsize >= phdr_sz && table_fits(v->phoff, phnum, v->phentsize, len)) v->phnum = phnum;
+    v->shstrndx = shstrndx;
+
+    struct elf_section ss;
+    if (shstrndx != SHN_UNDEF && elf_section(v, shstrndx, &ss) == 0 && ss.type == SHT_STRTAB && ss.data) {
+        v->shstr = (const char *)ss.data;
+        v->shstr_len = ss.size;
+    }
+    return 0;
+}
+
+/* -------- sections / segments -------- */
+
+int elf_section(const struct elf_view *v, uint32_t i, struct elf_section *out) {
+    if (i >= v->shnum) return -1;
+    const unsigned char *p = v->buf + v->shoff + (uint64_t)i * v->shentsize;
+    memset(out, 0, sizeof *out);
+    /* sh_name, sh_type are 32-bit and first in both classes */
+    uint32_t name = F32(p, Elf64_Shdr, sh_name);
+    out->type      = F32(p, Elf64_Shdr, sh_type);
+    out->flags     = FW(Elf64_Shdr, Elf32_Shdr, p, sh_flags);
+    out->addr      = FW(Elf64_Shdr, Elf32_Shdr, p, sh_addr);
+    out->offset    = FW(Elf64_Shdr, Elf32_Shdr, p, sh_offset);
+    out->size      = FW(Elf64_Shdr, Elf32_Shdr, p, sh_size);
+    out->link      = v->is64 ? F32(p, Elf64_Shdr, sh_link) : F32(p, Elf32_Shdr, sh_link);
+    out->info      = v->is64 ? F32(p, Elf64_Shdr, sh_info) : F32(p, Elf32_Shdr, sh_info);
+    out->addralign = FW(Elf64_Shdr, Elf32_Shdr, p, sh_addralign);
+    out->entsize   = FW(Elf64_Shdr, Elf32_Shdr, p, sh_entsize);
+    out->name = str_at(v->shstr, v->shstr_len, name);
+    if (out->type != SHT_NOBITS) out->data = span(v, out->offset, out->size);
+    return 0;
+}
+
+int elf_find_section(const struct elf_view *v, uint32_t type, struct elf_section *out) {
+    for (uint32_t i = 0; i < v->shnum; ++i) {
+        /* peek at sh_type before decoding the rest */
+        const unsigned char *p = v->buf + v->shoff + (uint64_t)i * v->shentsize;
+        if (F32(p, Elf64_Shdr, sh_type) != type) continue;
+        if (out) elf_section(v, i, out);
+        return (int)i;
+    }
+    return -1;
+}
+
+int elf_segment(const struct elf_view *v, uint32_t i, struct elf_segment *out) {
+    if (i >= v->phnum) return -1;
+    const unsigned char *p = v->buf + v->phoff + (uint64_t)i * v->phentsize;
+    memset(out, 0, sizeof *out);
+    out->type = F32(p, Elf64_Phdr, p_type);
+    if (v->is64) {
+        out->flags  = F32(p, Elf64_Phdr, p_flags);
+        out->offset = rd64(v, p + offsetof(Elf64_Phdr, p_offset));
+        out->vaddr  = rd64(v, p + offsetof(Elf64_Phdr, p_vaddr));
+        out->filesz = rd64(v, p + offsetof(Elf64_Phdr, p_filesz));
+        out->memsz  = rd64(v, p + offsetof(Elf64_Phdr, p_memsz));
+        out->align  = rd64(v, p + offsetof(Elf64_Phdr, p_align));
+    } else {
+        out->flags  = F32(p, Elf32_Phdr, p_flags);
+        out->offset = F32(p, Elf32_Phdr, p_offset);
+        out->vaddr  = F32(p, Elf32_Phdr, p_vaddr);
+        out->filesz = F32(p, Elf32_Phdr, p_filesz);
+        out->memsz  = F32(p, Elf32_Phdr, p_memsz);
+        out->align  = F32(p, Elf32_Phdr, p_align);
+    }
+    out->data = span(v, out->offset, out->filesz);
+    return 0;
+}
+
+/* file offset of a virtual address, through the PT_LOAD segments */
+static bool vaddr_to_off(const struct elf_view *v, uint64_t va, uint64_t *off) {
+    struct elf_segment s;
+    for (uint32_t i = 0; i < v->phnum; ++i) {
+        if (elf_segment(v, i, &s) != 0 || s.type != PT_LOAD) continue;
+        if (va >= s.vaddr && va - s.vaddr < s.filesz) { *off = s.offset + (va - s.vaddr); return true; }
+    }
+    return false;
+}
+
+/* -------- symbols -------- */
+
+int elf_symtab_open(const struct elf_view *v, uint32_t type, struct elf_symtab *st) {
+    memset(st, 0, sizeof *st);
+    struct elf_section s, str;
+    if (elf_find_section(v, type, &s) < 0 || !s.data) return -1;
+    size_t min = v->is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+    st->entsize = s.entsize ? (size_t)s.entsize : min;
+    if (st->entsize < min) return -1;
+    st->data  = s.data;
+    st->count = (size_t)(s.size / st->entsize);
+    if (elf_section(v, s.link, &str) == 0 && str.type == SHT_STRTAB && str.data) {
+        st->strtab = (const char *)str.data;
+        st->strtab_len = str.size;
+    }
+    return 0;
+}
+
+int elf_symbol(const struct elf_view *v, const struct elf_symtab *st, size_t i, struct elf_symbol *out) {
+    if (i >= st->count) return -1;
+    const unsigned char *p = st->data + i * st->entsize;
+    unsigned char info;
+    if (v->is64) {
+        info        = p[offsetof(Elf64_Sym, st_info)];
+        out->shndx  = F16(p, Elf64_Sym, st_shndx);
+        out->value  = rd64(v, p + offsetof(Elf64_Sym, st_value));
+        out->size   = rd64(v, p + offsetof(Elf64_Sym, st_size));
+    } else {
+        info        = p[offsetof(Elf32_Sym, st_info)];
+        out->shndx  = F16(p, Elf32_Sym, st_shndx);
+        out->value  = F32(p, Elf32_Sym, st_value);
+        out->size   = F32(p, Elf32_Sym, st_size);
+    }
+    out->bind = (uint8_t)(info >> 4);
+    out->type = (uint8_t)(info & 0xf);
+    out->name = str_at(st->strtab, st->strtab_len, F32(p, Elf64_Sym, st_name));
+    return 0;
+}
+
+/* -------- dynamic / notes -------- */
+
+int elf_foreach_needed(const struct elf_view *v, int (*cb)(const char *lib, void *ctx), void *ctx) {
+    const unsigned char *dyn = NULL;
+    uint64_t dyn_len = 0;
+    const char *strtab = NULL;
+    uint64_t strtab_len = 0;
+    size_t entsz = v->is64 ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+
+    struct elf_section s, str;
+    struct elf_segment g;
+    if (elf_find_section(v, SHT_DYNAMIC, &s) >= 0 && s.data) {
+        dyn = s.data; dyn_len = s.size;
+        if (elf_section(v, s.link, &str) == 0 && str.data) { strtab = (const char *)str.data; strtab_len = str.size; }
+    } else {
+        for (uint32_t i = 0; i < v->phnum; ++i)
+            if (elf_segment(v, i, &g) == 0 && g.type == PT_DYNAMIC && g.data) { dyn = g.data; dyn_len = g.filesz; break; }
+    }
+    if (!dyn) return 0;
+
+    if (!strtab) {                  /* no section headers: find DT_STRTAB by address */
+        uint64_t va = 0, sz = 0, off;
+        for (uint64_t o = 0; o + entsz <= dyn_len; o += entsz) {
+            int64_t tag = v->is64 ? (int64_t)rd64(v, dyn + o) : (int32_t)rd32(v, dyn + o);
+            if (tag == DT_NULL) break;
+            if (tag == DT_STRTAB) va = rdw(v, dyn + o + entsz / 2);
+            if (tag == DT_STRSZ)  sz = rdw(v, dyn + o + entsz / 2);
+        }
+        if (!va || !vaddr_to_off(v, va, &off) || off > v->len) return 0;
+        if (sz > v->len - off) sz = v->len - off;
+        strtab = (const char *)(v->buf + off);
+        strtab_len = sz;
+    }
+
+    int n = 0;
+    for (uint64_t o = 0; o + entsz <= dyn_len; o += entsz) {
+        int64_t tag = v->is64 ? (int64_t)rd64(v, dyn + o) : (int32_t)rd32(v, dyn + o);
+        if (tag == DT_NULL) break;
+        if (tag != DT_NEEDED) continue;
+        const char *lib = str_at(strtab, (size_t)strtab_len, rdw(v, dyn + o + entsz / 2));
+        ++n;
+        if (cb && cb(lib, ctx)) break;
+    }
+    return n;
+}
+
+/* walk one note area; name and desc each end on an `align` boundary (4, or 8 for some) */
+static int walk_notes(const struct elf_view *v, const unsigned char *p, uint64_t len, uint64_t align,
+                      int (*cb)(const struct elf_note *n, void *ctx), void *ctx, int *count) {
+    align = align == 8 ? 8 : 4;
+    uint64_t o = 0;
+    while (o <= len && len - o >= 12) {
+        uint32_t namesz = rd32(v, p + o), descsz = rd32(v, p + o + 4);
+        struct elf_note n = { "", rd32(v, p + o + 8), NULL, descsz };
+        o += 12;
+        if (namesz > len - o) break;
+        if (namesz && p[o + namesz - 1] == '\0') n.name = (const char *)(p + o);
+        o = (o + namesz + align - 1) & ~(align - 1);
+        if (o > len || descsz > len - o) break;
+        n.desc = p + o;
+        o = (o + descsz + align - 1) & ~(align - 1);
+        ++*count;
+        if (cb && cb(&n, ctx)) return 1;
+    }
+    return 0;
+}
+
+int elf_foreach_note(const struct elf_view *v, int (*cb)(const struct elf_note *n, void *ctx), void *ctx) {
+    int count = 0, any_sec = 0;
+    struct elf_section s;
+    for (uint32_t i = 0; i < v->shnum; ++i) {
+        if (elf_section(v, i, &s) != 0 || s.type != SHT_NOTE || !s.data) continue;
+        any_sec = 1;
+        if (walk_notes(v, s.data, s.size, s.addralign, cb, ctx, &count)) return count;
+    }
+    if (any_sec) return count;
+    struct elf_segment g;
+    for (uint32_t i = 0; i < v->phnum; ++i) {
+        if (elf_segment(v, i, &g) != 0 || g.type != PT_NOTE || !g.data) continue;
+        if (walk_notes(v, g.data, g.filesz, g.align, cb, ctx, &count)) return count;
     }
+    return count;
+}
 
-done:
-    free(buf);
+const char *elf_section_type_name(uint32_t t) {
+    switch (t) {
+        case SHT_NULL:          return "NULL";
+        case SHT_PROGBITS:      return "PROGBITS";
+        case SHT_SYMTAB:        return "SYMTAB";
+        case SHT_STRTAB:        return "STRTAB";
+        case SHT_RELA:          return "RELA";
+        case SHT_HASH:          return "HASH";
+        case SHT_DYNAMIC:       return "DYNAMIC";
+        case SHT_NOTE:          return "NOTE";
+        case SHT_NOBITS:        return "NOBITS";
+        case SHT_REL:           return "REL";
+        case SHT_DYNSYM:        return "DYNSYM";
+        case SHT_INIT_ARRAY:    return "INIT_ARRAY";
+        case SHT_FINI_ARRAY:    return "FINI_ARRAY";
+        case SHT_PREINIT_ARRAY: return "PREINIT_ARRAY";
+        case SHT_GROUP:         return "GROUP";
+        case SHT_SYMTAB_SHNDX:  return "SYMTAB_SHNDX";
+        case SHT_GNU_HASH:      return "GNU_HASH";
+        case SHT_GNU_verdef:    return "VERDEF";
+        case SHT_GNU_verneed:   return "VERNEED";
+        case SHT_GNU_versym:    return "VERSYM";
+        default:                return "OTHER";
+    }
+}
+
+const char *elf_segment_type_name(uint32_t t) {
+    switch (t) {
+        case PT_NULL:         return "NULL";
+        case PT_LOAD:         return "LOAD";
+        case PT_DYNAMIC:      return "DYNAMIC";
+        case PT_INTERP:       return "INTERP";
+        case PT_NOTE:         return "NOTE";
+        case PT_SHLIB:        return "SHLIB";
+        case PT_PHDR:         return "PHDR";
+        case PT_TLS:          return "TLS";
+        case PT_GNU_EH_FRAME: return "GNU_EH_FRAME";
+        case PT_GNU_STACK:    return "GNU_STACK";
+        case PT_GNU_RELRO:    return "GNU_RELRO";
+        case PT_GNU_PROPERTY: return "GNU_PROPERTY";
+        default:              return "OTHER";
+    }
+}
+
+/* -------- summary (header + one sh_type sweep) -------- */
+
+int elf_summarize(const char *path, struct elf_summary *out, char *err, size_t errlen) {
+    struct file_view fv;
+    if (map_file(path, &fv, err, errlen) != 0) return -1;
+    int rc = elf_summarize_buf(fv.data, fv.len, out, err, errlen);
+    unmap_file(&fv);
     return rc;
 }
+
+int elf_summarize_buf(const unsigned char *buf, size_t len, struct elf_summary *out, char *err, size_t errlen) {
+    struct elf_view v;
+    if (elf_open(&v, buf, len, err, errlen) != 0) return -1;
+    snprintf(out->class_str, sizeof out->class_str, v.is64 ? "ELF64" : "ELF32");
+    snprintf(out->endian_str, sizeof out->endian_str, (v.data==ELFDATA2LSB)?"LE":(v.data==ELFDATA2MSB?"BE":"?"));
+    snprintf(out->machine, sizeof out->machine, "%s", elf_machine_name(v.machine));
+    out->entry = v.entry;
+    out->pie = (v.type == ET_DYN);
+    out->has_symtab = elf_find_section(&v, SHT_SYMTAB, NULL) >= 0;
+    return 0;
+}
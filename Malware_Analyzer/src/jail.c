@@ -11,6 +11,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/wait.h>
 
 #include "jail.h"
 
@@ -43,16 +45,11 @@ static int bind_ro(const char *src, const char *dst, int readonly) {
     return 0;
 }
 
-/* The header declares:
- * int jail_enter(const struct jail_opts *opt, char *err, size_t errlen);
- */
-int jail_enter(const struct jail_opts *opt, char *err, size_t errlen) {
-    if (!err || errlen == 0) return -1;
-    if (!opt) {
-        snprintf(err, errlen, "jail_enter: opt == NULL");
-        return -1;
-    }
+#define ROOT_MAX 256
 
+/* New mount (and optionally net) namespace with the bind tree under a root
+ * directory, which is returned in root. Everything but the chroot. */
+static int build_root(const struct jail_opts *opt, char root[ROOT_MAX], char *err, size_t errlen) {
     /* unshare mount namespace and optionally network namespace */
     int flags = CLONE_NEWNS;
     if (opt->make_netns) flags |= CLONE_NEWNET;
@@ -68,11 +65,10 @@ int jail_enter(const struct jail_opts *opt, char *err, size_t errlen) {
     }
 
     /* choose root directory (user-specified or temp) */
-    char root[256];
     if (opt->root) {
         /* copy safely */
         size_t rlen = strlen(opt->root);
-        if (rlen >= sizeof(root)) {
+        if (rlen >= ROOT_MAX) {
             snprintf(err, errlen, "root path too long");
             return -1;
         }
@@ -91,7 +87,7 @@ int jail_enter(const struct jail_opts *opt, char *err, size_t errlen) {
         }
         /* mkdtemp modifies template in place */
         size_t tlen = strlen(tmp_template);
-        if (tlen >= sizeof(root)) {
+        if (tlen >= ROOT_MAX) {
             snprintf(err, errlen, "temp root path too long");
             return -1;
         }
@@ -135,6 +131,22 @@ int jail_enter(const struct jail_opts *opt, char *err, size_t errlen) {
     TRY_BIND("usr");
     #undef TRY_BIND
 
+    return 0;
+}
+
+/* The header declares:
+ * int jail_enter(const struct jail_opts *opt, char *err, size_t errlen);
+ */
+int jail_enter(const struct jail_opts *opt, char *err, size_t errlen) {
+    if (!err || errlen == 0) return -1;
+    if (!opt) {
+        snprintf(err, errlen, "jail_enter: opt == NULL");
+        return -1;
+    }
+
+    char root[ROOT_MAX];
+    if (build_root(opt, root, err, errlen) != 0) return -1;
+
     /* chroot into the jail root and switch to "/" */
     if (chroot(root) != 0 || chdir("/") != 0) {
         snprintf(err, errlen, "chroot/chdir: %s", strerror(errno));
@@ -148,3 +160,104 @@ int jail_enter(const struct jail_opts *opt, char *err, size_t errlen) {
     /* success */
     return 0;
 }
+
+/* ---------- prepared jail ---------- */
+
+/* Helper: build the tree in fresh namespaces, report "OK root" or "ERR msg"
+ * on the pipe, then stay alive until the parent has opened the namespace. */
+static void prep_helper(const struct jail_opts *opt, int wfd, int rfd) {
+    char root[ROOT_MAX], err[256] = {0}, msg[600];
+    int ok = build_root(opt, root, err, sizeof err) == 0;
+    if (ok) {
+        char proc[300];
+        snprintf(proc, sizeof proc, "%s/proc", root);
+        (void) mount("proc", proc, "proc", 0, NULL);    /* best-effort, as in jail_enter */
+        snprintf(msg, sizeof msg, "OK %s", root);
+    } else {
+        snprintf(msg, sizeof msg, "ERR %s", err);
+    }
+    if (write(wfd, msg, strlen(msg)) < 0) _exit(1);
+    close(wfd);
+    char c;
+    while (read(rfd, &c, 1) < 0 && errno == EINTR) {}  /* parent done (or gone) */
+    _exit(ok ? 0 : 1);
+}
+
+int jail_prepare(const struct jail_opts *opt, struct jail_prep *jp, char *err, size_t errlen) {
+    int up[2], down[2];
+    memset(jp, 0, sizeof *jp);
+    jp->mnt_fd = jp->net_fd = -1;
+    if (pipe2(up, O_CLOEXEC) != 0 || pipe2(down, O_CLOEXEC) != 0) {
+        snprintf(err, errlen, "pipe: %s", strerror(errno));
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        snprintf(err, errlen, "fork: %s", strerror(errno));
+        close(up[0]); close(up[1]); close(down[0]); close(down[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(up[0]); close(down[1]);
+        prep_helper(opt, up[1], down[0]);
+    }
+    close(up[1]); close(down[0]);
+
+    char msg[600];
+    ssize_t n = read(up[0], msg, sizeof msg - 1);
+    close(up[0]);
+    msg[n > 0 ? n : 0] = '\0';
+
+    int rc = -1;
+    if (strncmp(msg, "OK ", 3) == 0) {
+        char ns[64];
+        if (strlen(msg + 3) >= sizeof jp->root) msg[3 + sizeof jp->root - 1] = '\0';
+        memcpy(jp->root, msg + 3, strlen(msg + 3) + 1);
+        snprintf(jp->tmp, sizeof jp->tmp, "%s/tmp", jp->root);
+        snprintf(ns, sizeof ns, "/proc/%d/ns/mnt", (int)pid);
+        jp->mnt_fd = open(ns, O_RDONLY | O_CLOEXEC);
+        if (opt->make_netns) {
+            snprintf(ns, sizeof ns, "/proc/%d/ns/net", (int)pid);
+            jp->net_fd = open(ns, O_RDONLY | O_CLOEXEC);
+        }
+        if (jp->mnt_fd < 0 || (opt->make_netns && jp->net_fd < 0))
+            snprintf(err, errlen, "open %s: %s", ns, strerror(errno));
+        else
+            rc = 0;
+    } else {
+        snprintf(err, errlen, "%s", n > 4 ? msg + 4 : "jail helper died");
+    }
+
+    close(down[1]);                                    /* lets the helper exit */
+    (void) waitpid(pid, NULL, 0);
+    if (rc != 0) jail_release(jp);
+    return rc;
+}
+
+int jail_attach(const struct jail_prep *jp) {
+    if (jp->net_fd >= 0 && setns(jp->net_fd, CLONE_NEWNET) != 0) return -1;
+    if (setns(jp->mnt_fd, CLONE_NEWNS) != 0) return -1;
+    /* a namespace of our own on top, just for a private /tmp */
+    if (unshare(CLONE_NEWNS) != 0) return -1;
+    if (mount("tmpfs", jp->tmp, "tmpfs", MS_NOSUID | MS_NODEV, "mode=1777,size=64m") != 0) return -1;
+    if (chroot(jp->root) != 0 || chdir("/") != 0) return -1;
+    return 0;
+}
+
+void jail_release(struct jail_prep *jp) {
+    if (jp->mnt_fd >= 0) close(jp->mnt_fd);           /* last reference: the mounts go away */
+    if (jp->net_fd >= 0) close(jp->net_fd);
+    jp->mnt_fd = jp->net_fd = -1;
+    if (jp->root[0]) {
+        /* the host only ever saw empty mount points (best-effort) */
+        static const char *const sub[] = { "bin", "lib", "lib64", "usr", "proc", "tmp" };
+        char path[512];
+        for (size_t i = 0; i < sizeof sub / sizeof sub[0]; ++i) {
+            snprintf(path, sizeof path, "%s/%s", jp->root, sub[i]);
+            (void) rmdir(path);
+        }
+        (void) rmdir(jp->root);
+        jp->root[0] = '\0';
+    }
+}
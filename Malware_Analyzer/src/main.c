@@ -7,12 +7,15 @@
 #include "elfx.h"
 #include "sandbox.h"
 #include "trace.h"
+#include "syscalls.h"
+#include "scan.h"
+#include "batch.h"
+#include "static.h"
+#include "cache.h"
+#include "content.h"
+#include "version.h"
 
-/* -------- Version / exit codes -------- */
-#ifndef MALX_VERSION
-#define MALX_VERSION "1.0.0"
-#endif
-
+/* -------- Exit codes -------- */
 #define EX_OK       0   /* success */
 #define EX_USAGE    1   /* bad args */
 #define EX_IO       2   /* file/ELF/hash error */
@@ -25,9 +28,14 @@ static void print_usage(void) {
         "malx " MALX_VERSION "\n"
         "Usage:\n"
         "  malx --help | --version\n"
-        "  malx static <file> [--json] [--pretty]\n"
-        "  malx run    <path> [--timeout SEC] [--mem MB] [--no-net] [--jail] [--json] [--pretty] [--] [args...]\n"
-        "  malx trace  <path> [--timeout SEC] [--max N] [--jail] [--json] [--pretty] [--] [args...]\n"
+        "  malx static <file> [--json] [--pretty] [--deep] [--content] [--rules FILE] [--no-cache]\n"
+        "  malx scan   <dir|file|@list>... [-j N] [--no-cache]   (NDJSON, one record per file)\n"
+        "  malx run    <path> [--timeout SEC] [--mem MB] [--no-net] [--jail] [--json] [--pretty] [--cache] [--] [args...]\n"
+        "  malx run-batch <file|dir|@list>... [-j N] [--budget MB] [--timeout SEC] [--mem MB] [--cpu PCT]\n"
+        "                 [--pids N] [--cgroup DIR] [--no-net] [--jail] [--fork] [-- args...]   (NDJSON, one record per sample)\n"
+        "                 cgroup limits need a delegated cgroup: --cgroup DIR, or run malx under\n"
+        "                 systemd-run --user -p Delegate=yes --scope; otherwise rlimits are used\n"
+        "  malx trace  <path> [--timeout SEC] [--max N] [--syscalls=a,b,...] [--summary] [--jail] [--json|--ndjson] [--pretty] [--] [args...]\n"
     );
 }
 
@@ -36,42 +44,119 @@ static void print_usage(void) {
  * ======================= */
 static int cmd_static(int argc, char **argv) {
     if (argc < 1) {
-        fprintf(stderr, "Usage: malx static <file> [--json] [--pretty]\n");
+        fprintf(stderr, "Usage: malx static <file> [--json] [--pretty] [--deep] [--content] [--rules FILE] [--no-cache]\n");
         return EX_USAGE;
     }
 
     const char *path = argv[0];
-    int json = 0, pretty = 0;
+    const char *rules_path = NULL;
+    int json = 0, pretty = 0, use_cache = 1, deep = 0, content = 0;
     for (int i = 1; i < argc; ++i) {
         if (!strcmp(argv[i], "--json"))   json = 1;
         else if (!strcmp(argv[i], "--pretty")) pretty = 1;
+        else if (!strcmp(argv[i], "--deep"))   deep = 1;
+        else if (!strcmp(argv[i], "--content")) content = 1;
+        else if (!strcmp(argv[i], "--rules") && i+1 < argc) { rules_path = argv[++i]; content = 1; }
+        else if (!strcmp(argv[i], "--no-cache")) use_cache = 0;
     }
 
-    struct elf_summary sum;
     char err[256] = {0};
-
-    if (elf_summarize(path, &sum, err, sizeof(err)) != 0) {
-        fprintf(stderr, "ELF parse failed: %s\n", err[0] ? err : path);
-        return EX_IO;
+    struct rule_set *rules = NULL;
+    if (content) {
+        rules = rules_new();
+        if (!rules || rules_add_builtin(rules) != 0 ||
+            (rules_path && rules_add_file(rules, rules_path, err, sizeof err) < 0) ||
+            rules_compile(rules, err, sizeof err) != 0) {
+            fprintf(stderr, "rules: %s\n", err[0] ? err : "out of memory");
+            rules_free(rules);
+            return EX_USAGE;
+        }
     }
+    struct malx_cache *cache = use_cache ? cache_open(err, sizeof err) : NULL;
 
-    unsigned char *buf = NULL; size_t len = 0;
-    if (read_file(path, &buf, &len, err, sizeof(err)) != 0) {
-        fprintf(stderr, "read_file failed: %s\n", err[0] ? err : path);
+    struct static_result res;
+    struct content_scan cs;
+    int rc = static_analyze_content(path, cache, rules, content ? &cs : NULL, &res);
+    cache_close(cache);
+    if (rc != 0 && content && res.stage && !strcmp(res.stage, "elf")) {
+        /* not ELF (a packed blob, a script): the content scan is still the answer */
+        fprintf(stderr, "ELF parse failed: %s\n", res.err[0] ? res.err : path);
+        struct report_opts opt = { .json = json, .pretty = pretty };
+        print_static_report_ex(path, res.sha256, NULL, NULL, &cs.rep, rules, &opt);
+        content_free(&cs);
+        rules_free(rules);
         return EX_IO;
     }
-
-    char sha256[65] = {0};
-    if (sha256_hex(buf, len, sha256) != 0) {
-        free(buf);
-        fprintf(stderr, "sha256_hex failed\n");
+    if (rc != 0) {
+        if (content) { content_free(&cs); rules_free(rules); }
+        if (res.stage && !strcmp(res.stage, "elf"))
+            fprintf(stderr, "ELF parse failed: %s\n", res.err[0] ? res.err : path);
+        else if (res.stage && !strcmp(res.stage, "hash"))
+            fprintf(stderr, "sha256_hex failed\n");
+        else
+            fprintf(stderr, "map_file failed: %s\n", res.err[0] ? res.err : path);
         return EX_IO;
     }
-    free(buf);
 
     struct report_opts opt = { .json = json, .pretty = pretty };
-    print_static_report(path, sha256, &sum, &opt);
-    return EX_OK;
+    const struct content_report *crep = content ? &cs.rep : NULL;
+    rc = EX_OK;
+    if (!deep) {
+        print_static_report_ex(path, res.sha256, &res.sum, NULL, crep, rules, &opt);
+    } else {
+        /* the tables are decoded lazily while printing, straight from the mapping */
+        struct file_view fv;
+        struct elf_view ev;
+        if (map_file(path, &fv, err, sizeof err) != 0) {
+            fprintf(stderr, "map_file failed: %s\n", err);
+            rc = EX_IO;
+        } else if (elf_open(&ev, fv.data, fv.len, err, sizeof err) != 0) {
+            fprintf(stderr, "ELF parse failed: %s\n", err);
+            rc = EX_IO;
+        } else {
+            print_static_report_ex(path, res.sha256, &res.sum, &ev, crep, rules, &opt);
+        }
+        unmap_file(&fv);
+    }
+    if (content) { content_free(&cs); rules_free(rules); }
+    return rc;
+}
+
+/* =======================
+ * Batch triage: scan
+ * ======================= */
+static int cmd_scan(int argc, char **argv) {
+    if (argc < 1) {
+        fprintf(stderr, "Usage: malx scan <dir|file|@list>... [-j N] [--no-cache]\n");
+        return EX_USAGE;
+    }
+
+    char **roots = calloc((size_t)argc, sizeof(char*));
+    if (!roots) { perror("calloc"); return EX_IO; }
+    int nroots = 0, jobs = 0, use_cache = 1;
+    for (int i = 0; i < argc; ++i) {
+        if (!strcmp(argv[i], "-j") && i+1 < argc) jobs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-cache")) use_cache = 0;
+        else if (!strncmp(argv[i], "-j", 2) && argv[i][2]) jobs = atoi(argv[i] + 2);
+        else roots[nroots++] = argv[i];
+    }
+    if (!nroots) {
+        free(roots);
+        fprintf(stderr, "Usage: malx scan <dir|file|@list>... [-j N] [--no-cache]\n");
+        return EX_USAGE;
+    }
+
+    char err[256] = {0};
+    struct scan_opts so = { .roots = roots, .nroots = nroots, .jobs = jobs,
+                            .cache = use_cache ? cache_open(err, sizeof err) : NULL };
+    struct scan_stats st = {0};
+    int rc = scan_run(&so, &st);
+    cache_close(so.cache);
+    free(roots);
+    if (rc != 0) return EX_SANDBOX;
+
+    fprintf(stderr, "scanned %lu file(s), %lu error(s) (%lu not ELF)\n", st.files, st.errors, st.not_elf);
+    return st.errors > st.not_elf ? EX_IO : EX_OK;   /* non-ELF input isn't a failure */
 }
 
 /* =======================
@@ -79,19 +164,20 @@ static int cmd_static(int argc, char **argv) {
  * ======================= */
 static int cmd_run(int argc, char **argv) {
     if (argc < 1) {
-        fprintf(stderr, "Usage: malx run <path> [--timeout SEC] [--mem MB] [--no-net] [--jail] [--json] [--pretty] [--] [args...]\n");
+        fprintf(stderr, "Usage: malx run <path> [--timeout SEC] [--mem MB] [--no-net] [--jail] [--json] [--pretty] [--cache] [--] [args...]\n");
         return EX_USAGE;
     }
 
     const char *path = argv[0];
     struct limits lim = { .timeout_sec = 5, .mem_bytes = 256L*1024*1024, .fsize_bytes = 16L*1024*1024, .nofile = 64 };
-    int no_net = 0, json = 0, pretty = 0, use_jail = 0;
+    int no_net = 0, json = 0, pretty = 0, use_jail = 0, use_cache = 0;
 
     int sep = -1;
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "--")) { sep = i; break; }
         else if (!strcmp(argv[i], "--timeout") && i+1 < argc) lim.timeout_sec = atoi(argv[++i]);
         else if (!strcmp(argv[i], "--mem")     && i+1 < argc) lim.mem_bytes  = atol(argv[++i]) * 1024L * 1024L;
+        else if (!strcmp(argv[i], "--cache"))   use_cache = 1;
         else if (!strcmp(argv[i], "--no-net"))  no_net = 1;
         else if (!strcmp(argv[i], "--jail"))    use_jail = 1;
         else if (!strcmp(argv[i], "--json"))    json = 1;
@@ -105,26 +191,55 @@ static int cmd_run(int argc, char **argv) {
     if (sep >= 0) for (int i = 0; i < argc - sep - 1; i++) child_argv[1+i] = argv[sep+1+i];
     child_argv[child_argc] = NULL;
 
-    struct run_result rr = {0};
-    int run_rc = run_in_sandbox(path, child_argv, &lim, no_net, use_jail, &rr);
-    free(child_argv);
+    /* Opt-in: a run isn't deterministic, but re-detonating the same sample
+       with the same arguments and limits rarely tells us anything new. */
+    struct malx_cache *cache = NULL;
+    struct static_result sres;
+    uint64_t tag = 0;
+    if (use_cache) {
+        char cerr[256];
+        cache = cache_open(cerr, sizeof cerr);
+        if (!cache) fprintf(stderr, "cache disabled: %s\n", cerr);
+        else if (static_analyze(path, cache, &sres) != 0 && !sres.sha256[0]) { cache_close(cache); cache = NULL; }
+        for (int i = 1; i < child_argc; i++) tag = cache_tag(tag, child_argv[i], strlen(child_argv[i]) + 1);
+        /* field by field: the struct's padding bytes are indeterminate */
+        long params[6] = { lim.timeout_sec, lim.mem_bytes, lim.fsize_bytes, lim.nofile, no_net, use_jail };
+        tag = cache_tag(tag, params, sizeof params);
+    }
 
-    if (run_rc != 0) {
-        fprintf(stderr, "run failed\n");
-        return EX_SANDBOX;
+    struct run_result rr = {0};
+    int cached = cache && cache_get_run(cache, sres.sha256, tag, &rr);
+    if (!cached) {
+        int run_rc = run_in_sandbox(path, child_argv, &lim, no_net, use_jail, &rr);
+        if (run_rc != 0) {
+            free(child_argv);
+            cache_close(cache);
+            fprintf(stderr, "run failed\n");
+            return EX_SANDBOX;
+        }
+        if (cache) cache_put_run(cache, sres.sha256, tag, &rr);
     }
+    free(child_argv);
+    cache_close(cache);
 
+    const char *cached_json = !use_cache ? "" : cached ? (pretty ? ",\n    \"cached\": true" : ",\"cached\":true")
+                                                      : (pretty ? ",\n    \"cached\": false" : ",\"cached\":false");
     if (json) {
         if (pretty) {
-            printf("{\n  \"run\": {\n    \"path\": \"%s\",\n    \"exit_code\": %d,\n    \"term_signal\": %d,\n    \"timeout\": %s,\n    \"elapsed_ms\": %ld\n  }\n}\n",
-                   path, rr.exit_code, rr.term_signal, rr.killed_by_timeout ? "true":"false", rr.elapsed_ms);
+            printf("{\n  \"run\": {\n    \"path\": \"%s\",\n    \"exit_code\": %d,\n    \"term_signal\": %d,\n    \"timeout\": %s,\n    \"elapsed_ms\": %ld,\n    \"setup_us\": %ld,\n    ",
+                   path, rr.exit_code, rr.term_signal, rr.killed_by_timeout ? "true":"false", rr.elapsed_ms, rr.setup_us);
+            json_write_usage(stdout, &rr.usage, "    ");
+            printf("%s\n  }\n}\n", cached_json);
         } else {
-            printf("{\"run\":{\"path\":\"%s\",\"exit_code\":%d,\"term_signal\":%d,\"timeout\":%s,\"elapsed_ms\":%ld}}\n",
-                   path, rr.exit_code, rr.term_signal, rr.killed_by_timeout ? "true":"false", rr.elapsed_ms);
+            printf("{\"run\":{\"path\":\"%s\",\"exit_code\":%d,\"term_signal\":%d,\"timeout\":%s,\"elapsed_ms\":%ld,\"setup_us\":%ld,",
+                   path, rr.exit_code, rr.term_signal, rr.killed_by_timeout ? "true":"false", rr.elapsed_ms, rr.setup_us);
+            json_write_usage(stdout, &rr.usage, NULL);
+            printf("%s}}\n", cached_json);
         }
     } else {
-        printf("ran %s  exit=%d  sig=%d  timeout=%d  elapsed=%ldms\n",
-               path, rr.exit_code, rr.term_signal, rr.killed_by_timeout, rr.elapsed_ms);
+        printf("ran %s  exit=%d  sig=%d  timeout=%d  elapsed=%ldms  setup=%ldus  user=%ldus  sys=%ldus  rss=%ldKB%s\n",
+               path, rr.exit_code, rr.term_signal, rr.killed_by_timeout, rr.elapsed_ms, rr.setup_us,
+               rr.usage.utime_us, rr.usage.stime_us, rr.usage.maxrss_kb, cached ? "  (cached)" : "");
     }
 
     /* Standardized exit code mapping for CI/scripts */
@@ -134,29 +249,90 @@ static int cmd_run(int argc, char **argv) {
     return EX_OK;
 }
 
+/* =======================
+ * Detonation farm: run-batch
+ * ======================= */
+static int cmd_run_batch(int argc, char **argv) {
+    const char *usage = "Usage: malx run-batch <file|dir|@list>... [-j N] [--budget MB] [--timeout SEC] [--mem MB] [--cpu PCT] [--pids N] [--cgroup DIR] [--no-net] [--jail] [--fork] [-- args...]\n";
+    char **inputs = calloc((size_t)argc + 1, sizeof(char*));
+    if (!inputs) { perror("calloc"); return EX_IO; }
+
+    struct batch_opts bo = {
+        .lim = { .timeout_sec = 5, .mem_bytes = 256L*1024*1024, .fsize_bytes = 16L*1024*1024, .nofile = 64 },
+        .cg  = { .mem_bytes = 256L*1024*1024, .cpu_pct = 100, .pids = 64 },
+    };
+    int n = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (!strcmp(argv[i], "--")) { bo.args = &argv[i+1]; bo.nargs = argc - i - 1; break; }
+        else if (!strcmp(argv[i], "-j") && i+1 < argc)        bo.jobs = atoi(argv[++i]);
+        else if (!strncmp(argv[i], "-j", 2) && argv[i][2])    bo.jobs = atoi(argv[i] + 2);
+        else if (!strcmp(argv[i], "--budget") && i+1 < argc)  bo.budget_bytes = atol(argv[++i]) * 1024L * 1024L;
+        else if (!strcmp(argv[i], "--timeout") && i+1 < argc) bo.lim.timeout_sec = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--mem") && i+1 < argc)     bo.lim.mem_bytes = bo.cg.mem_bytes = atol(argv[++i]) * 1024L * 1024L;
+        else if (!strcmp(argv[i], "--cpu") && i+1 < argc)     bo.cg.cpu_pct = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--pids") && i+1 < argc)    bo.cg.pids = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--cgroup") && i+1 < argc)  bo.cgroup_parent = argv[++i];
+        else if (!strcmp(argv[i], "--no-net"))                bo.no_net = 1;
+        else if (!strcmp(argv[i], "--jail"))                  bo.use_jail = 1;
+        else if (!strcmp(argv[i], "--fork"))                  bo.fork_each = 1;
+        else inputs[n++] = argv[i];
+    }
+    if (!n) { free(inputs); fputs(usage, stderr); return EX_USAGE; }
+    bo.inputs = inputs;
+    bo.ninputs = n;
+
+    struct batch_stats st;
+    int rc = batch_run(&bo, &st);
+    free(inputs);
+    if (rc != 0) return EX_SANDBOX;
+
+    fprintf(stderr, "ran %lu sample(s) %d at a time (%s limits): %lu failed, %lu timed out\n",
+            st.runs, st.jobs, st.cgroups ? "cgroup" : "rlimit", st.failed, st.timeouts);
+    return EX_OK;
+}
+
 /* =======================
  * Phase 3 + 4: trace (ptrace + optional jail)
  * NOTE: we accept --timeout/--max, but CI does not rely on timeout here.
  * ======================= */
 static int cmd_trace(int argc, char **argv) {
     if (argc < 1) {
-        fprintf(stderr, "Usage: malx trace <path> [--timeout SEC] [--max N] [--jail] [--json] [--pretty] [--] [args...]\n");
+        fprintf(stderr, "Usage: malx trace <path> [--timeout SEC] [--max N] [--syscalls=a,b,...] [--summary] [--jail] [--json|--ndjson] [--pretty] [--] [args...]\n");
         return EX_USAGE;
     }
 
     const char *path = argv[0];
-    int timeout = 5, maxev = 200, json = 1, pretty = 0, use_jail = 0;
+    int timeout = 5, maxev = 200, json = 1, ndjson = 0, pretty = 0, use_jail = 0;
+    int summary = 0, max_set = 0;
+    long filter[TRACE_MAX_FILTER];
+    int nfilter = 0;
 
     int sep = -1;
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "--")) { sep = i; break; }
+        else if (!strncmp(argv[i], "--syscalls=", 11) || (!strcmp(argv[i], "--syscalls") && i+1 < argc)) {
+            char list[1024];
+            snprintf(list, sizeof list, "%s", argv[i][10] == '=' ? argv[i] + 11 : argv[++i]);
+            for (char *save = NULL, *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+                long nr = syscall_number(tok);
+                if (nr < 0) { fprintf(stderr, "unknown syscall: %s\n", tok); return EX_USAGE; }
+                if (nfilter == TRACE_MAX_FILTER) { fprintf(stderr, "at most %d syscalls\n", TRACE_MAX_FILTER); return EX_USAGE; }
+                filter[nfilter++] = nr;
+            }
+            if (!nfilter) { fprintf(stderr, "--syscalls: empty list\n"); return EX_USAGE; }
+        }
         else if (!strcmp(argv[i], "--timeout") && i+1 < argc) timeout = atoi(argv[++i]);
-        else if (!strcmp(argv[i], "--max")     && i+1 < argc) maxev   = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--max")     && i+1 < argc) { maxev = atoi(argv[++i]); max_set = 1; }
+        else if (!strcmp(argv[i], "--summary")) summary = 1;
         else if (!strcmp(argv[i], "--jail"))   use_jail = 1;
         else if (!strcmp(argv[i], "--json"))   json   = 1;
+        else if (!strcmp(argv[i], "--ndjson")) json = ndjson = 1;
         else if (!strcmp(argv[i], "--pretty")) pretty = 1;
     }
 
+    /* a summary stays the same size however long the run, so don't cut it short */
+    if (summary && !max_set) maxev = 0;
+
     int child_argc = 1 + ((sep >= 0) ? (argc - sep - 1) : 0);
     char **child_argv = calloc(child_argc + 1, sizeof(char*));
     if (!child_argv) { perror("calloc"); return EX_SANDBOX; }
@@ -169,7 +345,11 @@ static int cmd_trace(int argc, char **argv) {
         .max_events  = maxev,
         .json        = json,
         .pretty      = pretty,
-        .jail        = use_jail
+        .ndjson      = ndjson,
+        .jail        = use_jail,
+        .summary     = summary,
+        .syscalls    = filter,
+        .nsyscalls   = nfilter
     };
 
     int rc = trace_process(path, child_argv, &topt);
@@ -192,7 +372,9 @@ int main(int argc, char **argv) {
     if (!strcmp(argv[1], "--version")) { printf("malx %s\n", MALX_VERSION); return EX_OK; }
 
     if (!strcmp(argv[1], "static")) return cmd_static(argc-2, &argv[2]);
+    if (!strcmp(argv[1], "scan"))   return cmd_scan  (argc-2, &argv[2]);
     if (!strcmp(argv[1], "run"))    return cmd_run   (argc-2, &argv[2]);
+    if (!strcmp(argv[1], "run-batch")) return cmd_run_batch(argc-2, &argv[2]);
     if (!strcmp(argv[1], "trace"))  return cmd_trace (argc-2, &argv[2]);
 
     fprintf(stderr, "unknown subcommand: %s\n", argv[1]);
@@ -0,0 +1,43 @@
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perfctr.h"
+
+static int open_counter(uint64_t config) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof a);
+    a.size = sizeof a;
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = config;
+    a.disabled = 1;
+    a.inherit = 1;              /* no PERF_FORMAT_GROUP: inherited groups can't be read */
+    a.enable_on_exec = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+void perf_child_open(struct perf_counters *pc) {
+    pc->cycles_fd = open_counter(PERF_COUNT_HW_CPU_CYCLES);
+    pc->instr_fd  = open_counter(PERF_COUNT_HW_INSTRUCTIONS);
+}
+
+static long long read_counter(int fd) {
+    uint64_t v;
+    if (fd < 0 || read(fd, &v, sizeof v) != (ssize_t)sizeof v) return -1;
+    return (long long)v;
+}
+
+void perf_child_read(const struct perf_counters *pc, long long *cycles, long long *instructions) {
+    *cycles = read_counter(pc->cycles_fd);
+    *instructions = read_counter(pc->instr_fd);
+}
+
+void perf_child_close(struct perf_counters *pc) {
+    if (pc->cycles_fd >= 0) close(pc->cycles_fd);
+    if (pc->instr_fd >= 0) close(pc->instr_fd);
+    pc->cycles_fd = pc->instr_fd = -1;
+}
@@ -1,30 +1,307 @@
 #include "report.h"
+#include "sandbox.h"
+#include "utils.h"
+#include <elf.h>
 #include <stdio.h>
+#include <string.h>
 
-static void print_json(const char *file, const char sha256[65], const struct elf_summary *s, int pretty) {
+#define HIGH_ENTROPY 7.2    /* bits/byte; compressed or encrypted payloads */
+
+static void flags_str(uint64_t f, char out[4]) {
+    out[0] = (f & SHF_WRITE) ? 'W' : '-';
+    out[1] = (f & SHF_ALLOC) ? 'A' : '-';
+    out[2] = (f & SHF_EXECINSTR) ? 'X' : '-';
+    out[3] = '\0';
+}
+
+static void pflags_str(uint32_t f, char out[4]) {
+    out[0] = (f & PF_R) ? 'R' : '-';
+    out[1] = (f & PF_W) ? 'W' : '-';
+    out[2] = (f & PF_X) ? 'X' : '-';
+    out[3] = '\0';
+}
+
+static double section_entropy(const struct elf_section *sec) {
+    return sec->data ? byte_entropy(sec->data, (size_t)sec->size) : 0.0;
+}
+
+static void hex_bytes(FILE *out, const unsigned char *p, size_t n) {
+    for (size_t i = 0; i < n; ++i) fprintf(out, "%02x", p[i]);
+}
+
+/* -------- --deep: text -------- */
+
+struct list_ctx { int n; int json; };
+
+static int print_needed(const char *lib, void *ctx) {
+    struct list_ctx *c = ctx;
+    if (c->json) { if (c->n++) putchar(','); json_write_str(stdout, lib); }
+    else printf("%s%s", c->n++ ? ", " : "", lib);
+    return 0;
+}
+
+static int print_note(const struct elf_note *n, void *ctx) {
+    struct list_ctx *c = ctx;
+    size_t shown = n->descsz > 32 && !(n->type == NT_GNU_BUILD_ID && !strcmp(n->name, "GNU")) ? 32 : n->descsz;
+    if (c->json) {
+        printf("%s{\"name\":", c->n++ ? "," : "");
+        json_write_str(stdout, n->name);
+        printf(",\"type\":%u,\"desc\":\"", n->type);
+        hex_bytes(stdout, n->desc, shown);
+        printf("\"}");
+    } else {
+        c->n++;
+        printf("  %-8s type=%-3u ", n->name, n->type);
+        if (n->type == NT_GNU_BUILD_ID && !strcmp(n->name, "GNU")) printf("build-id=");
+        hex_bytes(stdout, n->desc, shown);
+        printf("%s\n", shown < n->descsz ? "..." : "");
+    }
+    return 0;
+}
+
+/* undefined dynamic symbols with a name: what the sample pulls in at load time */
+static void print_imports(const struct elf_view *v, int json) {
+    struct elf_symtab st;
+    int n = 0;
+    if (elf_symtab_open(v, SHT_DYNSYM, &st) != 0) return;
+    struct elf_symbol sym;
+    for (size_t i = 1; i < st.count; ++i) {
+        if (elf_symbol(v, &st, i, &sym) != 0 || sym.shndx != SHN_UNDEF || !sym.name[0]) continue;
+        if (json) { if (n) putchar(','); json_write_str(stdout, sym.name); }
+        else printf("%s%s", n ? ", " : "", sym.name);
+        ++n;
+    }
+}
+
+static size_t symtab_count(const struct elf_view *v, uint32_t type) {
+    struct elf_symtab st;
+    return elf_symtab_open(v, type, &st) == 0 ? st.count : 0;
+}
+
+static void print_deep_text(const struct elf_view *v) {
+    struct elf_section sec;
+    struct elf_segment seg;
+    char fl[4];
+
+    printf("Sections: %u\n", v->shnum);
+    for (uint32_t i = 0; i < v->shnum; ++i) {
+        if (elf_section(v, i, &sec) != 0) continue;
+        double h = section_entropy(&sec);
+        flags_str(sec.flags, fl);
+        printf("  [%2u] %-20s %-13s off=0x%llx size=0x%llx %s H=%.2f%s%s\n", i, sec.name,
+               elf_section_type_name(sec.type), (unsigned long long)sec.offset,
+               (unsigned long long)sec.size, fl, h,
+               (sec.flags & SHF_WRITE) && (sec.flags & SHF_EXECINSTR) ? "  <- W+X" : "",
+               sec.size >= 256 && h > HIGH_ENTROPY ? "  <- high entropy" : "");
+    }
+    printf("Segments: %u\n", v->phnum);
+    for (uint32_t i = 0; i < v->phnum; ++i) {
+        if (elf_segment(v, i, &seg) != 0) continue;
+        pflags_str(seg.flags, fl);
+        printf("  %-13s off=0x%llx vaddr=0x%llx filesz=0x%llx memsz=0x%llx %s%s\n",
+               elf_segment_type_name(seg.type), (unsigned long long)seg.offset,
+               (unsigned long long)seg.vaddr, (unsigned long long)seg.filesz,
+               (unsigned long long)seg.memsz, fl,
+               seg.type == PT_LOAD && (seg.flags & PF_W) && (seg.flags & PF_X) ? "  <- W+X" : "");
+    }
+    struct list_ctx c = { 0, 0 };
+    printf("Needed: ");
+    elf_foreach_needed(v, print_needed, &c);
+    printf("%s\nImports: ", c.n ? "" : "(none)");
+    print_imports(v, 0);
+    printf("\nSymbols: symtab=%zu dynsym=%zu\n", symtab_count(v, SHT_SYMTAB), symtab_count(v, SHT_DYNSYM));
+    printf("Notes:\n");
+    c.n = 0;
+    elf_foreach_note(v, print_note, &c);
+}
+
+/* -------- --deep: JSON (one line per entry when pretty) -------- */
+
+static void print_deep_json(const struct elf_view *v, const char *sep, const char *pad, const char *nl) {
+    struct elf_section sec;
+    struct elf_segment seg;
+    char fl[4];
+
+    printf("%s\"deep\": {%s\n", pad, nl);
+    printf("%s%s\"sections\": [", pad, pad);
+    for (uint32_t i = 0; i < v->shnum; ++i) {
+        if (elf_section(v, i, &sec) != 0) continue;
+        flags_str(sec.flags, fl);
+        printf("%s%s%s%s%s{\"name\":", i ? "," : "", nl, pad, pad, pad);
+        json_write_str(stdout, sec.name);
+        printf(",\"type\":\"%s\",\"offset\":%llu,\"size\":%llu,\"flags\":\"%s\",\"entropy\":%.3f}",
+               elf_section_type_name(sec.type), (unsigned long long)sec.offset,
+               (unsigned long long)sec.size, fl, section_entropy(&sec));
+    }
+    printf("],%s\n", nl);
+    printf("%s%s\"segments\": [", pad, pad);
+    for (uint32_t i = 0; i < v->phnum; ++i) {
+        if (elf_segment(v, i, &seg) != 0) continue;
+        pflags_str(seg.flags, fl);
+        printf("%s%s%s%s%s{\"type\":\"%s\",\"offset\":%llu,\"vaddr\":%llu,\"filesz\":%llu,\"memsz\":%llu,\"flags\":\"%s\"}",
+               i ? "," : "", nl, pad, pad, pad, elf_segment_type_name(seg.type),
+               (unsigned long long)seg.offset, (unsigned long long)seg.vaddr,
+               (unsigned long long)seg.filesz, (unsigned long long)seg.memsz, fl);
+    }
+    printf("],%s\n", nl);
+    struct list_ctx c = { 0, 1 };
+    printf("%s%s\"needed\": [", pad, pad);
+    elf_foreach_needed(v, print_needed, &c);
+    printf("],%s\n%s%s\"imports\": [", nl, pad, pad);
+    print_imports(v, 1);
+    printf("],%s\n", nl);
+    printf("%s%s\"symbols\": {\"symtab\":%zu,\"dynsym\":%zu},%s\n", pad, pad,
+           symtab_count(v, SHT_SYMTAB), symtab_count(v, SHT_DYNSYM), nl);
+    printf("%s%s\"notes\": [", pad, pad);
+    c.n = 0;
+    elf_foreach_note(v, print_note, &c);
+    printf("]%s\n", nl);
+    printf("%s}%s%s\n", pad, sep, nl);
+}
+
+/* -------- content: entropy windows + rule hits -------- */
+
+static void print_content_text(const struct content_report *c, const struct rule_set *rules) {
+    printf("Entropy: %.3f overall, max %.3f @0x%llx (%d KiB windows), %llu/%llu windows > %.1f",
+           c->entropy, c->max_window, (unsigned long long)c->max_window_off, CONTENT_WINDOW / 1024,
+           (unsigned long long)c->high_windows, (unsigned long long)c->windows, CONTENT_HIGH_ENTROPY);
+    if (c->run_len) printf(", longest run 0x%llx+0x%llx", (unsigned long long)c->run_off, (unsigned long long)c->run_len);
+    printf("\nMatches:");
+    int any = 0;
+    for (size_t i = 0; i < c->nrules; ++i) {
+        if (!c->hits[i]) continue;
+        printf("%s %s x%llu @0x%llx", any++ ? "," : "", rules_name(rules, i),
+               (unsigned long long)c->hits[i], (unsigned long long)c->first[i]);
+    }
+    printf("%s\n", any ? "" : " (none)");
+}
+
+static void print_content_json(const struct content_report *c, const struct rule_set *rules,
+                               const char *pad, const char *nl) {
+    printf("%s\"content\": {%s\n", pad, nl);
+    printf("%s%s\"entropy\": %.3f,%s\n", pad, pad, c->entropy, nl);
+    printf("%s%s\"window\": %d,%s\n", pad, pad, CONTENT_WINDOW, nl);
+    printf("%s%s\"max_window_entropy\": %.3f,%s\n", pad, pad, c->max_window, nl);
+    printf("%s%s\"max_window_offset\": %llu,%s\n", pad, pad, (unsigned long long)c->max_window_off, nl);
+    printf("%s%s\"windows\": %llu,%s\n", pad, pad, (unsigned long long)c->windows, nl);
+    printf("%s%s\"high_entropy_windows\": %llu,%s\n", pad, pad, (unsigned long long)c->high_windows, nl);
+    printf("%s%s\"high_entropy_run\": {\"offset\":%llu,\"length\":%llu},%s\n", pad, pad,
+           (unsigned long long)c->run_off, (unsigned long long)c->run_len, nl);
+    printf("%s%s\"matches\": [", pad, pad);
+    int any = 0;
+    for (size_t i = 0; i < c->nrules; ++i) {
+        if (!c->hits[i]) continue;
+        printf("%s{\"rule\":\"%s\",\"count\":%llu,\"first\":%llu}", any++ ? "," : "",
+               rules_name(rules, i), (unsigned long long)c->hits[i], (unsigned long long)c->first[i]);
+    }
+    printf("]%s\n", nl);
+    printf("%s}%s\n", pad, nl);
+}
+
+static void print_json(const char *file, const char sha256[65], const struct elf_summary *s,
+                       const struct elf_view *deep, const struct content_report *content,
+                       const struct rule_set *rules, int pretty) {
     const char *pad = pretty ? "  " : "";
     const char *nl = pretty ? "\n" : "";
     printf("{\n");
-    printf("%s\"file\": \"%s\",%s\n", pad, file, nl);
+    printf("%s\"file\": ", pad);
+    json_write_str(stdout, file);
+    printf(",%s\n", nl);
     printf("%s\"sha256\": \"%s\",%s\n", pad, sha256, nl);
-    printf("%s\"elf\": {\n", pad);
-    printf("%s%s\"class\": \"%s\",%s\n", pad,pad, s->class_str, nl);
-    printf("%s%s\"endian\": \"%s\",%s\n", pad,pad, s->endian_str, nl);
-    printf("%s%s\"machine\": \"%s\",%s\n", pad,pad, s->machine, nl);
-    printf("%s%s\"entry\": %llu,%s\n", pad,pad, (unsigned long long)s->entry, nl);
-    printf("%s%s\"pie\": %s,%s\n", pad,pad, s->pie? "true":"false", nl);
-    printf("%s%s\"has_symtab\": %s%s\n", pad,pad, s->has_symtab? "true":"false", nl);
-    printf("%s}%s\n", pad, nl);
+    if (!s) printf("%s\"elf\": null%s%s\n", pad, deep || content ? "," : "", nl);
+    else {
+        printf("%s\"elf\": {\n", pad);
+        printf("%s%s\"class\": \"%s\",%s\n", pad,pad, s->class_str, nl);
+        printf("%s%s\"endian\": \"%s\",%s\n", pad,pad, s->endian_str, nl);
+        printf("%s%s\"machine\": \"%s\",%s\n", pad,pad, s->machine, nl);
+        printf("%s%s\"entry\": %llu,%s\n", pad,pad, (unsigned long long)s->entry, nl);
+        printf("%s%s\"pie\": %s,%s\n", pad,pad, s->pie? "true":"false", nl);
+        printf("%s%s\"has_symtab\": %s%s\n", pad,pad, s->has_symtab? "true":"false", nl);
+        printf("%s}%s%s\n", pad, deep || content ? "," : "", nl);
+    }
+    if (deep) print_deep_json(deep, content ? "," : "", pad, nl);
+    if (content) print_content_json(content, rules, pad, nl);
     printf("}%s\n", nl);
 }
 
 void print_static_report(const char *file, const char sha256[65], const struct elf_summary *s, const struct report_opts *opt) {
-    if (opt && opt->json) print_json(file, sha256, s, opt->pretty);
+    print_static_report_ex(file, sha256, s, NULL, NULL, NULL, opt);
+}
+
+void print_static_report_ex(const char *file, const char sha256[65], const struct elf_summary *s,
+                            const struct elf_view *deep, const struct content_report *content,
+                            const struct rule_set *rules, const struct report_opts *opt) {
+    if (opt && opt->json) print_json(file, sha256, s, deep, content, rules, opt->pretty);
     else {
         printf("File: %s\n", file);
         printf("SHA-256: %s\n", sha256);
-        printf("ELF: %s %s %s entry=0x%llx PIE=%s symtab=%s\n",
-               s->class_str, s->endian_str, s->machine, (unsigned long long)s->entry,
-               s->pie? "yes":"no", s->has_symtab? "yes":"no");
+        if (!s) printf("ELF: none\n");
+        else printf("ELF: %s %s %s entry=0x%llx PIE=%s symtab=%s\n",
+                    s->class_str, s->endian_str, s->machine, (unsigned long long)s->entry,
+                    s->pie? "yes":"no", s->has_symtab? "yes":"no");
+        if (deep) print_deep_text(deep);
+        if (content) print_content_text(content, rules);
+    }
+}
+
+void json_write_str(FILE *out, const char *s) {
+    static const char *hex = "0123456789abcdef";
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+        switch (*p) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (*p < 0x20) { fputs("\\u00", out); fputc(hex[*p >> 4], out); fputc(hex[*p & 15], out); }
+            else fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+void json_write_usage(FILE *out, const struct run_usage *u, const char *indent) {
+    const struct { const char *key; long long v; } f[] = {
+        { "user_us", u->utime_us },      { "sys_us", u->stime_us },
+        { "max_rss_kb", u->maxrss_kb },  { "minflt", u->minflt },      { "majflt", u->majflt },
+        { "nvcsw", u->nvcsw },           { "nivcsw", u->nivcsw },
+        { "cg_usage_us", u->cg_usage_us }, { "cg_user_us", u->cg_user_us },
+        { "cg_system_us", u->cg_system_us }, { "cg_throttled_us", u->cg_throttled_us },
+        { "cg_mem_peak", u->cg_mem_peak },
+        { "cycles", u->cycles },         { "instructions", u->instructions },
+    };
+    fputs(indent ? "\"usage\": {" : "\"usage\":{", out);
+    for (size_t i = 0; i < sizeof f / sizeof f[0]; ++i) {
+        if (i) fputc(',', out);
+        if (indent) fprintf(out, "\n%s  \"%s\": ", indent, f[i].key);
+        else fprintf(out, "\"%s\":", f[i].key);
+        if (f[i].v < 0) fputs("null", out); else fprintf(out, "%lld", f[i].v);
+    }
+    if (indent) fprintf(out, "\n%s", indent);
+    fputc('}', out);
+}
+
+void print_scan_record(FILE *out, const char *file, const char *sha256,
+                       const struct elf_summary *s, const char *stage, const char *error) {
+    fputs("{\"file\":", out);
+    json_write_str(out, file);
+    fputs(",\"sha256\":", out);
+    if (sha256) fprintf(out, "\"%s\"", sha256); else fputs("null", out);
+    if (s) {
+        fprintf(out, ",\"elf\":{\"class\":\"%s\",\"endian\":\"%s\",\"machine\":\"%s\","
+                     "\"entry\":%llu,\"pie\":%s,\"has_symtab\":%s}",
+                s->class_str, s->endian_str, s->machine, (unsigned long long)s->entry,
+                s->pie ? "true" : "false", s->has_symtab ? "true" : "false");
+    } else {
+        fputs(",\"elf\":null", out);
+    }
+    if (error) {
+        fputs(",\"error\":", out);
+        json_write_str(out, error);
+        fputs(",\"stage\":", out);
+        json_write_str(out, stage ? stage : "unknown");
     }
+    fputs("}\n", out);
 }
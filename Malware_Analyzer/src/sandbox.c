@@ -1,24 +1,33 @@
 //#define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/ptrace.h>
 #include <sys/resource.h>
-#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
-#include <time.h>
 #include <unistd.h>
 
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 #ifndef NO_SECCOMP
 #include <seccomp.h>
 #endif
 
 #include "sandbox.h"
 #include "jail.h"
+#include "supervise.h"
+#include "cgroup.h"
+#include "perfctr.h"
 
-static int apply_limits(const struct limits *lim) {
+static int apply_limits(const struct limits *lim, int cgroup_mem) {
     struct rlimit rl;
 
     if (lim->timeout_sec > 0) {
@@ -26,7 +35,7 @@ static int apply_limits(const struct limits *lim) {
         rl.rlim_cur = rl.rlim_max = lim->timeout_sec;
         if (setrlimit(RLIMIT_CPU, &rl) != 0) return -1;
     }
-    if (lim->mem_bytes > 0) {
+    if (lim->mem_bytes > 0 && !cgroup_mem) {
         rl.rlim_cur = rl.rlim_max = (rlim_t)lim->mem_bytes;
         if (setrlimit(RLIMIT_AS, &rl) != 0) return -1;
     }
@@ -46,9 +55,9 @@ static void set_no_new_privs(void) {
 }
 
 #ifndef NO_SECCOMP
-static int apply_seccomp_no_net(void) {
+static scmp_filter_ctx no_net_filter(void) {
     scmp_filter_ctx ctx = seccomp_init(SCMP_ACT_ALLOW);
-    if (!ctx) return -1;
+    if (!ctx) return NULL;
 
     int rc = 0;
     rc |= seccomp_rule_add(ctx, SCMP_ACT_ERRNO(EPERM), SCMP_SYS(socket),   0);
@@ -65,70 +74,288 @@ static int apply_seccomp_no_net(void) {
     rc |= seccomp_rule_add(ctx, SCMP_ACT_ERRNO(EPERM), SCMP_SYS(recvmsg),  0);
     rc |= seccomp_rule_add(ctx, SCMP_ACT_ERRNO(EPERM), SCMP_SYS(shutdown), 0);
 
-    if (rc) { seccomp_release(ctx); return -1; }
+    if (rc) { seccomp_release(ctx); return NULL; }
+    return ctx;
+}
+
+static int apply_seccomp_no_net(void) {
+    scmp_filter_ctx ctx = no_net_filter();
+    if (!ctx) return -1;
     if (seccomp_load(ctx) != 0) { seccomp_release(ctx); return -1; }
     seccomp_release(ctx);
     return 0;
 }
+
+/* The same filter as raw BPF, so a vfork()ed child can load it with one
+   prctl() instead of running libseccomp (which allocates). */
+static int compile_no_net(struct sock_fprog *prog) {
+    scmp_filter_ctx ctx = no_net_filter();
+    if (!ctx) return -1;
+    int fd = memfd_create("malx-seccomp", MFD_CLOEXEC);
+    int rc = -1;
+    if (fd >= 0 && seccomp_export_bpf(ctx, fd) == 0) {
+        off_t len = lseek(fd, 0, SEEK_END);
+        struct sock_filter *f = len > 0 ? malloc((size_t)len) : NULL;
+        if (f && pread(fd, f, (size_t)len, 0) == len) {
+            prog->filter = f;
+            prog->len = (unsigned short)((size_t)len / sizeof *f);
+            rc = 0;
+        } else {
+            free(f);
+        }
+    }
+    if (fd >= 0) close(fd);
+    seccomp_release(ctx);
+    return rc;
+}
 #else
 static int apply_seccomp_no_net(void) { errno = ENOSYS; return -1; }
 #endif
 
-static long now_ms(void) {
-    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (long)(ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL);
+static long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
 }
 
-int run_in_sandbox(const char *path, char *const argv[],
-                   const struct limits *lim, int no_net,
-                   int use_jail,
-                   struct run_result *out) {
-    pid_t pid = fork();
-    if (pid < 0) return -1;
+/* -------- prepared launches -------- */
+
+#define PREP_STACK (64 * 1024)
+
+struct sandbox_prep {
+    struct { int res; int skip_in_cgroup; struct rlimit rl; } rl[4];
+    int nrl;
+    int devnull;            /* -1 unless quiet */
+    int no_net;
+    int has_jail;
+    struct jail_prep jail;
+#ifndef NO_SECCOMP
+    struct sock_fprog bpf;  /* len 0 = none (best-effort, as on the fork path) */
+#endif
+    void *stack;            /* the vfork child runs here until it execs */
+};
+
+static void prep_rlimit(struct sandbox_prep *p, int res, long v, int skip_in_cgroup) {
+    if (v <= 0) return;
+    p->rl[p->nrl].res = res;
+    p->rl[p->nrl].skip_in_cgroup = skip_in_cgroup;
+    p->rl[p->nrl].rl.rlim_cur = p->rl[p->nrl].rl.rlim_max = (rlim_t)v;
+    p->nrl++;
+}
+
+struct sandbox_prep *sandbox_prepare(const struct spawn_opts *o, char *err, size_t errlen) {
+    struct sandbox_prep *p = calloc(1, sizeof *p);
+    if (!p) { snprintf(err, errlen, "calloc: %s", strerror(errno)); return NULL; }
+    p->devnull = -1;
+    p->jail.mnt_fd = p->jail.net_fd = -1;
+
+    /* same limits, same order as apply_limits() */
+    prep_rlimit(p, RLIMIT_CPU, o->lim->timeout_sec, 0);
+    prep_rlimit(p, RLIMIT_AS, o->lim->mem_bytes, 1);
+    prep_rlimit(p, RLIMIT_FSIZE, o->lim->fsize_bytes, 0);
+    prep_rlimit(p, RLIMIT_NOFILE, o->lim->nofile, 0);
+
+    p->stack = mmap(NULL, PREP_STACK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (p->stack == MAP_FAILED) {
+        p->stack = NULL;
+        snprintf(err, errlen, "mmap stack: %s", strerror(errno));
+        goto fail;
+    }
+    if (o->quiet && (p->devnull = open("/dev/null", O_RDWR | O_CLOEXEC)) < 0) {
+        snprintf(err, errlen, "/dev/null: %s", strerror(errno));
+        goto fail;
+    }
+    p->no_net = o->no_net;
+#ifndef NO_SECCOMP
+    if (o->no_net) (void)compile_no_net(&p->bpf);
+#endif
+    if (o->use_jail) {
+        struct jail_opts jopt = { .root=NULL, .make_netns=0, .readonly=1 };
+        if (jail_prepare(&jopt, &p->jail, err, errlen) != 0) goto fail;
+        p->has_jail = 1;
+    }
+    return p;
+
+fail:
+    sandbox_prep_free(p);
+    return NULL;
+}
+
+void sandbox_prep_free(struct sandbox_prep *p) {
+    if (!p) return;
+    if (p->has_jail) jail_release(&p->jail);
+    if (p->devnull >= 0) close(p->devnull);
+#ifndef NO_SECCOMP
+    free(p->bpf.filter);
+#endif
+    if (p->stack) munmap(p->stack, PREP_STACK);
+    free(p);
+}
+
+struct vfork_args {
+    const struct sandbox_prep *p;
+    const struct spawn_opts *o;
+    const char *path;
+    char *const *argv;
+    sigset_t mask;          /* the caller's, restored just before exec */
+};
+
+/* Runs on the prep stack in the caller's memory until execv(): syscalls
+   only, no allocation, nothing the parent would see change. */
+static int vfork_child(void *arg) {
+    const struct vfork_args *a = arg;
+    const struct sandbox_prep *p = a->p;
+
+    /* handlers point into the parent's code and data; not ours to run */
+    for (int sig = 1; sig < NSIG; ++sig) {
+        struct sigaction sa;
+        if (sigaction(sig, NULL, &sa) == 0 && sa.sa_handler != SIG_DFL && sa.sa_handler != SIG_IGN) {
+            sa.sa_handler = SIG_DFL;
+            sa.sa_flags = 0;
+            (void)sigaction(sig, &sa, NULL);
+        }
+    }
+
+    if (a->o->traceme && ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) _exit(127);
+    int in_cgroup = a->o->cgroup_fd >= 0;
+    if (in_cgroup) {
+        struct cgroup cg = { .procs_fd = a->o->cgroup_fd };
+        if (cg_enter(&cg) != 0) _exit(127);
+    }
+    if (p->devnull >= 0) {
+        if (dup2(p->devnull, 0) < 0 || dup2(p->devnull, 1) < 0 || dup2(p->devnull, 2) < 0) _exit(127);
+    }
+    if (p->has_jail && jail_attach(&p->jail) != 0) _exit(127);
+    for (int i = 0; i < p->nrl; ++i) {
+        if (p->rl[i].skip_in_cgroup && in_cgroup) continue;
+        if (setrlimit(p->rl[i].res, &p->rl[i].rl) != 0) _exit(127);
+    }
+    set_no_new_privs();
+#ifndef NO_SECCOMP
+    if (p->no_net && p->bpf.len)
+        (void)prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &p->bpf); /* best-effort */
+#endif
+    sigprocmask(SIG_SETMASK, &a->mask, NULL);
+    /* last, so that nothing but the execve runs under it */
+    if (a->o->filter && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, a->o->filter) != 0) _exit(127);
+    execv(a->path, a->argv);
+    _exit(127); /* exec failed */
+}
+
+static int spawn_prepared(const char *path, char *const argv[], const struct spawn_opts *o, pid_t *pid) {
+    struct vfork_args a = { .p = o->prep, .o = o, .path = path, .argv = argv };
+    sigset_t all;
+    sigfillset(&all);
+    /* nothing may run a handler on the shared stack before the child has reset them */
+    sigprocmask(SIG_BLOCK, &all, &a.mask);
+    int p = clone(vfork_child, (char *)o->prep->stack + PREP_STACK,
+                  CLONE_VM | CLONE_VFORK | SIGCHLD, &a);
+    int saved = errno;
+    sigprocmask(SIG_SETMASK, &a.mask, NULL);
+    if (p < 0) { errno = saved; return -1; }
+    *pid = p;
+    return 0;
+}
+
+/* -------- classic launch: fork, then build everything in the child -------- */
 
-    long t0 = now_ms();
-    int status = 0;
+static int spawn_forked(const char *path, char *const argv[], const struct spawn_opts *o, pid_t *pid) {
+    int sync[2];                /* closed by the child's exec; tells us when setup is over */
+    if (pipe2(sync, O_CLOEXEC) != 0) return -1;
+    pid_t p = fork();
+    if (p < 0) { close(sync[0]); close(sync[1]); return -1; }
 
-    if (pid == 0) {
-        /* Child: optional jail first, then apply limits/seccomp, then exec */
-        if (use_jail) {
+    if (p == 0) {
+        close(sync[0]);
+        if (o->traceme && ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) _exit(127);
+        /* Child: cgroup first (a jail's namespaces could hide it), then the
+           jail, then limits/seccomp, then exec */
+        if (o->cgroup_fd >= 0) {
+            struct cgroup cg = { .procs_fd = o->cgroup_fd };
+            if (cg_enter(&cg) != 0) _exit(127);
+        }
+        if (o->quiet) {
+            int fd = open("/dev/null", O_RDWR);
+            if (fd < 0) _exit(127);
+            dup2(fd, 0); dup2(fd, 1); dup2(fd, 2);
+            if (fd > 2) close(fd);
+        }
+        if (o->use_jail) {
             char jerr[256]={0};
             struct jail_opts jopt = { .root=NULL, .make_netns=0, .readonly=1 };
             if (jail_enter(&jopt, jerr, sizeof jerr) != 0) _exit(127);
         }
 
-        if (apply_limits(lim) != 0) _exit(127);
+        if (apply_limits(o->lim, o->cgroup_fd >= 0) != 0) _exit(127);
         set_no_new_privs();
-        if (no_net) (void)apply_seccomp_no_net(); /* best-effort */
+        if (o->no_net) (void)apply_seccomp_no_net(); /* best-effort */
+        if (o->filter && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, o->filter) != 0) _exit(127);
         execv(path, argv);
         _exit(127); /* exec failed */
     }
+    close(sync[1]);
+    char c;
+    while (read(sync[0], &c, 1) < 0 && errno == EINTR) {}
+    close(sync[0]);
+    *pid = p;
+    return 0;
+}
 
-    /* Parent: supervise and kill on wall-clock timeout */
-    int timed_out = 0;
-    while (1) {
-        pid_t r = waitpid(pid, &status, WNOHANG);
-        if (r == pid) break;              /* child finished */
-        if (r == 0) {                     /* still running */
-            if (lim->timeout_sec > 0) {
-                long elapsed = now_ms() - t0;
-                if (elapsed >= (long)lim->timeout_sec * 1000L) {
-                    timed_out = 1;
-                    kill(pid, SIGKILL);
-                    (void)waitpid(pid, &status, 0);
-                    break;
-                }
-            }
-            usleep(10000);
-            continue;
-        }
-        if (r < 0 && errno != EINTR) break;
-    }
+int sandbox_spawn(const char *path, char *const argv[], const struct spawn_opts *o,
+                  pid_t *pid, long *setup_us) {
+    long long t0 = now_us();
+    int rc = o->prep ? spawn_prepared(path, argv, o, pid) : spawn_forked(path, argv, o, pid);
+    if (rc == 0 && setup_us) *setup_us = (long)(now_us() - t0);
+    return rc;
+}
 
-    long t1 = now_ms();
-    out->elapsed_ms = t1 - t0;
-    out->killed_by_timeout = timed_out;
-    out->exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-    out->term_signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
-    return 0;
+int run_in_sandbox(const char *path, char *const argv[],
+                   const struct limits *lim, int no_net,
+                   int use_jail,
+                   struct run_result *out) {
+    struct supervisor *sup = sup_open();
+    if (!sup) return -1;
+
+    /* one run: the preparation is part of its setup cost */
+    long long t0 = now_us();
+    char err[256];
+    pid_t pid;
+    struct spawn_opts so = { .lim = lim, .no_net = no_net, .use_jail = use_jail, .cgroup_fd = -1 };
+
+    /* Accounting, all best effort: a cgroup of its own when cgroup v2 is
+       delegated to us (its memory.max then stands in for RLIMIT_AS, as in
+       run-batch), and user-space cycle/instruction counters. */
+    struct cg_limits cgl = { .mem_bytes = lim->mem_bytes };
+    struct cg_root root;
+    struct cgroup cg = { .procs_fd = -1 };
+    int has_cg = cg_root_open(&root, NULL, &cgl, err, sizeof err) == 0;
+    if (has_cg && cg_create(&root, "run", &cgl, &cg, err, sizeof err) != 0) { cg_root_close(&root); has_cg = 0; }
+    if (has_cg) so.cgroup_fd = cg.procs_fd;
+    struct perf_counters pc;
+    perf_child_open(&pc);
+
+    struct sandbox_prep *prep = sandbox_prepare(&so, err, sizeof err);
+    if (!prep) fprintf(stderr, "sandbox: %s; forking instead\n", err);
+    so.prep = prep;
+    int rc = sandbox_spawn(path, argv, &so, &pid, NULL);
+    long setup_us = (long)(now_us() - t0);
+
+    /* Parent: sleep until the child exits or its timer fires (then it is killed) */
+    struct sup_exit ex;
+    if (rc == 0 && (sup_watch(sup, pid, lim->timeout_sec, NULL) != 0 || sup_next(sup, &ex) != 1)) {
+        kill(pid, SIGKILL);
+        (void)waitpid(pid, NULL, 0);
+        rc = -1;
+    }
+    sup_close(sup);
+    sandbox_prep_free(prep);    /* only now: removing the jail's mount points detaches them */
+    if (rc == 0) {
+        *out = ex.res;
+        out->setup_us = setup_us;
+        perf_child_read(&pc, &out->usage.cycles, &out->usage.instructions);
+        if (has_cg) cg_usage(&cg, &out->usage);
+    }
+    perf_child_close(&pc);
+    if (has_cg) { cg_destroy(&cg); cg_root_close(&root); }
+    return rc;
 }
@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "scan.h"
+#include "elfx.h"
+#include "report.h"
+#include "static.h"
+
+#define SCAN_MAX_JOBS 256
+
+/* -------- bounded path queue (ring of owned strings) -------- */
+struct path_queue {
+    char **ring;
+    size_t cap, head, len;
+    int closed;
+    pthread_mutex_t mu;
+    pthread_cond_t not_empty, not_full;
+};
+
+static int pq_init(struct path_queue *q, size_t cap) {
+    memset(q, 0, sizeof *q);
+    q->ring = calloc(cap, sizeof *q->ring);
+    if (!q->ring) return -1;
+    q->cap = cap;
+    pthread_mutex_init(&q->mu, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return 0;
+}
+
+static void pq_destroy(struct path_queue *q) {
+    free(q->ring);
+    pthread_mutex_destroy(&q->mu);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+/* blocks while full: this is the backpressure on the walker */
+static void pq_push(struct path_queue *q, char *path) {
+    pthread_mutex_lock(&q->mu);
+    while (q->len == q->cap) pthread_cond_wait(&q->not_full, &q->mu);
+    q->ring[(q->head + q->len) % q->cap] = path;
+    q->len++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->mu);
+}
+
+/* NULL once the queue is closed and drained */
+static char *pq_pop(struct path_queue *q) {
+    pthread_mutex_lock(&q->mu);
+    while (q->len == 0 && !q->closed) pthread_cond_wait(&q->not_empty, &q->mu);
+    char *p = NULL;
+    if (q->len) {
+        p = q->ring[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->len--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->mu);
+    return p;
+}
+
+static void pq_close(struct path_queue *q) {
+    pthread_mutex_lock(&q->mu);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->mu);
+}
+
+/* -------- records -------- */
+static pthread_mutex_t g_stats_mu = PTHREAD_MUTEX_INITIALIZER;
+static struct scan_stats g_stats;
+
+/* flockfile keeps each record on its own line even with many writers */
+static void emit(const char *file, const char *sha, const struct elf_summary *s,
+                 const char *stage, const char *err) {
+    flockfile(stdout);
+    print_scan_record(stdout, file, sha, s, stage, err);
+    fflush(stdout);
+    funlockfile(stdout);
+
+    pthread_mutex_lock(&g_stats_mu);
+    g_stats.files++;
+    if (err) g_stats.errors++;
+    if (err && stage && !strcmp(stage, "elf")) g_stats.not_elf++;
+    pthread_mutex_unlock(&g_stats_mu);
+}
+
+static struct malx_cache *g_cache;
+
+static void scan_one(const char *path) {
+    struct static_result r;
+    if (static_analyze(path, g_cache, &r) == 0) emit(path, r.sha256, &r.sum, NULL, NULL);
+    else emit(path, r.sha256[0] ? r.sha256 : NULL, NULL, r.stage, r.err);
+}
+
+static void *worker(void *arg) {
+    struct path_queue *q = arg;
+    char *p;
+    while ((p = pq_pop(q)) != NULL) {
+        scan_one(p);
+        free(p);
+    }
+    return NULL;
+}
+
+/* -------- producers -------- */
+static struct path_queue *g_queue;   /* nftw() callbacks take no user pointer */
+
+static void enqueue(const char *path) {
+    char *dup = strdup(path);
+    if (!dup) { emit(path, NULL, NULL, "walk", "out of memory"); return; }
+    pq_push(g_queue, dup);
+}
+
+static int walk_cb(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st; (void)ftw;
+    switch (type) {
+    case FTW_F:   enqueue(path); break;              /* FTW_PHYS: symlinks aren't followed */
+    case FTW_DNR: emit(path, NULL, NULL, "walk", "cannot read directory"); break;
+    case FTW_NS:  emit(path, NULL, NULL, "walk", "cannot stat"); break;
+    default:      break;
+    }
+    return 0;
+}
+
+static void walk_root(const char *root) {
+    if (nftw(root, walk_cb, 32, FTW_PHYS) != 0)
+        emit(root, NULL, NULL, "walk", strerror(errno));
+}
+
+/* @list: one path per line; blank lines and '#' comments skipped */
+static void walk_list(const char *list) {
+    FILE *f = strcmp(list, "-") ? fopen(list, "r") : stdin;
+    if (!f) { emit(list, NULL, NULL, "list", strerror(errno)); return; }
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        while (n > 0 && (line[n-1] == '\n' || line[n-1] == '\r')) line[--n] = '\0';
+        if (n == 0 || line[0] == '#') continue;
+        walk_root(line);          /* a listed directory is walked too */
+    }
+    free(line);
+    if (f != stdin) fclose(f);
+}
+
+int scan_run(const struct scan_opts *opt, struct scan_stats *st) {
+    int jobs = opt->jobs;
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1) jobs = 1;
+    if (jobs > SCAN_MAX_JOBS) jobs = SCAN_MAX_JOBS;
+
+    struct path_queue q;
+    if (pq_init(&q, (size_t)jobs * 4) != 0) { perror("calloc"); return -1; }
+    pthread_t *tid = calloc((size_t)jobs, sizeof *tid);
+    if (!tid) { perror("calloc"); pq_destroy(&q); return -1; }
+    memset(&g_stats, 0, sizeof g_stats);
+    g_queue = &q;
+    g_cache = opt->cache;
+
+    int started = 0;
+    for (; started < jobs; started++)
+        if (pthread_create(&tid[started], NULL, worker, &q) != 0) break;
+    if (!started) { perror("pthread_create"); free(tid); pq_destroy(&q); return -1; }
+
+    for (int i = 0; i < opt->nroots; i++) {
+        const char *r = opt->roots[i];
+        if (r[0] == '@') walk_list(r + 1);
+        else walk_root(r);
+    }
+    pq_close(&q);
+    for (int i = 0; i < started; i++) pthread_join(tid[i], NULL);
+
+    free(tid);
+    pq_destroy(&q);
+    g_queue = NULL;
+    g_cache = NULL;
+    if (st) *st = g_stats;
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "static.h"
+#include "utils.h"
+
+static int fail(struct static_result *r, const char *stage) {
+    r->stage = stage;
+    return -1;
+}
+
+static void feed(void *ctx, size_t off, size_t n) {
+    content_feed(ctx, off, n);
+}
+
+int static_analyze(const char *path, struct malx_cache *cache, struct static_result *r) {
+    return static_analyze_content(path, cache, NULL, NULL, r);
+}
+
+int static_analyze_content(const char *path, struct malx_cache *cache, const struct rule_set *rules,
+                           struct content_scan *cs, struct static_result *r) {
+    memset(r, 0, sizeof *r);
+
+    struct stat st;
+    int hintable = cache && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+    if (!cs && hintable && cache_get_hash(cache, &st, r->sha256) &&
+        cache_get_static(cache, r->sha256, &r->elf_ok, &r->sum, r->err, sizeof r->err)) {
+        r->cached = 1;
+        return r->elf_ok ? 0 : fail(r, "elf");
+    }
+
+    struct file_view fv;
+    if (map_file(path, &fv, r->err, sizeof r->err) != 0) return fail(r, "open");
+    int sha_ok;
+    if (cs) {
+        if (content_begin(cs, rules, fv.data, fv.len) != 0) {
+            unmap_file(&fv);
+            snprintf(r->err, sizeof r->err, "out of memory");
+            return fail(r, "content");
+        }
+        sha_ok = sha256_hex_view_cb(&fv, r->sha256, feed, cs) == 0;
+        content_end(cs);
+    } else {
+        sha_ok = sha256_hex_view(&fv, r->sha256) == 0;
+    }
+    if (!sha_ok) {
+        unmap_file(&fv);
+        r->sha256[0] = '\0';
+        snprintf(r->err, sizeof r->err, "sha256 failed");
+        return fail(r, "hash");
+    }
+
+    /* same content under another name or inode: the ELF pass is already known */
+    if (cache && cache_get_static(cache, r->sha256, &r->elf_ok, &r->sum, r->err, sizeof r->err)) {
+        r->cached = 1;
+    } else {
+        r->elf_ok = elf_summarize_buf(fv.data, fv.len, &r->sum, r->err, sizeof r->err) == 0;
+        if (cache) cache_put_static(cache, r->sha256, r->elf_ok, &r->sum, r->elf_ok ? NULL : r->err);
+    }
+    unmap_file(&fv);
+    if (hintable) cache_put_hash(cache, &st, r->sha256);
+    if (!r->elf_ok) return fail(r, "elf");
+    r->err[0] = '\0';
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "supervise.h"
+#include "cgroup.h"
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+struct watched {
+    pid_t pid;                  /* 0 = free slot */
+    int pidfd, timerfd;         /* timerfd -1 without a timeout */
+    int timed_out;
+    long long t0_ns;
+    void *tag;
+};
+
+/* a finished sample's cgroup waiting for its last tasks to leave */
+struct draining {
+    char *path;                 /* NULL = free slot */
+    int events_fd;
+};
+
+struct supervisor {
+    int ep;
+    struct watched *w;
+    int cap, live;
+    struct draining *d;
+    int dcap, ndrain;
+};
+
+/* epoll data: slot index, low 2 bits = which fd */
+#define EV_PID    0u
+#define EV_TIMER  1u
+#define EV_CGROUP 2u
+#define EV_SHIFT  2
+
+static long long now_ns(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int pidfd_open_(pid_t pid) { return (int)syscall(SYS_pidfd_open, pid, 0); }
+static int pidfd_kill(int pidfd, int sig) { return (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0); }
+/* the raw syscall takes a struct rusage, which glibc's waitid() leaves out */
+static int waitid_ru(int pidfd, siginfo_t *si, int options, struct rusage *ru) {
+    return (int)syscall(SYS_waitid, P_PIDFD, pidfd, si, options, ru);
+}
+
+struct supervisor *sup_open(void) {
+    struct supervisor *s = calloc(1, sizeof *s);
+    if (!s) return NULL;
+    s->ep = epoll_create1(EPOLL_CLOEXEC);
+    if (s->ep < 0) { free(s); return NULL; }
+    return s;
+}
+
+static void release(struct supervisor *s, struct watched *w) {
+    epoll_ctl(s->ep, EPOLL_CTL_DEL, w->pidfd, NULL);
+    close(w->pidfd);
+    if (w->timerfd >= 0) { epoll_ctl(s->ep, EPOLL_CTL_DEL, w->timerfd, NULL); close(w->timerfd); }
+    memset(w, 0, sizeof *w);
+    s->live--;
+}
+
+static void drain_done(struct supervisor *s, struct draining *d) {
+    epoll_ctl(s->ep, EPOLL_CTL_DEL, d->events_fd, NULL);
+    close(d->events_fd);
+    free(d->path);
+    memset(d, 0, sizeof *d);
+    s->ndrain--;
+}
+
+/* a cgroup.events notification: remove the cgroup once it is empty */
+static void drain_event(struct supervisor *s, struct draining *d) {
+    if (d->path && cg_remove_if_empty(d->path, d->events_fd)) drain_done(s, d);
+}
+
+void sup_close(struct supervisor *s) {
+    if (!s) return;
+    for (int i = 0; i < s->cap; ++i) {
+        struct watched *w = &s->w[i];
+        if (!w->pid) continue;
+        pidfd_kill(w->pidfd, SIGKILL);
+        siginfo_t si;
+        while (waitid((idtype_t)P_PIDFD, (id_t)w->pidfd, &si, WEXITED) < 0 && errno == EINTR) {}
+        release(s, w);
+    }
+    /* cgroups still draining: the caller is about to remove their parent */
+    long long deadline = now_ns() + 1000000000LL;
+    while (s->ndrain > 0 && now_ns() < deadline) {
+        struct epoll_event ev;
+        if (epoll_wait(s->ep, &ev, 1, 50) > 0 && (ev.data.u64 & 3u) == EV_CGROUP)
+            drain_event(s, &s->d[ev.data.u64 >> EV_SHIFT]);
+    }
+    for (int i = 0; i < s->dcap; ++i) {
+        if (!s->d[i].path) continue;
+        (void)rmdir(s->d[i].path);
+        drain_done(s, &s->d[i]);
+    }
+    close(s->ep);
+    free(s->w);
+    free(s->d);
+    free(s);
+}
+
+int sup_count(const struct supervisor *s) { return s->live; }
+
+static int add_fd(struct supervisor *s, int fd, int slot, unsigned kind) {
+    struct epoll_event ev = { .events = kind == EV_CGROUP ? EPOLLPRI : EPOLLIN,
+                              .data.u64 = ((uint64_t)slot << EV_SHIFT) | kind };
+    return epoll_ctl(s->ep, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int sup_reap_cgroup(struct supervisor *s, struct cgroup *cg) {
+    int fd;
+    if (cg_release(cg, &fd) != 1) { cg->path[0] = '\0'; return 0; }
+
+    int slot = -1;
+    for (int i = 0; i < s->dcap && slot < 0; ++i) if (!s->d[i].path) slot = i;
+    if (slot < 0) {
+        int ncap = s->dcap ? s->dcap * 2 : 8;
+        struct draining *nd = realloc(s->d, (size_t)ncap * sizeof *nd);
+        if (!nd) goto fallback;
+        memset(nd + s->dcap, 0, (size_t)(ncap - s->dcap) * sizeof *nd);
+        slot = s->dcap;
+        s->d = nd;
+        s->dcap = ncap;
+    }
+    char *path = strdup(cg->path);
+    if (!path) goto fallback;
+    if (add_fd(s, fd, slot, EV_CGROUP) != 0) { free(path); goto fallback; }
+    s->d[slot] = (struct draining){ .path = path, .events_fd = fd };
+    s->ndrain++;
+    cg->path[0] = '\0';
+    return 0;
+
+fallback:                       /* no memory: wait for it here after all */
+    close(fd);
+    cg_destroy(cg);
+    return -1;
+}
+
+int sup_watch(struct supervisor *s, pid_t pid, int timeout_sec, void *tag) {
+    int slot = -1;
+    for (int i = 0; i < s->cap && slot < 0; ++i) if (!s->w[i].pid) slot = i;
+    if (slot < 0) {
+        int ncap = s->cap ? s->cap * 2 : 8;
+        struct watched *nw = realloc(s->w, (size_t)ncap * sizeof *nw);
+        if (!nw) return -1;
+        memset(nw + s->cap, 0, (size_t)(ncap - s->cap) * sizeof *nw);
+        slot = s->cap;
+        s->w = nw;
+        s->cap = ncap;
+    }
+
+    /* our own unreaped child: its pid cannot be reused before we wait on it */
+    struct watched w = { .pid = pid, .timerfd = -1, .t0_ns = now_ns(), .tag = tag };
+    w.pidfd = pidfd_open_(pid);
+    if (w.pidfd < 0) return -1;
+    if (add_fd(s, w.pidfd, slot, EV_PID) != 0) goto fail;
+
+    if (timeout_sec > 0) {
+        w.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        struct itimerspec its = { .it_value = { .tv_sec = timeout_sec } };
+        if (w.timerfd < 0 || timerfd_settime(w.timerfd, 0, &its, NULL) != 0 ||
+            add_fd(s, w.timerfd, slot, EV_TIMER) != 0) goto fail;
+    }
+    s->w[slot] = w;
+    s->live++;
+    return 0;
+
+fail:;
+    int e = errno;
+    epoll_ctl(s->ep, EPOLL_CTL_DEL, w.pidfd, NULL);
+    close(w.pidfd);
+    if (w.timerfd >= 0) close(w.timerfd);
+    errno = e;
+    return -1;
+}
+
+int sup_next(struct supervisor *s, struct sup_exit *out) {
+    while (s->live > 0) {
+        struct epoll_event ev;
+        int n = epoll_wait(s->ep, &ev, 1, -1);
+        if (n < 0) { if (errno == EINTR) continue; return -1; }
+        if (n == 0) continue;
+
+        unsigned kind = (unsigned)(ev.data.u64 & 3u);
+        if (kind == EV_CGROUP) { drain_event(s, &s->d[ev.data.u64 >> EV_SHIFT]); continue; }
+        struct watched *w = &s->w[ev.data.u64 >> EV_SHIFT];
+        if (kind == EV_TIMER) {
+            uint64_t ticks;
+            if (read(w->timerfd, &ticks, sizeof ticks) < 0 && errno == EAGAIN) continue;
+            w->timed_out = 1;
+            pidfd_kill(w->pidfd, SIGKILL);      /* the pidfd turns readable when it is gone */
+            continue;
+        }
+
+        siginfo_t si;
+        struct rusage ru;
+        memset(&si, 0, sizeof si);
+        memset(&ru, 0, sizeof ru);
+        if (waitid_ru(w->pidfd, &si, WEXITED | WNOHANG, &ru) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (si.si_pid == 0) continue;           /* not actually gone yet */
+
+        long long t1 = now_ns();
+        out->pid = w->pid;
+        out->tag = w->tag;
+        out->res.elapsed_ms = (long)((t1 - w->t0_ns) / 1000000LL);
+        out->res.killed_by_timeout = w->timed_out;
+        out->res.exit_code = si.si_code == CLD_EXITED ? si.si_status : -1;
+        out->res.term_signal = (si.si_code == CLD_KILLED || si.si_code == CLD_DUMPED) ? si.si_status : 0;
+        memset(&out->res.usage, 0xff, sizeof out->res.usage);      /* all -1 */
+        struct run_usage *u = &out->res.usage;
+        u->utime_us  = ru.ru_utime.tv_sec * 1000000L + ru.ru_utime.tv_usec;
+        u->stime_us  = ru.ru_stime.tv_sec * 1000000L + ru.ru_stime.tv_usec;
+        u->maxrss_kb = ru.ru_maxrss;
+        u->minflt = ru.ru_minflt;
+        u->majflt = ru.ru_majflt;
+        u->nvcsw  = ru.ru_nvcsw;
+        u->nivcsw = ru.ru_nivcsw;
+        release(s, w);
+        return 1;
+    }
+    return 0;
+}
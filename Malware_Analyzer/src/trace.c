@@ -1,137 +1,424 @@
 //#define _GNU_SOURCE
 #include <errno.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
 #include <sys/ptrace.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
 #include <sys/user.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "trace.h"
 #include "jail.h"
+#include "sandbox.h"
+#include "syscalls.h"
+#include "tracebuf.h"
+#include "tracestat.h"
 
-static long now_ms(void){
+static long now_ns(void){
     struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (long)(ts.tv_sec*1000LL + ts.tv_nsec/1000000LL);
+    return (long)(ts.tv_sec*1000000000LL + ts.tv_nsec);
 }
 
-static void json_enter(long num, long a0,long a1,long a2,long a3,long a4,long a5, int pretty){
-    if(pretty){
-        printf("    {\"type\":\"enter\",\"num\":%ld,\"args\":[%ld,%ld,%ld,%ld,%ld,%ld]},\n",
-               num,a0,a1,a2,a3,a4,a5);
-    }else{
-        printf("{\"type\":\"enter\",\"num\":%ld,\"args\":[%ld,%ld,%ld,%ld,%ld,%ld]},\n",
-               num,a0,a1,a2,a3,a4,a5);
+#ifdef __x86_64__
+/* -------- filtered mode: seccomp RET_TRACE on the listed syscalls only -------- */
+
+#ifndef __X32_SYSCALL_BIT
+#define __X32_SYSCALL_BIT 0x40000000
+#endif
+
+/*
+ * arch != x86_64 or an x32 number: trace (numbers mean something else there);
+ * nr in the list: trace; anything else: allow without a stop.
+ */
+#define TRACE_FILTER_LEN (6 + TRACE_MAX_FILTER + 1)
+
+/* f has room for TRACE_FILTER_LEN instructions; prog points into it */
+static void build_trace_filter(struct sock_filter *f, const long *nrs, int n, struct sock_fprog *prog){
+    int k = 0;
+    f[k++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+    f[k++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0);
+    f[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE);
+    f[k++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+    f[k++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, __X32_SYSCALL_BIT, (unsigned char)(n + 1), 0);
+    for(int i = 0; i < n; i++)
+        f[k++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned)nrs[i], (unsigned char)(n - i), 0);
+    f[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    f[k++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE);
+    prog->len = (unsigned short)k;
+    prog->filter = f;
+}
+
+/*
+ * Until the tracer sets PTRACE_O_TRACESECCOMP, the kernel fails every
+ * RET_TRACE syscall with ENOSYS. A vfork()ed child can't wait for that
+ * (its parent is suspended until the exec), so it loads the filter right
+ * before execve and the options go on at the exec stop: fine unless execve
+ * itself is filtered, which would fail the launch.
+ */
+static int filter_has_execve(const long *nrs, int n){
+    for(int i = 0; i < n; i++) if(nrs[i] == SYS_execve) return 1;
+    return 0;
+}
+
+/* -------- per-task state -------- */
+
+/*
+ * One entry per traced thread, keyed by tid. Each thread stops at syscall
+ * entry and exit on its own schedule, so "entering or leaving" and the
+ * pending syscall belong to the thread, not to the trace. Open addressing
+ * with linear probing; deletion backward-shifts so lookups never need
+ * tombstones.
+ */
+struct task {
+    pid_t tid;          /* 0 = empty slot */
+    int   in_call;      /* between syscall entry and exit */
+    int   fresh;        /* auto-attached, initial SIGSTOP not seen yet */
+    long  nr;           /* pending syscall */
+    long  t0;           /* entry time, ns */
+};
+
+struct task_table {
+    struct task *slot;
+    size_t cap, len;    /* cap is a power of two */
+};
+
+static size_t task_hash(const struct task_table *t, pid_t tid){
+    return ((size_t)(unsigned)tid * 0x9e3779b1u) & (t->cap - 1);
+}
+
+static struct task *task_find(struct task_table *t, pid_t tid){
+    for(size_t i = task_hash(t, tid);; i = (i + 1) & (t->cap - 1)){
+        if(t->slot[i].tid == tid) return &t->slot[i];
+        if(t->slot[i].tid == 0) return NULL;
     }
 }
-static void json_exit(long num, long ret, int pretty){
-    if(pretty){
-        printf("    {\"type\":\"exit\",\"num\":%ld,\"ret\":%ld},\n", num, ret);
-    }else{
-        printf("{\"type\":\"exit\",\"num\":%ld,\"ret\":%ld},\n", num, ret);
+
+static int task_grow(struct task_table *t){
+    size_t ncap = t->cap ? t->cap * 2 : 64;
+    struct task *old = t->slot, *ns = calloc(ncap, sizeof *ns);
+    if(!ns) return -1;
+    size_t ocap = t->cap;
+    t->slot = ns; t->cap = ncap;
+    for(size_t i = 0; i < ocap; i++){
+        if(!old[i].tid) continue;
+        size_t j = task_hash(t, old[i].tid);
+        while(ns[j].tid) j = (j + 1) & (ncap - 1);
+        ns[j] = old[i];
     }
+    free(old);
+    return 0;
 }
 
-int trace_process(const char *path, char *const argv[], const struct trace_opts *opt){
-#ifndef __x86_64__
-    fprintf(stderr, "trace: only x86_64 is supported in this prototype\n");
-    return 1;
-#else
-    int timeout = opt ? opt->timeout_sec : 5;
-    int maxev   = opt ? opt->max_events : 200;
-    int as_json = opt ? opt->json : 1;
-    int pretty  = opt ? opt->pretty : 0;
-    int use_jail= opt ? opt->jail : 0;
+/* existing entry, or a new zeroed one; NULL only when out of memory */
+static struct task *task_get(struct task_table *t, pid_t tid){
+    struct task *e = t->cap ? task_find(t, tid) : NULL;
+    if(e) return e;
+    if((t->len + 1) * 4 > t->cap * 3 && task_grow(t) != 0) return NULL;
+    size_t i = task_hash(t, tid);
+    while(t->slot[i].tid) i = (i + 1) & (t->cap - 1);
+    memset(&t->slot[i], 0, sizeof t->slot[i]);
+    t->slot[i].tid = tid;
+    t->len++;
+    return &t->slot[i];
+}
 
-    pid_t pid = fork();
-    if(pid < 0){ perror("fork"); return 1; }
+static void task_del(struct task_table *t, pid_t tid){
+    struct task *e = t->cap ? task_find(t, tid) : NULL;
+    if(!e) return;
+    size_t i = (size_t)(e - t->slot);
+    t->slot[i].tid = 0;
+    t->len--;
+    /* pull later members of the probe run back over the hole */
+    for(size_t j = (i + 1) & (t->cap - 1); t->slot[j].tid; j = (j + 1) & (t->cap - 1)){
+        size_t h = task_hash(t, t->slot[j].tid);
+        if(((j - h) & (t->cap - 1)) >= ((j - i) & (t->cap - 1))){
+            t->slot[i] = t->slot[j];
+            t->slot[j].tid = 0;
+            i = j;
+        }
+    }
+}
 
-    long t0 = now_ms();
-    int status = 0;
+/* SIGKILL takes the whole thread group, so one per task is plenty */
+static void task_kill_all(const struct task_table *t){
+    for(size_t i = 0; i < t->cap; i++)
+        if(t->slot[i].tid) kill(t->slot[i].tid, SIGKILL);
+}
 
-    if(pid == 0){
-        /* child: set up for tracing, optional jail, then exec */
-        if(ptrace(PTRACE_TRACEME, 0, NULL, NULL) < 0){ _exit(127); }
-        raise(SIGSTOP); /* let parent seize us */
+/* -------- capture (inside the stop: no formatting here) -------- */
 
-        if (use_jail) {
-            char jerr[256]={0};
-            struct jail_opts j = { .root=NULL, .make_netns=0, .readonly=1 };
-            if (jail_enter(&j, jerr, sizeof jerr) != 0) _exit(127);
+/*
+ * One process_vm_readv per string, split at the page boundary so a string
+ * ending just before an unmapped page still comes back. PTRACE_PEEKDATA,
+ * a syscall per word, is only the fallback (e.g. EPERM across a userns).
+ */
+static int read_string(pid_t tid, unsigned long addr, char *dst, size_t n){
+    static long page;
+    if(!addr) return -1;
+    if(!page) page = sysconf(_SC_PAGESIZE);
+    size_t want = n - 1, first = (size_t)page - (addr % (size_t)page);
+    if(first > want) first = want;
+    struct iovec local = { dst, want };
+    struct iovec remote[2] = { { (void*)addr, first }, { (void*)(addr + first), want - first } };
+    ssize_t got = process_vm_readv(tid, &local, 1, remote, want > first ? 2 : 1, 0);
+    if(got < 0 && (errno == ENOSYS || errno == EPERM)){
+        got = 0;
+        while((size_t)got < want){
+            errno = 0;
+            long w = ptrace(PTRACE_PEEKDATA, tid, (void*)(addr + (size_t)got), 0);
+            if(errno) break;
+            size_t k = want - (size_t)got < sizeof w ? want - (size_t)got : sizeof w;
+            memcpy(dst + got, &w, k);
+            got += (ssize_t)k;
+            if(memchr(&w, 0, k)) break;
         }
+    }
+    if(got <= 0) return -1;
+    if(memchr(dst, 0, (size_t)got)) return 0;
+    dst[got] = '\0';                                 /* cut short: mark it */
+    if(got >= 3) memcpy(dst + got - 3, "...", 3);
+    return 0;
+}
 
-        if (argv == NULL) {
-            char *av[2] = { (char*)path, NULL };
-            execv(path, av);
-        } else {
-            execv(path, argv);
-        }
-        _exit(127);
+static void record_enter(struct trace_ring *ring, struct trace_summary *sum, long t_start,
+                         pid_t tid, const struct task *t, const struct user_regs_struct *r){
+    if(sum){ summary_enter(sum, t->nr); return; }
+    struct trace_event *e = ring_reserve(ring);
+    e->t_ns = (uint64_t)(t->t0 - t_start);
+    e->tid = tid;
+    e->kind = TRACE_ENTER;
+    e->nr = t->nr;
+    e->args[0] = (int64_t)r->rdi; e->args[1] = (int64_t)r->rsi; e->args[2] = (int64_t)r->rdx;
+    e->args[3] = (int64_t)r->r10; e->args[4] = (int64_t)r->r8;  e->args[5] = (int64_t)r->r9;
+    e->nstr = 0;
+    unsigned mask = syscall_string_args(t->nr);
+    for(int i = 0; i < 6 && mask && e->nstr < TRACE_STR_SLOTS; i++){
+        if(!(mask & (1u << i))) continue;
+        if(read_string(tid, (unsigned long)e->args[i], e->str[e->nstr], TRACE_STR_LEN) == 0)
+            e->str_arg[e->nstr++] = (uint8_t)i;
     }
+    ring_commit(ring);
+}
+
+static void record_exit(struct trace_ring *ring, struct trace_summary *sum, long t_start,
+                        pid_t tid, const struct task *t, const struct user_regs_struct *r){
+    long now = now_ns();
+    if(sum){ summary_exit(sum, t->nr, (int64_t)r->rax, now - t->t0); return; }
+    struct trace_event *e = ring_reserve(ring);
+    e->t_ns = (uint64_t)(now - t_start);
+    e->tid = tid;
+    e->kind = TRACE_EXIT;
+    e->nstr = 0;
+    e->nr = t->nr;
+    e->ret = (int64_t)r->rax;
+    e->dur_ns = now - t->t0;
+    ring_commit(ring);
+}
 
-    /* parent */
+static volatile sig_atomic_t trace_alarm;
+static void on_alarm(int sig){ (void)sig; trace_alarm = 1; }
+
+/*
+ * Follows the whole task tree: forks, vforks and threads are attached by
+ * the kernel (PTRACE_O_TRACE*) and every stop is collected with
+ * waitpid(-1, __WALL), so it does not matter which task stops next.
+ *
+ * Unfiltered, every task steps with PTRACE_SYSCALL and each stop flips that
+ * task's in_call. Filtered, tasks run with PTRACE_CONT until the seccomp
+ * filter stops them at an entry; only then do they step to the matching
+ * exit stop. Filters are inherited, so children are filtered too.
+ *
+ * The tracee may stop rarely (filtered) or block in a syscall, so the
+ * wall-clock limit can't be checked between stops: SIGALRM interrupts
+ * waitpid() instead.
+ *
+ * With sum, nothing is logged: each stop only bumps a slot of the fixed
+ * table (no string reads, no ring) and the table is printed at the end.
+ */
+static int trace_tree(pid_t pid, int filtered, int timeout, int maxev,
+                      int format, int pretty, struct trace_summary *sum){
+    int status = 0;
     if(waitpid(pid, &status, 0) < 0){ perror("waitpid"); return 1; }
-    if(ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD) < 0){ perror("PTRACE_SETOPTIONS"); return 1; }
+    if(!WIFSTOPPED(status)){ fprintf(stderr, "trace: the sample did not start (exec failed?)\n"); return 1; }
+    long o = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL |
+             PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE;
+    if(filtered) o |= PTRACE_O_TRACESECCOMP;
+    if(ptrace(PTRACE_SETOPTIONS, pid, 0, o) < 0){ perror("PTRACE_SETOPTIONS"); kill(pid, SIGKILL); return 1; }
 
-    int events = 0;
-    int entering = 1;
+    struct task_table tasks = {0};
+    if(!task_get(&tasks, pid)){ perror("calloc"); kill(pid, SIGKILL); return 1; }
 
-    if(as_json){
-        if(pretty) puts("{\n  \"trace\": [");
-        else       puts("{\"trace\":[");
-    }
+    struct sigaction sa = { .sa_handler = on_alarm }, old;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, &old);                   /* no SA_RESTART: waitpid sees EINTR */
+    trace_alarm = 0;
+    if(timeout > 0) alarm((unsigned)timeout);
 
-    while(1){
-        if(ptrace(PTRACE_SYSCALL, pid, 0, 0) < 0){ perror("PTRACE_SYSCALL"); break; }
-        if(waitpid(pid, &status, 0) < 0){ if(errno==EINTR) continue; perror("waitpid"); break; }
+    struct trace_ring *ring = NULL;
+    if(!sum && !(ring = ring_open(format, pretty))){ perror("trace ring"); kill(pid, SIGKILL); free(tasks.slot); return 1; }
+    long t_start = now_ns();
+    if(sum){ sum->t_start = t_start; sum->tasks = 1; }
 
-        if(WIFEXITED(status) || WIFSIGNALED(status)){
-            break;
+    int events = 0, stopping = 0;
+    pid_t tid = pid;
+    int sig = 0;
+    for(;;){
+        /* resume the task that stopped last */
+        if(tid > 0 && !stopping){
+            struct task *t = task_find(&tasks, tid);
+            int step = !filtered || (t && t->in_call);
+            if(ptrace(step ? PTRACE_SYSCALL : PTRACE_CONT, tid, 0, (void*)(long)sig) < 0 && errno != ESRCH){
+                perror("ptrace"); task_kill_all(&tasks); stopping = 1;
+            }
         }
+        sig = 0;
 
-        if(WIFSTOPPED(status) && (WSTOPSIG(status) == (SIGTRAP | 0x80))){
-            struct user_regs_struct r;
-            if(ptrace(PTRACE_GETREGS, pid, 0, &r) < 0){ perror("PTRACE_GETREGS"); break; }
-
-            if(entering){
-                long num = (long)r.orig_rax;
-                long a0 = (long)r.rdi, a1=(long)r.rsi, a2=(long)r.rdx;
-                long a3 = (long)r.r10, a4=(long)r.r8,  a5=(long)r.r9;
+        tid = waitpid(-1, &status, __WALL);
+        if(tid < 0){
+            if(errno == ECHILD) break;               /* every task is gone */
+            if(errno != EINTR){ perror("waitpid"); task_kill_all(&tasks); stopping = 1; continue; }
+            if(trace_alarm && !stopping){ task_kill_all(&tasks); stopping = 1; }
+            continue;
+        }
+        /* a busy tracee always has a stop pending, so waitpid() may never see EINTR */
+        if(trace_alarm && !stopping){ task_kill_all(&tasks); stopping = 1; }
+        if(WIFEXITED(status) || WIFSIGNALED(status)){
+            task_del(&tasks, tid);
+            tid = 0;
+            continue;
+        }
+        if(!WIFSTOPPED(status)) { tid = 0; continue; }
+        if(stopping){ kill(tid, SIGKILL); continue; }  /* includes children born mid-kill */
 
-                if(as_json) json_enter(num,a0,a1,a2,a3,a4,a5, pretty);
-                else        printf("enter  num=%ld args=[%ld,%ld,%ld,%ld,%ld,%ld]\n", num,a0,a1,a2,a3,a4,a5);
+        /* a child can report its attach stop before the parent's fork event */
+        struct task *t = task_find(&tasks, tid);
+        int newborn = !t;
+        if(!t) t = task_get(&tasks, tid);
+        if(!t){ perror("calloc"); task_kill_all(&tasks); stopping = 1; continue; }
+        if(newborn && sum) sum->tasks++;
+        int s = WSTOPSIG(status), ev = status >> 16;
+        struct user_regs_struct r;
 
-                entering = 0;
+        if(s == SIGTRAP && (ev == PTRACE_EVENT_FORK || ev == PTRACE_EVENT_VFORK || ev == PTRACE_EVENT_CLONE)){
+            unsigned long child = 0;
+            /* the child may have reported its SIGSTOP already; fresh marks it if not */
+            if(ptrace(PTRACE_GETEVENTMSG, tid, 0, &child) == 0 && child &&
+               !task_find(&tasks, (pid_t)child)){
+                struct task *c = task_get(&tasks, (pid_t)child);
+                if(c) c->fresh = 1;
+                if(c && sum) sum->tasks++;
+            }
+        }else if(s == SIGTRAP && ev == PTRACE_EVENT_EXEC){
+            /* a non-leader thread that execs takes over the leader's tid */
+            unsigned long former = 0;
+            if(ptrace(PTRACE_GETEVENTMSG, tid, 0, &former) == 0 && (pid_t)former != tid){
+                struct task *f = task_find(&tasks, (pid_t)former);
+                if(f){ struct task keep = *f; task_del(&tasks, (pid_t)former);
+                       t = task_get(&tasks, tid);
+                       if(t){ t->in_call = keep.in_call; t->nr = keep.nr; t->t0 = keep.t0; } }
+            }
+        }else if(s == SIGTRAP && ev == PTRACE_EVENT_SECCOMP){
+            if(ptrace(PTRACE_GETREGS, tid, 0, &r) < 0) continue;
+            t->nr = (long)r.orig_rax;
+            t->t0 = now_ns();
+            t->in_call = 1;
+            record_enter(ring, sum, t_start, tid, t, &r);
+        }else if(s == (SIGTRAP | 0x80)){
+            if(filtered && !t->in_call) continue;
+            if(ptrace(PTRACE_GETREGS, tid, 0, &r) < 0) continue;
+            if(!t->in_call){
+                t->nr = (long)r.orig_rax;
+                t->t0 = now_ns();
+                t->in_call = 1;
+                record_enter(ring, sum, t_start, tid, t, &r);
             }else{
-                long num = (long)r.orig_rax;
-                long ret = (long)r.rax;
-
-                if(as_json) json_exit(num,ret, pretty);
-                else        printf("exit   num=%ld ret=%ld\n", num, ret);
-
-                entering = 1;
-                if(maxev > 0 && ++events >= maxev){
-                    kill(pid, SIGKILL);
-                    (void)waitpid(pid, &status, 0);
-                    break;
-                }
+                t->in_call = 0;
+                record_exit(ring, sum, t_start, tid, t, &r);
+                if(maxev > 0 && ++events >= maxev){ task_kill_all(&tasks); stopping = 1; }
             }
+        }else if(s == SIGSTOP && (newborn || t->fresh)){
+            t->fresh = 0;                            /* attach stop, not the sample's signal */
+        }else if(s == SIGTRAP && ev){
+            /* other ptrace events: nothing to deliver */
+        }else{
+            sig = s;                                 /* the sample's own signal */
         }
+    }
+    alarm(0);
+    sigaction(SIGALRM, &old, NULL);
+    free(tasks.slot);
+    if(ring) ring_close(ring);
+    if(sum){ sum->t_end = now_ns(); summary_print(stdout, sum, format, pretty); }
+    return 0;
+}
+#endif
+
+int trace_process(const char *path, char *const argv[], const struct trace_opts *opt){
+#ifndef __x86_64__
+    fprintf(stderr, "trace: only x86_64 is supported in this prototype\n");
+    return 1;
+#else
+    int timeout = opt ? opt->timeout_sec : 5;
+    int maxev   = opt ? opt->max_events : 200;
+    int as_json = opt ? opt->json : 1;
+    int format  = !as_json ? TRACE_OUT_TEXT : (opt && opt->ndjson) ? TRACE_OUT_NDJSON : TRACE_OUT_JSON;
+    int pretty  = opt ? opt->pretty : 0;
+    int use_jail= opt ? opt->jail : 0;
+
+    int filtered = opt && opt->nsyscalls > 0;
+    char *av[2] = { (char*)path, NULL };
+    if(!argv) argv = av;
+    struct sock_filter f[TRACE_FILTER_LEN];
+    struct sock_fprog prog;
+    if(filtered) build_trace_filter(f, opt->syscalls, opt->nsyscalls, &prog);
 
-        if(timeout > 0 && (now_ms() - t0) >= (long)timeout*1000L){
-            kill(pid, SIGKILL);
-            (void)waitpid(pid, &status, 0);
-            break;
+    pid_t pid;
+    struct sandbox_prep *prep = NULL;
+    if(filtered && filter_has_execve(opt->syscalls, opt->nsyscalls)){
+        /* fork, stop, let trace_tree set the options, then filter and exec */
+        if((pid = fork()) < 0){ perror("fork"); return 1; }
+        if(pid == 0){
+            if(ptrace(PTRACE_TRACEME, 0, NULL, NULL) < 0) _exit(127);
+            raise(SIGSTOP);
+            if(use_jail){
+                char jerr[256] = {0};
+                struct jail_opts j = { .root=NULL, .make_netns=0, .readonly=1 };
+                if(jail_enter(&j, jerr, sizeof jerr) != 0) _exit(127);
+            }
+            if(prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 || prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) != 0) _exit(127);
+            execv(path, argv);
+            _exit(127);
         }
+    }else{
+        /* as run: prepared jail, vfork child that TRACEMEs and stops at its exec */
+        struct limits lim = {0};
+        struct spawn_opts so = { .lim = &lim, .use_jail = use_jail, .cgroup_fd = -1,
+                                 .traceme = 1, .filter = filtered ? &prog : NULL };
+        char err[256];
+        if(!(prep = sandbox_prepare(&so, err, sizeof err))) fprintf(stderr, "trace: %s; forking instead\n", err);
+        so.prep = prep;
+        if(sandbox_spawn(path, argv, &so, &pid, NULL) != 0){ perror("trace: spawn"); sandbox_prep_free(prep); return 1; }
     }
 
-    if(as_json){
-        if(pretty) puts("  ]\n}");
-        else       puts("]}");
+    /* parent: the summary table is ~115 KiB whatever the run, so allocate it once here */
+    struct trace_summary *sum = NULL;
+    if(opt && opt->summary && !(sum = calloc(1, sizeof *sum))){
+        perror("calloc"); kill(pid, SIGKILL); waitpid(pid, NULL, 0); sandbox_prep_free(prep); return 1;
     }
-    return 0;
+    int rc = trace_tree(pid, filtered, timeout, maxev, format, pretty, sum);
+    free(sum);
+    sandbox_prep_free(prep);    /* after the run, as in run_in_sandbox */
+    return rc;
 #endif
 }
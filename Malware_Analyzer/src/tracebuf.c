@@ -0,0 +1,209 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracebuf.h"
+#include "report.h"
+#include "syscalls.h"
+
+#define TRACE_BATCH   512         /* wake the writer every this many events */
+#define TRACE_IDLE_MS 50          /* ... and it looks again after this long anyway */
+
+/*
+ * Single producer (the tracer), single consumer (the writer). head and tail
+ * only grow; slot = counter % cap. The hot path is two atomics per event;
+ * the mutex is only for sleeping: the writer when idle, the tracer when the
+ * ring is full.
+ */
+struct trace_ring {
+    struct trace_event *ev;
+    size_t cap;
+    _Atomic size_t head, tail;    /* head: writer's, tail: tracer's */
+    int closed, waiting;          /* under mu */
+    pthread_mutex_t mu;
+    pthread_cond_t not_empty, not_full;
+    pthread_t writer;
+
+    FILE *out;
+    int format, pretty;
+    int first;                    /* no separator before the first JSON event */
+};
+
+/* -------- formatting (writer thread only) -------- */
+
+/* Strings come from the tracee: C-style escape everything that isn't
+   printable ASCII, so a sample can't forge lines or drive the terminal. */
+static void put_cstr(FILE *out, const char *s) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+        switch (*p) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (*p < 0x20 || *p >= 0x7f) fprintf(out, "\\x%02x", *p);
+            else fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void put_args(FILE *out, const struct trace_event *e, int as_json) {
+    for (int i = 0; i < 6; ++i) {
+        if (i) fputc(',', out);
+        int s = -1;
+        for (int k = 0; k < e->nstr; ++k) if (e->str_arg[k] == i) s = k;
+        if (s < 0) fprintf(out, "%lld", (long long)e->args[i]);
+        else if (as_json) json_write_str(out, e->str[s]);
+        else put_cstr(out, e->str[s]);
+    }
+}
+
+static void put_event(struct trace_ring *r, const struct trace_event *e) {
+    FILE *out = r->out;
+    const char *name = syscall_name((long)e->nr);
+    if (r->format == TRACE_OUT_TEXT) {
+        fprintf(out, "[%d] %s  %s(%lld)", (int)e->tid, e->kind == TRACE_ENTER ? "enter" : "exit ",
+                name ? name : "?", (long long)e->nr);
+        if (e->kind == TRACE_ENTER) { fputs(" args=[", out); put_args(out, e, 0); fputs("]\n", out); }
+        else fprintf(out, " ret=%lld  %.3f us\n", (long long)e->ret, (double)e->dur_ns / 1000.0);
+        return;
+    }
+    if (r->format == TRACE_OUT_JSON) {
+        if (!r->first) fputs(",\n", out);
+        if (r->pretty) fputs("    ", out);
+    }
+    r->first = 0;
+    fprintf(out, "{\"t_us\":%.3f,\"type\":\"%s\",\"tid\":%d,\"num\":%lld,\"name\":\"%s\",",
+            (double)e->t_ns / 1000.0, e->kind == TRACE_ENTER ? "enter" : "exit",
+            (int)e->tid, (long long)e->nr, name ? name : "?");
+    if (e->kind == TRACE_ENTER) { fputs("\"args\":[", out); put_args(out, e, 1); fputs("]}", out); }
+    else fprintf(out, "\"ret\":%lld,\"dur_us\":%.3f}", (long long)e->ret, (double)e->dur_ns / 1000.0);
+    if (r->format == TRACE_OUT_NDJSON) fputc('\n', out);
+}
+
+/*
+ * The writer takes whatever is queued, formats it straight out of the ring
+ * (the tracer never touches slots before head), and only then hands the
+ * slots back. It flushes when it runs dry, so output lags by at most one
+ * idle period.
+ */
+static void *writer_main(void *arg) {
+    struct trace_ring *r = arg;
+    for (;;) {
+        size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        size_t n = atomic_load_explicit(&r->tail, memory_order_acquire) - head;
+        if (n == 0) {
+            fflush(r->out);
+            pthread_mutex_lock(&r->mu);
+            int done = r->closed && atomic_load(&r->tail) == head;
+            if (!done && atomic_load(&r->tail) == head) {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += TRACE_IDLE_MS * 1000000L;
+                if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+                pthread_cond_timedwait(&r->not_empty, &r->mu, &ts);
+            }
+            pthread_mutex_unlock(&r->mu);
+            if (done) break;
+            continue;
+        }
+        size_t at = head % r->cap;
+        if (at + n > r->cap) n = r->cap - at;     /* contiguous part; the rest next round */
+        for (size_t i = 0; i < n; ++i) put_event(r, &r->ev[at + i]);
+        atomic_store_explicit(&r->head, head + n, memory_order_release);
+
+        pthread_mutex_lock(&r->mu);
+        if (r->waiting) pthread_cond_signal(&r->not_full);
+        pthread_mutex_unlock(&r->mu);
+    }
+    return NULL;
+}
+
+/* -------- ring -------- */
+
+struct trace_ring *ring_open(int format, int pretty) {
+    struct trace_ring *r = calloc(1, sizeof *r);
+    if (!r) return NULL;
+    r->cap = TRACE_RING_EVENTS;
+    r->ev = malloc(r->cap * sizeof *r->ev);
+    fflush(stdout);                               /* the writer's stream shares the fd */
+    int fd = dup(STDOUT_FILENO);
+    r->out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!r->ev || !r->out) {
+        if (r->out) fclose(r->out); else if (fd >= 0) close(fd);
+        free(r->ev); free(r);
+        return NULL;
+    }
+    setvbuf(r->out, NULL, _IOFBF, 1 << 16);
+    r->format = format;
+    r->pretty = pretty;
+    r->first = 1;
+    pthread_mutex_init(&r->mu, NULL);
+    pthread_cond_init(&r->not_empty, NULL);
+    pthread_cond_init(&r->not_full, NULL);
+
+    if (format == TRACE_OUT_JSON) fputs(pretty ? "{\n  \"trace\": [\n" : "{\"trace\":[\n", r->out);
+    if (pthread_create(&r->writer, NULL, writer_main, r) != 0) {
+        fclose(r->out);
+        pthread_mutex_destroy(&r->mu);
+        pthread_cond_destroy(&r->not_empty);
+        pthread_cond_destroy(&r->not_full);
+        free(r->ev); free(r);
+        return NULL;
+    }
+    return r;
+}
+
+/* blocks while full: this is what bounds the memory */
+struct trace_event *ring_reserve(struct trace_ring *r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&r->head, memory_order_acquire) == r->cap) {
+        pthread_mutex_lock(&r->mu);
+        r->waiting = 1;
+        while (tail - atomic_load(&r->head) == r->cap) {
+            pthread_cond_signal(&r->not_empty);
+            pthread_cond_wait(&r->not_full, &r->mu);
+        }
+        r->waiting = 0;
+        pthread_mutex_unlock(&r->mu);
+    }
+    return &r->ev[tail % r->cap];
+}
+
+void ring_commit(struct trace_ring *r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed) + 1;
+    atomic_store_explicit(&r->tail, tail, memory_order_release);
+    if (tail % TRACE_BATCH == 0) {
+        pthread_mutex_lock(&r->mu);
+        pthread_cond_signal(&r->not_empty);
+        pthread_mutex_unlock(&r->mu);
+    }
+}
+
+void ring_close(struct trace_ring *r) {
+    if (!r) return;
+    pthread_mutex_lock(&r->mu);
+    r->closed = 1;
+    pthread_cond_signal(&r->not_empty);
+    pthread_mutex_unlock(&r->mu);
+    pthread_join(r->writer, NULL);
+
+    if (r->format == TRACE_OUT_JSON) {
+        if (!r->first) fputc('\n', r->out);
+        fputs(r->pretty ? "  ]\n}\n" : "]}\n", r->out);
+    }
+    fclose(r->out);
+    pthread_mutex_destroy(&r->mu);
+    pthread_cond_destroy(&r->not_empty);
+    pthread_cond_destroy(&r->not_full);
+    free(r->ev);
+    free(r);
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracestat.h"
+#include "tracebuf.h"
+
+static struct trace_stat *slot(struct trace_summary *s, long nr) {
+    return &s->sc[nr >= 0 && nr < SYSCALL_MAX ? nr : SYSCALL_MAX];
+}
+
+static int bucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int b = us ? 64 - __builtin_clzll(us) : 0;
+    return b < TRACE_HIST_BUCKETS ? b : TRACE_HIST_BUCKETS - 1;
+}
+
+void summary_enter(struct trace_summary *s, long nr) {
+    slot(s, nr)->calls++;
+}
+
+void summary_exit(struct trace_summary *s, long nr, int64_t ret, int64_t dur_ns) {
+    struct trace_stat *st = slot(s, nr);
+    uint64_t ns = dur_ns > 0 ? (uint64_t)dur_ns : 0;
+    st->done++;
+    if (ret < 0 && ret >= -4095) st->errors++;
+    st->total_ns += ns;
+    if (ns > st->max_ns) st->max_ns = ns;
+    st->hist[bucket(ns)]++;
+}
+
+/* -------- output -------- */
+
+/* Upper bound of the bucket holding the q-quantile of the timed calls; an
+   estimate to within a factor of two, which is all a log2 histogram has. */
+static uint64_t quantile_us(const struct trace_stat *st, double q) {
+    uint64_t want = (uint64_t)(q * (double)st->done + 0.5), seen = 0;
+    if (!want) want = 1;
+    for (int i = 0; i < TRACE_HIST_BUCKETS; ++i) {
+        seen += st->hist[i];
+        if (seen >= want) return (uint64_t)1 << i;
+    }
+    return (uint64_t)1 << (TRACE_HIST_BUCKETS - 1);
+}
+
+static const struct trace_summary *g_sort;
+
+static int by_time(const void *a, const void *b) {
+    const struct trace_stat *x = &g_sort->sc[*(const int *)a], *y = &g_sort->sc[*(const int *)b];
+    if (x->total_ns != y->total_ns) return x->total_ns < y->total_ns ? 1 : -1;
+    if (x->calls != y->calls) return x->calls < y->calls ? 1 : -1;
+    return *(const int *)a - *(const int *)b;
+}
+
+static const char *slot_name(int nr) {
+    const char *name = nr < SYSCALL_MAX ? syscall_name(nr) : "other";
+    return name ? name : "?";
+}
+
+static void print_text(FILE *out, const struct trace_summary *s, const int *order, int n,
+                       uint64_t calls, uint64_t errors, uint64_t total_ns) {
+    fprintf(out, "%% time     seconds  usecs/call     calls    errors  p99<us syscall\n");
+    fprintf(out, "------ ----------- ----------- --------- --------- ------- ----------------\n");
+    for (int i = 0; i < n; ++i) {
+        const struct trace_stat *st = &s->sc[order[i]];
+        fprintf(out, "%6.2f %11.6f %11llu %9llu %9llu %7llu %s",
+                total_ns ? 100.0 * (double)st->total_ns / (double)total_ns : 0.0,
+                (double)st->total_ns / 1e9,
+                (unsigned long long)(st->done ? st->total_ns / st->done / 1000 : 0),
+                (unsigned long long)st->calls, (unsigned long long)st->errors,
+                (unsigned long long)(st->done ? quantile_us(st, 0.99) : 0), slot_name(order[i]));
+        if (order[i] == SYSCALL_MAX) fputs(" (unnamed numbers)", out);
+        fputc('\n', out);
+    }
+    fprintf(out, "------ ----------- ----------- --------- --------- ------- ----------------\n");
+    fprintf(out, "100.00 %11.6f %11s %9llu %9llu %7s total (%llu tasks, %.3f s wall)\n",
+            (double)total_ns / 1e9, "", (unsigned long long)calls, (unsigned long long)errors, "",
+            (unsigned long long)s->tasks, (double)(s->t_end - s->t_start) / 1e9);
+}
+
+static void print_json(FILE *out, const struct trace_summary *s, const int *order, int n,
+                       uint64_t calls, uint64_t errors, uint64_t total_ns, int pretty) {
+    const char *nl = pretty ? "\n" : "", *in1 = pretty ? "  " : "", *in2 = pretty ? "    " : "";
+    fprintf(out, "{%s%s\"summary\":{%s", nl, in1, nl);
+    fprintf(out, "%s\"wall_ms\":%.3f,\"tasks\":%llu,\"calls\":%llu,\"errors\":%llu,\"total_us\":%.3f,%s",
+            in2, (double)(s->t_end - s->t_start) / 1e6, (unsigned long long)s->tasks,
+            (unsigned long long)calls, (unsigned long long)errors, (double)total_ns / 1000.0, nl);
+    fprintf(out, "%s\"hist_buckets_us\":\"log2: [i] = [2^(i-1), 2^i), [0] = under 1\",%s", in2, nl);
+    fprintf(out, "%s\"syscalls\":[%s", in2, nl);
+    for (int i = 0; i < n; ++i) {
+        const struct trace_stat *st = &s->sc[order[i]];
+        int last = TRACE_HIST_BUCKETS;
+        while (last > 0 && !st->hist[last - 1]) --last;
+        fprintf(out, "%s%s{\"num\":%d,\"name\":\"%s\",\"calls\":%llu,\"errors\":%llu,"
+                "\"total_us\":%.3f,\"avg_us\":%.3f,\"max_us\":%.3f,\"p50_us\":%llu,\"p99_us\":%llu,\"hist\":[",
+                in2, in1, order[i] < SYSCALL_MAX ? order[i] : -1, slot_name(order[i]),
+                (unsigned long long)st->calls, (unsigned long long)st->errors,
+                (double)st->total_ns / 1000.0,
+                st->done ? (double)st->total_ns / 1000.0 / (double)st->done : 0.0,
+                (double)st->max_ns / 1000.0,
+                (unsigned long long)(st->done ? quantile_us(st, 0.50) : 0),
+                (unsigned long long)(st->done ? quantile_us(st, 0.99) : 0));
+        for (int b = 0; b < last; ++b) fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)st->hist[b]);
+        fprintf(out, "]}%s%s", i + 1 < n ? "," : "", nl);
+    }
+    fprintf(out, "%s]%s%s}%s}\n", in2, nl, in1, nl);
+}
+
+void summary_print(FILE *out, const struct trace_summary *s, int format, int pretty) {
+    int order[SYSCALL_MAX + 1], n = 0;
+    uint64_t calls = 0, errors = 0, total_ns = 0;
+    for (int nr = 0; nr <= SYSCALL_MAX; ++nr) {
+        const struct trace_stat *st = &s->sc[nr];
+        if (!st->calls && !st->done) continue;
+        order[n++] = nr;
+        calls += st->calls; errors += st->errors; total_ns += st->total_ns;
+    }
+    g_sort = s;
+    qsort(order, (size_t)n, sizeof order[0], by_time);
+
+    if (format == TRACE_OUT_TEXT) print_text(out, s, order, n, calls, errors, total_ns);
+    else print_json(out, s, order, n, calls, errors, total_ns, pretty);
+    fflush(out);
+}
@@ -1,8 +1,19 @@
+
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <openssl/evp.h>
 
+#define HASH_CHUNK (4u << 20)   /* 4 MiB: multiple of any page size */
+#define HASH_SLICE (64u << 10)
+
 int read_file(const char *path, unsigned char **buf, size_t *len, char *err, size_t errlen) {
     *buf = NULL; *len = 0;
     FILE *f = fopen(path, "rb");
@@ -17,14 +28,103 @@ int read_file(const char *path, unsigned char **buf, size_t *len, char *err, siz
     *buf = tmp; *len = (size_t)sz; return 0;
 }
 
+/* non-seekable input: read until EOF into a growing buffer */
+static int slurp_fd(int fd, struct file_view *fv, char *err, size_t errlen) {
+    size_t cap = 1u << 16, len = 0;
+    unsigned char *buf = malloc(cap);
+    if (!buf) { snprintf(err, errlen, "malloc failed"); return -1; }
+    for (;;) {
+        if (len == cap) {
+            unsigned char *nb = realloc(buf, cap * 2);
+            if (!nb) { free(buf); snprintf(err, errlen, "realloc failed"); return -1; }
+            buf = nb; cap *= 2;
+        }
+        ssize_t r = read(fd, buf + len, cap - len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { free(buf); snprintf(err, errlen, "read failed: %s", strerror(errno)); return -1; }
+        if (r == 0) break;
+        len += (size_t)r;
+    }
+    fv->data = buf; fv->len = len; fv->mapped = 0;
+    return 0;
+}
+
+int map_file(const char *path, struct file_view *fv, char *err, size_t errlen) {
+    memset(fv, 0, sizeof *fv);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { snprintf(err, errlen, "cannot open file: %s", strerror(errno)); return -1; }
+    struct stat st;
+    if (fstat(fd, &st) != 0) { snprintf(err, errlen, "fstat failed: %s", strerror(errno)); close(fd); return -1; }
+
+    int rc = 0;
+    if (!S_ISREG(st.st_mode)) {
+        rc = slurp_fd(fd, fv, err, errlen);
+    } else if (st.st_size > 0) {
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) { snprintf(err, errlen, "mmap failed: %s", strerror(errno)); rc = -1; }
+        else { fv->data = m; fv->len = (size_t)st.st_size; fv->mapped = 1; }
+    }
+    close(fd);   /* the mapping keeps its own reference */
+    return rc;
+}
+
+void unmap_file(struct file_view *fv) {
+    if (!fv || !fv->data) return;
+    if (fv->mapped) munmap((void*)fv->data, fv->len);
+    else free((void*)fv->data);
+    memset(fv, 0, sizeof *fv);
+}
+
+static void to_hex(const unsigned char md[32], char out_hex[65]) {
+    static const char *hex = "0123456789abcdef";
+    for (unsigned i = 0; i < 32; ++i) { out_hex[i*2] = hex[(md[i]>>4)&0xF]; out_hex[i*2+1] = hex[md[i]&0xF]; }
+    out_hex[64] = '\0';
+}
+
 int sha256_hex(const unsigned char *buf, size_t len, char out_hex[65]) {
+    struct file_view fv = { buf, len, 0 };
+    return sha256_hex_view(&fv, out_hex);
+}
+
+int sha256_hex_view(const struct file_view *fv, char out_hex[65]) {
+    return sha256_hex_view_cb(fv, out_hex, NULL, NULL);
+}
+
+int sha256_hex_view_cb(const struct file_view *fv, char out_hex[65],
+                       void (*chunk)(void *ctx, size_t off, size_t n), void *chunk_ctx) {
     unsigned char md[32]; unsigned int mdlen = 0;
     EVP_MD_CTX *ctx = EVP_MD_CTX_new(); if (!ctx) return -1;
     if (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1) { EVP_MD_CTX_free(ctx); return -1; }
-    if (EVP_DigestUpdate(ctx, buf, len) != 1) { EVP_MD_CTX_free(ctx); return -1; }
+    if (fv->mapped) (void)madvise((void*)fv->data, fv->len, MADV_SEQUENTIAL);
+    for (size_t off = 0; off < fv->len; off += HASH_CHUNK) {
+        size_t n = fv->len - off < HASH_CHUNK ? fv->len - off : HASH_CHUNK;
+        /* slices small enough that the chunk pass finds them still in L2 */
+        for (size_t o = off; o < off + n; o += HASH_SLICE) {
+            size_t sn = off + n - o < HASH_SLICE ? off + n - o : HASH_SLICE;
+            if (EVP_DigestUpdate(ctx, fv->data + o, sn) != 1) { EVP_MD_CTX_free(ctx); return -1; }
+            if (chunk) chunk(chunk_ctx, o, sn);
+        }
+        /* clean file-backed pages: dropping them is free, a later touch refaults.
+           With a chunk pass, lag one chunk so it can still look back (patterns
+           straddling the boundary) without refaulting. */
+        if (fv->mapped && !chunk) (void)madvise((void*)(fv->data + off), n, MADV_DONTNEED);
+        else if (fv->mapped && off >= HASH_CHUNK) (void)madvise((void*)(fv->data + off - HASH_CHUNK), HASH_CHUNK, MADV_DONTNEED);
+    }
     if (EVP_DigestFinal_ex(ctx, md, &mdlen) != 1) { EVP_MD_CTX_free(ctx); return -1; }
     EVP_MD_CTX_free(ctx);
-    static const char *hex = "0123456789abcdef";
-    for (unsigned i = 0; i < 32; ++i) { out_hex[i*2] = hex[(md[i]>>4)&0xF]; out_hex[i*2+1] = hex[md[i]&0xF]; }
-    out_hex[64] = '\0'; return 0;
+    to_hex(md, out_hex);
+    return 0;
+}
+
+double byte_entropy(const unsigned char *p, size_t n) {
+    if (!n) return 0.0;
+    size_t hist[256] = {0};
+    for (size_t i = 0; i < n; ++i) hist[p[i]]++;
+    double h = 0.0;
+    for (int b = 0; b < 256; ++b) {
+        if (!hist[b]) continue;
+        double q = (double)hist[b] / (double)n;
+        h -= q * log2(q);
+    }
+    return h;
 }
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "acmatch.h"
+
+static void *ac_xrealloc(void *q, size_t n){
+    void *p = realloc(q, n);
+    if(!p){ perror("realloc"); exit(1); }
+    return p;
+}
+
+static unsigned char fold(unsigned char c, int icase){
+    if(icase && c >= 'A' && c <= 'Z') return (unsigned char)(c - 'A' + 'a');
+    return c;
+}
+
+void ac_init(ACMatcher *ac, int icase){
+    memset(ac, 0, sizeof *ac);
+    ac->icase = icase;
+}
+
+static void free_patterns(ACMatcher *ac){
+    for(size_t i = 0; i < ac->npats; i++) free(ac->pats[i]);
+    free(ac->pats);
+    free(ac->plens);
+    free(ac->pmasks);
+    ac->pats = NULL; ac->plens = NULL; ac->pmasks = NULL;
+    ac->npats = ac->pcap = 0;
+}
+
+void ac_free(ACMatcher *ac){
+    if(!ac) return;
+    free_patterns(ac);
+    free(ac->next);
+    free(ac->out);
+    int icase = ac->icase;
+    memset(ac, 0, sizeof *ac);
+    ac->icase = icase;
+}
+
+void ac_add(ACMatcher *ac, const char *pat, size_t n, uint64_t mask){
+    if(!n) return;
+    if(ac->npats == ac->pcap){
+        size_t nc = ac->pcap ? ac->pcap * 2 : 16;
+        ac->pats   = (char**)ac_xrealloc(ac->pats, nc * sizeof *ac->pats);
+        ac->plens  = (size_t*)ac_xrealloc(ac->plens, nc * sizeof *ac->plens);
+        ac->pmasks = (uint64_t*)ac_xrealloc(ac->pmasks, nc * sizeof *ac->pmasks);
+        ac->pcap = nc;
+    }
+    char *p = (char*)ac_xrealloc(NULL, n);
+    memcpy(p, pat, n);
+    ac->pats[ac->npats] = p;
+    ac->plens[ac->npats] = n;
+    ac->pmasks[ac->npats] = mask;
+    ac->npats++;
+}
+
+int ac_add_file(ACMatcher *ac, const char *path, uint64_t mask){
+    FILE *fp = fopen(path, "r");
+    if(!fp) return -1;
+    char buf[1024];
+    int added = 0;
+    while(fgets(buf, (int)sizeof buf, fp)){
+        size_t n = strcspn(buf, "\r\n");
+        if(n == 0 || buf[0] == '#') continue;
+        ac_add(ac, buf, n, mask);
+        added++;
+    }
+    fclose(fp);
+    return added;
+}
+
+/* state table grows while the trie is built */
+static uint32_t new_state(ACMatcher *ac, size_t *cap){
+    if(ac->nstates == *cap){
+        size_t nc = *cap ? *cap * 2 : 64;
+        ac->next = (uint32_t*)ac_xrealloc(ac->next, nc * ac->nclasses * sizeof *ac->next);
+        ac->out  = (uint64_t*)ac_xrealloc(ac->out, nc * sizeof *ac->out);
+        *cap = nc;
+    }
+    size_t s = ac->nstates++;
+    memset(ac->next + s * ac->nclasses, 0, ac->nclasses * sizeof *ac->next);
+    ac->out[s] = 0;
+    return (uint32_t)s;
+}
+
+void ac_compile(ACMatcher *ac){
+    /* byte classes: 0 = byte not used by any pattern */
+    memset(ac->cls, 0, sizeof ac->cls);
+    size_t ncls = 1;
+    for(size_t i = 0; i < ac->npats; i++){
+        for(size_t j = 0; j < ac->plens[i]; j++){
+            unsigned char c = fold((unsigned char)ac->pats[i][j], ac->icase);
+            if(!ac->cls[c]) ac->cls[c] = (uint16_t)ncls++;
+        }
+    }
+    if(ac->icase){
+        for(int c = 'A'; c <= 'Z'; c++) ac->cls[c] = ac->cls[c - 'A' + 'a'];
+    }
+    ac->nclasses = ncls;
+
+    free(ac->next); free(ac->out);
+    ac->next = NULL; ac->out = NULL;
+    ac->nstates = 0;
+    ac->all = 0;
+    size_t cap = 0;
+    (void)new_state(ac, &cap);   /* root */
+
+    /* trie; transition 0 means "none" while building (root is never a child) */
+    for(size_t i = 0; i < ac->npats; i++){
+        uint32_t s = 0;
+        for(size_t j = 0; j < ac->plens[i]; j++){
+            size_t c = ac->cls[fold((unsigned char)ac->pats[i][j], ac->icase)];
+            uint32_t t = ac->next[s * ac->nclasses + c];
+            if(!t){
+                t = new_state(ac, &cap);
+                ac->next[s * ac->nclasses + c] = t;
+            }
+            s = t;
+        }
+        ac->out[s] |= ac->pmasks[i];
+        ac->all |= ac->pmasks[i];
+    }
+
+    /* BFS: fill failure links straight into the table (full DFA) */
+    uint32_t *fail = (uint32_t*)ac_xrealloc(NULL, ac->nstates * sizeof *fail);
+    uint32_t *queue = (uint32_t*)ac_xrealloc(NULL, ac->nstates * sizeof *queue);
+    size_t qh = 0, qt = 0;
+    for(size_t c = 0; c < ac->nclasses; c++){
+        uint32_t t = ac->next[c];
+        if(t){ fail[t] = 0; queue[qt++] = t; }
+    }
+    while(qh < qt){
+        uint32_t s = queue[qh++];
+        ac->out[s] |= ac->out[fail[s]];
+        for(size_t c = 0; c < ac->nclasses; c++){
+            uint32_t *slot = &ac->next[s * ac->nclasses + c];
+            uint32_t via_fail = ac->next[(size_t)fail[s] * ac->nclasses + c];
+            if(*slot){
+                fail[*slot] = via_fail;
+                queue[qt++] = *slot;
+            } else {
+                *slot = via_fail;
+            }
+        }
+    }
+    free(queue);
+    free(fail);
+    free_patterns(ac);
+}
+
+uint64_t ac_scan(const ACMatcher *ac, const char *s, size_t n){
+    if(!ac->nstates) return 0;
+    const uint32_t *next = ac->next;
+    const size_t nc = ac->nclasses;
+    uint32_t st = 0;
+    uint64_t m = 0;
+    for(size_t i = 0; i < n; i++){
+        st = next[st * nc + ac->cls[(unsigned char)s[i]]];
+        m |= ac->out[st];
+        if(m == ac->all) break;
+    }
+    return m;
+}
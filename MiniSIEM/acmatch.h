@@ -0,0 +1,50 @@
+#ifndef ACMATCH_H
+#define ACMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Aho-Corasick multi-pattern matcher shared by MiniSIEM and SecLog.
+ *
+ * Patterns are added with a 64-bit category mask, then compiled into a
+ * dense DFA over byte classes (only bytes that occur in some pattern get
+ * their own column). ac_scan() walks a line once and returns the OR of the
+ * masks of every pattern that occurs in it, so the cost per line does not
+ * depend on how many patterns are loaded.
+ *
+ * With icase set, ASCII letters are folded while compiling; the input is
+ * never copied or lowercased.
+ */
+
+typedef struct {
+    int icase;
+    /* patterns, kept until ac_compile() */
+    char **pats;
+    size_t *plens;
+    uint64_t *pmasks;
+    size_t npats, pcap;
+    /* compiled automaton */
+    uint16_t cls[256];
+    size_t nclasses;
+    uint32_t *next;      /* nstates * nclasses */
+    uint64_t *out;       /* per-state output mask */
+    size_t nstates;
+    uint64_t all;        /* OR of every pattern mask */
+} ACMatcher;
+
+void ac_init(ACMatcher *ac, int icase);
+void ac_free(ACMatcher *ac);
+
+/* Add one pattern; empty patterns are ignored. */
+void ac_add(ACMatcher *ac, const char *pat, size_t n, uint64_t mask);
+/* One pattern per line; blank lines and lines starting with '#' are skipped.
+   Returns the number of patterns added, or -1 if the file can't be read. */
+int ac_add_file(ACMatcher *ac, const char *path, uint64_t mask);
+
+/* Build the DFA. Must be called after the last ac_add() and before ac_scan(). */
+void ac_compile(ACMatcher *ac);
+
+uint64_t ac_scan(const ACMatcher *ac, const char *s, size_t n);
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * bench - throughput harness for the log analyzers.
+ *
+ *   bench stages --format=auth|clf [--runs=N] LOGFILE
+ *       Runs the shared ingest pipeline in-process, one cumulative stage at
+ *       a time (read -> tokenize -> match -> aggregate), and prints what
+ *       each stage adds on top of the previous one.
+ *
+ *   bench run [--runs=N] LOGFILE -- PROGRAM [ARGS...]
+ *       Runs PROGRAM with LOGFILE in place of a "{}" argument (appended if
+ *       there is none), stdout to /dev/null, and reports wall/user/sys time,
+ *       lines/s, MB/s and peak RSS from wait4().
+ *
+ * Every figure is the best of N runs (default 3); the first pass over the
+ * file warms the page cache and is not counted.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../acmatch.h"
+#include "../ingest.h"
+#include "../ipindex.h"
+#include "../logtok.h"
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double tv_s(struct timeval tv){ return (double)tv.tv_sec + (double)tv.tv_usec / 1e6; }
+
+typedef struct {
+    unsigned long long lines, bytes;
+} Count;
+
+/* count lines/bytes once so `run` can report rates for any program */
+static Count measure(const char *path){
+    Count c = {0, 0};
+    LineReader lr;
+    if(lr_open(&lr, path) != 0){ perror(path); exit(1); }
+    const char *line;
+    size_t n;
+    while(lr_next(&lr, &line, &n) > 0){ c.lines++; c.bytes += n + 1; }
+    lr_close(&lr);
+    return c;
+}
+
+static void print_rate(const char *label, double secs, Count c){
+    if(secs <= 0) secs = 1e-9;
+    printf("  %-22s %9.3f s %12.0f lines/s %9.1f MB/s", label, secs,
+           (double)c.lines / secs, (double)c.bytes / secs / 1e6);
+}
+
+/* ---- stages ---- */
+
+enum { ST_READ, ST_TOKENIZE, ST_MATCH, ST_AGGREGATE, ST_COUNT };
+static const char *const stage_name[ST_COUNT] = { "read", "+tokenize", "+match", "+aggregate" };
+
+/* the analyzers' own signature sets */
+static void build_sigs(ACMatcher *ac, int clf){
+    static const char *const web[] = {
+        "union%20select", "union+select", "union select", "' or '1'='1",
+        "%27or%271%27%3d%271", "<script", "%3cscript", "../", "%2e%2e%2f",
+    };
+    static const char *const auth[] = {
+        "sshd", "sudo", "Failed password", "Invalid user",
+        "authentication failure", "NOT in sudoers", "not in the sudoers file",
+    };
+    ac_init(ac, clf);
+    if(clf) for(size_t i = 0; i < sizeof web / sizeof web[0]; i++) ac_add(ac, web[i], strlen(web[i]), 1);
+    else    for(size_t i = 0; i < sizeof auth / sizeof auth[0]; i++) ac_add(ac, auth[i], strlen(auth[i]), 1ull << i);
+    ac_compile(ac);
+}
+
+/* one pass through stages [0, upto]; returns a checksum so nothing is optimized out */
+static unsigned long long pipeline(const char *path, int clf, int upto, const ACMatcher *ac,
+                                   size_t *uniq){
+    LineReader lr;
+    if(lr_open(&lr, path) != 0){ perror(path); exit(1); }
+    IPIndex ix;
+    ipidx_init(&ix, sizeof(unsigned));
+    unsigned long long sum = 0;
+    const char *line;
+    size_t n;
+    while(lr_next(&lr, &line, &n) > 0){
+        sum += n;
+        if(upto < ST_TOKENIZE) continue;
+        strview ip = { NULL, 0 }, subject = { line, n };
+        if(clf){
+            ClfLine f;
+            if(clf_parse(line, n, &f)){ ip = f.host; subject = f.path; }
+        } else {
+            (void)log_find_ip(line, n, &ip);
+        }
+        sum += ip.n;
+        if(upto < ST_MATCH) continue;
+        uint64_t m = ac_scan(ac, subject.p, subject.n);
+        sum += m;
+        if(upto < ST_AGGREGATE || !ip.n) continue;
+        if(clf || (m & 0xc)){                 /* auth: failed password / invalid user only */
+            unsigned *v = (unsigned*)ipidx_get(&ix, ip.p, ip.n, NULL);
+            (*v)++;
+        }
+    }
+    lr_close(&lr);
+    *uniq = ix.len;
+    ipidx_free(&ix);
+    return sum;
+}
+
+static int cmd_stages(int argc, char **argv){
+    const char *path = NULL, *format = "auth";
+    int runs = 3;
+    for(int i = 0; i < argc; i++){
+        if(!strncmp(argv[i], "--format=", 9)) format = argv[i] + 9;
+        else if(!strncmp(argv[i], "--runs=", 7)) runs = atoi(argv[i] + 7);
+        else path = argv[i];
+    }
+    if(!path){ fprintf(stderr, "bench stages: need a log file\n"); return 2; }
+    if(runs < 1) runs = 1;
+    int clf = !strcmp(format, "clf");
+
+    ACMatcher ac;
+    build_sigs(&ac, clf);
+    Count c = measure(path);                  /* also warms the page cache */
+    printf("stages %s (%s): %llu lines, %.1f MB\n", path, format, c.lines, (double)c.bytes / 1e6);
+
+    double prev = 0;
+    size_t uniq = 0;
+    unsigned long long sink = 0;
+    for(int s = 0; s < ST_COUNT; s++){
+        double best = 1e30;
+        for(int r = 0; r < runs; r++){
+            double t0 = now_s();
+            sink += pipeline(path, clf, s, &ac, &uniq);
+            double dt = now_s() - t0;
+            if(dt < best) best = dt;
+        }
+        print_rate(stage_name[s], best, c);
+        printf("   (+%.3f s)\n", best - prev);
+        prev = best;
+    }
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("  unique IPs %zu, peak RSS %ld KiB, checksum %llx\n", uniq, ru.ru_maxrss, sink);
+    ac_free(&ac);
+    return 0;
+}
+
+/* ---- run ---- */
+
+static int cmd_run(int argc, char **argv){
+    const char *path = NULL;
+    int runs = 3, i = 0;
+    for(; i < argc && strcmp(argv[i], "--"); i++){
+        if(!strncmp(argv[i], "--runs=", 7)) runs = atoi(argv[i] + 7);
+        else path = argv[i];
+    }
+    if(!path || i + 1 >= argc){ fprintf(stderr, "bench run: LOGFILE -- PROGRAM [ARGS...]\n"); return 2; }
+    if(runs < 1) runs = 1;
+
+    char **cmd = calloc((size_t)(argc - i) + 1, sizeof *cmd);
+    if(!cmd){ perror("calloc"); return 1; }
+    int nc = 0, placed = 0;
+    for(int k = i + 1; k < argc; k++){
+        if(!strcmp(argv[k], "{}")){ cmd[nc++] = (char*)path; placed = 1; }
+        else cmd[nc++] = argv[k];
+    }
+    if(!placed) cmd[nc++] = (char*)path;
+    cmd[nc] = NULL;
+
+    Count c = measure(path);
+    double best_wall = 1e30, best_user = 0, best_sys = 0;
+    long peak_rss = 0;
+    int status = 0;
+    for(int r = 0; r < runs; r++){
+        double t0 = now_s();
+        pid_t pid = fork();
+        if(pid < 0){ perror("fork"); return 1; }
+        if(pid == 0){
+            int null = open("/dev/null", O_WRONLY);
+            if(null >= 0){ dup2(null, STDOUT_FILENO); close(null); }
+            execvp(cmd[0], cmd);
+            perror(cmd[0]);
+            _exit(127);
+        }
+        struct rusage ru;
+        while(wait4(pid, &status, 0, &ru) < 0){
+            if(errno != EINTR){ perror("wait4"); return 1; }
+        }
+        double wall = now_s() - t0;
+        if(wall < best_wall){ best_wall = wall; best_user = tv_s(ru.ru_utime); best_sys = tv_s(ru.ru_stime); }
+        if(ru.ru_maxrss > peak_rss) peak_rss = ru.ru_maxrss;
+    }
+    free(cmd);
+
+    printf("run %s on %s: %llu lines, %.1f MB\n", argv[i + 1], path, c.lines, (double)c.bytes / 1e6);
+    print_rate("wall", best_wall, c);
+    printf("\n  user %.3f s, sys %.3f s, peak RSS %ld KiB, exit %d\n",
+           best_user, best_sys, peak_rss, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv){
+    if(argc >= 2 && !strcmp(argv[1], "stages")) return cmd_stages(argc - 2, argv + 2);
+    if(argc >= 2 && !strcmp(argv[1], "run"))    return cmd_run(argc - 2, argv + 2);
+    fprintf(stderr,
+      "Usage: %s stages --format=auth|clf [--runs=N] LOGFILE\n"
+      "       %s run [--runs=N] LOGFILE -- PROGRAM [ARGS...]   ({} = LOGFILE)\n", argv[0], argv[0]);
+    return 2;
+}
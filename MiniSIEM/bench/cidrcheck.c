@@ -0,0 +1,301 @@
+/*
+ * cidrcheck - checks cidrset's trie against a brute-force longest-prefix match.
+ *
+ *   cidrcheck [--v4=N] [--v6=N] [--queries=N] [--seed=S]
+ *
+ * First a fixed table of nested allow/deny prefixes with known answers
+ * (holes carved out of holes, /0, /32 and /128, ::ffff: mapped forms on
+ * both sides, ties between allow and deny, inputs that must be refused).
+ * Then N random IPv4 and IPv6 prefixes (default 20000 and 5000), a third
+ * of them nested under earlier ones, some re-added with the other list and
+ * some written as ::ffff:a.b.c.d/96+len, and --queries lookups per family
+ * aimed in, just past and outside them: every answer has to equal a linear
+ * scan over the list. Exits 1 if any answer differs.
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cidrset.h"
+
+static uint64_t rng_state;
+
+/* splitmix64, as in loggen */
+static uint64_t rng(void){
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static unsigned below(unsigned n){ return (unsigned)(rng() % n); }
+
+static int failures;
+
+/* ---- fixed cases ---- */
+
+typedef struct { const char *cidr; unsigned list; } Entry;
+typedef struct { const char *ip; unsigned want; } Probe;
+
+static const Entry fixed_set[] = {
+    { "0.0.0.0/0",              CIDR_DENY  },
+    { "10.0.0.0/8",             CIDR_ALLOW },
+    { "10.1.0.0/16",            CIDR_DENY  },
+    { "10.1.2.0/24",            CIDR_ALLOW },
+    { "10.1.2.3",               CIDR_DENY  },       /* bare address = /32 */
+    { "10.1.2.128/25",          CIDR_DENY  },
+    { "10.1.2.128/25",          CIDR_ALLOW },       /* same prefix twice: both bits */
+    { "192.168.7.99/16",        CIDR_ALLOW },       /* host bits dropped */
+    { "::ffff:172.16.0.0/108",  CIDR_DENY  },       /* = 172.16.0.0/12 */
+    { "::ffff:172.16.5.5",      CIDR_ALLOW },       /* = 172.16.5.5/32 */
+    { "::/0",                   CIDR_ALLOW },
+    { "2001:db8::/32",          CIDR_DENY  },
+    { "2001:db8:1::/48",        CIDR_ALLOW },
+    { "2001:db8:1:2::/64",      CIDR_DENY  },
+    { "2001:db8:1:2::1/128",    CIDR_ALLOW },
+    { "2001:db8:1:2::2",        CIDR_ALLOW },       /* bare address = /128 */
+};
+
+static const Probe fixed_probe[] = {
+    { "8.8.8.8",                CIDR_DENY  },
+    { "10.9.9.9",               CIDR_ALLOW },
+    { "10.1.9.9",               CIDR_DENY  },
+    { "10.1.2.4",               CIDR_ALLOW },
+    { "10.1.2.3",               CIDR_DENY  },
+    { "10.1.2.200",             CIDR_ALLOW | CIDR_DENY },
+    { "192.168.0.1",            CIDR_ALLOW },
+    { "192.169.0.1",            CIDR_DENY  },
+    { "172.31.255.255",         CIDR_DENY  },
+    { "172.32.0.0",             CIDR_DENY  },       /* only /0 */
+    { "172.16.5.5",             CIDR_ALLOW },
+    { "::ffff:10.1.2.3",        CIDR_DENY  },       /* mapped lookups go to IPv4 */
+    { "::ffff:10.1.2.4",        CIDR_ALLOW },
+    { "::FFFF:172.16.5.5",      CIDR_ALLOW },
+    { "::ffff:0a01:0203",       CIDR_DENY  },       /* the same, in hex */
+    { "2001:db9::1",            CIDR_ALLOW },
+    { "2001:db8:ffff::1",       CIDR_DENY  },
+    { "2001:db8:1:3::1",        CIDR_ALLOW },
+    { "2001:db8:1:2::3",        CIDR_DENY  },
+    { "2001:db8:1:2::1",        CIDR_ALLOW },
+    { "2001:db8:1:2::2",        CIDR_ALLOW },
+    { "::1",                    CIDR_ALLOW },
+    { "::",                     CIDR_ALLOW },
+    { "not-an-ip",              0 },
+    { "999.1.1.1",              0 },
+    { "",                       0 },
+};
+
+static const char *const refused[] = {
+    "1.2.3.4/33", "1.2.3.4/", "1.2.3.4/3x", "1.2.3.4/0032", "999.1.1.1", "1.2.3",
+    "::/129", "::ffff:1.2.3.4/95", "::ffff:1.2.3.4/129", "2001:db8::1::2", "/8", "",
+};
+
+static void check_fixed(void){
+    CidrSet cs;
+    cidr_init(&cs);
+    for(size_t i = 0; i < sizeof fixed_set / sizeof *fixed_set; i++){
+        const Entry *e = &fixed_set[i];
+        if(cidr_add(&cs, e->cidr, strlen(e->cidr), e->list) != 1){
+            printf("FAIL add %s\n", e->cidr); failures++;
+        }
+    }
+    for(size_t i = 0; i < sizeof refused / sizeof *refused; i++){
+        if(cidr_add(&cs, refused[i], strlen(refused[i]), CIDR_DENY) != 0){
+            printf("FAIL accepted \"%s\"\n", refused[i]); failures++;
+        }
+    }
+    /* one address or prefix per distinct masked prefix; /25 was added twice */
+    if(cs.count[0] != 9 || cs.count[1] != 6){
+        printf("FAIL count v4=%zu v6=%zu, want 9 and 6\n", cs.count[0], cs.count[1]); failures++;
+    }
+    for(size_t i = 0; i < sizeof fixed_probe / sizeof *fixed_probe; i++){
+        const Probe *p = &fixed_probe[i];
+        unsigned got = cidr_lookup(&cs, p->ip, strlen(p->ip));
+        if(got != p->want){
+            printf("FAIL lookup %s = %u, want %u\n", p->ip, got, p->want); failures++;
+        }
+    }
+    /* the empty set answers nothing, /0 included */
+    CidrSet empty;
+    cidr_init(&empty);
+    if(cidr_lookup(&empty, "1.2.3.4", 7) || cidr_lookup(&empty, "::1", 3)){
+        printf("FAIL lookup in an empty set\n"); failures++;
+    }
+    cidr_free(&empty);
+    cidr_free(&cs);
+}
+
+/* ---- random sets vs a linear scan ---- */
+
+typedef struct {
+    uint8_t a[16];          /* network address, host bits 0 */
+    unsigned plen, list;
+} Prefix;
+
+typedef struct {
+    Prefix *v;
+    size_t len;
+} List;
+
+static void mask_bytes(uint8_t *a, unsigned bytes, unsigned plen){
+    for(unsigned i = 0; i < bytes; i++){
+        unsigned keep = plen > i * 8 ? plen - i * 8 : 0;
+        if(keep < 8) a[i] = (uint8_t)(keep ? a[i] & (0xff00u >> keep) : 0);
+    }
+}
+
+static int in_prefix(const uint8_t *ip, const Prefix *p){
+    unsigned full = p->plen / 8, rest = p->plen % 8;
+    if(memcmp(ip, p->a, full) != 0) return 0;
+    if(!rest) return 1;
+    uint8_t m = (uint8_t)(0xff00u >> rest);
+    return (ip[full] & m) == p->a[full];
+}
+
+/* a duplicate prefix ORs its lists, as the trie does */
+static unsigned brute(const List *l, const uint8_t *ip){
+    int best = -1;
+    unsigned list = 0;
+    for(size_t i = 0; i < l->len; i++){
+        const Prefix *p = &l->v[i];
+        if(!in_prefix(ip, p) || (int)p->plen < best) continue;
+        if((int)p->plen > best){ best = (int)p->plen; list = 0; }
+        list |= p->list;
+    }
+    return list;
+}
+
+static void random_bytes(uint8_t *a, unsigned n){
+    for(unsigned i = 0; i < n; i++) a[i] = (uint8_t)rng();
+}
+
+/* short prefixes are rare, as in real lists */
+static unsigned random_plen(unsigned max){
+    unsigned r = below(100);
+    if(r < 2)  return below(max / 4 + 1);
+    if(r < 10) return max;
+    return max / 4 + below(max - max / 4 + 1);
+}
+
+static void to_text(int v6, const Prefix *p, int mapped, int bare, char *out, size_t cap){
+    char addr[INET6_ADDRSTRLEN];
+    inet_ntop(v6 ? AF_INET6 : AF_INET, p->a, addr, sizeof addr);
+    unsigned max = v6 ? 128 : 32;
+    if(mapped){
+        if(bare && p->plen == max) snprintf(out, cap, "::ffff:%s", addr);
+        else snprintf(out, cap, "::ffff:%s/%u", addr, 96 + p->plen);
+    }else if(bare && p->plen == max){
+        snprintf(out, cap, "%s", addr);
+    }else{
+        snprintf(out, cap, "%s/%u", addr, p->plen);
+    }
+}
+
+static void build(CidrSet *cs, List *l, int v6, size_t n){
+    unsigned bytes = v6 ? 16 : 4, max = v6 ? 128 : 32;
+    l->v = calloc(n + 1, sizeof *l->v);
+    if(!l->v){ perror("calloc"); exit(2); }
+    l->len = 0;
+    for(size_t i = 0; i < n; i++){
+        Prefix p = {{0}, 0, 0};
+        unsigned r = below(100);
+        if(i == 0){
+            p.plen = 0;                                  /* one /0 per family */
+        }else if(r < 5){
+            p = l->v[below((unsigned)l->len)];           /* same prefix again */
+        }else if(r < 38){
+            const Prefix *up = &l->v[below((unsigned)l->len)];  /* nested under an earlier one */
+            random_bytes(p.a, bytes);
+            memcpy(p.a, up->a, up->plen / 8);
+            if(up->plen % 8){
+                uint8_t m = (uint8_t)(0xff00u >> (up->plen % 8));
+                p.a[up->plen / 8] = (uint8_t)((up->a[up->plen / 8] & m) | (p.a[up->plen / 8] & ~m));
+            }
+            p.plen = up->plen == max ? max : up->plen + 1 + below(max - up->plen);
+        }else{
+            random_bytes(p.a, bytes);
+            p.plen = random_plen(max);
+        }
+        mask_bytes(p.a, bytes, p.plen);
+        p.list = below(2) ? CIDR_ALLOW : CIDR_DENY;
+
+        char text[80];
+        to_text(v6, &p, !v6 && below(10) == 0, below(2) != 0, text, sizeof text);
+        if(cidr_add(cs, text, strlen(text), p.list) != 1){
+            printf("FAIL add %s\n", text); failures++;
+            continue;
+        }
+        l->v[l->len++] = p;
+    }
+}
+
+/* an address in, or just past, a prefix of the list, or anywhere at all */
+static void random_query(const List *l, int v6, uint8_t *ip){
+    unsigned bytes = v6 ? 16 : 4;
+    random_bytes(ip, bytes);
+    if(below(4) == 0) return;
+    const Prefix *p = &l->v[below((unsigned)l->len)];
+    memcpy(ip, p->a, p->plen / 8);
+    if(p->plen % 8){
+        uint8_t m = (uint8_t)(0xff00u >> (p->plen % 8));
+        ip[p->plen / 8] = (uint8_t)((p->a[p->plen / 8] & m) | (ip[p->plen / 8] & ~m));
+    }
+    if(below(6) == 0) mask_bytes(ip, bytes, p->plen);   /* the network address itself */
+    if(p->plen && below(4) == 0){                    /* flip the prefix's last bit */
+        unsigned b = p->plen - 1;
+        ip[b / 8] ^= (uint8_t)(0x80u >> (b % 8));
+    }
+}
+
+static void check_random(int v6, size_t nprefix, size_t nquery){
+    CidrSet cs;
+    List l;
+    cidr_init(&cs);
+    build(&cs, &l, v6, nprefix);
+
+    size_t mism = 0;
+    for(size_t q = 0; q < nquery && mism < 10; q++){
+        uint8_t ip[16];
+        random_query(&l, v6, ip);
+        char addr[INET6_ADDRSTRLEN + 8], t[INET6_ADDRSTRLEN];
+        inet_ntop(v6 ? AF_INET6 : AF_INET, ip, t, sizeof t);
+        if(!v6 && below(5) == 0) snprintf(addr, sizeof addr, "::ffff:%s", t);
+        else snprintf(addr, sizeof addr, "%s", t);
+
+        unsigned want = brute(&l, ip), got = cidr_lookup(&cs, addr, strlen(addr));
+        if(got != want){
+            printf("FAIL %s: trie says %u, linear scan %u\n", addr, got, want);
+            mism++;
+        }
+    }
+    failures += (int)mism;
+    printf("%s: %zu prefixes (%zu distinct), %zu lookups, %zu wrong\n",
+           v6 ? "IPv6" : "IPv4", l.len, cs.count[v6], nquery, mism);
+    free(l.v);
+    cidr_free(&cs);
+}
+
+int main(int argc, char **argv){
+    size_t n4 = 20000, n6 = 5000, nq = 20000;
+    uint64_t seed = 1;
+    for(int i = 1; i < argc; i++){
+        if(strncmp(argv[i], "--v4=", 5) == 0) n4 = strtoul(argv[i] + 5, NULL, 10);
+        else if(strncmp(argv[i], "--v6=", 5) == 0) n6 = strtoul(argv[i] + 5, NULL, 10);
+        else if(strncmp(argv[i], "--queries=", 10) == 0) nq = strtoul(argv[i] + 10, NULL, 10);
+        else if(strncmp(argv[i], "--seed=", 7) == 0) seed = strtoull(argv[i] + 7, NULL, 10);
+        else { fprintf(stderr, "usage: %s [--v4=N] [--v6=N] [--queries=N] [--seed=S]\n", argv[0]); return 2; }
+    }
+    if(!n4 || !n6){ fprintf(stderr, "cidrcheck: --v4 and --v6 need at least one prefix\n"); return 2; }
+    rng_state = seed;
+
+    check_fixed();
+    printf("fixed cases: %d wrong\n", failures);
+    check_random(0, n4, nq);
+    check_random(1, n6, nq);
+    if(failures){ printf("cidrcheck: %d failures\n", failures); return 1; }
+    printf("cidrcheck: ok\n");
+    return 0;
+}
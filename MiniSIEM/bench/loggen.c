@@ -0,0 +1,189 @@
+/*
+ * loggen - deterministic synthetic log generator for the benchmarks.
+ *
+ *   loggen --format=auth|clf [--lines=N] [--ips=K] [--attack=R] [--seed=S] [-o FILE]
+ *
+ * auth: syslog auth.log (sshd failures/accepts, sudo, cron noise)
+ * clf:  Combined Log Format access log (SQLi/XSS/traversal probes vs normal traffic)
+ *
+ * K is the number of distinct client IPs (all unique, spread over the
+ * whole IPv4 space); a fraction R of the lines are attacks, coming from a
+ * small attacker subset (1% of K, at least one IP). The same arguments
+ * always produce the same bytes.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t rng_state;
+
+/* splitmix64: fast, tiny, and identical everywhere */
+static uint64_t rng(void){
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint32_t rng_below(uint32_t n){ return (uint32_t)(rng() % n); }
+static double rng_unit(void){ return (double)(rng() >> 11) / 9007199254740992.0; }
+
+/* bijection on 32 bits, so distinct indices give distinct addresses */
+static uint32_t scramble(uint32_t x){
+    x ^= x >> 16; x *= 0x7feb352du;
+    x ^= x >> 15; x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static void ip_of(uint32_t idx, char *buf, size_t sz){
+    uint32_t a = scramble(idx);
+    snprintf(buf, sz, "%u.%u.%u.%u", a >> 24, (a >> 16) & 255u, (a >> 8) & 255u, a & 255u);
+}
+
+#define PICK(arr) (arr[rng_below((uint32_t)(sizeof arr / sizeof arr[0]))])
+
+/* ---- auth.log ---- */
+
+static const char *const users[] = { "root", "admin", "ubuntu", "deploy", "alice", "bob", "git", "oracle", "test" };
+
+static void auth_line(FILE *out, const char *stamp, const char *ip, int attack){
+    unsigned pid = 1000 + rng_below(60000);
+    unsigned port = 1024 + rng_below(64000);
+    const char *u = PICK(users);
+    if(attack){
+        switch(rng_below(10)){
+        case 0:
+            fprintf(out, "%s web01 sshd[%u]: Invalid user %s from %s port %u\n", stamp, pid, u, ip, port);
+            break;
+        case 1:
+            fprintf(out, "%s web01 sudo: pam_unix(sudo:auth): authentication failure; logname=%s uid=1000 euid=0 tty=/dev/pts/0 ruser=%s rhost=  user=%s\n",
+                    stamp, u, u, u);
+            break;
+        case 2:
+            fprintf(out, "%s web01 sudo:      %s : user NOT in sudoers ; TTY=pts/1 ; PWD=/home/%s ; USER=root ; COMMAND=/bin/bash\n",
+                    stamp, u, u);
+            break;
+        case 3: case 4:
+            fprintf(out, "%s web01 sshd[%u]: Failed password for invalid user %s from %s port %u ssh2\n", stamp, pid, u, ip, port);
+            break;
+        default:
+            fprintf(out, "%s web01 sshd[%u]: Failed password for %s from %s port %u ssh2\n", stamp, pid, u, ip, port);
+        }
+        return;
+    }
+    switch(rng_below(8)){
+    case 0: case 1: case 2:
+        fprintf(out, "%s web01 sshd[%u]: Accepted publickey for %s from %s port %u ssh2: ED25519 SHA256:%016llx\n",
+                stamp, pid, u, ip, port, (unsigned long long)rng());
+        break;
+    case 3:
+        fprintf(out, "%s web01 sshd[%u]: Disconnected from user %s %s port %u\n", stamp, pid, u, ip, port);
+        break;
+    case 4:
+        fprintf(out, "%s web01 sudo:    %s : TTY=pts/0 ; PWD=/home/%s ; USER=root ; COMMAND=/usr/bin/systemctl status nginx\n",
+                stamp, u, u);
+        break;
+    default:
+        fprintf(out, "%s web01 CRON[%u]: pam_unix(cron:session): session opened for user root(uid=0) by (uid=0)\n", stamp, pid);
+    }
+}
+
+/* ---- Combined Log Format ---- */
+
+static const char *const good_paths[] = {
+    "/", "/index.html", "/about", "/static/app.js", "/static/site.css", "/img/logo.png",
+    "/api/v1/items?page=2", "/api/v1/items/4812", "/login", "/search?q=shoes", "/favicon.ico",
+};
+static const char *const bad_paths[] = {
+    "/index.php?id=1%27%20OR%20%271%27=%271", "/search?q=%3Cscript%3Ealert(1)%3C/script%3E",
+    "/admin/../../etc/passwd", "/products?id=1+UNION+SELECT+user,pass+FROM+users",
+    "/download?f=..%2f..%2f..%2fetc%2fshadow", "/wp-login.php", "/.env", "/cgi-bin/%2e%2e/%2e%2e/bin/sh",
+};
+static const char *const agents[] = {
+    "Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0",
+    "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/126.0 Safari/537.36",
+    "curl/8.5.0", "python-requests/2.31.0", "Googlebot/2.1 (+http://www.google.com/bot.html)",
+};
+
+static void clf_line(FILE *out, const char *stamp, const char *ip, int attack){
+    const char *path, *method = "GET";
+    int status;
+    if(attack){
+        static const int codes[] = { 400, 403, 404, 404, 500 };
+        path = PICK(bad_paths);
+        status = PICK(codes);
+    } else {
+        static const int codes[] = { 200, 200, 200, 200, 200, 200, 304, 301, 404 };
+        path = PICK(good_paths);
+        status = PICK(codes);
+        if(!strcmp(path, "/login") && rng_below(2)) method = "POST";
+    }
+    fprintf(out, "%s - - [%s] \"%s %s HTTP/1.1\" %d %u \"-\" \"%s\"\n",
+            ip, stamp, method, path, status, 100 + rng_below(50000), PICK(agents));
+}
+
+/* ---- main ---- */
+
+static void usage(const char *prog){
+    fprintf(stderr,
+      "Usage: %s --format=auth|clf [--lines=N] [--ips=K] [--attack=R] [--seed=S] [-o FILE]\n"
+      "  --lines=N   lines to write (default 1000000)\n"
+      "  --ips=K     distinct client IPs (default 10000)\n"
+      "  --attack=R  fraction of attack lines, 0..1 (default 0.05)\n"
+      "  --seed=S    PRNG seed (default 1)\n", prog);
+}
+
+int main(int argc, char **argv){
+    const char *format = NULL, *outpath = NULL;
+    unsigned long long lines = 1000000, seed = 1;
+    unsigned long ips = 10000;
+    double attack = 0.05;
+
+    for(int i = 1; i < argc; i++){
+        const char *a = argv[i];
+        if(!strncmp(a, "--format=", 9)) format = a + 9;
+        else if(!strncmp(a, "--lines=", 8)) lines = strtoull(a + 8, NULL, 10);
+        else if(!strncmp(a, "--ips=", 6)) ips = strtoul(a + 6, NULL, 10);
+        else if(!strncmp(a, "--attack=", 9)) attack = strtod(a + 9, NULL);
+        else if(!strncmp(a, "--seed=", 7)) seed = strtoull(a + 7, NULL, 10);
+        else if(!strcmp(a, "-o") && i + 1 < argc) outpath = argv[++i];
+        else { usage(argv[0]); return 2; }
+    }
+    int clf = format && !strcmp(format, "clf");
+    if(!format || (!clf && strcmp(format, "auth"))){ usage(argv[0]); return 2; }
+    if(ips < 1) ips = 1;
+    if(ips > 0xffffffffUL) ips = 0xffffffffUL;
+    if(attack < 0) attack = 0;
+    if(attack > 1) attack = 1;
+    uint32_t attackers = (uint32_t)(ips / 100 ? ips / 100 : 1);
+
+    FILE *out = outpath ? fopen(outpath, "w") : stdout;
+    if(!out){ perror(outpath); return 1; }
+    static char obuf[1 << 20];
+    setvbuf(out, obuf, _IOFBF, sizeof obuf);
+    rng_state = seed;
+
+    /* fixed start so output never depends on the wall clock */
+    time_t t = 1755129600;                    /* 2025-08-14 00:00:00 UTC */
+    time_t stamp_t = (time_t)-1;
+    char stamp[40], ip[16];
+    for(unsigned long long n = 0; n < lines; n++){
+        if(rng_below(8) == 0) t++;            /* ~8 lines per second */
+        if(t != stamp_t){
+            struct tm tm;
+            gmtime_r(&t, &tm);
+            strftime(stamp, sizeof stamp, clf ? "%d/%b/%Y:%H:%M:%S +0000" : "%b %e %H:%M:%S", &tm);
+            stamp_t = t;
+        }
+        int is_attack = rng_unit() < attack;
+        uint32_t who = is_attack ? rng_below(attackers) : rng_below((uint32_t)ips);
+        ip_of(who, ip, sizeof ip);
+        if(clf) clf_line(out, stamp, ip, is_attack);
+        else    auth_line(out, stamp, ip, is_attack);
+    }
+    if(fclose(out) != 0){ perror("write"); return 1; }
+    return 0;
+}
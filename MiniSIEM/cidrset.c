@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cidrset.h"
+#include "ingest.h"
+#include "ipindex.h"
+
+void cidr_init(CidrSet *cs){
+    memset(cs, 0, sizeof *cs);
+}
+
+void cidr_free(CidrSet *cs){
+    free(cs->nodes);
+    memset(cs, 0, sizeof *cs);
+}
+
+/* ---- 128-bit keys ---- */
+
+static unsigned bit_at(const uint32_t k[4], unsigned i){
+    return (k[i >> 5] >> (31 - (i & 31))) & 1u;
+}
+
+/* leading bits a and b have in common, at most lim */
+static unsigned common_bits(const uint32_t a[4], const uint32_t b[4], unsigned lim){
+    for(unsigned w = 0; w * 32 < lim; w++){
+        uint32_t x = a[w] ^ b[w];
+        if(x){
+            unsigned d = w * 32 + (unsigned)__builtin_clz(x);
+            return d < lim ? d : lim;
+        }
+    }
+    return lim;
+}
+
+static void mask_to(uint32_t k[4], unsigned plen){
+    for(unsigned w = 0; w < 4; w++){
+        unsigned keep = plen > w * 32 ? plen - w * 32 : 0;
+        if(keep < 32) k[w] = keep ? k[w] & ~(0xffffffffu >> keep) : 0;
+    }
+}
+
+/* Address text -> key. 0 = IPv4 (also ::ffff:a.b.c.d, *mapped set),
+   1 = IPv6, -1 = neither. */
+static int addr_parse(const char *s, size_t n, uint32_t k[4], int *mapped){
+    memset(k, 0, 4 * sizeof k[0]);
+    *mapped = 0;
+    if(ip4_parse(s, n, &k[0])) return 0;
+
+    char buf[INET6_ADDRSTRLEN];
+    unsigned char a[16];
+    if(!n || n >= sizeof buf || !memchr(s, ':', n)) return -1;
+    memcpy(buf, s, n);
+    buf[n] = '\0';
+    if(inet_pton(AF_INET6, buf, a) != 1) return -1;
+    for(unsigned w = 0; w < 4; w++)
+        k[w] = (uint32_t)a[4*w] << 24 | (uint32_t)a[4*w+1] << 16 | (uint32_t)a[4*w+2] << 8 | a[4*w+3];
+    if(!k[0] && !k[1] && k[2] == 0xffffu){       /* IPv4 client on a dual-stack socket */
+        k[0] = k[3];
+        k[2] = k[3] = 0;
+        *mapped = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/* ---- trie ---- */
+
+static uint32_t node_new(CidrSet *cs, const uint32_t k[4], unsigned plen, unsigned list){
+    CidrNode *nd = &cs->nodes[cs->len];
+    memset(nd, 0, sizeof *nd);
+    memcpy(nd->key, k, sizeof nd->key);
+    mask_to(nd->key, plen);
+    nd->plen = (uint8_t)plen;
+    nd->list = (uint8_t)list;
+    return (uint32_t)cs->len++;
+}
+
+static int insert(CidrSet *cs, int fam, const uint32_t k[4], unsigned plen, unsigned list){
+    /* an insert adds two nodes at most: reserve them up front so the
+       link pointer below (which may point into nodes[]) stays valid */
+    if(cs->len + 2 > cs->cap){
+        size_t cap = cs->cap ? cs->cap * 2 : 64;
+        CidrNode *nn = (CidrNode*)realloc(cs->nodes, cap * sizeof *nn);
+        if(!nn) return -1;
+        cs->nodes = nn;
+        cs->cap = cap;
+        if(!cs->len) cs->len = 1;
+    }
+
+    uint32_t *link = &cs->root[fam];
+    while(*link){
+        CidrNode *nd = &cs->nodes[*link];
+        unsigned d = common_bits(k, nd->key, plen < nd->plen ? plen : nd->plen);
+        if(d == nd->plen){
+            if(plen == nd->plen){                   /* same prefix again */
+                if(!nd->list) cs->count[fam]++;
+                nd->list = (uint8_t)(nd->list | list);
+                return 0;
+            }
+            link = &nd->child[bit_at(k, nd->plen)];
+            continue;
+        }
+        /* k leaves nd's path at bit d: it goes above nd, or beside it
+           under a new branch node of length d */
+        uint32_t old = *link;
+        unsigned ob = bit_at(nd->key, d);
+        if(d == plen){
+            uint32_t x = node_new(cs, k, plen, list);
+            cs->nodes[x].child[ob] = old;
+            *link = x;
+        } else {
+            uint32_t g = node_new(cs, k, d, 0);
+            uint32_t x = node_new(cs, k, plen, list);
+            cs->nodes[g].child[ob] = old;
+            cs->nodes[g].child[!ob] = x;
+            *link = g;
+        }
+        cs->count[fam]++;
+        return 0;
+    }
+    *link = node_new(cs, k, plen, list);
+    cs->count[fam]++;
+    return 0;
+}
+
+int cidr_add(CidrSet *cs, const char *s, size_t n, unsigned list){
+    const char *sl = (const char*)memchr(s, '/', n);
+    size_t an = sl ? (size_t)(sl - s) : n;
+    uint32_t k[4];
+    int mapped;
+    int fam = addr_parse(s, an, k, &mapped);
+    if(fam < 0) return 0;
+
+    unsigned max = fam ? 128 : 32, plen = mapped ? 128 : max;
+    if(sl){
+        const char *p = sl + 1, *end = s + n;
+        if(p == end || end - p > 3) return 0;
+        for(plen = 0; p < end; p++){
+            if(*p < '0' || *p > '9') return 0;
+            plen = plen * 10 + (unsigned)(*p - '0');
+        }
+    }
+    if(mapped){                                     /* ::ffff:0:0/96 is all of IPv4 */
+        if(plen < 96 || plen > 128) return 0;
+        plen -= 96;
+    }
+    if(plen > max) return 0;
+    return insert(cs, fam, k, plen, list) == 0 ? 1 : -1;
+}
+
+unsigned cidr_lookup(const CidrSet *cs, const char *ip, size_t n){
+    uint32_t k[4];
+    int mapped;
+    int fam = addr_parse(ip, n, k, &mapped);
+    if(fam < 0) return 0;
+    unsigned max = fam ? 128 : 32, best = 0;
+    for(uint32_t i = cs->root[fam]; i; ){
+        const CidrNode *nd = &cs->nodes[i];
+        if(common_bits(k, nd->key, nd->plen) < nd->plen) break;
+        if(nd->list) best = nd->list;
+        if(nd->plen >= max) break;
+        i = nd->child[bit_at(k, nd->plen)];
+    }
+    return best;
+}
+
+/* ---- list files ---- */
+
+static int is_space(char c){ return c == ' ' || c == '\t' || c == '\r'; }
+static int is_comment(char c){ return c == '#' || c == ';'; }
+
+long cidr_load(CidrSet *cs, const char *path, unsigned list){
+    LineReader lr;
+    if(lr_open(&lr, path) != 0){
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    const char *line;
+    size_t n;
+    long added = 0;
+    unsigned long lineno = 0;
+    int rc;
+    while((rc = lr_next(&lr, &line, &n)) > 0){
+        const char *p = line, *end = line + n;
+        lineno++;
+        while(p < end && is_space(*p)) p++;
+        const char *tok = p;
+        while(p < end && !is_space(*p) && !is_comment(*p)) p++;
+        size_t tn = (size_t)(p - tok);
+        while(p < end && is_space(*p)) p++;
+        if(!tn && (p == end || is_comment(*p))) continue;
+
+        int r = (p == end || is_comment(*p)) ? cidr_add(cs, tok, tn, list) : 0;
+        if(r < 0){
+            fprintf(stderr, "%s: out of memory\n", path);
+            added = -1;
+            break;
+        }
+        if(r == 0){
+            fprintf(stderr, "%s:%lu: not an address or CIDR: %.*s\n", path, lineno,
+                    (int)(n > 80 ? 80 : n), line);
+            added = -1;
+            break;
+        }
+        added++;
+    }
+    if(rc < 0 && added >= 0){
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        added = -1;
+    }
+    lr_close(&lr);
+    return added;
+}
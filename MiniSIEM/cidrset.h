@@ -0,0 +1,56 @@
+#ifndef CIDRSET_H
+#define CIDRSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Allow/deny prefix lists for the enforcer.
+ *
+ * A path-compressed binary (Patricia) trie per address family: every node
+ * holds the whole prefix it stands for, so a chain of single-child nodes
+ * never exists and a lookup visits at most one node per distinct prefix
+ * length on its path, comparing whole 32-bit words as it goes: O(prefix
+ * length), independent of how many prefixes are loaded. The answer is the
+ * longest matching prefix, so "allow 10.1.0.0/16" carves a hole out of
+ * "deny 10.0.0.0/8".
+ *
+ * IPv4 keys are 32 bits, IPv6 keys 128; an IPv4-mapped IPv6 address
+ * (::ffff:a.b.c.d) is looked up as the IPv4 address it carries. Nodes live
+ * in one array and link by index, so a set is two allocations at most and
+ * freeing it is O(1).
+ */
+
+#define CIDR_ALLOW 1u
+#define CIDR_DENY  2u
+
+typedef struct {
+    uint32_t key[4];        /* prefix, most significant word first; bits past plen are 0 */
+    uint32_t child[2];      /* node index, 0 = none; child[b] continues with bit plen == b */
+    uint8_t  plen;
+    uint8_t  list;          /* CIDR_* bits of exactly this prefix, 0 = branch point only */
+} CidrNode;
+
+typedef struct {
+    CidrNode *nodes;        /* nodes[0] unused, so index 0 can mean "none" */
+    size_t len, cap;
+    uint32_t root[2];       /* [0] IPv4, [1] IPv6 */
+    size_t count[2];        /* prefixes stored per family */
+} CidrSet;
+
+void cidr_init(CidrSet *cs);
+void cidr_free(CidrSet *cs);
+
+/* "addr" or "addr/len" (n bytes, need not be NUL-terminated), tagged with
+   `list`. The host bits are dropped. 1 = added, 0 = not a CIDR, -1 = OOM. */
+int cidr_add(CidrSet *cs, const char *s, size_t n, unsigned list);
+
+/* One prefix per line; '#' or ';' starts a comment, blank lines are skipped.
+   Returns the number of prefixes read, or -1 (reason on stderr). */
+long cidr_load(CidrSet *cs, const char *path, unsigned list);
+
+/* CIDR_* bits of the longest prefix containing ip, 0 when none does (or ip
+   isn't an address). */
+unsigned cidr_lookup(const CidrSet *cs, const char *ip, size_t n);
+
+#endif
@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libgen.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ingest.h"
+
+#define LR_CHUNK (64u * 1024u)
+
+const char *lr_find_nl(const char *p, const char *end){
+#if defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    while(end - p >= 32){
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(const void*)p), nl);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(const void*)(p + 16)), nl);
+        int m = _mm_movemask_epi8(_mm_or_si128(a, b));
+        if(m){
+            int ma = _mm_movemask_epi8(a);
+            if(ma) return p + __builtin_ctz((unsigned)ma);
+            return p + 16 + __builtin_ctz((unsigned)_mm_movemask_epi8(b));
+        }
+        p += 32;
+    }
+    if(end - p >= 16){
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(const void*)p), nl));
+        if(m) return p + __builtin_ctz((unsigned)m);
+        p += 16;
+    }
+#endif
+    for(; p < end; p++)
+        if(*p == '\n') return p;
+    return NULL;
+}
+
+int lr_open(LineReader *lr, const char *path){
+    memset(lr, 0, sizeof *lr);
+    lr->ifd = lr->wd_file = lr->wd_dir = -1;
+    if(!path || strcmp(path, "-") == 0){
+        lr->fd = STDIN_FILENO;
+    } else {
+        lr->fd = open(path, O_RDONLY | O_CLOEXEC);
+        if(lr->fd < 0) return -1;
+        lr->own_fd = 1;
+    }
+
+    struct stat st;
+    int regular = fstat(lr->fd, &st) == 0 && S_ISREG(st.st_mode);
+    if(regular){
+        lr->ino = (unsigned long long)st.st_ino;
+        lr->dev = (unsigned long long)st.st_dev;
+    }
+    if(regular && st.st_size > 0){
+        off_t here = lseek(lr->fd, 0, SEEK_CUR);
+        if(here < 0) here = 0;
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, lr->fd, 0);
+        if(m != MAP_FAILED){
+            (void)madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL);
+            lr->map = (const char*)m;
+            lr->map_len = (size_t)st.st_size;
+            lr->pos = here < st.st_size ? (size_t)here : lr->map_len;
+            return 0;
+        }
+    }
+    /* pipe, tty, or mmap refused: stream */
+    lr->buf_cap = LR_CHUNK;
+    lr->buf = (char*)malloc(lr->buf_cap);
+    if(!lr->buf){ lr_close(lr); errno = ENOMEM; return -1; }
+    return 0;
+}
+
+static int next_mapped(LineReader *lr, const char **line, size_t *len){
+    if(lr->pos >= lr->map_len) return 0;
+    const char *p = lr->map + lr->pos, *end = lr->map + lr->map_len;
+    const char *nl = lr_find_nl(p, end);
+    size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+    *line = p;
+    *len = n;
+    size_t used = n + (nl ? 1u : 0u);
+    lr->unterminated = !nl;
+    lr->pos += used;
+    lr->offset += used;
+    return 1;
+}
+
+/* Read more bytes into the streaming buffer; returns bytes read, 0 at EOF, -1 on error. */
+static ssize_t fill(LineReader *lr){
+    if(lr->beg > 0 && lr->beg == lr->end){
+        lr->beg = lr->end = 0;
+    } else if(lr->beg > 0 && lr->end == lr->buf_cap){
+        memmove(lr->buf, lr->buf + lr->beg, lr->end - lr->beg);
+        lr->end -= lr->beg;
+        lr->beg = 0;
+    }
+    if(lr->end == lr->buf_cap){
+        if(lr->buf_cap >= LR_MAX_LINE) return -2;   /* line too long */
+        size_t nc = lr->buf_cap * 2;
+        char *nb = (char*)realloc(lr->buf, nc);
+        if(!nb){ errno = ENOMEM; return -1; }
+        lr->buf = nb;
+        lr->buf_cap = nc;
+    }
+    for(;;){
+        ssize_t r = read(lr->fd, lr->buf + lr->end, lr->buf_cap - lr->end);
+        if(r < 0 && errno == EINTR && !lr->interruptible) continue;
+        if(r > 0) lr->end += (size_t)r;
+        return r;
+    }
+}
+
+static void stat_ids(LineReader *lr){
+    struct stat st;
+    if(fstat(lr->fd, &st) == 0){
+        lr->ino = (unsigned long long)st.st_ino;
+        lr->dev = (unsigned long long)st.st_dev;
+    }
+}
+
+static void watch_file(LineReader *lr){
+    if(lr->ifd < 0) return;
+    if(lr->wd_file >= 0) (void)inotify_rm_watch(lr->ifd, lr->wd_file);
+    lr->wd_file = inotify_add_watch(lr->ifd, lr->path, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+}
+
+/* Old file fully drained: move over to whatever now lives at lr->path.
+   Returns 1 if a new file was opened. */
+static int reopen_file(LineReader *lr){
+    int nfd = open(lr->path, O_RDONLY | O_CLOEXEC);
+    if(nfd < 0) return 0;            /* not recreated yet; keep waiting */
+    close(lr->fd);
+    lr->fd = nfd;
+    lr->reopen = 0;
+    lr->offset = 0;
+    lr->beg = lr->end = 0;           /* a torn last line of the old file is dropped */
+    stat_ids(lr);
+    watch_file(lr);
+    return 1;
+}
+
+static int next_streamed(LineReader *lr, const char **line, size_t *len){
+    size_t scanned = lr->beg;
+    int cut = 0;
+    for(;;){
+        const char *nl = lr_find_nl(lr->buf + scanned, lr->buf + lr->end);
+        if(nl){
+            *line = lr->buf + lr->beg;
+            *len = (size_t)(nl - *line);
+            lr->offset += *len + 1u;
+            lr->beg += *len + 1u;
+            lr->unterminated = 0;
+            return 1;
+        }
+        if(lr->eof) break;
+        size_t keep = lr->end - lr->beg;
+        ssize_t r = fill(lr);
+        scanned = lr->beg + keep;   /* fill() may have moved the data */
+        if(r == -2){ cut = 1; break; }
+        if(r < 0) return -1;
+        if(r == 0){
+            if(!lr->follow) lr->eof = 1;
+            else if(!lr->reopen || reopen_file(lr) != 1) return 0;   /* partial line waits */
+            scanned = lr->beg;
+        }
+    }
+    if(lr->beg == lr->end) return 0;
+    /* last line without '\n', or a piece of an over-long line */
+    lr->unterminated = !cut;
+    *line = lr->buf + lr->beg;
+    *len = lr->end - lr->beg;
+    lr->offset += *len;
+    lr->beg = lr->end;
+    return 1;
+}
+
+int lr_seek(LineReader *lr, unsigned long long off){
+    if(lr->map){
+        if(off > lr->map_len){ errno = EINVAL; return -1; }
+        lr->pos = (size_t)off;
+    } else {
+        struct stat st;
+        if(fstat(lr->fd, &st) != 0) return -1;
+        if(!S_ISREG(st.st_mode) || off > (unsigned long long)st.st_size){ errno = EINVAL; return -1; }
+        if(lseek(lr->fd, (off_t)off, SEEK_SET) < 0) return -1;
+        lr->beg = lr->end = 0;
+        lr->eof = 0;
+    }
+    lr->offset = off;
+    return 0;
+}
+
+int lr_next(LineReader *lr, const char **line, size_t *len){
+    return lr->map ? next_mapped(lr, line, len) : next_streamed(lr, line, len);
+}
+
+void lr_close(LineReader *lr){
+    if(lr->map) munmap((void*)(uintptr_t)lr->map, lr->map_len);
+    free(lr->buf);
+    if(lr->own_fd && lr->fd >= 0) close(lr->fd);
+    if(lr->ifd >= 0) close(lr->ifd);
+    free(lr->path);
+    memset(lr, 0, sizeof *lr);
+    lr->fd = lr->ifd = lr->wd_file = lr->wd_dir = -1;
+}
+
+int lr_open_follow(LineReader *lr, const char *path){
+    memset(lr, 0, sizeof *lr);
+    lr->ifd = lr->wd_file = lr->wd_dir = -1;
+    lr->interruptible = 1;
+    if(!path || strcmp(path, "-") == 0){
+        /* a pipe already blocks for more input; nothing to watch */
+        lr->fd = STDIN_FILENO;
+    } else {
+        lr->fd = open(path, O_RDONLY | O_CLOEXEC);
+        if(lr->fd < 0) return -1;
+        lr->own_fd = 1;
+        lr->follow = 1;
+        lr->path = strdup(path);
+        if(!lr->path){ lr_close(lr); errno = ENOMEM; return -1; }
+        stat_ids(lr);
+
+        lr->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(lr->ifd >= 0){
+            char *dcopy = strdup(path);
+            if(dcopy){
+                lr->wd_dir = inotify_add_watch(lr->ifd, dirname(dcopy), IN_CREATE | IN_MOVED_TO);
+                free(dcopy);
+            }
+            watch_file(lr);
+        }
+    }
+    lr->buf_cap = LR_CHUNK;
+    lr->buf = (char*)malloc(lr->buf_cap);
+    if(!lr->buf){ lr_close(lr); errno = ENOMEM; return -1; }
+    return 0;
+}
+
+/* Compare what we hold with what the path names now. */
+static void check_rotation(LineReader *lr){
+    struct stat st;
+    if(stat(lr->path, &st) == 0 &&
+       ((unsigned long long)st.st_ino != lr->ino || (unsigned long long)st.st_dev != lr->dev)){
+        lr->reopen = 1;              /* rotated: finish the old file first */
+        return;
+    }
+    struct stat cur;
+    if(fstat(lr->fd, &cur) == 0 && (unsigned long long)cur.st_size < lr->offset + (lr->end - lr->beg)){
+        /* truncated in place (copytruncate) */
+        (void)lseek(lr->fd, 0, SEEK_SET);
+        lr->offset = 0;
+        lr->beg = lr->end = 0;
+    }
+}
+
+int lr_wait(LineReader *lr, int timeout_ms){
+    if(!lr->follow){ errno = ENOTSUP; return -1; }
+    if(lr->reopen) return 1;
+
+    if(lr->ifd < 0){
+        /* no inotify: plain polling */
+        struct timespec ts = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+        if(timeout_ms < 0){ ts.tv_sec = 0; ts.tv_nsec = 250000000L; }
+        if(nanosleep(&ts, NULL) != 0) return -1;
+        check_rotation(lr);
+        return 1;
+    }
+
+    struct pollfd pfd = { .fd = lr->ifd, .events = POLLIN, .revents = 0 };
+    int r = poll(&pfd, 1, timeout_ms);
+    if(r < 0) return -1;
+    if(r == 0){
+        check_rotation(lr);
+        return lr->reopen ? 1 : 0;
+    }
+
+    char evbuf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while((n = read(lr->ifd, evbuf, sizeof evbuf)) > 0){
+        /* events only wake us up; the file itself is the source of truth */
+    }
+    check_rotation(lr);
+    return 1;
+}
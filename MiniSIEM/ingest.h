@@ -0,0 +1,64 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stddef.h>
+
+/*
+ * Line reader for the log analyzers.
+ *
+ * Regular files (including a regular file on stdin) are mmapped and split
+ * in place; pipes and terminals fall back to a buffered read() loop. Either
+ * way lines come back as pointer + length into the reader's memory, without
+ * the trailing '\n' and without a NUL terminator. A line stays valid until
+ * the next lr_next() call.
+ *
+ * There is no fixed line limit: the streaming buffer grows to fit the
+ * longest line, up to LR_MAX_LINE, past which a line is handed out in
+ * LR_MAX_LINE sized pieces.
+ */
+
+#define LR_MAX_LINE (64u * 1024u * 1024u)
+
+typedef struct {
+    int fd;
+    int own_fd;
+    /* follow mode (tail -F) */
+    int follow;
+    char *path;
+    int ifd, wd_file, wd_dir;
+    unsigned long long ino, dev; /* of the open file (regular files; follow mode tracks reopens) */
+    int reopen;                  /* rotation seen; switch files after draining */
+    int interruptible;           /* EINTR ends a blocking read instead of retrying */
+    /* mmap path */
+    const char *map;
+    size_t map_len, pos;
+    /* streaming path */
+    char *buf;
+    size_t buf_cap, beg, end;
+    int eof;
+    unsigned long long offset;   /* bytes consumed so far */
+    int unterminated;            /* the line lr_next() just returned ended at EOF, no '\n'
+                                    (an over-long line's pieces don't count) */
+} LineReader;
+
+/* path == NULL or "-" reads stdin. Returns 0, or -1 with errno set. */
+int lr_open(LineReader *lr, const char *path);
+/* Like lr_open() but never mmaps, keeps a trailing partial line until its
+   '\n' arrives, and tracks rotation/truncation of `path` for lr_wait(). */
+int lr_open_follow(LineReader *lr, const char *path);
+/* 1 = got a line, 0 = end of input (for now, in follow mode),
+   -1 = read error (errno set). */
+int lr_next(LineReader *lr, const char **line, size_t *len);
+/* Follow mode: block up to timeout_ms (-1 = forever) for the file to grow,
+   be rotated or truncated. Returns 1 when lr_next() is worth calling again,
+   0 on timeout, -1 on error/EINTR or when the reader is not following. */
+int lr_wait(LineReader *lr, int timeout_ms);
+/* Resume at byte `off` of a regular file, e.g. from a state checkpoint;
+   before the first lr_next(). Returns 0, or -1 (not seekable, past EOF). */
+int lr_seek(LineReader *lr, unsigned long long off);
+void lr_close(LineReader *lr);
+
+/* First '\n' in [p, end), or NULL. SSE2 when the compiler offers it. */
+const char *lr_find_nl(const char *p, const char *end);
+
+#endif
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ipindex.h"
+
+static void *ix_xrealloc(void *q, size_t n){
+    void *p = realloc(q, n);
+    if(!p){ perror("realloc"); exit(1); }
+    return p;
+}
+
+static size_t grow_cap(size_t cap, size_t need, size_t elem){
+    size_t nc = cap ? cap : 16;
+    while(nc < need){
+        if(nc > SIZE_MAX / 2 / elem){
+            fprintf(stderr, "cap overflow\n");
+            exit(1);
+        }
+        nc *= 2;
+    }
+    return nc;
+}
+
+int ip4_parse(const char *s, size_t n, uint32_t *out){
+    uint32_t v = 0;
+    size_t i = 0;
+    for(int oct = 0; oct < 4; oct++){
+        if(oct){
+            if(i >= n || s[i] != '.') return 0;
+            i++;
+        }
+        unsigned x = 0, digits = 0;
+        while(i < n && s[i] >= '0' && s[i] <= '9'){
+            x = x * 10u + (unsigned)(s[i] - '0');
+            if(++digits > 3 || x > 255u) return 0;
+            i++;
+        }
+        if(!digits) return 0;
+        v = (v << 8) | x;
+    }
+    if(i != n) return 0;
+    *out = v;
+    return 1;
+}
+
+/* murmur3 finalizer for packed v4, FNV-1a for the rest */
+static uint32_t hash_v4(uint32_t x){
+    x ^= x >> 16; x *= 0x85ebca6bu;
+    x ^= x >> 13; x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t hash_str(const char *s, size_t n){
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < n; i++){
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return hash_v4(h);
+}
+
+void ipidx_init(IPIndex *ix, size_t val_size){
+    memset(ix, 0, sizeof *ix);
+    ix->val_size = val_size;
+}
+
+void ipidx_free(IPIndex *ix){
+    if(!ix) return;
+    free(ix->keys);
+    free(ix->vals);
+    free(ix->slots);
+    free(ix->arena);
+    size_t vs = ix->val_size;
+    memset(ix, 0, sizeof *ix);
+    ix->val_size = vs;
+}
+
+static int key_eq(const IPIndex *ix, const IPKey *k, int is_str, uint32_t v4,
+                  const char *s, size_t n){
+    if(k->is_str != is_str) return 0;
+    if(!is_str) return k->v4 == v4;
+    return k->slen == n && memcmp(ix->arena + k->soff, s, n) == 0;
+}
+
+static void rehash(IPIndex *ix, size_t nslots){
+    IPSlot *ns = (IPSlot*)calloc(nslots, sizeof *ns);
+    if(!ns){ perror("calloc"); exit(1); }
+    size_t mask = nslots - 1;
+    for(size_t i = 0; i < ix->nslots; i++){
+        if(!ix->slots[i].id1) continue;
+        size_t j = ix->slots[i].hash & mask;
+        while(ns[j].id1) j = (j + 1) & mask;
+        ns[j] = ix->slots[i];
+    }
+    free(ix->slots);
+    ix->slots = ns;
+    ix->nslots = nslots;
+}
+
+/* Returns slot position; sets *found when the key is already present. */
+static size_t probe(const IPIndex *ix, uint32_t h, int is_str, uint32_t v4,
+                    const char *s, size_t n, int *found){
+    size_t mask = ix->nslots - 1;
+    size_t j = h & mask;
+    while(ix->slots[j].id1){
+        const IPSlot *sl = &ix->slots[j];
+        if(sl->hash == h && key_eq(ix, &ix->keys[sl->id1 - 1], is_str, v4, s, n)){
+            *found = 1;
+            return j;
+        }
+        j = (j + 1) & mask;
+    }
+    *found = 0;
+    return j;
+}
+
+static uint32_t key_hash(const char *ip, size_t n, int *is_str, uint32_t *v4){
+    *is_str = !ip4_parse(ip, n, v4);
+    return *is_str ? hash_str(ip, n) : hash_v4(*v4);
+}
+
+void *ipidx_find(const IPIndex *ix, const char *ip, size_t n){
+    if(!ix->nslots) return NULL;
+    int is_str, found;
+    uint32_t v4 = 0;
+    uint32_t h = key_hash(ip, n, &is_str, &v4);
+    size_t j = probe(ix, h, is_str, v4, ip, n, &found);
+    return found ? ipidx_val(ix, ix->slots[j].id1 - 1) : NULL;
+}
+
+void *ipidx_get(IPIndex *ix, const char *ip, size_t n, int *is_new){
+    if(is_new) *is_new = 0;
+    if(n > UINT16_MAX) n = UINT16_MAX;
+    if((ix->len + 1) * 2 > ix->nslots) rehash(ix, ix->nslots ? ix->nslots * 2 : 64);
+
+    int is_str, found;
+    uint32_t v4 = 0;
+    uint32_t h = key_hash(ip, n, &is_str, &v4);
+    size_t j = probe(ix, h, is_str, v4, ip, n, &found);
+    if(found) return ipidx_val(ix, ix->slots[j].id1 - 1);
+
+    if(ix->len >= UINT32_MAX - 1){
+        fprintf(stderr, "ip index full\n");
+        exit(1);
+    }
+    if(ix->len + 1 > ix->cap){
+        size_t nc = grow_cap(ix->cap, ix->len + 1, ix->val_size > sizeof(IPKey) ? ix->val_size : sizeof(IPKey));
+        ix->keys = (IPKey*)ix_xrealloc(ix->keys, nc * sizeof(IPKey));
+        ix->vals = (unsigned char*)ix_xrealloc(ix->vals, nc * ix->val_size);
+        ix->cap = nc;
+    }
+
+    IPKey *k = &ix->keys[ix->len];
+    memset(k, 0, sizeof *k);
+    k->is_str = (uint8_t)is_str;
+    if(is_str){
+        if(ix->arena_len + n > UINT32_MAX){
+            fprintf(stderr, "ip arena full\n");
+            exit(1);
+        }
+        if(ix->arena_len + n > ix->arena_cap){
+            ix->arena_cap = grow_cap(ix->arena_cap, ix->arena_len + n, 1);
+            ix->arena = (char*)ix_xrealloc(ix->arena, ix->arena_cap);
+        }
+        memcpy(ix->arena + ix->arena_len, ip, n);
+        k->soff = (uint32_t)ix->arena_len;
+        k->slen = (uint16_t)n;
+        ix->arena_len += n;
+    } else {
+        k->v4 = v4;
+    }
+
+    ix->len++;
+    ix->slots[j].hash = h;
+    ix->slots[j].id1 = (uint32_t)ix->len;
+
+    void *v = ipidx_val(ix, ix->len - 1);
+    memset(v, 0, ix->val_size);
+    if(is_new) *is_new = 1;
+    return v;
+}
+
+const char *ipidx_key(const IPIndex *ix, size_t i, char *buf, size_t bufsz){
+    if(!bufsz) return buf;
+    const IPKey *k = &ix->keys[i];
+    if(k->is_str){
+        size_t n = k->slen < bufsz - 1 ? k->slen : bufsz - 1;
+        memcpy(buf, ix->arena + k->soff, n);
+        buf[n] = '\0';
+    } else {
+        snprintf(buf, bufsz, "%u.%u.%u.%u",
+                 (k->v4 >> 24) & 255u, (k->v4 >> 16) & 255u,
+                 (k->v4 >> 8) & 255u, k->v4 & 255u);
+    }
+    return buf;
+}
+
+void ipidx_compact(IPIndex *ix, int (*keep)(const void *val, void *ud), void *ud){
+    char *arena = NULL;
+    size_t alen = 0;
+    if(ix->arena_len){
+        arena = (char*)malloc(ix->arena_len);
+        if(!arena){ perror("malloc"); exit(1); }
+    }
+    size_t j = 0;
+    for(size_t i = 0; i < ix->len; i++){
+        if(!keep(ipidx_val(ix, i), ud)) continue;
+        IPKey k = ix->keys[i];
+        if(k.is_str){
+            memcpy(arena + alen, ix->arena + k.soff, k.slen);
+            k.soff = (uint32_t)alen;
+            alen += k.slen;
+        }
+        ix->keys[j] = k;
+        if(j != i) memcpy(ipidx_val(ix, j), ipidx_val(ix, i), ix->val_size);
+        j++;
+    }
+    free(ix->arena);
+    ix->arena = arena;
+    ix->arena_len = ix->arena_cap = alen;
+    if(!alen){ free(arena); ix->arena = NULL; }
+    ix->len = j;
+
+    memset(ix->slots, 0, ix->nslots * sizeof *ix->slots);
+    size_t mask = ix->nslots - 1;
+    for(size_t i = 0; i < ix->len; i++){
+        const IPKey *k = &ix->keys[i];
+        uint32_t h = k->is_str ? hash_str(ix->arena + k->soff, k->slen) : hash_v4(k->v4);
+        size_t p = h & mask;
+        while(ix->slots[p].id1) p = (p + 1) & mask;
+        ix->slots[p].hash = h;
+        ix->slots[p].id1 = (uint32_t)(i + 1);
+    }
+}
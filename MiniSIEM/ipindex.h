@@ -0,0 +1,65 @@
+#ifndef IPINDEX_H
+#define IPINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Insertion-ordered IP index shared by the log analyzers.
+ *
+ * Dotted-quad IPv4 keys are packed into a uint32_t; anything else
+ * (IPv6 text, hostnames) is copied once into a string arena. Every key
+ * owns a fixed-size value slot of `val_size` bytes which is zeroed on
+ * first sight. Lookups go through an open-addressing (linear probing)
+ * table, so ingest cost stays O(1) per line no matter how many IPs show up.
+ *
+ * Entries stay dense and in first-seen order: `for(i < ix.len)` walks
+ * them the same way the old Vec did. Value pointers are invalidated by
+ * the next insertion.
+ */
+
+typedef struct {
+    uint32_t v4;      /* packed address, host order (is_str == 0) */
+    uint32_t soff;    /* arena offset (is_str == 1) */
+    uint16_t slen;
+    uint8_t  is_str;
+} IPKey;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t id1;     /* entry index + 1, 0 = empty slot */
+} IPSlot;
+
+typedef struct {
+    IPKey *keys;
+    unsigned char *vals;
+    size_t len, cap, val_size;
+    IPSlot *slots;
+    size_t nslots;    /* power of two */
+    char *arena;
+    size_t arena_len, arena_cap;
+} IPIndex;
+
+void ipidx_init(IPIndex *ix, size_t val_size);
+void ipidx_free(IPIndex *ix);
+
+/* Look up `ip` (n bytes, need not be NUL-terminated); insert if missing. */
+void *ipidx_get(IPIndex *ix, const char *ip, size_t n, int *is_new);
+/* Lookup only; NULL when the key was never seen. */
+void *ipidx_find(const IPIndex *ix, const char *ip, size_t n);
+
+static inline void *ipidx_val(const IPIndex *ix, size_t i){
+    return ix->vals + i * ix->val_size;
+}
+
+/* Drop every entry for which keep(value, ud) returns 0. Survivors keep
+   their relative order but get new indices; the arena is repacked. O(len). */
+void ipidx_compact(IPIndex *ix, int (*keep)(const void *val, void *ud), void *ud);
+
+/* Render key i into buf (always NUL-terminated); returns buf. */
+const char *ipidx_key(const IPIndex *ix, size_t i, char *buf, size_t bufsz);
+
+/* Strict dotted-quad parser: 4 decimal octets, nothing else. Returns 1 on success. */
+int ip4_parse(const char *s, size_t n, uint32_t *out);
+
+#endif
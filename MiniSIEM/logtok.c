@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "logtok.h"
+
+static int is_sp(char c){ return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f'; }
+static int is_digit(char c){ return c >= '0' && c <= '9'; }
+
+/* cursor over [p, end) */
+typedef struct { const char *p, *end; } Cur;
+
+static void skip_sp(Cur *c){ while(c->p < c->end && is_sp(*c->p)) c->p++; }
+
+/* run of non-space bytes */
+static strview take_token(Cur *c){
+    strview v = { c->p, 0 };
+    while(c->p < c->end && !is_sp(*c->p)) c->p++;
+    v.n = (size_t)(c->p - v.p);
+    return v;
+}
+
+/* bytes up to (not including) `stop`; the cursor ends on `stop` or at end */
+static strview take_until(Cur *c, char stop){
+    strview v = { c->p, 0 };
+    const char *s = memchr(c->p, stop, (size_t)(c->end - c->p));
+    c->p = s ? s : c->end;
+    v.n = (size_t)(c->p - v.p);
+    return v;
+}
+
+/* body of a "..." field starting at the opening quote; Apache writes \" inside */
+static strview take_quoted(Cur *c){
+    c->p++;                                  /* opening quote */
+    strview v = { c->p, 0 };
+    while(c->p < c->end && *c->p != '"'){
+        if(*c->p == '\\' && c->p + 1 < c->end) c->p++;
+        c->p++;
+    }
+    v.n = (size_t)(c->p - v.p);
+    if(c->p < c->end) c->p++;                /* closing quote */
+    return v;
+}
+
+/* ---- Common / Combined Log Format ---- */
+
+static void split_request(strview r, ClfLine *out){
+    Cur c = { r.p, r.p + r.n };
+    out->method = take_token(&c);
+    skip_sp(&c);
+    out->path = take_token(&c);
+    skip_sp(&c);
+    out->proto = take_token(&c);
+}
+
+int clf_parse(const char *line, size_t n, ClfLine *out){
+    memset(out, 0, sizeof *out);
+    out->status = -1;
+    Cur c = { line, line + n };
+
+    skip_sp(&c);
+    out->host = take_token(&c);
+    if(!out->host.n) return 0;
+    skip_sp(&c);
+
+    /* ident and user, unless the log skipped straight to [time] or "request" */
+    if(c.p < c.end && *c.p != '[' && *c.p != '"'){ out->ident = take_token(&c); skip_sp(&c); }
+    if(c.p < c.end && *c.p != '[' && *c.p != '"'){ out->user = take_token(&c); skip_sp(&c); }
+    if(c.p < c.end && *c.p == '['){
+        c.p++;
+        out->time = take_until(&c, ']');
+        if(c.p < c.end) c.p++;
+    }
+
+    /* loose: the request is the next quoted field, wherever it starts */
+    (void)take_until(&c, '"');
+    if(c.p >= c.end) return 1;
+    split_request(take_quoted(&c), out);
+
+    skip_sp(&c);
+    const char *d = c.p;
+    int v = 0;
+    while(c.p < c.end && is_digit(*c.p) && c.p - d < 3) v = v * 10 + (*c.p++ - '0');
+    if(c.p > d && (c.p == c.end || is_sp(*c.p))) out->status = v;
+    else c.p = d;
+    (void)take_token(&c);                     /* rest of a bad status */
+    skip_sp(&c);
+    out->bytes = take_token(&c);
+
+    skip_sp(&c);
+    if(c.p < c.end && *c.p == '"') out->referer = take_quoted(&c);
+    skip_sp(&c);
+    if(c.p < c.end && *c.p == '"') out->agent = take_quoted(&c);
+    return 1;
+}
+
+/* ---- syslog ---- */
+
+static int is_month(strview t){
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if(t.n != 3) return 0;
+    for(int k = 0; k < 12; k++)
+        if(memcmp(t.p, months + 3 * k, 3) == 0) return 1;
+    return 0;
+}
+
+int syslog_parse(const char *line, size_t n, SyslogLine *out){
+    memset(out, 0, sizeof *out);
+    Cur c = { line, line + n };
+
+    if(n && is_digit(line[0])){
+        out->stamp = take_token(&c);          /* ISO 8601 */
+        if(out->stamp.n < 19 || out->stamp.p[4] != '-' || out->stamp.p[13] != ':') return 0;
+    } else {
+        /* "Mmm dd HH:MM:SS", day may be space-padded */
+        strview mon = take_token(&c);
+        skip_sp(&c);
+        strview day = take_token(&c);
+        skip_sp(&c);
+        strview tod = take_token(&c);
+        if(!is_month(mon) || !day.n || tod.n < 8 || tod.p[2] != ':') return 0;
+        out->stamp.p = line;
+        out->stamp.n = (size_t)(c.p - line);
+    }
+    skip_sp(&c);
+    out->host = take_token(&c);
+    skip_sp(&c);
+
+    out->tag.p = c.p;
+    while(c.p < c.end && *c.p != '[' && *c.p != ':' && !is_sp(*c.p)) c.p++;
+    out->tag.n = (size_t)(c.p - out->tag.p);
+    if(c.p < c.end && *c.p == '['){
+        c.p++;
+        out->pid = take_until(&c, ']');
+        if(c.p < c.end) c.p++;
+    }
+    if(c.p < c.end && *c.p == ':') c.p++;
+    if(c.p < c.end && *c.p == ' ') c.p++;
+    out->msg.p = c.p;
+    out->msg.n = (size_t)(c.end - c.p);
+    return out->host.n && out->tag.n;
+}
+
+/* ---- auth message source address ---- */
+
+/* a dotted quad (a ":port" suffix is dropped), or an IPv6 literal: hex
+   digits, '.' and at least two ':' */
+static int ipish(const char *p, const char *end, strview *ip){
+    const char *s = p, *colon = NULL;
+    int colons = 0, hex = 0;
+    for(; p < end; p++){
+        char c = (char)(*p | 0x20);
+        if(*p == ':'){ if(!colons++) colon = p; }
+        else if(c >= 'a' && c <= 'f') hex = 1;
+        else if(!is_digit(*p) && *p != '.') break;
+    }
+    if(colons == 1) p = colon;
+    if(colons < 2 && hex) return 0;
+    size_t n = (size_t)(p - s);
+    if(n == 0 || n > LT_IP_MAX) return 0;
+    ip->p = s;
+    ip->n = n;
+    return 1;
+}
+
+int log_find_ip(const char *line, size_t n, strview *ip){
+    SyslogLine sl;
+    if(syslog_parse(line, n, &sl)){ line = sl.msg.p; n = sl.msg.n; }
+    const char *end = line + n;
+    const char *p = memmem(line, n, "from ", 5);
+    if(p) p += 5;
+    else if((p = memmem(line, n, "rhost=", 6)) != NULL) p += 6;
+    else return 0;
+    if(ipish(p, end, ip)) return 1;
+
+    const char *last = memrchr(line, ' ', n);
+    if(!last || last + 1 >= end) return 0;
+    return ipish(last + 1, end, ip);
+}
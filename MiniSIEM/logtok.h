@@ -0,0 +1,66 @@
+#ifndef LOGTOK_H
+#define LOGTOK_H
+
+#include <stddef.h>
+
+/*
+ * Zero-copy tokenizer for the log formats the analyzers read.
+ *
+ * Every field comes back as a strview into the caller's line: nothing is
+ * copied, nothing is allocated, and the line does not need a NUL
+ * terminator. Each parser walks the line once, front to back. Fields that
+ * are missing come back empty (n == 0); the parsers are loose on purpose
+ * and never reject a line outright.
+ */
+
+typedef struct {
+    const char *p;
+    size_t n;
+} strview;
+
+/* Longest IP-ish token we treat as an address (matches the old 64-byte buffers). */
+#define LT_IP_MAX 63
+
+/*
+ * Common / Combined Log Format:
+ *   host ident user [time] "METHOD PATH PROTO" status bytes ["referer" "agent"]
+ */
+typedef struct {
+    strview host;             /* first token: client IP */
+    strview ident, user;
+    strview time;             /* inside [ ] */
+    strview method, path, proto;
+    int     status;           /* -1 when absent/unparsable */
+    strview bytes;
+    strview referer, agent;   /* combined format only */
+} ClfLine;
+
+/* Returns 1 when a host token was found (the rest is best-effort). */
+int clf_parse(const char *line, size_t n, ClfLine *out);
+
+/*
+ * BSD syslog as written by rsyslog / journalctl -o short[-iso]:
+ *   STAMP host tag[pid]: message
+ * STAMP is "Mmm dd HH:MM:SS" or a single ISO 8601 token.
+ */
+typedef struct {
+    strview stamp;
+    strview host;
+    strview tag;              /* program name, e.g. "sshd" */
+    strview pid;              /* inside [ ], may be empty */
+    strview msg;
+} SyslogLine;
+
+/* Returns 1 when a valid stamp, a host and a tag were all found. */
+int syslog_parse(const char *line, size_t n, SyslogLine *out);
+
+/*
+ * Source address of an auth message: the dotted quad or IPv6 literal after
+ * "from " or "rhost=", else the last space-separated token. A syslog
+ * header, when there is one, is skipped first so the hostname and tag
+ * can't be mistaken for part of the message.
+ * Returns 1 and sets *ip on success.
+ */
+int log_find_ip(const char *line, size_t n, strview *ip);
+
+#endif
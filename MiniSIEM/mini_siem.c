@@ -1,137 +1,76 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdint.h>   // for SIZE_MAX
 
-typedef struct { char *ip; unsigned fails; } IPFail;
-typedef struct { IPFail *data; size_t len, cap; } Vec;
-
-static void *xmalloc(size_t n){
-    void *p = malloc(n);
-    if(!p){ perror("malloc"); exit(1); }
-    return p;
-}
-
-static void *xrealloc(void *q, size_t n){
-    void *p = realloc(q, n);
-    if(!p){ perror("realloc"); exit(1); }
-    return p;
-}
-
-static char *xstrdup(const char *s){
-    size_t n = strlen(s) + 1;
-    char *p = (char*)xmalloc(n);
-    memcpy(p, s, n);
-    return p;
-}
-
-static void vec_reserve(Vec *v, size_t need){
-    if(need <= v->cap) return;
-    size_t nc = v->cap ? v->cap * 2 : 16;
-    while(nc < need){
-        if(nc > SIZE_MAX/2){
-            fprintf(stderr, "cap overflow\n");
-            exit(1);
-        }
-        nc *= 2;
-    }
-    v->data = (IPFail*)xrealloc(v->data, nc * sizeof(IPFail));
-    v->cap = nc;
-}
-
-static ssize_t vec_find_ip(Vec *v, const char *ip){
-    for(size_t i = 0; i < v->len; i++)
-        if(strcmp(v->data[i].ip, ip) == 0)
-            return (ssize_t)i;
-    return -1;
-}
-
-static void bump_ip(Vec *v, const char *ip){
-    ssize_t i = vec_find_ip(v, ip);
-    if(i < 0){
-        vec_reserve(v, v->len + 1);
-        v->data[v->len].ip = xstrdup(ip);
-        v->data[v->len].fails = 1u;
-        v->len++;
-    } else {
-        v->data[(size_t)i].fails++;
-    }
+#include "ipindex.h"
+#include "ingest.h"
+#include "acmatch.h"
+#include "logtok.h"
+
+/* signature categories; one automaton pass per line yields all of them */
+enum {
+    SIG_SSHD       = 1u << 0,
+    SIG_SUDO       = 1u << 1,
+    SIG_FAILED_PW  = 1u << 2,
+    SIG_INVALID    = 1u << 3,
+    SIG_AUTH_FAIL  = 1u << 4,
+    SIG_NOT_SUDOER = 1u << 5,
+};
+
+static void build_signatures(ACMatcher *ac){
+    static const struct { const char *pat; uint64_t mask; } sigs[] = {
+        { "sshd",                   SIG_SSHD },
+        { "sudo",                   SIG_SUDO },
+        { "Failed password",        SIG_FAILED_PW },
+        { "Invalid user",           SIG_INVALID },
+        { "authentication failure", SIG_AUTH_FAIL },
+        { "NOT in sudoers",         SIG_NOT_SUDOER },
+    };
+    ac_init(ac, 0);
+    for(size_t i = 0; i < sizeof sigs / sizeof sigs[0]; i++)
+        ac_add(ac, sigs[i].pat, strlen(sigs[i].pat), sigs[i].mask);
+    ac_compile(ac);
 }
 
-static void vec_free(Vec *v){
-    if(!v) return;
-    for(size_t i = 0; i < v->len; i++)
-        free(v->data[i].ip);
-    free(v->data);
-    v->data = NULL;
-    v->len = v->cap = 0;
-}
-
-static int extract_ip(const char *line, char *out, size_t outsz){
-    const char *p = strstr(line, "from ");
-    if(!p) p = strstr(line, "rhost=");
-    if(!p) return 0;
-
-    p += (p[0] == 'r') ? 6 : 5; 
-    size_t i = 0;
-
-    while(p[i] && (isdigit((unsigned char)p[i]) || p[i] == '.')){
-        if(i+1 >= outsz) {
-            return 0;
-        }
-        out[i] = p[i];
-        i++;
-    }
-
-    if(i == 0){
-        const char *last = strrchr(line, ' ');
-        if(!last || !last[1]) return 0;
-        last++;
-        size_t j = 0;
-        while(last[j] && (isdigit((unsigned char)last[j]) || last[j] == '.')){
-            if(j+1 >= outsz) {
-                return 0;
-            }
-            out[j] = last[j];
-            j++;
-        }
-        if(j == 0) {
-            return 0;
-        }
-        out[j] = '\0';
-        return 1;
-    }
-    out[i] = '\0';
-    return 1;
-}
 
 int main(int argc, char **argv){
     const unsigned BRUTE_THRESHOLD = 5; // adjust if you want
-    FILE *fp = (argc >= 2) ? fopen(argv[1], "r") : stdin;
-    if(!fp){
-        perror("fopen");
+    LineReader lr;
+    if(lr_open(&lr, (argc >= 2) ? argv[1] : NULL) != 0){
+        perror("open");
         return 1;
     }
 
-    Vec ssh_fails = {0};
+    ACMatcher sigs;
+    build_signatures(&sigs);
+    IPIndex ssh_fails;
+    ipidx_init(&ssh_fails, sizeof(unsigned));
     unsigned long total = 0, ssh_fail_lines = 0, sudo_fail = 0, sudo_notin = 0;
-    char line[4096];
+    const char *line;
+    size_t n;
+    int rc;
 
-    while(fgets(line, (int)sizeof line, fp)){
+    while((rc = lr_next(&lr, &line, &n)) > 0){
         total++;
-        int is_sshd = strstr(line, "sshd") != NULL;
-        int is_sudo = strstr(line, "sudo") != NULL;
+        uint64_t m = ac_scan(&sigs, line, n);
+        int is_sshd = (m & SIG_SSHD) != 0;
+        int is_sudo = (m & SIG_SUDO) != 0;
 
-        if(is_sshd && (strstr(line, "Failed password") || strstr(line, "Invalid user"))){
+        if(is_sshd && (m & (SIG_FAILED_PW | SIG_INVALID))){
             ssh_fail_lines++;
-            char ip[64] = {0};
-            if(extract_ip(line, ip, sizeof ip)) bump_ip(&ssh_fails, ip);
+            strview ip;
+            if(log_find_ip(line, n, &ip)){
+                unsigned *fails = (unsigned*)ipidx_get(&ssh_fails, ip.p, ip.n, NULL);
+                (*fails)++;
+            }
         }
-        if(is_sudo && strstr(line, "authentication failure")) sudo_fail++;
-        if(is_sudo && (strstr(line, "NOT in sudoers") || strstr(line, "user NOT in sudoers"))) sudo_notin++;
+        if(is_sudo && (m & SIG_AUTH_FAIL)) sudo_fail++;
+        if(is_sudo && (m & SIG_NOT_SUDOER)) sudo_notin++;
     }
-    if(fp != stdin) fclose(fp);
+    if(rc < 0) perror("read");
+    lr_close(&lr);
 
     printf("\n== Mini SIEM (real logs) ==\n");
     printf("Total lines: %lu\n", total);
@@ -142,8 +81,10 @@ int main(int argc, char **argv){
     if(ssh_fail_lines){
         printf("\n-- SSH brute-force suspects (>= %u fails) --\n", BRUTE_THRESHOLD);
         for(size_t i = 0; i < ssh_fails.len; i++){
-            if(ssh_fails.data[i].fails >= BRUTE_THRESHOLD){
-                printf("ALERT: %s has %u failed SSH attempts\n", ssh_fails.data[i].ip, ssh_fails.data[i].fails);
+            unsigned fails = *(unsigned*)ipidx_val(&ssh_fails, i);
+            if(fails >= BRUTE_THRESHOLD){
+                char ip[64];
+                printf("ALERT: %s has %u failed SSH attempts\n", ipidx_key(&ssh_fails, i, ip, sizeof ip), fails);
                 printf("  Remediation: fail2ban (sshd), key-only auth, disable root SSH, firewall allowlist.\n");
             }
         }
@@ -159,6 +100,7 @@ int main(int argc, char **argv){
         if(sudo_fail)   printf("- Review sudo password policy; investigate repeated failures.\n");
         if(sudo_notin)  printf("- Investigate users attempting sudo without authorization.\n");
     }
-    vec_free(&ssh_fails);
+    ipidx_free(&ssh_fails);
+    ac_free(&sigs);
     return 0;
 }
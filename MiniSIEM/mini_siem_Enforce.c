@@ -1,213 +1,425 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
 #include <stdint.h>   // for SIZE_MAX
 
-typedef struct { char *ip; unsigned fails; } IPFail;
-typedef struct { IPFail *data; size_t len, cap; } Vec;
+#include "ipindex.h"
+#include "ingest.h"
+#include "acmatch.h"
+#include "logtok.h"
+#include "ratewin.h"
+#include "nftban.h"
+#include "snapshot.h"
+#include "cidrset.h"
 
-static void *xmalloc(size_t n){
-    void *p = malloc(n);
-    if(!p){ perror("malloc"); exit(1); }
-    return p;
-}
+/* signature categories; one automaton pass per line yields all of them */
+enum {
+    SIG_SSHD       = 1u<<0,
+    SIG_SUDO       = 1u<<1,
+    SIG_FAILED_PW  = 1u<<2,
+    SIG_INVALID    = 1u<<3,
+    SIG_AUTH_FAIL  = 1u<<4,
+    SIG_NOT_SUDOER = 1u<<5,
+};
 
-static void *xrealloc(void *q, size_t n){
-    void *p = realloc(q, n);
-    if(!p){ perror("realloc"); exit(1); }
-    return p;
+static void build_signatures(ACMatcher *ac){
+    static const struct { const char *pat; uint64_t mask; } sigs[] = {
+        { "sshd",                       SIG_SSHD },
+        { "sudo",                       SIG_SUDO },
+        { "Failed password",            SIG_FAILED_PW },
+        { "Invalid user",               SIG_INVALID },
+        { "authentication failure",     SIG_AUTH_FAIL },
+        { "NOT in sudoers",             SIG_NOT_SUDOER },
+        { "not in the sudoers file",    SIG_NOT_SUDOER }, /* also covers "is not in ..." */
+    };
+    ac_init(ac,0);
+    for(size_t i=0;i<sizeof sigs/sizeof sigs[0];i++)
+        ac_add(ac,sigs[i].pat,strlen(sigs[i].pat),sigs[i].mask);
+    ac_compile(ac);
 }
 
-static char *xstrdup(const char *s){
-    size_t n = strlen(s)+1;
-    char *p = (char*)xmalloc(n);
-    memcpy(p,s,n);
-    return p;
+static void usage(const char *prog){
+    fprintf(stderr,
+      "Usage: %s [--enforce [--dry-run]] [--follow] [--threshold=N] [--window=SECS]\n"
+      "          [--ban=SECONDS] [--flush-ms=N] [--state=FILE [--state-every=SECS]]\n"
+      "          [--allow=FILE] [--deny=FILE] [logfile]\n"
+      "  Reads logfile or STDIN. Detects SSH brute-force, sudo failures, sudoers violations.\n"
+      "  --enforce      add offending IPs to nftables set 'mini_siem_blocklist'\n"
+      "  --follow       keep reading as the log grows (tail -F, survives rotation);\n"
+      "                 IPs are alerted/banned the moment they cross the threshold.\n"
+      "                 For journald: journalctl -f -u ssh | %s --follow\n"
+      "  --threshold=N  fails needed to alert/ban (default 5)\n"
+      "  --window=SECS  count only fails within the last SECS seconds (1-3600,\n"
+      "                 from the log timestamps) instead of the lifetime total\n"
+      "  --ban=SECONDS  nftables timeout (default 3600)\n"
+      "  --flush-ms=N   batch bans into one nft transaction per N ms (default 200)\n"
+      "  --dry-run      with --enforce: print the nft transactions instead of running them\n"
+      "  --state=FILE   keep per-IP state in FILE: loaded at startup, so only the part of\n"
+      "                 logfile not read yet is replayed; rewritten on exit and, with\n"
+      "                 --follow, every --state-every seconds (default 60)\n"
+      "  --allow=FILE   addresses/CIDRs (IPv4 or IPv6, one per line) never counted or\n"
+      "                 banned; loopback is always allowed\n"
+      "  --deny=FILE    addresses/CIDRs alerted/banned on their first failure\n"
+      "                 (the most specific prefix wins; allow beats deny on a tie).\n"
+      "                 With --follow, SIGHUP re-reads both lists; counters are kept\n"
+      "  $MINI_SIEM_NFT overrides the nft binary\n", prog, prog);
 }
 
-static void vec_reserve(Vec *v, size_t need){
-    if(need <= v->cap) return;
-    size_t nc = v->cap ? v->cap*2 : 16;
-    while(nc < need){
-        if(nc > SIZE_MAX/2){
-            fprintf(stderr,"cap overflow\n");
-            exit(1);
-        }
-        nc *= 2;
+/* per-IP state kept resident in the index; with --window a RateWin follows it */
+typedef struct {
+    int64_t  seen;      /* newest event (log time) */
+    unsigned fails;     /* lifetime total */
+    unsigned peak;      /* highest windowed count */
+    bool     over;      /* currently at/over threshold */
+} IPState;
+
+static RateWin *ip_win(IPState *st){ return (RateWin*)(void*)(st+1); }
+
+#define EXPIRE_EVERY 60  /* seconds of log time between idle sweeps (--follow --window) */
+
+typedef struct {
+    bool enforce, follow, dry_run;
+    unsigned threshold, ban_seconds, flush_ms;
+    NftBan nft;
+    unsigned window;            /* 0 = lifetime counting */
+    int64_t now;                /* newest timestamp seen */
+    int64_t last_sweep;
+    ACMatcher sigs;
+    IPIndex ssh_fails;
+    unsigned long total, ssh_fail_lines, sudo_fail, sudo_notin;
+    const char *state_path;     /* NULL = no snapshots */
+    unsigned state_every;
+    time_t state_at;            /* last snapshot written (wall clock) */
+    const char *allow_path, *deny_path;
+    CidrSet lists;              /* --allow/--deny prefixes, plus loopback */
+    bool have_lists;            /* a list file was given: look IPs up before counting */
+    unsigned long allowed;      /* lines skipped as allowlisted */
+} Siem;
+
+static void enforce_ip(Siem *S, const char *ip){
+    if(cidr_lookup(&S->lists,ip,strlen(ip)) & CIDR_ALLOW) {
+        fprintf(stderr,"[enforce] NOT banning %s (allowlisted)\n", ip);
+    } else {
+        (void)nft_queue(&S->nft,ip);   /* no-op if already banned */
+        nft_maybe_flush(&S->nft);
     }
-    v->data = (IPFail*)xrealloc(v->data, nc*sizeof(IPFail));
-    v->cap = nc;
 }
 
-static ssize_t vec_find_ip(Vec *v, const char *ip){
-    for(size_t i=0;i<v->len;i++)
-        if(strcmp(v->data[i].ip,ip)==0)
-            return (ssize_t)i;
-    return -1;
+/* called once per IP, on the line that takes it to the threshold */
+static void on_threshold(Siem *S, const char *ip, unsigned fails, bool denied){
+    if(S->follow){
+        if(denied)    printf("ALERT: %s is denylisted (%u failed SSH attempts)\n", ip, fails);
+        else if(S->window) printf("ALERT: %s has %u failed SSH attempts in %us\n", ip, fails, S->window);
+        else          printf("ALERT: %s has %u failed SSH attempts\n", ip, fails);
+        fflush(stdout);
+    }
+    if(S->enforce) enforce_ip(S, ip);
 }
 
-static void bump_ip(Vec *v,const char *ip){
-    ssize_t i = vec_find_ip(v,ip);
-    if(i<0){
-        vec_reserve(v,v->len+1);
-        v->data[v->len].ip = xstrdup(ip);
-        v->data[v->len].fails = 1u;
-        v->len++;
-    } else {
-        v->data[(size_t)i].fails++;
-    }
+/* lifetime or windowed count for st after an event at log time ts
+   (0 = no timestamp seen yet: counted for life, not in the window) */
+static unsigned bump(Siem *S, IPState *st, int64_t ts){
+    st->fails++;
+    if(ts > st->seen) st->seen = ts;
+    if(!S->window) return st->fails;
+    RateWin *w = ip_win(st);
+    if(ts) rw_add(w, ts);               /* an older line is filed at w->last */
+    unsigned c = rw_count(w, w->last, S->window);
+    if(c > st->peak) st->peak = c;
+    return c;
 }
 
-static void vec_free(Vec *v){
-    if(!v) return;
-    for(size_t i=0;i<v->len;i++)
-        free(v->data[i].ip);
-    free(v->data);
-    v->data=NULL;
-    v->len=v->cap=0;
+static int still_active(const void *val, void *ud){
+    const Siem *S = (const Siem*)ud;
+    const IPState *st = (const IPState*)val;
+    int64_t idle = S->window > RW_MAX_WINDOW/2 ? 2*(int64_t)S->window : RW_MAX_WINDOW;
+    return S->now - st->seen < idle;
 }
 
-/* Extract IPv4 from journalctl-ish lines */
-static int extract_ip(const char *line,char *out,size_t outsz){
-    const char *p = strstr(line,"from ");
-    if(!p) p = strstr(line,"rhost=");
-    if(!p) return 0;
+static void process_line(Siem *S, const char *line, size_t n){
+    S->total++;
+    strview ip;
+    int have_ip = -1;                   /* -1: not looked for yet */
+    bool denied = false;
+    if(S->have_lists && (have_ip = log_find_ip(line,n,&ip))){
+        /* before the signature scan: allowlisted sources cost one trie walk */
+        unsigned l = cidr_lookup(&S->lists,ip.p,ip.n);
+        if(l & CIDR_ALLOW){ S->allowed++; return; }
+        denied = (l & CIDR_DENY)!=0;
+    }
+    /* no stamp (e.g. journal "-- Boot --" markers): reuse the newest one
+       parsed. Never the wall clock: on a replayed log that would push every
+       later event into the same bucket. */
+    int64_t ts;
+    if(!log_timestamp(line,n,&ts)) ts = S->now;
+    if(ts > S->now) S->now = ts;
+    uint64_t m = ac_scan(&S->sigs,line,n);
+    int is_sshd = (m & SIG_SSHD)!=0;
+    int is_sudo = (m & SIG_SUDO)!=0;
 
-    p += (p[0]=='r')?6:5;
-    size_t i=0;
-    while(p[i] && (isdigit((unsigned char)p[i])||p[i]=='.')){
-        if(i+1 >= outsz){
-            return 0;
+    if(is_sshd && (m & (SIG_FAILED_PW|SIG_INVALID))){
+        S->ssh_fail_lines++;
+        if(have_ip<0) have_ip=log_find_ip(line,n,&ip);
+        if(have_ip){
+            IPState *st=(IPState*)ipidx_get(&S->ssh_fails,ip.p,ip.n,NULL);
+            unsigned c=bump(S,st,ts), need=denied ? 1 : S->threshold;
+            if(c>=need && !st->over){
+                char buf[LT_IP_MAX+1];          /* only copied when it matters */
+                memcpy(buf,ip.p,ip.n);
+                buf[ip.n]='\0';
+                on_threshold(S,buf,c,denied);
+            }
+            st->over = c>=need;
         }
-        out[i]=p[i];
-        i++;
     }
+    if(is_sudo && (m & SIG_AUTH_FAIL)) S->sudo_fail++;
+    if(is_sudo && (m & SIG_NOT_SUDOER)) S->sudo_notin++;
 
-    if(i==0){
-        const char *last = strrchr(line,' ');
-        if(!last || !last[1]){
-            return 0;
-        }
-        last++;
-        size_t j=0;
-        while(last[j] && (isdigit((unsigned char)last[j])||last[j]=='.')){
-            if(j+1 >= outsz){
-                return 0;
+    /* long --follow --window runs: forget IPs that went quiet so memory stays
+       bounded. Lifetime counts (no --window) are never expired: a late fail
+       has to add to the total, not start it over. */
+    if(S->follow && S->window && S->now - S->last_sweep >= EXPIRE_EVERY){
+        if(S->last_sweep) ipidx_compact(&S->ssh_fails,still_active,S);
+        S->last_sweep = S->now;
+    }
+}
+
+static void report(const Siem *S){
+    printf("\n== Mini SIEM (real logs) ==\n");
+    printf("Total lines: %lu\n", S->total);
+    printf("SSH failed log lines: %lu\n", S->ssh_fail_lines);
+    printf("sudo auth failures: %lu\n", S->sudo_fail);
+    printf("sudoers policy violations: %lu\n", S->sudo_notin);
+    if(S->have_lists) printf("Allowlisted lines skipped: %lu\n", S->allowed);
+
+    if(S->ssh_fail_lines){
+        if(S->window) printf("\n-- SSH brute-force suspects (>= %u fails in %us) --\n", S->threshold, S->window);
+        else          printf("\n-- SSH brute-force suspects (>= %u fails) --\n", S->threshold);
+        for(size_t i=0;i<S->ssh_fails.len;i++){
+            const IPState *st=(const IPState*)ipidx_val(&S->ssh_fails,i);
+            char ip[64];
+            ipidx_key(&S->ssh_fails,i,ip,sizeof ip);
+            bool denied = S->have_lists && (cidr_lookup(&S->lists,ip,strlen(ip)) & CIDR_DENY);
+            if(denied || (S->window ? st->peak : st->fails) >= S->threshold){
+                if(denied)
+                    printf("ALERT: %s is denylisted, %u failed SSH attempts\n", ip, st->fails);
+                else if(S->window)
+                    printf("ALERT: %s peaked at %u failed SSH attempts in %us (%u total)\n",
+                           ip, st->peak, S->window, st->fails);
+                else
+                    printf("ALERT: %s has %u failed SSH attempts\n", ip, st->fails);
+                printf("  Remediation: fail2ban (sshd), key-only auth, disable root SSH, firewall allowlist.\n");
             }
-            out[j]=last[j];
-            j++;
         }
-        if(j==0) return 0;
-        out[j]='\0';
-        return 1;
+        if(!S->ssh_fails.len) printf("(no IPs extracted — check log format)\n");
     }
 
-    out[i]='\0';
-    return 1;
+    if(S->ssh_fail_lines||S->sudo_fail||S->sudo_notin){
+        printf("\n== Recommendations ==\n");
+        if(S->ssh_fail_lines){
+            printf("- Install & configure fail2ban for sshd\n");
+        }
+        if(S->sudo_fail)   printf("- Review sudo password policy; investigate repeated failures\n");
+        if(S->sudo_notin)  printf("- Investigate users attempting sudo without authorization\n");
+    }
 }
 
-/* --- enforcement helpers --- */
-static bool is_whitelisted(const char *ip){
-    // Keep only loopback whitelisted by default.
-    return strcmp(ip,"127.0.0.1")==0;
+/* --- state snapshots --- */
+enum { C_TOTAL, C_SSH_FAIL, C_SUDO_FAIL, C_SUDO_NOTIN, C_NOW, C_SWEEP };
+
+/* the value layout depends on --window (a RateWin follows each IPState) and
+   IPState.over on --threshold: window in bits 0-31, a marker bit 32, the
+   threshold (at most INT_MAX, from atoi) in bits 33-63 */
+static uint64_t state_tag(const Siem *S){
+    return (uint64_t)S->threshold << 33 | (uint64_t)1 << 32 | S->window;
 }
 
-static void ban_ip_nft(const char *ip, unsigned timeout_seconds){
-    char cmd[256];
-    snprintf(cmd,sizeof cmd,
-             "nft add element inet filter mini_siem_blocklist { %s timeout %us }",
-             ip, timeout_seconds);
-    int rc = system(cmd);
-    if(rc!=0) fprintf(stderr,"[enforce] nft add failed for %s (rc=%d)\n", ip, rc);
-    else      fprintf(stderr,"[enforce] blocked %s for %us via nftables\n", ip, timeout_seconds);
+static void state_save(Siem *S, const LineReader *lr){
+    int64_t c[SNAP_COUNTERS] = {0};
+    c[C_TOTAL] = (int64_t)S->total;
+    c[C_SSH_FAIL] = (int64_t)S->ssh_fail_lines;
+    c[C_SUDO_FAIL] = (int64_t)S->sudo_fail;
+    c[C_SUDO_NOTIN] = (int64_t)S->sudo_notin;
+    c[C_NOW] = S->now;
+    c[C_SWEEP] = S->last_sweep;
+    SnapCheckpoint cp;
+    memset(&cp,0,sizeof cp);
+    if(lr->own_fd) snap_mark(&cp,lr->fd,lr->offset);    /* stdin can't be resumed */
+    if(snap_write(S->state_path,&S->ssh_fails,state_tag(S),c,&cp)!=0)
+        fprintf(stderr,"[state] write %s: %s\n",S->state_path,strerror(errno));
+    S->state_at = time(NULL);
 }
 
-static void usage(const char *prog){
-    fprintf(stderr,
-      "Usage: %s [--enforce] [--threshold=N] [--ban=SECONDS] [logfile]\n"
-      "  Reads logfile or STDIN. Detects SSH brute-force, sudo failures, sudoers violations.\n"
-      "  --enforce      add offending IPs to nftables set 'mini_siem_blocklist'\n"
-      "  --threshold=N  fails needed to alert/ban (default 5)\n"
-      "  --ban=SECONDS  nftables timeout (default 3600)\n", prog);
+/* --follow: rewrite the snapshot every --state-every seconds */
+static void state_tick(Siem *S, const LineReader *lr){
+    if(S->state_path && S->follow && S->state_every &&
+       time(NULL)-S->state_at >= (time_t)S->state_every)
+        state_save(S,lr);
+}
+
+/* before any line is read: restore the counters and skip what they already cover */
+static void state_restore(Siem *S, LineReader *lr){
+    int64_t c[SNAP_COUNTERS];
+    SnapCheckpoint cp;
+    if(snap_load(S->state_path,&S->ssh_fails,state_tag(S),c,&cp)!=1) return;
+    S->total = (unsigned long)c[C_TOTAL];
+    S->ssh_fail_lines = (unsigned long)c[C_SSH_FAIL];
+    S->sudo_fail = (unsigned long)c[C_SUDO_FAIL];
+    S->sudo_notin = (unsigned long)c[C_SUDO_NOTIN];
+    S->now = c[C_NOW];
+    S->last_sweep = c[C_SWEEP];
+
+    uint64_t off = lr->own_fd ? snap_resume(&cp,lr->fd) : 0;
+    if(off && lr_seek(lr,off)!=0) off = 0;
+    fprintf(stderr,"[state] %zu IPs from %s; ",S->ssh_fails.len,S->state_path);
+    if(off)          fprintf(stderr,"resuming the log at byte %llu\n",(unsigned long long)off);
+    else if(!lr->own_fd) fprintf(stderr,"stdin has no checkpoint, reading all of it\n");
+    else if(cp.ino)  fprintf(stderr,"log rotated or truncated since, reading it from the start\n");
+    else             fprintf(stderr,"reading the log from the start\n");
+}
+
+/* --- allow/deny lists --- */
+
+/* a fresh set from --allow/--deny; the current one is untouched on failure */
+static int lists_build(const Siem *S, CidrSet *out){
+    cidr_init(out);
+    if(cidr_add(out,"127.0.0.0/8",11,CIDR_ALLOW)!=1 || cidr_add(out,"::1",3,CIDR_ALLOW)!=1) goto fail;
+    long na = 0, nd = 0;
+    if(S->allow_path && (na = cidr_load(out,S->allow_path,CIDR_ALLOW)) < 0) goto fail;
+    if(S->deny_path && (nd = cidr_load(out,S->deny_path,CIDR_DENY)) < 0) goto fail;
+    if(S->have_lists)
+        fprintf(stderr,"[lists] %ld allow, %ld deny prefixes (%zu IPv4, %zu IPv6 in the trie)\n",
+                na, nd, out->count[0], out->count[1]);
+    return 0;
+fail:
+    cidr_free(out);
+    return -1;
+}
+
+/* SIGHUP: swap in the re-read lists; per-IP state and counters stay */
+static void lists_reload(Siem *S){
+    CidrSet fresh;
+    if(lists_build(S,&fresh)!=0){
+        fprintf(stderr,"[lists] reload failed, keeping the old lists\n");
+        return;
+    }
+    cidr_free(&S->lists);
+    S->lists = fresh;
+}
+
+static volatile sig_atomic_t g_stop = 0, g_reload = 0;
+static void on_stop(int sig){ (void)sig; g_stop = 1; }
+static void on_hup(int sig){ (void)sig; g_reload = 1; }
+
+/* periodic work that mustn't wait for the log to go quiet */
+static void housekeeping(Siem *S, const LineReader *lr){
+    if(g_reload){ g_reload = 0; lists_reload(S); }
+    state_tick(S,lr);
 }
 
 int main(int argc,char **argv){
-    bool enforce=false;
-    unsigned threshold=5;      /* default alert threshold */
-    unsigned ban_seconds=3600; /* default ban time */
+    Siem S;
+    memset(&S,0,sizeof S);
+    S.threshold=5;      /* default alert threshold */
+    S.ban_seconds=3600; /* default ban time */
+    S.flush_ms=200;
+    S.state_every=60;
 
     const char *fname=NULL;
     for(int i=1;i<argc;i++){
-        if     (strcmp(argv[i],"--enforce")==0) enforce=true;
-        else if(strncmp(argv[i],"--threshold=",12)==0) threshold=(unsigned)atoi(argv[i]+12);
-        else if(strncmp(argv[i],"--ban=",6)==0)        ban_seconds=(unsigned)atoi(argv[i]+6);
+        if     (strcmp(argv[i],"--enforce")==0) S.enforce=true;
+        else if(strcmp(argv[i],"--follow")==0)  S.follow=true;
+        else if(strncmp(argv[i],"--threshold=",12)==0) S.threshold=(unsigned)atoi(argv[i]+12);
+        else if(strncmp(argv[i],"--ban=",6)==0)        S.ban_seconds=(unsigned)atoi(argv[i]+6);
+        else if(strncmp(argv[i],"--window=",9)==0)     S.window=(unsigned)atoi(argv[i]+9);
+        else if(strncmp(argv[i],"--flush-ms=",11)==0)  S.flush_ms=(unsigned)atoi(argv[i]+11);
+        else if(strcmp(argv[i],"--dry-run")==0)        S.dry_run=true;
+        else if(strncmp(argv[i],"--state=",8)==0)      S.state_path=argv[i]+8;
+        else if(strncmp(argv[i],"--state-every=",14)==0) S.state_every=(unsigned)atoi(argv[i]+14);
+        else if(strncmp(argv[i],"--allow=",8)==0)      S.allow_path=argv[i]+8;
+        else if(strncmp(argv[i],"--deny=",7)==0)       S.deny_path=argv[i]+7;
         else if(argv[i][0]=='-'){ usage(argv[0]); return 1; }
         else fname=argv[i];
     }
+    if(S.window>RW_MAX_WINDOW){
+        fprintf(stderr,"--window: at most %u seconds\n",(unsigned)RW_MAX_WINDOW);
+        return 1;
+    }
+    if(S.enforce && !S.dry_run && geteuid()!=0){
+        fprintf(stderr,"[enforce] need root; run with sudo (alerting only)\n");
+        S.enforce=false;
+    }
 
-    FILE *fp = fname? fopen(fname,"r") : stdin;
-    if(fname && !fp){ perror("fopen"); return 1; }
-
-    Vec ssh_fails={0};
-    unsigned long total=0, ssh_fail_lines=0, sudo_fail=0, sudo_notin=0;
-    char line[4096];
+    S.have_lists = S.allow_path || S.deny_path;
+    if(lists_build(&S,&S.lists)!=0) return 1;
 
-    while(fgets(line,(int)sizeof line,fp)){
-        total++;
-        int is_sshd = strstr(line,"sshd")!=NULL;
-        int is_sudo = strstr(line,"sudo")!=NULL;
+    LineReader lr;
+    int orc = S.follow ? lr_open_follow(&lr,fname) : lr_open(&lr,fname);
+    if(orc!=0){ perror("open"); cidr_free(&S.lists); return 1; }
 
-        if(is_sshd && (strstr(line,"Failed password")||strstr(line,"Invalid user"))){
-            ssh_fail_lines++;
-            char ip[64]={0};
-            if(extract_ip(line,ip,sizeof ip)) bump_ip(&ssh_fails,ip);
-        }
-        if(is_sudo && strstr(line,"authentication failure")) sudo_fail++;
-        if(is_sudo && (strstr(line,"NOT in sudoers") ||
-                       strstr(line,"is not in the sudoers file") ||
-                       strstr(line,"not in the sudoers file"))) sudo_notin++;
+    if(S.follow){
+        /* no SA_RESTART: let poll()/read() return so the report gets printed */
+        struct sigaction sa;
+        memset(&sa,0,sizeof sa);
+        sa.sa_handler=on_stop;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT,&sa,NULL);
+        sigaction(SIGTERM,&sa,NULL);
+        sa.sa_handler=on_hup;
+        sigaction(SIGHUP,&sa,NULL);
     }
-    if(fp!=stdin) fclose(fp);
 
-    printf("\n== Mini SIEM (real logs) ==\n");
-    printf("Total lines: %lu\n", total);
-    printf("SSH failed log lines: %lu\n", ssh_fail_lines);
-    printf("sudo auth failures: %lu\n", sudo_fail);
-    printf("sudoers policy violations: %lu\n", sudo_notin);
-
-    if(ssh_fail_lines){
-        printf("\n-- SSH brute-force suspects (>= %u fails) --\n", threshold);
-        for(size_t i=0;i<ssh_fails.len;i++){
-            if(ssh_fails.data[i].fails >= threshold){
-                printf("ALERT: %s has %u failed SSH attempts\n",
-                       ssh_fails.data[i].ip, ssh_fails.data[i].fails);
-                printf("  Remediation: fail2ban (sshd), key-only auth, disable root SSH, firewall allowlist.\n");
-                if(enforce){
-                    if(geteuid()!=0) {
-                        fprintf(stderr,"[enforce] need root; run with sudo\n");
-                    } else if(is_whitelisted(ssh_fails.data[i].ip)) {
-                        fprintf(stderr,"[enforce] NOT banning %s (whitelisted)\n", ssh_fails.data[i].ip);
-                    } else {
-                        ban_ip_nft(ssh_fails.data[i].ip, ban_seconds);
-                    }
-                }
+    build_signatures(&S.sigs);
+    nft_init(&S.nft,S.ban_seconds,S.flush_ms,S.dry_run);
+    ipidx_init(&S.ssh_fails,sizeof(IPState)+(S.window?sizeof(RateWin):0));
+    if(S.state_path){ state_restore(&S,&lr); S.state_at=time(NULL); }
+    const char *line;
+    size_t n;
+    int rc=0;
+
+    for(;;){
+        unsigned long long at=lr.offset;
+        while(!g_stop && (rc=lr_next(&lr,&line,&n))>0){
+            if(S.state_path && S.follow && lr.unterminated){
+                /* no '\n' yet under --follow: still being written. Leave it
+                   out of the state and the checkpoint; the next run reads it
+                   whole. A finished log's last line counts as it is. */
+                lr.offset=at;
+                break;
             }
+            at=lr.offset;
+            process_line(&S,line,n);
+            if(!(S.total & 0xffff)) housekeeping(&S,&lr);   /* a log that never goes idle */
         }
-        if(!ssh_fails.len) printf("(no IPs extracted — check log format)\n");
-    }
-
-    if(ssh_fail_lines||sudo_fail||sudo_notin){
-        printf("\n== Recommendations ==\n");
-        if(ssh_fail_lines){
-            printf("- Install & configure fail2ban for sshd\n");
+        (void)nft_flush(&S.nft);      /* burst drained: ban now, don't wait for the timer */
+        if(g_stop || !S.follow) break;
+        housekeeping(&S,&lr);
+        if(rc<0){
+            if(errno==EINTR) continue;
+            break;
+        }
+        if(lr_wait(&lr,1000)<0){
+            if(errno==EINTR) continue;
+            if(errno!=ENOTSUP) perror("follow");
+            break;
         }
-        if(sudo_fail)   printf("- Review sudo password policy; investigate repeated failures\n");
-        if(sudo_notin)  printf("- Investigate users attempting sudo without authorization\n");
     }
+    if(rc<0 && errno!=EINTR) perror("read");
+    if(S.state_path) state_save(&S,&lr);
+    lr_close(&lr);
+    (void)nft_flush(&S.nft);
+
+    report(&S);
 
-    vec_free(&ssh_fails);
+    ipidx_free(&S.ssh_fails);
+    cidr_free(&S.lists);
+    ac_free(&S.sigs);
+    nft_free(&S.nft);
     return 0;
 }
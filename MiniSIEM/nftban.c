@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "nftban.h"
+
+static int64_t mono_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void nft_init(NftBan *nb, unsigned timeout_s, unsigned flush_ms, int dry_run){
+    memset(nb, 0, sizeof *nb);
+    nb->timeout_s = timeout_s;
+    nb->flush_ms = flush_ms;
+    nb->dry_run = dry_run;
+    ipidx_init(&nb->banned, sizeof(int64_t));
+    for(int f = 0; f < 2; f++){
+        nb->q[f].ip = malloc(NFT_MAX_BATCH * sizeof *nb->q[f].ip);
+        if(!nb->q[f].ip){ perror("malloc"); exit(1); }
+        nb->q[f].last_flush_ms = mono_ms();
+    }
+    /* a dying nft must not take us down with it */
+    signal(SIGPIPE, SIG_IGN);
+}
+
+static const char *set_name(int v6){ return v6 ? NFT_SET6 : NFT_SET4; }
+
+void nft_free(NftBan *nb){
+    for(int f = 0; f < 2; f++){
+        if(nb->q[f].n)
+            fprintf(stderr, "[enforce] %zu IP(s) never made it into nftables set %s\n", nb->q[f].n, set_name(f));
+        free(nb->q[f].ip);
+        nb->q[f].ip = NULL;
+        nb->q[f].n = 0;
+    }
+    ipidx_free(&nb->banned);
+}
+
+/* nft rejects the whole transaction over one bad element: only real
+   addresses get in. 0 = IPv4, 1 = IPv6, -1 = neither. */
+static int ip_family(const char *ip){
+    unsigned char a[16];
+    if(inet_pton(AF_INET, ip, a) == 1) return 0;
+    if(inet_pton(AF_INET6, ip, a) == 1) return 1;
+    return -1;
+}
+
+static int flush_family(NftBan *nb, int v6);
+
+int nft_queue(NftBan *nb, const char *ip){
+    size_t n = strlen(ip);
+    int f = n < sizeof nb->q[0].ip[0] ? ip_family(ip) : -1;
+    if(f < 0){
+        fprintf(stderr, "[enforce] not an IP address, not banning: %.64s\n", ip);
+        return 0;
+    }
+    NftQueue *q = &nb->q[f];
+    int64_t *exp = (int64_t*)ipidx_get(&nb->banned, ip, n, NULL);
+    int64_t now = (int64_t)time(NULL);
+    if(*exp > now) return 0;                 /* still banned (or queued) */
+    if(q->n == NFT_MAX_BATCH){
+        (void)flush_family(nb, f);
+        if(q->n == NFT_MAX_BATCH){           /* nft keeps failing: the batch is still queued */
+            fprintf(stderr, "[enforce] %s ban queue full, dropping %s\n", set_name(f), ip);
+            return 0;
+        }
+        exp = (int64_t*)ipidx_find(&nb->banned, ip, n);   /* re-fetch after flush */
+    }
+    *exp = now + (int64_t)nb->timeout_s;
+    memcpy(q->ip[q->n], ip, n + 1);
+    q->n++;
+    return 1;
+}
+
+void nft_maybe_flush(NftBan *nb){
+    int64_t now = mono_ms();
+    for(int f = 0; f < 2; f++){
+        const NftQueue *q = &nb->q[f];
+        if(!q->n || now < q->retry_at_ms) continue;
+        if(q->n >= NFT_MAX_BATCH || now - q->last_flush_ms >= (int64_t)nb->flush_ms)
+            (void)flush_family(nb, f);
+    }
+}
+
+static void write_set(FILE *out, const NftBan *nb, int v6){
+    const NftQueue *q = &nb->q[v6];
+    fprintf(out, "add element inet filter %s { ", set_name(v6));
+    for(size_t i = 0; i < q->n; i++)
+        fprintf(out, "%s%s timeout %us", i ? ", " : "", q->ip[i], nb->timeout_s);
+    fprintf(out, " }\n");
+}
+
+/* The batch stays queued and is sent again after a back-off (doubling from
+   max(flush_ms, 1s) to NFT_RETRY_MAX_MS): a crossing that already happened
+   won't happen again in lifetime mode, so dropping it would lose the ban. */
+static int failed(NftBan *nb, int v6){
+    NftQueue *q = &nb->q[v6];
+    int64_t base = nb->flush_ms > 1000 ? (int64_t)nb->flush_ms : 1000;
+    q->retry_ms = q->retry_ms ? q->retry_ms * 2 : base;
+    if(q->retry_ms > NFT_RETRY_MAX_MS) q->retry_ms = NFT_RETRY_MAX_MS;
+    q->retry_at_ms = mono_ms() + q->retry_ms;
+    fprintf(stderr, "[enforce] keeping %zu IP(s) queued for %s, retrying in %llds\n",
+            q->n, set_name(v6), (long long)(q->retry_ms / 1000));
+    return -1;
+}
+
+/* One transaction per set: a missing or broken IPv6 set must not hold up
+   IPv4 bans (nft rejects a whole transaction over one failing command). */
+static int flush_family(NftBan *nb, int v6){
+    NftQueue *q = &nb->q[v6];
+    if(!q->n) return 0;
+    if(mono_ms() < q->retry_at_ms) return -1;     /* backing off after a failure */
+    q->last_flush_ms = mono_ms();
+
+    if(nb->dry_run){
+        fprintf(stderr, "[enforce] dry-run transaction:\n");
+        write_set(stderr, nb, v6);
+        q->n = 0;
+        return 0;
+    }
+
+    int pfd[2];
+    if(pipe2(pfd, O_CLOEXEC) != 0){ perror("pipe"); return failed(nb, v6); }
+    const char *nft = getenv("MINI_SIEM_NFT");
+    if(!nft || !*nft) nft = "nft";
+
+    pid_t pid = fork();
+    if(pid < 0){
+        perror("fork");
+        close(pfd[0]); close(pfd[1]);
+        return failed(nb, v6);
+    }
+    if(pid == 0){
+        dup2(pfd[0], STDIN_FILENO);
+        execlp(nft, nft, "-f", "-", (char*)NULL);
+        _exit(127);
+    }
+    close(pfd[0]);
+
+    FILE *out = fdopen(pfd[1], "w");
+    if(out){
+        write_set(out, nb, v6);
+        fclose(out);                        /* EOF ends the transaction */
+    } else {
+        close(pfd[1]);
+    }
+
+    int status = 0;
+    pid_t w;
+    while((w = waitpid(pid, &status, 0)) < 0 && errno == EINTR){}
+    if(w != pid){                           /* no exit status: don't assume it worked */
+        perror("[enforce] waitpid nft");
+        return failed(nb, v6);
+    }
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        fprintf(stderr, "[enforce] nft transaction failed for %zu IP(s) in %s (status=%d)\n",
+                q->n, set_name(v6), status);
+        return failed(nb, v6);
+    }
+    fprintf(stderr, "[enforce] blocked %zu IP(s) for %us via nftables set %s (1 transaction)\n",
+            q->n, nb->timeout_s, set_name(v6));
+    q->n = 0;
+    q->retry_ms = q->retry_at_ms = 0;
+    return 0;
+}
+
+int nft_flush(NftBan *nb){
+    int a = flush_family(nb, 0), b = flush_family(nb, 1);
+    return a == 0 && b == 0 ? 0 : -1;
+}
@@ -0,0 +1,62 @@
+#ifndef NFTBAN_H
+#define NFTBAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ipindex.h"
+
+/*
+ * Batched nftables enforcement.
+ *
+ * IPs are queued and written out as ONE `nft -f -` transaction per set
+ * and flush instead of one fork+exec of /bin/sh and nft per address. IPs
+ * that are already banned (and whose timeout hasn't run out) are skipped,
+ * so repeated threshold crossings cost a hash lookup and nothing else.
+ *
+ * IPv4 addresses go to set NFT_SET4, IPv6 addresses to NFT_SET6, both in
+ * table `inet filter`. Each family has its own queue and back-off, so a
+ * missing IPv6 set only parks IPv6 bans. The sets have to exist:
+ *
+ *   nft add table inet filter
+ *   nft add set inet filter mini_siem_blocklist '{ type ipv4_addr; flags timeout; }'
+ *   nft add set inet filter mini_siem_blocklist6 '{ type ipv6_addr; flags timeout; }'
+ *
+ * (plus a rule that drops them, see the README). The nft binary can be
+ * overridden with $MINI_SIEM_NFT.
+ */
+
+#define NFT_SET4 "mini_siem_blocklist"
+#define NFT_SET6 "mini_siem_blocklist6"
+#define NFT_MAX_BATCH 512
+#define NFT_RETRY_MAX_MS 60000
+
+typedef struct {
+    char (*ip)[64];
+    size_t n;
+    int64_t last_flush_ms;
+    int64_t retry_ms, retry_at_ms;   /* back-off after a failed transaction */
+} NftQueue;
+
+typedef struct {
+    unsigned timeout_s;
+    unsigned flush_ms;
+    int dry_run;              /* print the transaction to stderr, don't run nft */
+    IPIndex banned;           /* ip -> int64_t expiry (wall clock), 0 = not banned */
+    NftQueue q[2];            /* [0] IPv4 -> NFT_SET4, [1] IPv6 -> NFT_SET6 */
+} NftBan;
+
+void nft_init(NftBan *nb, unsigned timeout_s, unsigned flush_ms, int dry_run);
+void nft_free(NftBan *nb);
+
+/* Queue ip for banning. Returns 1 if queued, 0 if already banned/queued or
+   not an IPv4/IPv6 address. */
+int nft_queue(NftBan *nb, const char *ip);
+/* Flush when the batch is full or flush_ms has passed since the last one. */
+void nft_maybe_flush(NftBan *nb);
+/* Send everything queued, one transaction per set. Returns 0 if both went
+   through; a set whose transaction failed keeps its IPs queued and waits
+   out a back-off, without holding up the other one. */
+int nft_flush(NftBan *nb);
+
+#endif
@@ -0,0 +1,156 @@
+#include <string.h>
+#include <time.h>
+
+#include "ratewin.h"
+
+static uint16_t sat_inc(uint16_t v){ return v == UINT16_MAX ? v : (uint16_t)(v + 1u); }
+
+void rw_add(RateWin *w, int64_t t){
+    if(t < w->last) t = w->last;          /* out-of-order line: count it as "now" */
+    if(w->last == 0){
+        memset(w->sec, 0, sizeof w->sec);
+        memset(w->min, 0, sizeof w->min);
+    } else {
+        int64_t ds = t - w->last;
+        if(ds >= RW_SECS) memset(w->sec, 0, sizeof w->sec);
+        else for(int64_t s = w->last + 1; s <= t; s++) w->sec[s % RW_SECS] = 0;
+
+        int64_t m0 = w->last / 60, m1 = t / 60;
+        if(m1 - m0 >= RW_MINS) memset(w->min, 0, sizeof w->min);
+        else for(int64_t m = m0 + 1; m <= m1; m++) w->min[m % RW_MINS] = 0;
+    }
+    w->last = t;
+    w->sec[t % RW_SECS] = sat_inc(w->sec[t % RW_SECS]);
+    w->min[(t / 60) % RW_MINS] = sat_inc(w->min[(t / 60) % RW_MINS]);
+}
+
+unsigned rw_count(const RateWin *w, int64_t now, unsigned window_s){
+    if(!w->last || window_s == 0) return 0;
+    if(window_s > RW_MAX_WINDOW) window_s = RW_MAX_WINDOW;
+    unsigned total = 0;
+
+    if(window_s <= RW_SECS){
+        /* buckets still valid: [last-59, last] */
+        int64_t lo = now - (int64_t)window_s + 1, hi = now;
+        if(lo < w->last - RW_SECS + 1) lo = w->last - RW_SECS + 1;
+        if(hi > w->last) hi = w->last;
+        for(int64_t s = lo; s <= hi; s++) total += w->sec[s % RW_SECS];
+        return total;
+    }
+
+    int64_t lm = w->last / 60;
+    int64_t lo = (now - (int64_t)window_s + 1) / 60, hi = now / 60;
+    if(lo < lm - RW_MINS + 1) lo = lm - RW_MINS + 1;
+    if(hi > lm) hi = lm;
+    for(int64_t m = lo; m <= hi; m++) total += w->min[m % RW_MINS];
+    return total;
+}
+
+/* ---- timestamps ---- */
+
+static int num(const char *s, size_t n, size_t *i, int digits, int *out){
+    int v = 0;
+    for(int k = 0; k < digits; k++){
+        if(*i >= n || s[*i] < '0' || s[*i] > '9') return 0;
+        v = v * 10 + (s[*i] - '0');
+        (*i)++;
+    }
+    *out = v;
+    return 1;
+}
+
+static int lit(const char *s, size_t n, size_t *i, char c){
+    if(*i >= n || s[*i] != c) return 0;
+    (*i)++;
+    return 1;
+}
+
+/* days since 1970-01-01 for a proleptic Gregorian date */
+static int64_t days_from_civil(int y, int m, int d){
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/* local midnight for y-m-d; mktime() is slow, and logs stay on one day for a while */
+static int64_t local_midnight(int y, int m, int d){
+    static int cy, cm, cd;
+    static int64_t cached;
+    if(y == cy && m == cm && d == cd) return cached;
+    struct tm tm;
+    memset(&tm, 0, sizeof tm);
+    tm.tm_year = y - 1900; tm.tm_mon = m - 1; tm.tm_mday = d;
+    tm.tm_isdst = -1;
+    cached = (int64_t)mktime(&tm);
+    cy = y; cm = m; cd = d;
+    return cached;
+}
+
+static int parse_iso(const char *s, size_t n, int64_t *out){
+    size_t i = 0;
+    int Y, M, D, h, mi, se;
+    if(!num(s, n, &i, 4, &Y) || !lit(s, n, &i, '-') || !num(s, n, &i, 2, &M) ||
+       !lit(s, n, &i, '-') || !num(s, n, &i, 2, &D)) return 0;
+    if(!lit(s, n, &i, 'T') && !lit(s, n, &i, ' ')) return 0;
+    if(!num(s, n, &i, 2, &h) || !lit(s, n, &i, ':') || !num(s, n, &i, 2, &mi) ||
+       !lit(s, n, &i, ':') || !num(s, n, &i, 2, &se)) return 0;
+    if(M < 1 || M > 12 || D < 1 || D > 31) return 0;
+    if(i < n && s[i] == '.'){ i++; while(i < n && s[i] >= '0' && s[i] <= '9') i++; }
+
+    int64_t tod = (int64_t)h * 3600 + mi * 60 + se;
+    if(i < n && s[i] == 'Z'){
+        *out = days_from_civil(Y, M, D) * 86400 + tod;
+        return 1;
+    }
+    if(i < n && (s[i] == '+' || s[i] == '-')){
+        int sign = s[i] == '-' ? -1 : 1, oh, om;
+        i++;
+        if(!num(s, n, &i, 2, &oh)) return 0;
+        (void)lit(s, n, &i, ':');
+        if(!num(s, n, &i, 2, &om)) return 0;
+        *out = days_from_civil(Y, M, D) * 86400 + tod - sign * ((int64_t)oh * 3600 + om * 60);
+        return 1;
+    }
+    *out = local_midnight(Y, M, D) + tod;
+    return 1;
+}
+
+static int parse_syslog(const char *s, size_t n, int64_t *out){
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if(n < 15) return 0;
+    int M = 0;
+    for(int k = 0; k < 12; k++)
+        if(memcmp(s, months + 3 * k, 3) == 0){ M = k + 1; break; }
+    if(!M || s[3] != ' ') return 0;
+    size_t i = 4;
+    if(s[i] == ' ') i++;                  /* "Aug  4" */
+    int D = 0;
+    while(i < n && s[i] >= '0' && s[i] <= '9' && D < 32) D = D * 10 + (s[i++] - '0');
+    if(D < 1 || D > 31 || !lit(s, n, &i, ' ')) return 0;
+    int h, mi, se;
+    if(!num(s, n, &i, 2, &h) || !lit(s, n, &i, ':') || !num(s, n, &i, 2, &mi) ||
+       !lit(s, n, &i, ':') || !num(s, n, &i, 2, &se)) return 0;
+
+    /* syslog has no year; refresh our idea of "this year" once an hour */
+    static time_t year_checked;
+    static int Y;
+    time_t now = time(NULL);
+    if(!Y || now - year_checked >= 3600){
+        struct tm lt;
+        localtime_r(&now, &lt);
+        Y = lt.tm_year + 1900;
+        year_checked = now;
+    }
+    int64_t t = local_midnight(Y, M, D) + (int64_t)h * 3600 + mi * 60 + se;
+    if(t > (int64_t)now + 86400) t = local_midnight(Y - 1, M, D) + (int64_t)h * 3600 + mi * 60 + se;
+    *out = t;
+    return 1;
+}
+
+int log_timestamp(const char *line, size_t n, int64_t *out){
+    if(n && line[0] >= '0' && line[0] <= '9') return parse_iso(line, n, out);
+    return parse_syslog(line, n, out);
+}
@@ -0,0 +1,41 @@
+#ifndef RATEWIN_H
+#define RATEWIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fixed-size per-IP event rate window: 60 one-second buckets plus
+ * 60 one-minute buckets, indexed by timestamp modulo the ring size.
+ * rw_add() is O(1) (at most one ring's worth of stale buckets is
+ * cleared per call), rw_count() reads at most 60 buckets, and the
+ * struct never grows, so memory per IP is constant.
+ *
+ * Windows up to 60s are exact to the second; longer ones (up to an
+ * hour) are counted in whole minutes.
+ */
+
+#define RW_SECS 60
+#define RW_MINS 60
+#define RW_MAX_WINDOW (RW_MINS * 60)
+
+typedef struct {
+    int64_t  last;            /* newest event, epoch seconds (0 = empty) */
+    uint16_t sec[RW_SECS];
+    uint16_t min[RW_MINS];
+} RateWin;
+
+void rw_add(RateWin *w, int64_t t);
+/* events in (now - window_s, now]; window_s is clamped to RW_MAX_WINDOW */
+unsigned rw_count(const RateWin *w, int64_t now, unsigned window_s);
+
+/*
+ * Leading timestamp of a log line: classic syslog "Mmm dd HH:MM:SS"
+ * (local time, current year, rolled back a year if that lands in the
+ * future) or ISO 8601 "YYYY-MM-DDTHH:MM:SS" as printed by
+ * journalctl -o short-iso. Returns 1 and sets *out on success.
+ * Keeps small static caches; not thread-safe.
+ */
+int log_timestamp(const char *line, size_t n, int64_t *out);
+
+#endif
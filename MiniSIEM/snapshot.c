@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+#define REC_ALIGN 8u
+#define OUT_CHUNK (64u * 1024u)
+
+static size_t rec_size(size_t val_size){
+    return (SNAP_KEY_LEN + val_size + REC_ALIGN - 1) & ~(size_t)(REC_ALIGN - 1);
+}
+
+static int write_all(int fd, const void *p, size_t n){
+    const char *c = (const char*)p;
+    while(n){
+        ssize_t w = write(fd, c, n);
+        if(w < 0 && errno == EINTR) continue;
+        if(w <= 0) return -1;
+        c += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+int snap_write(const char *path, const IPIndex *ix, uint64_t tag,
+               const int64_t counters[SNAP_COUNTERS], const SnapCheckpoint *cp){
+    char tmp[4096];
+    if((size_t)snprintf(tmp, sizeof tmp, "%s.tmp", path) >= sizeof tmp){ errno = ENAMETOOLONG; return -1; }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd < 0) return -1;
+
+    SnapHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, SNAP_MAGIC, sizeof h.magic);
+    h.hdr_size = (uint32_t)sizeof h;
+    h.rec_size = (uint32_t)rec_size(ix->val_size);
+    h.val_size = (uint32_t)ix->val_size;
+    h.key_len = SNAP_KEY_LEN;
+    h.count = ix->len;
+    h.tag = tag;
+    memcpy(h.counters, counters, sizeof h.counters);
+    h.cp = *cp;
+
+    /* records are staged in a fixed buffer: one write() per OUT_CHUNK */
+    size_t rs = h.rec_size, per = OUT_CHUNK / rs ? OUT_CHUNK / rs : 1;
+    char *out = (char*)malloc(per * rs);
+    int rc = out && write_all(fd, &h, sizeof h) == 0 ? 0 : -1;
+    for(size_t i = 0; rc == 0 && i < ix->len; ){
+        size_t k = 0;
+        memset(out, 0, per * rs);
+        for(; k < per && i < ix->len; k++, i++){
+            char *r = out + k * rs;
+            ipidx_key(ix, i, r, SNAP_KEY_LEN);
+            memcpy(r + SNAP_KEY_LEN, ipidx_val(ix, i), ix->val_size);
+        }
+        rc = write_all(fd, out, k * rs);
+    }
+    free(out);
+    int e = errno;
+    if(rc == 0 && fsync(fd) != 0) rc = -1, e = errno;
+    if(close(fd) != 0 && rc == 0) rc = -1, e = errno;
+    if(rc == 0 && rename(tmp, path) != 0) rc = -1, e = errno;
+    if(rc != 0){ unlink(tmp); errno = e; }
+    return rc;
+}
+
+int snap_load(const char *path, IPIndex *ix, uint64_t tag,
+              int64_t counters[SNAP_COUNTERS], SnapCheckpoint *cp){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        if(errno == ENOENT) return 0;
+        fprintf(stderr, "state: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapHeader)){
+        fprintf(stderr, "state: %s: too short, starting over\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t len = (size_t)st.st_size;
+    void *m = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED){ fprintf(stderr, "state: mmap %s: %s\n", path, strerror(errno)); return -1; }
+
+    const SnapHeader *h = (const SnapHeader*)m;
+    const char *why = NULL;
+    if(memcmp(h->magic, SNAP_MAGIC, sizeof h->magic) != 0 || h->hdr_size != sizeof *h ||
+       h->key_len != SNAP_KEY_LEN)                          why = "not a snapshot of this version";
+    else if(h->val_size != ix->val_size || h->rec_size != rec_size(ix->val_size) || h->tag != tag)
+                                                            why = "written with different settings";
+    else if(h->count > (len - sizeof *h) / h->rec_size ||
+            sizeof *h + h->count * h->rec_size != len)      why = "truncated";
+    if(why){
+        fprintf(stderr, "state: %s: %s, starting over\n", path, why);
+        munmap(m, len);
+        return -1;
+    }
+
+    (void)madvise(m, len, MADV_SEQUENTIAL);
+    const char *rec = (const char*)m + sizeof *h;
+    for(uint64_t i = 0; i < h->count; i++, rec += h->rec_size){
+        size_t kn = strnlen(rec, SNAP_KEY_LEN);
+        int is_new = 0;
+        void *v = kn && kn < SNAP_KEY_LEN ? ipidx_get(ix, rec, kn, &is_new) : NULL;
+        if(!v || !is_new){
+            fprintf(stderr, "state: %s: bad record %llu, starting over\n", path, (unsigned long long)i);
+            size_t vs = ix->val_size;
+            ipidx_free(ix);
+            ipidx_init(ix, vs);
+            munmap(m, len);
+            return -1;
+        }
+        memcpy(v, rec + SNAP_KEY_LEN, ix->val_size);
+    }
+    memcpy(counters, h->counters, sizeof h->counters);
+    *cp = h->cp;
+    munmap(m, len);
+    return 1;
+}
+
+/* --------- log checkpoints --------- */
+
+static uint64_t head_hash(int fd, uint32_t n){
+    unsigned char b[SNAP_HEAD_LEN];
+    if(pread(fd, b, n, 0) != (ssize_t)n) return 0;
+    uint64_t h = 1469598103934665603ULL;
+    for(uint32_t i = 0; i < n; i++){ h ^= b[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+void snap_mark(SnapCheckpoint *cp, int fd, uint64_t offset){
+    struct stat st;
+    memset(cp, 0, sizeof *cp);
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return;
+    cp->dev = (uint64_t)st.st_dev;
+    cp->ino = (uint64_t)st.st_ino;
+    cp->offset = offset;
+    cp->head_len = offset < SNAP_HEAD_LEN ? (uint32_t)offset : SNAP_HEAD_LEN;
+    cp->head_hash = head_hash(fd, cp->head_len);
+}
+
+uint64_t snap_resume(const SnapCheckpoint *cp, int fd){
+    struct stat st;
+    if(!cp->ino || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+    if((uint64_t)st.st_dev != cp->dev || (uint64_t)st.st_ino != cp->ino) return 0;
+    if((uint64_t)st.st_size < cp->offset) return 0;              /* truncated since */
+    if(head_hash(fd, cp->head_len) != cp->head_hash) return 0;   /* inode reused */
+    return cp->offset;
+}
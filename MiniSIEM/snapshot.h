@@ -0,0 +1,71 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ipindex.h"
+#include "logtok.h"
+
+/*
+ * State snapshots for the log analyzers, so a restart reloads its per-IP
+ * state instead of re-parsing the log from the beginning.
+ *
+ * One file, host byte order, read with a single mmap:
+ *   SnapHeader
+ *   count fixed-width records, rec_size bytes each:
+ *     key  SNAP_KEY_LEN bytes, the IP as ipidx_key() renders it, NUL padded
+ *     val  the index's value slot, byte for byte (val_size bytes, then
+ *          padding to a multiple of 8)
+ *
+ * The values are the caller's structs, so a snapshot is only good for the
+ * binary and settings that wrote it: `tag` carries whatever the layout
+ * and the values depend on (e.g. --window, --threshold), and snap_load()
+ * refuses a mismatch. The checkpoint names the log file (device, inode, a
+ * hash of its first bytes) and how far it had been read; snap_resume()
+ * says whether the file we have open now is that one.
+ *
+ * snap_write() goes through path.tmp + fsync + rename, so a crash leaves
+ * either the old snapshot or the new one, never half of one.
+ */
+
+#define SNAP_MAGIC     "MSIEMST1"
+#define SNAP_KEY_LEN   (LT_IP_MAX + 1)
+#define SNAP_COUNTERS  8
+#define SNAP_HEAD_LEN  256          /* log bytes fingerprinted */
+
+typedef struct {
+    uint64_t dev, ino;              /* 0/0 = no checkpoint (stdin, a pipe) */
+    uint64_t offset;                /* bytes of the log already reflected in the state */
+    uint64_t head_hash;             /* FNV-1a of the first head_len bytes */
+    uint32_t head_len;
+} SnapCheckpoint;
+
+typedef struct {
+    char     magic[8];
+    uint32_t hdr_size, rec_size;
+    uint32_t val_size, key_len;
+    uint64_t count;
+    uint64_t tag;
+    int64_t  counters[SNAP_COUNTERS];   /* caller's totals, clocks, ... */
+    SnapCheckpoint cp;
+    uint32_t pad;
+} SnapHeader;
+
+/* 0, or -1 with errno (path.tmp is removed again). */
+int snap_write(const char *path, const IPIndex *ix, uint64_t tag,
+               const int64_t counters[SNAP_COUNTERS], const SnapCheckpoint *cp);
+
+/* Fills an empty index (initialised with the same val_size), counters and
+   cp. 1 = loaded, 0 = no snapshot yet, -1 = unusable (reason on stderr,
+   ix left empty). */
+int snap_load(const char *path, IPIndex *ix, uint64_t tag,
+              int64_t counters[SNAP_COUNTERS], SnapCheckpoint *cp);
+
+/* Checkpoint of the regular file open on fd, read up to offset. */
+void snap_mark(SnapCheckpoint *cp, int fd, uint64_t offset);
+/* Offset to resume fd at: cp->offset if fd is the checkpointed file and it
+   is still at least that long, 0 otherwise (rotated, truncated, replaced). */
+uint64_t snap_resume(const SnapCheckpoint *cp, int fd);
+
+#endif
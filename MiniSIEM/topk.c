@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "topk.h"
+
+static void *ss_xmalloc(size_t n){
+    void *p = malloc(n ? n : 1);
+    if(!p){ perror("malloc"); exit(1); }
+    return p;
+}
+
+static uint32_t ss_hash(const char *s, size_t n){
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < n; i++){
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16; h *= 0x85ebca6bu;
+    h ^= h >> 13; h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+void ss_init(SpaceSaving *ss, size_t cap){
+    memset(ss, 0, sizeof *ss);
+    if(cap < 1) cap = 1;
+    ss->cap = cap;
+    ss->nslots = 16;
+    while(ss->nslots < cap * 2) ss->nslots *= 2;      /* load factor <= 0.5 */
+    ss->items = ss_xmalloc(cap * sizeof *ss->items);
+    ss->heap  = ss_xmalloc(cap * sizeof *ss->heap);
+    ss->slots = calloc(ss->nslots, sizeof *ss->slots);
+    if(!ss->slots){ perror("calloc"); exit(1); }
+}
+
+void ss_free(SpaceSaving *ss){
+    if(!ss) return;
+    free(ss->items);
+    free(ss->heap);
+    free(ss->slots);
+    memset(ss, 0, sizeof *ss);
+}
+
+/* ---- hash table ---- */
+
+static size_t key_len(size_t n){ return n < SS_KEY_MAX ? n : SS_KEY_MAX - 1; }
+
+static size_t find_slot(const SpaceSaving *ss, const char *key, size_t n, uint32_t h){
+    size_t mask = ss->nslots - 1;
+    for(size_t s = h & mask;; s = (s + 1) & mask){
+        uint32_t id1 = ss->slots[s];
+        if(!id1) return s;
+        const SSItem *it = &ss->items[id1 - 1];
+        if(it->hash == h && strlen(it->key) == n && memcmp(it->key, key, n) == 0) return s;
+    }
+}
+
+/* backward-shift deletion keeps probe chains intact without tombstones */
+static void slot_delete(SpaceSaving *ss, size_t s){
+    size_t mask = ss->nslots - 1;
+    size_t hole = s;
+    for(size_t j = (s + 1) & mask; ss->slots[j]; j = (j + 1) & mask){
+        size_t home = ss->items[ss->slots[j] - 1].hash & mask;
+        /* move j into the hole unless its home lies cyclically in (hole, j] */
+        if(((j - home) & mask) >= ((j - hole) & mask)){
+            ss->slots[hole] = ss->slots[j];
+            hole = j;
+        }
+    }
+    ss->slots[hole] = 0;
+}
+
+/* ---- min-heap on count ---- */
+
+static void heap_swap(SpaceSaving *ss, uint32_t a, uint32_t b){
+    uint32_t t = ss->heap[a];
+    ss->heap[a] = ss->heap[b];
+    ss->heap[b] = t;
+    ss->items[ss->heap[a]].heap_pos = a;
+    ss->items[ss->heap[b]].heap_pos = b;
+}
+
+static uint64_t heap_count(const SpaceSaving *ss, size_t i){ return ss->items[ss->heap[i]].count; }
+
+static void sift_up(SpaceSaving *ss, uint32_t i){
+    while(i){
+        uint32_t p = (i - 1) / 2;
+        if(heap_count(ss, p) <= heap_count(ss, i)) break;
+        heap_swap(ss, i, p);
+        i = p;
+    }
+}
+
+static void sift_down(SpaceSaving *ss, uint32_t i){
+    for(;;){
+        size_t l = 2 * (size_t)i + 1, r = l + 1, m = i;
+        if(l < ss->len && heap_count(ss, l) < heap_count(ss, m)) m = l;
+        if(r < ss->len && heap_count(ss, r) < heap_count(ss, m)) m = r;
+        if(m == i) return;
+        heap_swap(ss, i, (uint32_t)m);
+        i = (uint32_t)m;
+    }
+}
+
+/* ---- updates ---- */
+
+uint64_t ss_bound(const SpaceSaving *ss){
+    if(ss->len == ss->cap) return heap_count(ss, 0);
+    return ss->floor;
+}
+
+static void insert_item(SpaceSaving *ss, size_t slot, const char *key, size_t n,
+                        uint32_t h, uint64_t count, uint64_t err){
+    uint32_t idx = (uint32_t)ss->len++;
+    SSItem *it = &ss->items[idx];
+    memcpy(it->key, key, n);
+    it->key[n] = '\0';
+    it->hash = h;
+    it->count = count;
+    it->err = err;
+    it->heap_pos = idx;
+    ss->heap[idx] = idx;
+    ss->slots[slot] = idx + 1;
+    sift_up(ss, idx);
+}
+
+void ss_add(SpaceSaving *ss, const char *key, size_t n){
+    n = key_len(n);
+    uint32_t h = ss_hash(key, n);
+    size_t s = find_slot(ss, key, n, h);
+    ss->total++;
+
+    if(ss->slots[s]){
+        SSItem *it = &ss->items[ss->slots[s] - 1];
+        it->count++;
+        sift_down(ss, it->heap_pos);
+        return;
+    }
+    if(ss->len < ss->cap){
+        insert_item(ss, s, key, n, h, ss->floor + 1, ss->floor);
+        return;
+    }
+
+    /* evict the minimum: the newcomer inherits its counter as error */
+    uint32_t victim = ss->heap[0];
+    SSItem *it = &ss->items[victim];
+    uint64_t m = it->count;
+    slot_delete(ss, find_slot(ss, it->key, strlen(it->key), it->hash));
+    memcpy(it->key, key, n);
+    it->key[n] = '\0';
+    it->hash = h;
+    it->count = m + 1;
+    it->err = m;
+    ss->slots[find_slot(ss, key, n, h)] = victim + 1;   /* s may have moved */
+    sift_down(ss, 0);
+}
+
+/* ---- selection ---- */
+
+/* a ranks above b */
+static int item_above(const SSItem *a, const SSItem *b){
+    if(a->count != b->count) return a->count > b->count;
+    return strcmp(a->key, b->key) < 0;
+}
+
+static int item_cmp_desc(const void *a, const void *b){
+    const SSItem *x = a, *y = b;
+    if(item_above(x, y)) return -1;
+    if(item_above(y, x)) return 1;
+    return 0;
+}
+
+/* k best of src[0..n) into out (min-heap of size k on "above"), sorted desc */
+static size_t select_top(const SSItem *src, size_t n, SSItem *out, size_t k){
+    size_t len = 0;
+    for(size_t i = 0; i < n; i++){
+        size_t pos;
+        if(len < k){
+            pos = len++;
+            out[pos] = src[i];
+            while(pos){
+                size_t p = (pos - 1) / 2;
+                if(!item_above(&out[p], &out[pos])) break;
+                SSItem t = out[p]; out[p] = out[pos]; out[pos] = t;
+                pos = p;
+            }
+            continue;
+        }
+        if(!item_above(&src[i], &out[0])) continue;
+        out[0] = src[i];
+        pos = 0;
+        for(;;){
+            size_t l = 2 * pos + 1, r = l + 1, m = pos;
+            if(l < len && item_above(&out[m], &out[l])) m = l;
+            if(r < len && item_above(&out[m], &out[r])) m = r;
+            if(m == pos) break;
+            SSItem t = out[m]; out[m] = out[pos]; out[pos] = t;
+            pos = m;
+        }
+    }
+    qsort(out, len, sizeof *out, item_cmp_desc);
+    return len;
+}
+
+size_t ss_top(const SpaceSaving *ss, SSItem *out, size_t k){
+    return select_top(ss->items, ss->len, out, k);
+}
+
+/* ---- merge ---- */
+
+/*
+ * A key missing from one side may still have occurred there up to that
+ * side's bound, so it is credited with the bound (count and err both),
+ * which keeps every count an overestimate. Then the cap largest survive;
+ * whatever got pruned lifts the floor for keys we no longer track.
+ */
+void ss_merge(SpaceSaving *dst, const SpaceSaving *src){
+    uint64_t bd = ss_bound(dst), bs = ss_bound(src);
+    size_t n = 0, total = dst->len + src->len;
+    SSItem *all = ss_xmalloc(total * sizeof *all);
+    unsigned char *seen = calloc(src->len ? src->len : 1, 1);
+    if(!seen){ perror("calloc"); exit(1); }
+
+    for(size_t i = 0; i < dst->len; i++){
+        SSItem it = dst->items[i];
+        size_t s = find_slot(src, it.key, strlen(it.key), it.hash);
+        if(src->slots[s]){
+            const SSItem *o = &src->items[src->slots[s] - 1];
+            it.count += o->count;
+            it.err += o->err;
+            seen[src->slots[s] - 1] = 1;
+        } else {
+            it.count += bs;
+            it.err += bs;
+        }
+        all[n++] = it;
+    }
+    for(size_t i = 0; i < src->len; i++){
+        if(seen[i]) continue;
+        SSItem it = src->items[i];
+        it.count += bd;
+        it.err += bd;
+        all[n++] = it;
+    }
+    free(seen);
+
+    size_t cap = dst->cap;
+    SSItem *keep = ss_xmalloc(cap * sizeof *keep);
+    size_t kept = select_top(all, n, keep, cap);
+    uint64_t floor = bd + bs;
+    if(kept < n){
+        /* everything pruned ranks at or below the last survivor */
+        uint64_t pruned = keep[kept - 1].count;
+        if(pruned > floor) floor = pruned;
+    }
+    free(all);
+
+    uint64_t seen_total = dst->total + src->total;
+    memset(dst->slots, 0, dst->nslots * sizeof *dst->slots);
+    dst->len = 0;
+    for(size_t i = 0; i < kept; i++){
+        size_t kl = strlen(keep[i].key);
+        insert_item(dst, find_slot(dst, keep[i].key, kl, keep[i].hash),
+                    keep[i].key, kl, keep[i].hash, keep[i].count, keep[i].err);
+    }
+    free(keep);
+    dst->floor = floor;
+    dst->total = seen_total;
+}
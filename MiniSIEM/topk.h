@@ -0,0 +1,56 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Space-Saving heavy-hitter summary (Metwally et al.).
+ *
+ * Tracks at most `cap` keys in fixed memory: a hash table (linear probing,
+ * backward-shift deletion) finds a key's counter and a min-heap on the
+ * counts finds the one to evict. When a new key arrives and all counters
+ * are taken, it inherits the smallest counter, which becomes its `err`.
+ *
+ * Guarantees after N events: every reported count overestimates the true
+ * one by at most its err (count - err <= true <= count), err <= N / cap,
+ * and any key seen more than N / cap times is in the summary.
+ *
+ * Keys are up to SS_KEY_MAX - 1 bytes (longer ones are truncated).
+ */
+
+#define SS_KEY_MAX 64
+
+typedef struct {
+    char     key[SS_KEY_MAX];
+    uint64_t count;
+    uint64_t err;
+    uint32_t hash;
+    uint32_t heap_pos;
+} SSItem;
+
+typedef struct {
+    SSItem   *items;
+    uint32_t *heap;           /* item indices, min-heap on count */
+    uint32_t *slots;          /* item index + 1, 0 = empty */
+    size_t    len, cap, nslots;
+    uint64_t  total;          /* N: events seen */
+    uint64_t  floor;          /* bound for untracked keys left by ss_merge() */
+} SpaceSaving;
+
+void ss_init(SpaceSaving *ss, size_t cap);
+void ss_free(SpaceSaving *ss);
+
+/* one event for key (n bytes, need not be NUL-terminated) */
+void ss_add(SpaceSaving *ss, const char *key, size_t n);
+/* Fold src into dst (both summaries stay valid bounds for the union). */
+void ss_merge(SpaceSaving *dst, const SpaceSaving *src);
+
+/* Largest err any counter can carry right now (0 until the summary fills). */
+uint64_t ss_bound(const SpaceSaving *ss);
+
+/* Copy the k largest counters into out, count descending (ties by key).
+   Partial selection: O(len log k). Returns how many were written. */
+size_t ss_top(const SpaceSaving *ss, SSItem *out, size_t k);
+
+#endif
@@ -0,0 +1,289 @@
+// agent.c — key-caching agent for vault_aes (see agent.h)
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "agent.h"
+#include "crypto.h"
+
+#define REQ_LEN   (4 + STORE_SALT_LEN)
+#define REPLY_LEN (1 + STORE_KEY_LEN)
+
+/* --------- socket path --------- */
+
+/* Fills addr; with create, makes the private directory when using the /tmp
+   fallback. The directory has to be ours and not group/world accessible. */
+static int sock_addr(struct sockaddr_un *addr, int create){
+    char dir[sizeof addr->sun_path];
+    const char *env = getenv("VAULT_AGENT_SOCK");
+    const char *rt = getenv("XDG_RUNTIME_DIR");
+    memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+
+    int n;
+    if(env && *env){
+        n = snprintf(addr->sun_path, sizeof addr->sun_path, "%s", env);
+        if(n < 0 || (size_t)n >= sizeof addr->sun_path) return -1;
+        snprintf(dir, sizeof dir, "%s", addr->sun_path);
+        char *slash = strrchr(dir, '/');
+        if(!slash) snprintf(dir, sizeof dir, ".");
+        else if(slash == dir) slash[1] = 0;
+        else *slash = 0;
+    }else if(rt && *rt){
+        snprintf(dir, sizeof dir, "%s", rt);
+        n = snprintf(addr->sun_path, sizeof addr->sun_path, "%s/vault_aes.sock", rt);
+        if(n < 0 || (size_t)n >= sizeof addr->sun_path) return -1;
+    }else{
+        snprintf(dir, sizeof dir, "/tmp/vault_aes-%u", (unsigned)getuid());
+        if(create && mkdir(dir, 0700) != 0 && errno != EEXIST) return -1;
+        snprintf(addr->sun_path, sizeof addr->sun_path, "/tmp/vault_aes-%u/agent.sock", (unsigned)getuid());
+    }
+
+    struct stat st;
+    if(lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() ||
+       (st.st_mode & 077)){
+        if(create) fprintf(stderr, "agent: %s must be a directory owned by you with mode 0700\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+static int sock_connect(void){
+    struct sockaddr_un addr;
+    if(sock_addr(&addr, 0) != 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) return -1;
+    if(connect(fd, (struct sockaddr*)&addr, sizeof addr) != 0){ close(fd); return -1; }
+
+    /* the other end must be us too, not something squatting on the path */
+    struct ucred cr; socklen_t cl = sizeof cr;
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &cl) != 0 || cr.uid != getuid()){
+        close(fd); return -1;
+    }
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+    return fd;
+}
+
+static int read_full(int fd, void *buf, size_t n){
+    size_t got = 0;
+    while(got < n){
+        ssize_t r = read(fd, (char*)buf + got, n - got);
+        if(r < 0 && errno == EINTR) continue;
+        if(r <= 0) return -1;
+        got += (size_t)r;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t n){
+    size_t put = 0;
+    while(put < n){
+        ssize_t w = send(fd, (const char*)buf + put, n - put, MSG_NOSIGNAL);
+        if(w < 0 && errno == EINTR) continue;
+        if(w <= 0) return -1;
+        put += (size_t)w;
+    }
+    return 0;
+}
+
+/* --------- client --------- */
+
+static int request(const char op[4], const uint8_t *salt, uint8_t *reply){
+    uint8_t req[REQ_LEN] = {0};
+    int fd = sock_connect();
+    if(fd < 0) return -1;
+    memcpy(req, op, 4);
+    if(salt) memcpy(req + 4, salt, STORE_SALT_LEN);
+    int rc = write_full(fd, req, sizeof req);
+    if(rc == 0 && reply) rc = read_full(fd, reply, 1) != 0 || reply[0] != 'K' ? -1
+                            : read_full(fd, reply + 1, STORE_KEY_LEN);
+    close(fd);
+    return rc;
+}
+
+int agent_get(const uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN]){
+    uint8_t reply[REPLY_LEN];
+    int rc = request("GET", salt, reply);
+    if(rc == 0) memcpy(key, reply + 1, STORE_KEY_LEN);
+    secure_bzero(reply, sizeof reply);
+    return rc;
+}
+
+int agent_stop(void){
+    return request("BYE", NULL, NULL);
+}
+
+/* --------- agent --------- */
+
+static volatile sig_atomic_t g_quit;
+static void on_quit(int sig){ (void)sig; g_quit = 1; }
+
+/* CLOCK_BOOTTIME keeps counting through suspend: a TTL is wall time the key
+   sits in memory, not time the machine was awake */
+static uint64_t now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/* one request per connection; anything malformed just gets closed */
+static int serve_one(int cfd, const uint8_t *secret){
+    struct ucred cr; socklen_t cl = sizeof cr;
+    uint8_t req[REQ_LEN];
+    if(getsockopt(cfd, SOL_SOCKET, SO_PEERCRED, &cr, &cl) != 0 || cr.uid != getuid()) return 0;
+    if(read_full(cfd, req, sizeof req) != 0) return 0;
+
+    if(memcmp(req, "BYE", 4) == 0) return 1;
+    if(memcmp(req, "GET", 4) == 0){
+        uint8_t reply[REPLY_LEN];
+        if(memcmp(req + 4, secret, STORE_SALT_LEN) == 0){
+            reply[0] = 'K';
+            memcpy(reply + 1, secret + STORE_SALT_LEN, STORE_KEY_LEN);
+            write_full(cfd, reply, sizeof reply);
+        }else{
+            reply[0] = 'N';
+            write_full(cfd, reply, 1);
+        }
+        secure_bzero(reply, sizeof reply);
+    }
+    return 0;
+}
+
+static void agent_loop(int lfd, uint8_t *secret, unsigned ttl_sec){
+    uint64_t deadline = now_ms() + (uint64_t)ttl_sec * 1000u;
+    while(!g_quit){
+        uint64_t now = now_ms();
+        if(now >= deadline) break;
+        uint64_t left = deadline - now;
+        struct pollfd p = { lfd, POLLIN, 0 };
+        int r = poll(&p, 1, left > 60000 ? 60000 : (int)left);
+        if(r < 0 && errno != EINTR) break;
+        if(r <= 0) continue;
+
+        int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+        if(cfd < 0) continue;
+        struct timeval tv = { 1, 0 };      /* a stalled client can't wedge us */
+        setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+        setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+        int bye = serve_one(cfd, secret);
+        close(cfd);
+        if(bye) break;
+    }
+}
+
+int agent_start(const uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN],
+                unsigned ttl_sec){
+    struct sockaddr_un addr;
+    if(sock_addr(&addr, 1) != 0){
+        fprintf(stderr, "agent: no usable socket path (set VAULT_AGENT_SOCK)\n");
+        secure_bzero(key, STORE_KEY_LEN);
+        return -1;
+    }
+    int probe = sock_connect();
+    if(probe >= 0){
+        close(probe);
+        fprintf(stderr, "agent: one is already running on %s (vault_aes agent --stop)\n", addr.sun_path);
+        secure_bzero(key, STORE_KEY_LEN);
+        return -1;
+    }
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(lfd < 0){ perror("socket"); secure_bzero(key, STORE_KEY_LEN); return -1; }
+    unlink(addr.sun_path);                     /* stale socket from a dead agent */
+    mode_t old = umask(077);
+    int rc = bind(lfd, (struct sockaddr*)&addr, sizeof addr);
+    umask(old);
+    if(rc != 0 || listen(lfd, 16) != 0){
+        perror("agent: bind"); close(lfd); secure_bzero(key, STORE_KEY_LEN); return -1;
+    }
+
+    /* the child writes 0 once the key is locked in, or the errno that stopped it */
+    int ready[2];
+    if(pipe2(ready, O_CLOEXEC) != 0){ perror("pipe"); close(lfd); unlink(addr.sun_path); secure_bzero(key, STORE_KEY_LEN); return -1; }
+
+    pid_t pid = fork();
+    if(pid < 0){
+        perror("fork"); close(ready[0]); close(ready[1]); close(lfd); unlink(addr.sun_path);
+        secure_bzero(key, STORE_KEY_LEN); return -1;
+    }
+    if(pid > 0){
+        close(lfd);
+        close(ready[1]);
+        secure_bzero(key, STORE_KEY_LEN);
+        int err = EIO;                         /* EOF: the child died before it got there */
+        ssize_t r;
+        do r = read(ready[0], &err, sizeof err); while(r < 0 && errno == EINTR);
+        close(ready[0]);
+        if(r != (ssize_t)sizeof err) err = EIO;
+        if(err){
+            waitpid(pid, NULL, 0);
+            fprintf(stderr, "agent: could not lock the key in memory: %s%s\n", strerror(err),
+                    err == ENOMEM || err == EPERM || err == EAGAIN ? " (check ulimit -l)" : "");
+            return -1;
+        }
+        printf("Vault agent %d on %s, key expires in %u s\n", (int)pid, addr.sun_path, ttl_sec);
+        return 0;
+    }
+
+    /* child: detach, then lock the key down before copying it in */
+    close(ready[0]);
+    setsid();
+    prctl(PR_SET_DUMPABLE, 0);
+    struct rlimit nocore = { 0, 0 };
+    setrlimit(RLIMIT_CORE, &nocore);
+
+    size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+    uint8_t *secret = mmap(NULL, pg, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(secret == MAP_FAILED || mlock(secret, pg) != 0){
+        int err = errno;
+        secure_bzero(key, STORE_KEY_LEN);
+        unlink(addr.sun_path);
+        (void)!write(ready[1], &err, sizeof err);
+        _exit(1);
+    }
+    madvise(secret, pg, MADV_DONTDUMP);
+    memcpy(secret, salt, STORE_SALT_LEN);
+    memcpy(secret + STORE_SALT_LEN, key, STORE_KEY_LEN);
+    secure_bzero(key, STORE_KEY_LEN);         /* our copy of the caller's stack */
+
+    int dn = open("/dev/null", O_RDWR);
+    if(dn >= 0){ dup2(dn, 0); dup2(dn, 1); dup2(dn, 2); if(dn > 2) close(dn); }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_quit;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int ok = 0;
+    (void)!write(ready[1], &ok, sizeof ok);
+    close(ready[1]);
+    agent_loop(lfd, secret, ttl_sec);
+
+    secure_bzero(secret, pg);
+    munlock(secret, pg);
+    munmap(secret, pg);
+    close(lfd);
+    unlink(addr.sun_path);
+    _exit(0);
+}
@@ -0,0 +1,43 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <stdint.h>
+
+#include "store.h"
+
+/*
+ * vault agent: holds one vault's master key (the PBKDF2 output) so the
+ * commands after `vault_aes agent` skip the prompt and the KDF.
+ *
+ * The key sits in an mlocked, MADV_DONTDUMP page of a process that is not
+ * dumpable (no core files, no ptrace/proc access by other processes of the
+ * same user). It is wiped with secure_bzero when the TTL runs out (time
+ * spent suspended counts), on `vault_aes agent --stop`, and on
+ * SIGINT/SIGTERM/SIGHUP.
+ *
+ * Socket: $VAULT_AGENT_SOCK if set, else $XDG_RUNTIME_DIR/vault_aes.sock,
+ * else /tmp/vault_aes-<uid>/agent.sock. The directory must be ours and
+ * 0700, and every connection is checked with SO_PEERCRED: only our uid
+ * gets an answer.
+ *
+ * Protocol: one fixed-size request per connection.
+ *   request  op(4) | salt(16)         op "GET\0" or "BYE\0"
+ *   reply    'K' | key(32)            the key, if salt is the cached vault's
+ *            'N'                      anything else (wrong salt: rekeyed)
+ */
+
+#define AGENT_DEFAULT_TTL  900        /* seconds */
+
+/* Fork the agent for this key and return in the parent (0) once it has the
+   key in locked memory and is listening; -1 with a message on stderr (also
+   when the child can't mlock, e.g. RLIMIT_MEMLOCK). key is wiped either way. */
+int agent_start(const uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN],
+                unsigned ttl_sec);
+
+/* 0 and the key if a running agent holds one for salt; -1 otherwise (quietly). */
+int agent_get(const uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN]);
+
+/* Ask a running agent to wipe its key and exit. 0 if one answered. */
+int agent_stop(void);
+
+#endif
@@ -3,6 +3,8 @@
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/sha.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 int kdf_pbkdf2_sha256(const char *password,
@@ -19,6 +21,19 @@ int kdf_pbkdf2_sha256(const char *password,
     return 0;
 }
 
+int kdf_scrypt(const char *password,
+               const uint8_t *salt, size_t salt_len,
+               uint64_t N, uint32_t r, uint32_t p,
+               uint8_t *out_key, size_t out_key_len)
+{
+    if (!password || !salt || !out_key || out_key_len == 0) return -1;
+    /* what OpenSSL allocates: V (128*r*(N+2)) plus B (128*r*p) */
+    uint64_t maxmem = 128u * (uint64_t)r * (N + 2) + 128u * (uint64_t)r * p + 4096;
+    if (EVP_PBE_scrypt(password, strlen(password), salt, salt_len,
+                       N, r, p, maxmem, out_key, out_key_len) != 1) return -1;
+    return 0;
+}
+
 int aes256gcm_encrypt(const uint8_t *key,
                       const uint8_t *nonce, size_t nonce_len,
                       const uint8_t *pt, size_t pt_len,
@@ -85,6 +100,111 @@ done:
     return ok;
 }
 
+/* ---- reusable AEAD context ---- */
+
+/* OpenSSL lengths are int: feed at most this much per call */
+#define AEAD_CHUNK ((size_t)1 << 30)
+
+struct aead_ctx {
+    EVP_CIPHER_CTX *enc, *dec;   /* each keyed once; messages only reset the IV */
+    EVP_CIPHER_CTX *cur;         /* stream in progress */
+};
+
+static EVP_CIPHER_CTX *keyed_ctx(const uint8_t *key, int encrypt)
+{
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) return NULL;
+    if (EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL, encrypt) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, 12, NULL) != 1 ||
+        EVP_CipherInit_ex(ctx, NULL, NULL, key, NULL, encrypt) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+aead_ctx *aead_new(const uint8_t key[32])
+{
+    aead_ctx *c = calloc(1, sizeof *c);
+    if (!c) return NULL;
+    c->enc = keyed_ctx(key, 1);
+    c->dec = keyed_ctx(key, 0);
+    if (!c->enc || !c->dec) { aead_free(c); return NULL; }
+    return c;
+}
+
+void aead_free(aead_ctx *c)
+{
+    if (!c) return;
+    EVP_CIPHER_CTX_free(c->enc);   /* clears the expanded key */
+    EVP_CIPHER_CTX_free(c->dec);
+    free(c);
+}
+
+static int feed(EVP_CIPHER_CTX *ctx, const uint8_t *in, size_t n, uint8_t *out)
+{
+    while (n) {
+        int step = (int)(n < AEAD_CHUNK ? n : AEAD_CHUNK), outlen = 0;
+        if (EVP_CipherUpdate(ctx, out, &outlen, in, step) != 1) return -1;
+        in += step; n -= (size_t)step;
+        if (out) out += outlen;
+    }
+    return 0;
+}
+
+int aead_begin(aead_ctx *c, int encrypt, const uint8_t nonce[12],
+               const uint8_t *aad, size_t aad_len)
+{
+    c->cur = encrypt ? c->enc : c->dec;
+    if (EVP_CipherInit_ex(c->cur, NULL, NULL, NULL, nonce, encrypt) != 1) return -1;
+    return aad_len ? feed(c->cur, aad, aad_len, NULL) : 0;
+}
+
+int aead_update(aead_ctx *c, const uint8_t *in, size_t n, uint8_t *out)
+{
+    return c->cur ? feed(c->cur, in, n, out) : -1;
+}
+
+int aead_finish_seal(aead_ctx *c, uint8_t tag[16])
+{
+    uint8_t last[16];   /* GCM is a stream mode: Final emits nothing */
+    int outlen = 0;
+    if (c->cur != c->enc) return -1;
+    c->cur = NULL;
+    if (EVP_EncryptFinal_ex(c->enc, last, &outlen) != 1) return -1;
+    return EVP_CIPHER_CTX_ctrl(c->enc, EVP_CTRL_GCM_GET_TAG, 16, tag) == 1 ? 0 : -1;
+}
+
+int aead_finish_open(aead_ctx *c, const uint8_t tag[16])
+{
+    uint8_t last[16];
+    int outlen = 0;
+    if (c->cur != c->dec) return -1;
+    c->cur = NULL;
+    if (EVP_CIPHER_CTX_ctrl(c->dec, EVP_CTRL_GCM_SET_TAG, 16, (void*)tag) != 1) return -1;
+    return EVP_DecryptFinal_ex(c->dec, last, &outlen) == 1 ? 0 : -1;
+}
+
+int aead_seal(aead_ctx *c, const uint8_t nonce[12],
+              const uint8_t *pt, size_t pt_len,
+              const uint8_t *aad, size_t aad_len,
+              uint8_t *ct, uint8_t tag[16])
+{
+    if (aead_begin(c, 1, nonce, aad, aad_len) != 0 ||
+        aead_update(c, pt, pt_len, ct) != 0) { c->cur = NULL; return -1; }
+    return aead_finish_seal(c, tag);
+}
+
+int aead_open(aead_ctx *c, const uint8_t nonce[12],
+              const uint8_t *ct, size_t ct_len,
+              const uint8_t *aad, size_t aad_len,
+              const uint8_t tag[16], uint8_t *out_pt)
+{
+    if (aead_begin(c, 0, nonce, aad, aad_len) != 0 ||
+        aead_update(c, ct, ct_len, out_pt) != 0) { c->cur = NULL; return -1; }
+    return aead_finish_open(c, tag);
+}
+
 int crypto_rand(uint8_t *buf, size_t len) {
     return RAND_bytes(buf, (int)len) == 1 ? 0 : -1;
 }
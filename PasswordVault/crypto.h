@@ -10,6 +10,13 @@ int kdf_pbkdf2_sha256(const char *password,
                       uint32_t iters,
                       uint8_t *out_key, size_t out_key_len);
 
+/* Memory-hard KDF: scrypt with cost N (a power of two), block size r and
+   parallelism p. Needs about 128*r*N bytes. Returns 0 on success. */
+int kdf_scrypt(const char *password,
+               const uint8_t *salt, size_t salt_len,
+               uint64_t N, uint32_t r, uint32_t p,
+               uint8_t *out_key, size_t out_key_len);
+
 /* AEAD: AES-256-GCM encrypt/decrypt.
    - nonce_len must be 12 (GCM standard).
    - tag_len must be 16.
@@ -28,6 +35,38 @@ int aes256gcm_decrypt(const uint8_t *key,
                       const uint8_t *tag, size_t tag_len,
                       uint8_t *out_pt);
 
+/* Reusable AES-256-GCM context: the key is expanded once in aead_new()
+   and every message after that only sets a fresh nonce. Reuse one ctx
+   for many records instead of calling the one-shot functions per record.
+   Nonces are 12 bytes and tags 16. Lengths are size_t; anything over
+   INT_MAX is fed to OpenSSL in pieces. A ctx is not thread-safe. */
+typedef struct aead_ctx aead_ctx;
+
+aead_ctx *aead_new(const uint8_t key[32]);   /* NULL on failure */
+void aead_free(aead_ctx *c);                 /* wipes the key schedule */
+
+int aead_seal(aead_ctx *c, const uint8_t nonce[12],
+              const uint8_t *pt, size_t pt_len,
+              const uint8_t *aad, size_t aad_len,
+              uint8_t *ct, uint8_t tag[16]);
+/* -1 if the tag does not verify (out_pt must then be discarded) */
+int aead_open(aead_ctx *c, const uint8_t nonce[12],
+              const uint8_t *ct, size_t ct_len,
+              const uint8_t *aad, size_t aad_len,
+              const uint8_t tag[16], uint8_t *out_pt);
+
+/* Streaming, for data that does not fit one buffer:
+     aead_begin(c, encrypt, nonce, aad, aad_len);
+     aead_update(c, in, n, out);  ... as often as needed, out gets n bytes
+     aead_finish_seal(c, tag)  or  aead_finish_open(c, tag)
+   When decrypting, nothing aead_update() produced may be trusted until
+   aead_finish_open() returns 0. */
+int aead_begin(aead_ctx *c, int encrypt, const uint8_t nonce[12],
+               const uint8_t *aad, size_t aad_len);
+int aead_update(aead_ctx *c, const uint8_t *in, size_t n, uint8_t *out);
+int aead_finish_seal(aead_ctx *c, uint8_t tag[16]);
+int aead_finish_open(aead_ctx *c, const uint8_t tag[16]);
+
 /* Cryptographically secure random bytes. Returns 0 on success. */
 int crypto_rand(uint8_t *buf, size_t len);
 
@@ -0,0 +1,665 @@
+// store.c — VAES2 per-record vault store (see store.h for the layout)
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "crypto.h"
+#include "store.h"
+
+#define SALT_LEN    STORE_SALT_LEN
+#define NONCE_LEN   12
+#define TAG_LEN     16
+#define KEY_LEN     STORE_KEY_LEN
+#define HASH_LEN    16
+
+#define HDR_LEN     51
+#define OFF_KDF     6
+#define OFF_P1      7
+#define OFF_SALT    19
+#define OFF_SNAP    35
+#define OFF_END     43
+
+#define FRAME_HDR   (1 + 4 + NONCE_LEN)
+#define FRAME_OVH   (FRAME_HDR + TAG_LEN)
+#define ENT_LEN     (HASH_LEN + 8 + 4)
+#define MAX_FRAME   (64u << 20)
+
+typedef struct { uint8_t h[HASH_LEN]; uint64_t off; uint32_t len; } Ent;   /* len: whole frame */
+typedef struct { uint8_t op; Ent e; } JOp;
+
+struct Store {
+    int fd;
+    char path[4096];
+    uint8_t kdf;
+    uint32_t p[3];
+    uint8_t salt[SALT_LEN];
+    uint8_t master[KEY_LEN];           /* KDF output; kept for store_key() */
+    uint8_t k_rec[KEY_LEN], k_idx[KEY_LEN], k_name[KEY_LEN];
+    aead_ctx *a_rec, *a_idx;           /* keyed once per session, reused for every frame */
+    uint64_t snap_off, end_off;
+    Ent *snap; size_t nsnap;           /* sorted by (hash, off) */
+    JOp *jr;   size_t nj, capj;        /* journal after the snapshot, file order */
+    size_t nlive;
+    uint64_t live_bytes;               /* live record frames */
+};
+
+/* --------- little-endian fields --------- */
+static void put32(uint8_t *p, uint32_t v){ for(int i=0;i<4;i++) p[i] = (uint8_t)(v >> (8*i)); }
+static void put64(uint8_t *p, uint64_t v){ for(int i=0;i<8;i++) p[i] = (uint8_t)(v >> (8*i)); }
+static uint32_t get32(const uint8_t *p){ uint32_t v=0; for(int i=3;i>=0;i--) v = (v<<8) | p[i]; return v; }
+static uint64_t get64(const uint8_t *p){ uint64_t v=0; for(int i=7;i>=0;i--) v = (v<<8) | p[i]; return v; }
+
+static void put_ent(uint8_t *p, const Ent *e){ memcpy(p, e->h, HASH_LEN); put64(p+HASH_LEN, e->off); put32(p+HASH_LEN+8, e->len); }
+static void get_ent(const uint8_t *p, Ent *e){ memcpy(e->h, p, HASH_LEN); e->off = get64(p+HASH_LEN); e->len = get32(p+HASH_LEN+8); }
+
+static int pread_all(int fd, void *buf, size_t n, uint64_t off){
+    uint8_t *b = buf;
+    while(n){
+        ssize_t k = pread(fd, b, n, (off_t)off);
+        if(k < 0 && errno == EINTR) continue;
+        if(k <= 0) return -1;
+        b += k; n -= (size_t)k; off += (uint64_t)k;
+    }
+    return 0;
+}
+
+static int pwrite_all(int fd, const void *buf, size_t n, uint64_t off){
+    const uint8_t *b = buf;
+    while(n){
+        ssize_t k = pwrite(fd, b, n, (off_t)off);
+        if(k < 0 && errno == EINTR) continue;
+        if(k <= 0) return -1;
+        b += k; n -= (size_t)k; off += (uint64_t)k;
+    }
+    return 0;
+}
+
+/* --------- keys --------- */
+static int subkey(const uint8_t *master, const char *label, uint8_t *out){
+    unsigned int n = KEY_LEN;
+    return HMAC(EVP_sha256(), master, KEY_LEN, (const unsigned char*)label, strlen(label), out, &n) ? 0 : -1;
+}
+
+static void drop_ciphers(Store *s){
+    aead_free(s->a_rec); aead_free(s->a_idx);
+    s->a_rec = s->a_idx = NULL;
+}
+
+static int split_keys(Store *s){
+    int rc = subkey(s->master, "VAES2 records", s->k_rec) | subkey(s->master, "VAES2 index", s->k_idx)
+           | subkey(s->master, "VAES2 names", s->k_name);
+    if(rc != 0){ fprintf(stderr, "KDF failed\n"); return rc; }
+    drop_ciphers(s);                   /* rekey: the old keys go */
+    s->a_rec = aead_new(s->k_rec);
+    s->a_idx = aead_new(s->k_idx);
+    if(!s->a_rec || !s->a_idx){ fprintf(stderr, "cipher init failed\n"); return -1; }
+    return 0;
+}
+
+int store_kdf_check(const StoreKdf *k){
+    switch(k->id){
+    case STORE_KDF_PBKDF2:
+        if(k->p[0] < 1000){ fprintf(stderr, "PBKDF2 needs at least 1000 iterations\n"); return -1; }
+        return 0;
+    case STORE_KDF_SCRYPT:
+        if(k->p[0] < 10 || k->p[0] > 30 || k->p[1] < 1 || k->p[1] > 64 || k->p[2] < 1 || k->p[2] > 64 ||
+           128u * (uint64_t)k->p[1] << k->p[0] > (4ull << 30)){
+            fprintf(stderr, "scrypt parameters out of range (N=2^%u r=%u p=%u)\n", k->p[0], k->p[1], k->p[2]);
+            return -1;
+        }
+        return 0;
+    }
+    fprintf(stderr, "Unsupported KDF id %u\n", k->id);
+    return -1;
+}
+
+int store_derive(const StoreKdf *k, const char *password,
+                 const uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN]){
+    if(store_kdf_check(k) != 0) return -1;
+    int rc = k->id == STORE_KDF_PBKDF2
+           ? kdf_pbkdf2_sha256(password, salt, SALT_LEN, k->p[0], key, KEY_LEN)
+           : kdf_scrypt(password, salt, SALT_LEN, 1ull << k->p[0], k->p[1], k->p[2], key, KEY_LEN);
+    if(rc != 0) fprintf(stderr, "KDF failed\n");
+    return rc;
+}
+
+static int derive_keys(Store *s, const char *password){
+    StoreKdf k;
+    store_kdf(s, &k);
+    if(store_derive(&k, password, s->salt, s->master) != 0) return -1;
+    return split_keys(s);
+}
+
+/* keyed hash of a service name: equal names collide, nothing else leaks */
+static void name_hash(const Store *s, const char *svc, size_t n, uint8_t *out){
+    uint8_t full[32]; unsigned int len = sizeof full;
+    HMAC(EVP_sha256(), s->k_name, KEY_LEN, (const unsigned char*)svc, n, full, &len);
+    memcpy(out, full, HASH_LEN);
+}
+
+static size_t svc_len(const char *line){ return strcspn(line, "\t"); }
+
+/* --------- frames --------- */
+static void frame_aad(const Store *s, uint64_t off, uint8_t type, uint32_t len, uint8_t *aad){
+    memcpy(aad, s->salt, SALT_LEN);
+    put64(aad + SALT_LEN, off);
+    aad[SALT_LEN + 8] = type;
+    put32(aad + SALT_LEN + 9, len);
+}
+#define AAD_LEN (SALT_LEN + 8 + 1 + 4)
+
+static aead_ctx *frame_cipher(const Store *s, uint8_t type){ return type == 'R' ? s->a_rec : s->a_idx; }
+
+/* seal pt as a frame at off; returns the frame size, 0 on failure */
+static uint32_t write_frame(Store *s, int fd, uint8_t type, const uint8_t *pt, uint32_t n, uint64_t off){
+    uint32_t fsz = FRAME_OVH + n;
+    uint8_t *f = malloc(fsz);
+    if(!f) return 0;
+    f[0] = type;
+    put32(f + 1, n);
+    uint8_t aad[AAD_LEN];
+    frame_aad(s, off, type, n, aad);
+    uint32_t ok = 0;
+    if(crypto_rand(f + 5, NONCE_LEN) == 0 &&
+       aead_seal(frame_cipher(s, type), f + 5, pt, n, aad, AAD_LEN,
+                 f + FRAME_HDR, f + FRAME_HDR + n) == 0 &&
+       pwrite_all(fd, f, fsz, off) == 0) ok = fsz;
+    secure_bzero(f, fsz);
+    free(f);
+    return ok;
+}
+
+/* open a frame held in buf (its file offset is off); plaintext is malloc'd */
+static int open_frame(const Store *s, const uint8_t *f, size_t avail, uint64_t off,
+                      uint8_t want, uint8_t **pt, uint32_t *n){
+    if(avail < FRAME_OVH || f[0] != want) return -1;
+    uint32_t len = get32(f + 1);
+    if(len > MAX_FRAME || (size_t)len + FRAME_OVH > avail) return -1;
+    uint8_t aad[AAD_LEN];
+    frame_aad(s, off, want, len, aad);
+    uint8_t *out = malloc((size_t)len + 1);
+    if(!out) return -1;
+    if(aead_open(frame_cipher(s, want), f + 5, f + FRAME_HDR, len, aad, AAD_LEN,
+                 f + FRAME_HDR + len, out) != 0){ secure_bzero(out, len); free(out); return -1; }
+    out[len] = 0;
+    *pt = out; *n = len;
+    return 0;
+}
+
+static int read_frame(const Store *s, uint64_t off, uint32_t fsz, uint8_t want, uint8_t **pt, uint32_t *n){
+    if(fsz < FRAME_OVH || fsz > MAX_FRAME + FRAME_OVH || off + fsz > s->end_off) return -1;
+    uint8_t *f = malloc(fsz);
+    if(!f) return -1;
+    int rc = pread_all(s->fd, f, fsz, off) == 0 ? open_frame(s, f, fsz, off, want, pt, n) : -1;
+    free(f);
+    return rc;
+}
+
+/* --------- index --------- */
+static int ent_cmp_hash(const void *a, const void *b){
+    const Ent *x = a, *y = b;
+    int c = memcmp(x->h, y->h, HASH_LEN);
+    return c ? c : (x->off > y->off) - (x->off < y->off);
+}
+static int ent_cmp_off(const void *a, const void *b){
+    const Ent *x = a, *y = b;
+    return (x->off > y->off) - (x->off < y->off);
+}
+
+static int journal_deletes(const Store *s, uint64_t off){
+    for(size_t i = 0; i < s->nj; i++) if(s->jr[i].op == '-' && s->jr[i].e.off == off) return 1;
+    return 0;
+}
+
+/* live entries, sorted by offset (insertion order); caller frees */
+static Ent *live_entries(const Store *s, size_t *n){
+    Ent *v = malloc((s->nsnap + s->nj + 1) * sizeof *v);
+    if(!v) return NULL;
+    size_t k = 0;
+    for(size_t i = 0; i < s->nsnap; i++) v[k++] = s->snap[i];
+    for(size_t i = 0; i < s->nj; i++) if(s->jr[i].op == '+') v[k++] = s->jr[i].e;
+    qsort(v, k, sizeof *v, ent_cmp_off);
+    /* drop deleted ones: both lists are now in offset order */
+    Ent *del = malloc((s->nj + 1) * sizeof *del);
+    if(!del){ free(v); return NULL; }
+    size_t nd = 0;
+    for(size_t i = 0; i < s->nj; i++) if(s->jr[i].op == '-') del[nd++] = s->jr[i].e;
+    qsort(del, nd, sizeof *del, ent_cmp_off);
+    size_t out = 0, d = 0;
+    for(size_t i = 0; i < k; i++){
+        while(d < nd && del[d].off < v[i].off) d++;
+        if(d < nd && del[d].off == v[i].off) continue;
+        v[out++] = v[i];
+    }
+    free(del);
+    *n = out;
+    return v;
+}
+
+/* live entries for one hash, lowest offset first; returns how many (<= max) */
+static size_t lookup(const Store *s, const uint8_t *h, Ent *out, size_t max){
+    size_t lo = 0, hi = s->nsnap, k = 0;
+    while(lo < hi){ size_t mid = (lo + hi) / 2; if(memcmp(s->snap[mid].h, h, HASH_LEN) < 0) lo = mid + 1; else hi = mid; }
+    for(size_t i = lo; i < s->nsnap && k < max && !memcmp(s->snap[i].h, h, HASH_LEN); i++)
+        if(!journal_deletes(s, s->snap[i].off)) out[k++] = s->snap[i];
+    for(size_t i = 0; i < s->nj && k < max; i++)
+        if(s->jr[i].op == '+' && !memcmp(s->jr[i].e.h, h, HASH_LEN) && !journal_deletes(s, s->jr[i].e.off))
+            out[k++] = s->jr[i].e;
+    qsort(out, k, sizeof *out, ent_cmp_off);
+    return k;
+}
+
+static int journal_push(Store *s, uint8_t op, const Ent *e){
+    if(s->nj == s->capj){
+        size_t nc = s->capj ? s->capj * 2 : 16;
+        JOp *p = realloc(s->jr, nc * sizeof *p);
+        if(!p) return -1;
+        s->jr = p; s->capj = nc;
+    }
+    s->jr[s->nj].op = op;
+    s->jr[s->nj].e = *e;
+    s->nj++;
+    if(op == '+'){ s->nlive++; s->live_bytes += e->len; }
+    else         { s->nlive--; s->live_bytes -= e->len; }
+    return 0;
+}
+
+/* sorted snapshot of the given entries, sealed at off; returns frame size or 0 */
+static uint32_t write_snapshot(Store *s, int fd, Ent *v, size_t n, uint64_t off){
+    qsort(v, n, sizeof *v, ent_cmp_hash);
+    uint8_t *pt = malloc(n * ENT_LEN + 1);
+    if(!pt) return 0;
+    for(size_t i = 0; i < n; i++) put_ent(pt + i * ENT_LEN, &v[i]);
+    uint32_t fsz = write_frame(s, fd, 'S', pt, (uint32_t)(n * ENT_LEN), off);
+    free(pt);
+    return fsz;
+}
+
+static void header_bytes(const Store *s, uint8_t *h){
+    memset(h, 0, HDR_LEN);
+    memcpy(h, STORE_MAGIC, STORE_MAGIC_LEN);
+    h[OFF_KDF] = s->kdf;
+    for(int i = 0; i < 3; i++) put32(h + OFF_P1 + 4*i, s->p[i]);
+    memcpy(h + OFF_SALT, s->salt, SALT_LEN);
+    put64(h + OFF_SNAP, s->snap_off);
+    put64(h + OFF_END, s->end_off);
+}
+
+/* frames are on disk: make them durable, then point the header at them */
+static int commit(Store *s, int fd){
+    uint8_t offs[16];
+    put64(offs, s->snap_off);
+    put64(offs + 8, s->end_off);
+    if(fdatasync(fd) != 0 || pwrite_all(fd, offs, sizeof offs, OFF_SNAP) != 0 || fdatasync(fd) != 0){
+        perror("vault write");
+        return -1;
+    }
+    return 0;
+}
+
+/* --------- whole-file writes (create, compaction, rekey) --------- */
+
+/*
+ * Writes a fresh file at path.tmp with the store's current keys and salt:
+ * the lines as records, then one snapshot. Renamed over path on success.
+ * Leaves s->snap/end offsets and the in-memory index describing the new file.
+ */
+static int write_fresh(Store *s, const char *path, char *const *lines, size_t n){
+    char tmp[4200];
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd < 0){ perror("open tmp"); return -1; }
+    (void)flock(fd, LOCK_EX);          /* held on, once this is the vault */
+
+    Ent *v = malloc((n + 1) * sizeof *v);
+    if(!v){ close(fd); unlink(tmp); return -1; }
+    uint64_t off = HDR_LEN, live = 0;
+    for(size_t i = 0; i < n; i++){
+        uint32_t len = (uint32_t)strlen(lines[i]);
+        uint32_t fsz = write_frame(s, fd, 'R', (const uint8_t*)lines[i], len, off);
+        if(!fsz){ perror("vault write"); free(v); close(fd); unlink(tmp); return -1; }
+        name_hash(s, lines[i], svc_len(lines[i]), v[i].h);
+        v[i].off = off; v[i].len = fsz;
+        off += fsz; live += fsz;
+    }
+    s->snap_off = off;
+    uint32_t ssz = write_snapshot(s, fd, v, n, off);
+    s->end_off = off + ssz;
+    uint8_t h[HDR_LEN];
+    header_bytes(s, h);
+    if(!ssz || pwrite_all(fd, h, HDR_LEN, 0) != 0 || fsync(fd) != 0 || rename(tmp, path) != 0){
+        perror("vault write"); free(v); close(fd); unlink(tmp); return -1;
+    }
+
+    /* the new file is the store now (v is already sorted by hash) */
+    if(s->fd >= 0) close(s->fd);       /* drops the lock on the old inode with it */
+    s->fd = fd;
+    free(s->snap); s->snap = v; s->nsnap = n;
+    s->nj = 0;
+    s->nlive = n; s->live_bytes = live;
+    return 0;
+}
+
+int store_create(const char *path, const char *password, const StoreKdf *kdf,
+                 char *const *lines, size_t nlines){
+    Store s = { .fd = -1, .kdf = kdf->id, .p = { kdf->p[0], kdf->p[1], kdf->p[2] } };
+    if(crypto_rand(s.salt, SALT_LEN) != 0){ fprintf(stderr, "RAND(salt) failed\n"); return -1; }
+    if(derive_keys(&s, password) != 0){ drop_ciphers(&s); secure_bzero(&s, sizeof s); return -1; }
+    int rc = write_fresh(&s, path, lines, nlines);
+    if(s.fd >= 0) close(s.fd);
+    free(s.snap); free(s.jr);
+    drop_ciphers(&s);
+    secure_bzero(&s, sizeof s);
+    return rc;
+}
+
+/* decrypt the live records, in order, into owned lines */
+static char **all_lines(Store *s, size_t *n){
+    size_t k = 0;
+    Ent *v = live_entries(s, &k);
+    if(!v) return NULL;
+    char **lines = calloc(k + 1, sizeof *lines);
+    if(!lines){ free(v); return NULL; }
+    for(size_t i = 0; i < k; i++){
+        uint8_t *pt; uint32_t len;
+        if(read_frame(s, v[i].off, v[i].len, 'R', &pt, &len) != 0){
+            fprintf(stderr, "Vault record at %llu failed authentication.\n", (unsigned long long)v[i].off);
+            for(size_t j = 0; j < i; j++){ secure_bzero(lines[j], strlen(lines[j])); free(lines[j]); }
+            free(lines); free(v);
+            return NULL;
+        }
+        lines[i] = (char*)pt;
+    }
+    free(v);
+    *n = k;
+    return lines;
+}
+
+static void free_lines(char **lines, size_t n){
+    for(size_t i = 0; i < n; i++){ secure_bzero(lines[i], strlen(lines[i])); free(lines[i]); }
+    free(lines);
+}
+
+static int rewrite(Store *s){
+    size_t n = 0;
+    char **lines = all_lines(s, &n);
+    if(!lines) return -1;
+    int rc = write_fresh(s, s->path, lines, n);
+    free_lines(lines, n);
+    return rc;
+}
+
+void store_kdf(const Store *s, StoreKdf *out){
+    out->id = s->kdf;
+    memcpy(out->p, s->p, sizeof out->p);
+}
+
+int store_rekey(Store *s, const char *new_password, const StoreKdf *kdf){
+    if(kdf && store_kdf_check(kdf) != 0) return -1;
+    size_t n = 0;
+    char **lines = all_lines(s, &n);
+    if(!lines) return -1;
+    /* the new salt and keys stay in t until the new file is in place: a
+     * failed rekey leaves s keyed for the file that is still at s->path */
+    Store t = { .fd = -1, .kdf = s->kdf };
+    memcpy(t.p, s->p, sizeof t.p);
+    memcpy(t.path, s->path, sizeof t.path);
+    if(kdf){ t.kdf = kdf->id; memcpy(t.p, kdf->p, sizeof t.p); }
+    int rc = -1;
+    if(crypto_rand(t.salt, SALT_LEN) == 0 && derive_keys(&t, new_password) == 0)
+        rc = write_fresh(&t, t.path, lines, n);
+    free_lines(lines, n);
+    if(rc != 0){ free(t.snap); drop_ciphers(&t); secure_bzero(&t, sizeof t); return -1; }
+
+    /* t holds the new file now; the old one goes, the journal buffer stays */
+    JOp *jr = s->jr; size_t capj = s->capj;
+    if(s->fd >= 0) close(s->fd);
+    free(s->snap);
+    drop_ciphers(s);
+    *s = t;
+    s->jr = jr; s->capj = capj;
+    secure_bzero(&t, sizeof t);
+    return 0;
+}
+
+/* --------- open / close --------- */
+
+/* lock, and make sure the lock is on the file that is at path right now */
+static int open_locked(const char *path, int writable){
+    for(;;){
+        int fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+        if(fd < 0) return -1;
+        if(flock(fd, writable ? LOCK_EX : LOCK_SH) != 0){ close(fd); return -1; }
+        struct stat a, b;
+        if(fstat(fd, &a) == 0 && stat(path, &b) == 0 && a.st_ino == b.st_ino && a.st_dev == b.st_dev) return fd;
+        close(fd);                     /* replaced by a compaction while we waited */
+    }
+}
+
+static int load_index(Store *s){
+    uint8_t *pt; uint32_t n;
+    uint8_t fh[FRAME_HDR];
+    if(s->snap_off < HDR_LEN || s->snap_off + FRAME_OVH > s->end_off ||
+       pread_all(s->fd, fh, FRAME_HDR, s->snap_off) != 0) return -1;
+    uint32_t ssz = FRAME_OVH + get32(fh + 1);
+    if(read_frame(s, s->snap_off, ssz, 'S', &pt, &n) != 0 || n % ENT_LEN) return -1;
+    s->nsnap = n / ENT_LEN;
+    s->snap = malloc((s->nsnap + 1) * sizeof *s->snap);
+    if(!s->snap){ free(pt); return -1; }
+    for(size_t i = 0; i < s->nsnap; i++){
+        get_ent(pt + i * ENT_LEN, &s->snap[i]);
+        s->live_bytes += s->snap[i].len;
+    }
+    s->nlive = s->nsnap;
+    free(pt);
+
+    /* everything after the snapshot: records (skipped) and journal entries */
+    uint64_t off = s->snap_off + ssz, tail = s->end_off - off;
+    if(!tail) return 0;
+    uint8_t *buf = malloc(tail);
+    if(!buf || pread_all(s->fd, buf, tail, off) != 0){ free(buf); return -1; }
+    for(uint64_t at = 0; at < tail; ){
+        if(tail - at < FRAME_OVH){ free(buf); return -1; }
+        uint32_t fsz = FRAME_OVH + get32(buf + at + 1);
+        if(fsz > tail - at){ free(buf); return -1; }
+        if(buf[at] == 'J'){
+            Ent e;
+            if(open_frame(s, buf + at, fsz, off + at, 'J', &pt, &n) != 0 || n != 1 + ENT_LEN ||
+               (pt[0] != '+' && pt[0] != '-')){ free(buf); return -1; }
+            get_ent(pt + 1, &e);
+            int bad = journal_push(s, pt[0], &e);
+            free(pt);
+            if(bad){ free(buf); return -1; }
+        }else if(buf[at] != 'R'){ free(buf); return -1; }
+        at += fsz;
+    }
+    free(buf);
+    return 0;
+}
+
+/* password, or (password NULL) a master key from store_key() */
+static Store *open_store(const char *path, const char *password, const uint8_t *key, int writable){
+    Store *s = calloc(1, sizeof *s);
+    if(!s){ perror("calloc"); return NULL; }
+    snprintf(s->path, sizeof s->path, "%s", path);
+    s->fd = open_locked(path, writable);
+    if(s->fd < 0){ fprintf(stderr, "No vault. Run: ./vault_aes init\n"); free(s); return NULL; }
+
+    uint8_t h[HDR_LEN];
+    if(pread_all(s->fd, h, HDR_LEN, 0) != 0 || memcmp(h, STORE_MAGIC, STORE_MAGIC_LEN) != 0){
+        fprintf(stderr, "Not a VAES2 vault (bad magic)\n");
+        store_close(s); return NULL;
+    }
+    s->kdf = h[OFF_KDF];
+    for(int i = 0; i < 3; i++) s->p[i] = get32(h + OFF_P1 + 4*i);
+    memcpy(s->salt, h + OFF_SALT, SALT_LEN);
+    s->snap_off = get64(h + OFF_SNAP);
+    s->end_off = get64(h + OFF_END);
+    struct stat st;
+    if(fstat(s->fd, &st) != 0 || s->end_off > (uint64_t)st.st_size){
+        fprintf(stderr, "Corrupt vault (truncated)\n");
+        store_close(s); return NULL;
+    }
+    int rc;
+    if(password) rc = derive_keys(s, password);
+    else { memcpy(s->master, key, KEY_LEN); rc = split_keys(s); }
+    if(rc != 0){ store_close(s); return NULL; }
+    if(load_index(s) != 0){
+        fprintf(stderr, "Wrong master password or vault has been tampered.\n");
+        store_close(s); return NULL;
+    }
+    return s;
+}
+
+Store *store_open(const char *path, const char *password, int writable){
+    return open_store(path, password, NULL, writable);
+}
+
+Store *store_open_key(const char *path, const uint8_t key[STORE_KEY_LEN], int writable){
+    return open_store(path, NULL, key, writable);
+}
+
+void store_key(const Store *s, uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN]){
+    memcpy(salt, s->salt, SALT_LEN);
+    memcpy(key, s->master, KEY_LEN);
+}
+
+int store_peek_salt(const char *path, uint8_t salt[STORE_SALT_LEN]){
+    uint8_t h[HDR_LEN];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return -1;
+    int rc = pread_all(fd, h, HDR_LEN, 0);
+    close(fd);
+    if(rc != 0 || memcmp(h, STORE_MAGIC, STORE_MAGIC_LEN) != 0) return -1;
+    memcpy(salt, h + OFF_SALT, SALT_LEN);
+    return 0;
+}
+
+void store_close(Store *s){
+    if(!s) return;
+    if(s->fd >= 0) close(s->fd);
+    free(s->snap);
+    free(s->jr);
+    drop_ciphers(s);
+    secure_bzero(s, sizeof *s);
+    free(s);
+}
+
+size_t store_count(const Store *s){ return s->nlive; }
+
+/* --------- queries --------- */
+#define MAX_DUPS 64
+
+char *store_get(Store *s, const char *service){
+    uint8_t h[HASH_LEN];
+    Ent c[MAX_DUPS];
+    name_hash(s, service, strlen(service), h);
+    size_t k = lookup(s, h, c, MAX_DUPS);
+    for(size_t i = 0; i < k; i++){
+        uint8_t *pt; uint32_t n;
+        if(read_frame(s, c[i].off, c[i].len, 'R', &pt, &n) != 0){
+            fprintf(stderr, "Vault record failed authentication.\n");
+            return NULL;
+        }
+        size_t sl = svc_len((char*)pt);
+        if(sl == strlen(service) && !memcmp(pt, service, sl)) return (char*)pt;
+        secure_bzero(pt, n); free(pt);
+    }
+    return NULL;
+}
+
+int store_foreach(Store *s, int (*cb)(const char *line, void *ctx), void *ctx){
+    size_t n = 0;
+    char **lines = all_lines(s, &n);
+    if(!lines) return -1;
+    int rc = 0;
+    for(size_t i = 0; i < n && !rc; i++) rc = cb(lines[i], ctx);
+    free_lines(lines, n);
+    return 0;
+}
+
+/* --------- writes --------- */
+
+/* journal grows until it is a sixteenth of the snapshot (plus slack) */
+static int maybe_snapshot(Store *s){
+    if(s->nj <= 64 + s->nsnap / 16) return 0;
+    size_t n = 0;
+    Ent *v = live_entries(s, &n);
+    if(!v) return -1;
+    uint32_t ssz = write_snapshot(s, s->fd, v, n, s->end_off);
+    if(!ssz){ free(v); return -1; }
+    s->snap_off = s->end_off;
+    s->end_off += ssz;
+    free(s->snap); s->snap = v; s->nsnap = n;
+    s->nj = 0;
+    return 0;
+}
+
+/* garbage (old snapshots, removed records) over half the file: compact */
+static int maybe_compact(Store *s){
+    uint64_t live = HDR_LEN + s->live_bytes + FRAME_OVH + (uint64_t)s->nlive * ENT_LEN;
+    if(s->end_off <= 2 * live + (256u << 10)) return 0;
+    return rewrite(s);
+}
+
+static uint32_t append_journal(Store *s, uint8_t op, const Ent *e){
+    uint8_t pt[1 + ENT_LEN];
+    pt[0] = op;
+    put_ent(pt + 1, e);
+    return write_frame(s, s->fd, 'J', pt, sizeof pt, s->end_off);
+}
+
+int store_add(Store *s, const char *service, const char *line){
+    Ent e;
+    name_hash(s, service, strlen(service), e.h);
+    e.off = s->end_off;
+    e.len = write_frame(s, s->fd, 'R', (const uint8_t*)line, (uint32_t)strlen(line), e.off);
+    if(!e.len){ perror("vault write"); return -1; }
+    s->end_off += e.len;
+    uint32_t jsz = append_journal(s, '+', &e);
+    if(!jsz || journal_push(s, '+', &e) != 0){ perror("vault write"); return -1; }
+    s->end_off += jsz;
+    if(maybe_snapshot(s) != 0 || commit(s, s->fd) != 0) return -1;
+    return maybe_compact(s);
+}
+
+int store_remove(Store *s, const char *service){
+    uint8_t h[HASH_LEN];
+    Ent c[MAX_DUPS];
+    name_hash(s, service, strlen(service), h);
+    size_t k = lookup(s, h, c, MAX_DUPS);
+    for(size_t i = 0; i < k; i++){
+        uint8_t *pt; uint32_t n;
+        if(read_frame(s, c[i].off, c[i].len, 'R', &pt, &n) != 0) return -1;
+        size_t sl = svc_len((char*)pt);
+        int match = sl == strlen(service) && !memcmp(pt, service, sl);
+        secure_bzero(pt, n); free(pt);
+        if(!match) continue;
+
+        uint32_t jsz = append_journal(s, '-', &c[i]);
+        if(!jsz || journal_push(s, '-', &c[i]) != 0){ perror("vault write"); return -1; }
+        s->end_off += jsz;
+        if(maybe_snapshot(s) != 0 || commit(s, s->fd) != 0) return -1;
+
+        /* committed: now scrub the sealed record itself */
+        uint8_t *junk = malloc(c[i].len);
+        if(junk && crypto_rand(junk, c[i].len) == 0){
+            junk[0] = 'R';
+            put32(junk + 1, c[i].len - FRAME_OVH);
+            (void)pwrite_all(s->fd, junk, c[i].len, c[i].off);
+            (void)fdatasync(s->fd);
+        }
+        free(junk);
+        return maybe_compact(s) == 0 ? 0 : -1;
+    }
+    return 1;
+}
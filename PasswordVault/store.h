@@ -0,0 +1,83 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * VAES2 vault store: every entry is sealed on its own, and an encrypted
+ * index keyed by HMAC(index key, service) says where each one lives. A
+ * lookup decrypts the index and one record; add/remove append a record
+ * and a small journal entry instead of rewriting the file.
+ *
+ * Layout (all integers little endian):
+ *   MAGIC "VAES2\n"(6) | kdf(1) | p1(4) | p2(4) | p3(4) | salt(16)
+ *   | snap_off(8) | end_off(8)                       -- 51-byte header
+ *   frames...
+ *
+ * A frame is type(1) | len(4) | nonce(12) | ciphertext(len) | tag(16),
+ * sealed with AAD = salt | frame offset(8) | type | len, so frames cannot
+ * be moved around or spliced in from another vault. Types:
+ *   'R'  record: "service\tuser\tpass"
+ *   'S'  index snapshot: (hash16, off8, len4) entries sorted by hash
+ *   'J'  journal: op('+'/'-') followed by one such entry
+ * snap_off names the current snapshot; the journal frames after it are
+ * applied on top. Bytes past end_off are an uncommitted append and are
+ * ignored: writers sync the frames first and only then patch the two
+ * header offsets. Removed records are overwritten in place.
+ *
+ * kdf 1 = PBKDF2-HMAC-SHA256 with p1 iterations (p2, p3 unused).
+ * kdf 2 = scrypt with N = 2^p1, r = p2, p = p3 (about 128*r*N bytes).
+ */
+
+#define STORE_MAGIC     "VAES2\n"
+#define STORE_MAGIC_LEN 6
+#define STORE_KDF_PBKDF2 1
+#define STORE_KDF_SCRYPT 2
+#define STORE_SALT_LEN  16
+#define STORE_KEY_LEN   32
+
+typedef struct Store Store;
+
+/* KDF id and its three header parameters (meaning per id, see above) */
+typedef struct { uint8_t id; uint32_t p[3]; } StoreKdf;
+
+/* Parameters the store accepts (sane ranges, at most 4 GiB for scrypt).
+   0, or -1 with a reason on stderr. */
+int store_kdf_check(const StoreKdf *k);
+/* Run the KDF; what unlocking a vault with these parameters costs. */
+int store_derive(const StoreKdf *k, const char *password,
+                 const uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN]);
+
+/* New vault at path (atomically, via path.tmp) holding the given lines.
+   0 on success; -1 with a message on stderr. */
+int store_create(const char *path, const char *password, const StoreKdf *kdf,
+                 char *const *lines, size_t nlines);
+
+/* Opens and unlocks. writable takes the file lock exclusively for the
+   session. NULL with a message on stderr (wrong password included). */
+Store *store_open(const char *path, const char *password, int writable);
+/* Same, with the master key store_key() handed out: no KDF run. */
+Store *store_open_key(const char *path, const uint8_t key[STORE_KEY_LEN], int writable);
+/* The open vault's salt and KDF output; a key is only good for that salt. */
+void store_key(const Store *s, uint8_t salt[STORE_SALT_LEN], uint8_t key[STORE_KEY_LEN]);
+/* Salt of the VAES2 file at path without unlocking it; -1 if it is not one. */
+int store_peek_salt(const char *path, uint8_t salt[STORE_SALT_LEN]);
+void store_close(Store *s);
+
+/* First entry for the service, "service\tuser\tpass" (caller wipes and frees), or NULL. */
+char *store_get(Store *s, const char *service);
+/* Every entry in insertion order; cb returns nonzero to stop. */
+int store_foreach(Store *s, int (*cb)(const char *line, void *ctx), void *ctx);
+size_t store_count(const Store *s);
+
+int store_add(Store *s, const char *service, const char *line);
+/* 0 removed, 1 no such service, -1 error */
+int store_remove(Store *s, const char *service);
+/* Re-encrypt everything under a new password (fresh salt); kdf NULL keeps
+   the current KDF and parameters. */
+int store_rekey(Store *s, const char *new_password, const StoreKdf *kdf);
+/* The open vault's KDF and parameters */
+void store_kdf(const Store *s, StoreKdf *out);
+
+#endif
@@ -1,5 +1,5 @@
 // vault_aes.c — AES-GCM + PBKDF2 password vault (with rekey/search/remove)
-// Build: gcc -std=gnu99 -Wall -Wextra -Wpedantic -O2 -o vault_aes vault_aes.c crypto.c -lcrypto
+// Build: gcc -std=gnu99 -Wall -Wextra -Wpedantic -O2 -o vault_aes vault_aes.c store.c agent.c crypto.c -lcrypto
 
 #define _POSIX_C_SOURCE 200809L
 
@@ -8,13 +8,18 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <termios.h>
 #include <unistd.h>
+#include "agent.h"
 #include "crypto.h"
+#include "store.h"
 
 /* --------- Vault format constants --------- */
-#define MAGIC         "VAES1\n"
+#define MAGIC         "VAES1\n"      /* legacy single-blob format; VAES2 lives in store.c */
 #define MAGIC_LEN     6
 #define VAULT_FILE    "vault_aes.dat"
 
@@ -22,7 +27,12 @@
 #define NONCE_LEN     12
 #define TAG_LEN       16
 #define KEY_LEN       32            /* AES-256 */
-#define PBKDF2_ITERS  200000u       /* tune for your box */
+#define PBKDF2_ITERS  200000u       /* default; `bench-kdf` / --target calibrate instead */
+#define KDF_TARGET_MS 250u          /* bench-kdf's default unlock budget */
+#define SCRYPT_MEM_MB 64u           /* --kdf scrypt without --mem */
+#define SCRYPT_MEM_MIN_MB 16u       /* --target calibration starts here... */
+#define SCRYPT_MEM_MAX_MB 1024u     /* ...and grows memory up to this, or --mem */
+#define SCRYPT_R      8u
 
 #define MAX_LINE      1024
 
@@ -56,7 +66,9 @@ static char *prompt_hidden(const char *prompt){
     fprintf(stderr, "\n");
 
     buf[strcspn(buf, "\r\n")] = 0;
-    return xstrdup(buf); /* caller frees */
+    char *pw = xstrdup(buf); /* caller frees */
+    secure_bzero(buf, sizeof buf);
+    return pw;
 }
 
 /* --------- TSV lines in memory --------- */
@@ -78,27 +90,6 @@ static void lines_free(Lines *L){
     L->rows=NULL; L->len=L->cap=0;
 }
 
-/* Serialize lines -> single plaintext blob (with header) */
-static unsigned char *serialize(const Lines *L, size_t *outlen){
-    const char *hdr = "# AES_VAULT (authenticated)\n";
-    size_t total = strlen(hdr);
-    for(size_t i=0;i<L->len;i++) total += strlen(L->rows[i]) + 1;
-
-    unsigned char *buf = (unsigned char*)malloc(total + 1);
-    if(!buf) die("malloc");
-
-    size_t off = 0;
-    memcpy(buf+off, hdr, strlen(hdr)); off += strlen(hdr);
-    for(size_t i=0;i<L->len;i++){
-        size_t n = strlen(L->rows[i]);
-        memcpy(buf+off, L->rows[i], n); off += n;
-        buf[off++] = '\n';
-    }
-    buf[off] = '\0';
-    *outlen = off;
-    return buf;
-}
-
 /* Parse plaintext blob -> lines (skip header lines starting with '#') */
 static void parse_lines(Lines *L, char *plain){
     L->rows=NULL; L->len=L->cap=0;
@@ -126,66 +117,11 @@ static unsigned char *read_all(const char *path, size_t *sz){
     return buf;
 }
 
-static void write_all_atomic(const char *path, const uint8_t *data, size_t n){
-    char tmp[256]; snprintf(tmp, sizeof tmp, "%s.tmp", path);
-    FILE *f = fopen(tmp, "wb"); if(!f) die("fopen tmp");
-    if(fwrite(data,1,n,f)!=n) die("fwrite");
-    if(fclose(f)!=0) die("fclose");
-    if(rename(tmp, path)!=0) die("rename");
-    chmod(path, 0600); /* owner-only perms */
-}
-
-/* --------- AES-GCM vault read/write --------- */
+/* --------- VAES1 (legacy, read-only: migrated to VAES2 on first use) --------- */
 /* Layout:
    MAGIC(6) | iters(4 LE) | salt(16) | nonce(12) | ct_len(4 LE) | ciphertext | tag(16)
 */
 
-static void save_vault(const Lines *L, const char *password){
-    /* fresh salt + nonce */
-    uint8_t salt[SALT_LEN], nonce[NONCE_LEN];
-    if(crypto_rand(salt, SALT_LEN)!=0)   die("RAND(salt)");
-    if(crypto_rand(nonce, NONCE_LEN)!=0) die("RAND(nonce)");
-
-    /* serialize */
-    size_t plen=0; unsigned char *plain = serialize(L, &plen);
-
-    /* derive key */
-    uint8_t key[KEY_LEN];
-    if(kdf_pbkdf2_sha256(password, salt, SALT_LEN, PBKDF2_ITERS, key, KEY_LEN)!=0){
-        fprintf(stderr, "KDF failed\n"); exit(1);
-    }
-
-    /* encrypt */
-    uint8_t *ct = (uint8_t*)malloc(plen); if(!ct) die("malloc");
-    uint8_t tag[TAG_LEN];
-    if(aes256gcm_encrypt(key, nonce, NONCE_LEN, plain, plen, NULL, 0, ct, tag, TAG_LEN) != 0){
-        fprintf(stderr, "encrypt failed\n"); exit(1);
-    }
-
-    /* assemble */
-    uint32_t iters_le  = PBKDF2_ITERS;
-    uint32_t ct_len_le = (uint32_t)plen;
-    size_t outsz = MAGIC_LEN + 4 + SALT_LEN + NONCE_LEN + 4 + (size_t)ct_len_le + TAG_LEN;
-    uint8_t *out = (uint8_t*)malloc(outsz); if(!out) die("malloc");
-
-    size_t off=0;
-    memcpy(out+off, MAGIC, MAGIC_LEN); off+=MAGIC_LEN;
-    memcpy(out+off, &iters_le, 4);     off+=4;
-    memcpy(out+off, salt, SALT_LEN);   off+=SALT_LEN;
-    memcpy(out+off, nonce, NONCE_LEN); off+=NONCE_LEN;
-    memcpy(out+off, &ct_len_le, 4);    off+=4;
-    memcpy(out+off, ct, ct_len_le);    off+=ct_len_le;
-    memcpy(out+off, tag, TAG_LEN);     off+=TAG_LEN;
-
-    write_all_atomic(VAULT_FILE, out, outsz);
-
-    /* scrub */
-    secure_bzero(key, KEY_LEN);
-    secure_bzero(plain, plen); free(plain);
-    secure_bzero(ct, plen);    free(ct);
-    secure_bzero(out, outsz);  free(out);
-}
-
 static void load_vault(Lines *L, const char *password){
     size_t sz=0;
     uint8_t *buf = read_all(VAULT_FILE, &sz);
@@ -233,6 +169,192 @@ static void load_vault(Lines *L, const char *password){
     secure_bzero(buf, sz); free(buf);
 }
 
+/* Open the VAES2 store, upgrading a VAES1 file in place first. */
+/* The VAES1 vault kept aside by the upgrade: the migration never destroys the only copy. */
+#define VAULT_V1_BAK  VAULT_FILE ".v1.bak"
+
+/*
+ * Exclusive lock on the file that is at VAULT_FILE right now (-1 if there is
+ * none). Another process may finish the upgrade while we wait, so the lock
+ * only counts once path and fd still name the same inode.
+ */
+static int lock_vault(void){
+    for(;;){
+        int fd = open(VAULT_FILE, O_RDONLY | O_CLOEXEC);     /* flock needs no write access */
+        if(fd < 0) return -1;
+        if(flock(fd, LOCK_EX) != 0){ close(fd); return -1; }
+        struct stat a, b;
+        if(fstat(fd, &a) == 0 && stat(VAULT_FILE, &b) == 0 && a.st_ino == b.st_ino && a.st_dev == b.st_dev) return fd;
+        close(fd);
+    }
+}
+
+static Store *open_vault(const char *password, int writable){
+    char magic[MAGIC_LEN] = {0};
+    int fd = lock_vault();
+    if(fd >= 0){
+        ssize_t n = pread(fd, magic, MAGIC_LEN, 0);
+        if(n == MAGIC_LEN && memcmp(magic, MAGIC, MAGIC_LEN) == 0){
+            Lines L; load_vault(&L, password);               /* exits on a wrong password */
+            /* hard link first: the rename in store_create then only unlinks a name */
+            if(link(VAULT_FILE, VAULT_V1_BAK) != 0){
+                fprintf(stderr, "Upgrade to VAES2 needs %s: %s; %s left as it was.\n",
+                        VAULT_V1_BAK, strerror(errno), VAULT_FILE);
+                lines_free(&L); close(fd);
+                return NULL;
+            }
+            StoreKdf k = { STORE_KDF_PBKDF2, { PBKDF2_ITERS, 0, 0 } };
+            int rc = store_create(VAULT_FILE, password, &k, L.rows, L.len);
+            lines_free(&L);
+            if(rc != 0){
+                unlink(VAULT_V1_BAK);
+                close(fd);
+                fprintf(stderr, "Upgrade to VAES2 failed; %s left as it was.\n", VAULT_FILE);
+                return NULL;
+            }
+            fprintf(stderr, "Upgraded %s to the VAES2 format (old vault kept as %s).\n", VAULT_FILE, VAULT_V1_BAK);
+        }
+        close(fd);                                          /* waiters re-check and open the new file */
+    }
+    return store_open(VAULT_FILE, password, writable);
+}
+
+/* Key from a running agent if it has this vault's, else prompt (and run the KDF). */
+static Store *unlock_vault(int writable){
+    uint8_t salt[STORE_SALT_LEN], key[STORE_KEY_LEN];
+    if(store_peek_salt(VAULT_FILE, salt) == 0 && agent_get(salt, key) == 0){
+        Store *S = store_open_key(VAULT_FILE, key, writable);
+        secure_bzero(key, sizeof key);
+        if(S) return S;
+    }
+    char *pw = prompt_hidden("Master password: ");
+    if(!pw){ fprintf(stderr,"password input failed\n"); return NULL; }
+    Store *S = open_vault(pw, writable);
+    secure_bzero(pw, strlen(pw)); free(pw);
+    return S;
+}
+
+/* --------- KDF selection / calibration --------- */
+typedef struct {
+    int scrypt;
+    unsigned iters;        /* PBKDF2; 0 = default or calibrated */
+    unsigned mem_mb;       /* scrypt memory; with --target, the most calibration may use */
+    unsigned parallel;     /* scrypt p; 0 = 1, or calibrated */
+    unsigned target_ms;    /* 0 = no calibration */
+} KdfOpts;
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+/* wall time of one derivation with k (ms); -1 on failure */
+static double time_kdf(const StoreKdf *k){
+    uint8_t salt[SALT_LEN] = {0}, key[KEY_LEN];
+    double t0 = now_ms();
+    if(store_derive(k, "calibration password", salt, key) != 0) return -1;
+    double t = now_ms() - t0;
+    secure_bzero(key, sizeof key);
+    return t;
+}
+
+static unsigned log2_floor(uint64_t v){ unsigned n = 0; while(v >>= 1) n++; return n; }
+
+static StoreKdf scrypt_kdf(unsigned mem_mb, unsigned parallel){
+    /* 128*r*N bytes: largest power-of-two N that fits in mem_mb */
+    StoreKdf k = { STORE_KDF_SCRYPT, { log2_floor(((uint64_t)mem_mb << 20) / (128u * SCRYPT_R)), SCRYPT_R, parallel } };
+    return k;
+}
+
+/* PBKDF2: scale a short run up to target. scrypt: N (memory) is doubled
+   while the next step still fits the target, since an attacker pays for
+   memory times time and N raises both. p only buys time (OpenSSL runs the
+   lanes one after another in the same V), so it is raised last, and only
+   once N has hit the --mem cap. */
+static int calibrate(const KdfOpts *o, StoreKdf *out, double *took){
+    if(!o->scrypt){
+        StoreKdf k = { STORE_KDF_PBKDF2, { 20000, 0, 0 } };
+        double t = time_kdf(&k);
+        while(t >= 0 && t < 50 && k.p[0] < (1u << 28)){ k.p[0] *= 4; t = time_kdf(&k); }
+        if(t < 0) return -1;
+        double iters = (double)k.p[0] * o->target_ms / t;
+        k.p[0] = iters < 10000 ? 10000u : iters > 4e9 ? 4000000000u : (uint32_t)(iters / 1000) * 1000;
+        *out = k;
+        *took = time_kdf(out);
+        return *took < 0 ? -1 : 0;
+    }
+    unsigned cap = o->mem_mb ? o->mem_mb : SCRYPT_MEM_MAX_MB;
+    unsigned nmax = scrypt_kdf(cap, 1).p[0];
+    StoreKdf k = scrypt_kdf(cap < SCRYPT_MEM_MIN_MB ? cap : SCRYPT_MEM_MIN_MB, 1);
+    if(store_kdf_check(&k) != 0) return -1;
+    double t = time_kdf(&k);
+    if(t < 0) return -1;
+    while(t > o->target_ms && k.p[0] > 10){        /* one lane is already too slow */
+        k.p[0]--;
+        if((t = time_kdf(&k)) < 0) return -1;
+    }
+    while(k.p[0] < nmax && 2 * t <= o->target_ms){
+        k.p[0]++;
+        double t2 = time_kdf(&k);
+        if(t2 < 0){                                 /* out of memory: stop one below */
+            k.p[0]--; nmax = k.p[0];
+            break;
+        }
+        t = t2;
+    }
+    if(k.p[0] == nmax){
+        double lanes = o->target_ms / t;
+        k.p[2] = lanes < 1 ? 1u : lanes > 64 ? 64u : (uint32_t)lanes;
+    }
+    *out = k;
+    *took = k.p[2] == 1 ? t : time_kdf(out);
+    return *took < 0 ? -1 : 0;
+}
+
+/* --kdf pbkdf2|scrypt --iters N --mem MiB --parallel P --target MS */
+static int parse_kdf_arg(int argc, char **argv, int *i, KdfOpts *o){
+    const char *a = argv[*i];
+    if(*i + 1 >= argc) return 0;
+    if(strcmp(a,"--kdf")==0){
+        const char *v = argv[++*i];
+        if(strcmp(v,"scrypt")==0) o->scrypt = 1;
+        else if(strcmp(v,"pbkdf2")==0) o->scrypt = 0;
+        else { fprintf(stderr,"--kdf is pbkdf2 or scrypt\n"); return -1; }
+        return 1;
+    }
+    unsigned *dst = strcmp(a,"--iters")==0 ? &o->iters : strcmp(a,"--mem")==0 ? &o->mem_mb :
+                    strcmp(a,"--parallel")==0 ? &o->parallel : strcmp(a,"--target")==0 ? &o->target_ms : NULL;
+    if(!dst) return 0;
+    char *end; unsigned long v = strtoul(argv[++*i], &end, 10);
+    if(*end || v == 0 || v > 4000000000ul){ fprintf(stderr,"%s wants a positive number\n", a); return -1; }
+    *dst = (unsigned)v;
+    if(dst == &o->mem_mb || dst == &o->parallel) o->scrypt = 1;
+    return 1;
+}
+
+/* parameters for init/rekey: explicit ones win, --target calibrates the rest */
+static int resolve_kdf(const KdfOpts *o, StoreKdf *k){
+    if(o->target_ms && !o->iters && !o->parallel){
+        double took;
+        fprintf(stderr, "Calibrating KDF for %u ms...\n", o->target_ms);
+        if(calibrate(o, k, &took) != 0) return -1;
+        fprintf(stderr, "Using %s (%.0f ms here)\n", k->id == STORE_KDF_SCRYPT ? "scrypt" : "PBKDF2", took);
+        return 0;
+    }
+    if(o->scrypt) *k = scrypt_kdf(o->mem_mb ? o->mem_mb : SCRYPT_MEM_MB, o->parallel ? o->parallel : 1);
+    else { k->id = STORE_KDF_PBKDF2; k->p[0] = o->iters ? o->iters : PBKDF2_ITERS; k->p[1] = k->p[2] = 0; }
+    return store_kdf_check(k);
+}
+
+static void print_kdf(FILE *f, const StoreKdf *k){
+    if(k->id == STORE_KDF_SCRYPT)
+        fprintf(f, "scrypt N=2^%u r=%u p=%u (%llu MiB)", k->p[0], k->p[1], k->p[2],
+                (unsigned long long)(((uint64_t)128u * k->p[1] << k->p[0]) >> 20));
+    else
+        fprintf(f, "PBKDF2-SHA256 %u iterations", k->p[0]);
+}
+
 /* --------- Phase 4 helpers (case-insensitive search) --------- */
 static int ieq(char a, char b){
     if(a>='A'&&a<='Z') a = (char)(a - 'A' + 'a');
@@ -251,11 +373,13 @@ static int contains_icase(const char *hay, const char *needle){
 }
 
 /* --------- commands --------- */
-static int cmd_init(void){
+static int cmd_init(const KdfOpts *ko){
     if(file_exists(VAULT_FILE)){
         fprintf(stderr, "Refusing to overwrite existing %s\n", VAULT_FILE);
         return 1;
     }
+    StoreKdf kdf;
+    if(resolve_kdf(ko, &kdf) != 0) return 1;
     char *pw1 = prompt_hidden("Set master password: ");
     char *pw2 = prompt_hidden("Confirm master password: ");
     if(!pw1 || !pw2){ fprintf(stderr,"password input failed\n"); return 1; }
@@ -266,12 +390,13 @@ static int cmd_init(void){
         free(pw1); free(pw2);
         return 1;
     }
-    Lines L = (Lines){0}; /* empty */
-    save_vault(&L, pw1);
+    int rc = store_create(VAULT_FILE, pw1, &kdf, NULL, 0);
     secure_bzero(pw1, strlen(pw1)); secure_bzero(pw2, strlen(pw2));
     free(pw1); free(pw2);
-    lines_free(&L);
-    printf("Initialized AES vault: %s\n", VAULT_FILE);
+    if(rc != 0) return 1;
+    printf("Initialized AES vault: %s (", VAULT_FILE);
+    print_kdf(stdout, &kdf);
+    printf(")\n");
     return 0;
 }
 
@@ -285,130 +410,130 @@ static int cmd_add(const char *svc, const char *usr, const char *pwd){
         fprintf(stderr,"Tabs/newlines not allowed in fields.\n");
         return 1;
     }
-    char *pw = prompt_hidden("Master password: ");
-    if(!pw){ fprintf(stderr,"password input failed\n"); return 1; }
-    Lines L; load_vault(&L, pw);
+    Store *S = unlock_vault(1);
+    if(!S) return 1;
     char line[MAX_LINE];
     snprintf(line, sizeof line, "%s\t%s\t%s", svc, usr, pwd);
-    lines_push(&L, line);
-    save_vault(&L, pw);
-    secure_bzero(pw, strlen(pw)); free(pw);
-    lines_free(&L);
+    int rc = store_add(S, svc, line);      /* one sealed record + journal entry appended */
+    secure_bzero(line, sizeof line);
+    store_close(S);
+    if(rc != 0) return 1;
     printf("Added entry for service: %s\n", svc);
     return 0;
 }
 
-static int cmd_list(void){
-    char *pw = prompt_hidden("Master password: ");
-    if(!pw){ fprintf(stderr,"password input failed\n"); return 1; }
-    Lines L; load_vault(&L, pw);
-    for(size_t i=0;i<L.len;i++){
-        char buf[MAX_LINE]; strncpy(buf, L.rows[i], sizeof buf); buf[sizeof buf-1]=0;
-        char *svc = strtok(buf, "\t");
-        if(svc) puts(svc);
-    }
-    secure_bzero(pw, strlen(pw)); free(pw);
-    lines_free(&L);
+static int print_service(const char *line, void *ctx){
+    (void)ctx;
+    printf("%.*s\n", (int)strcspn(line, "\t"), line);
     return 0;
 }
 
+static int cmd_list(void){
+    Store *S = unlock_vault(0);
+    if(!S) return 1;
+    int rc = store_foreach(S, print_service, NULL);
+    store_close(S);
+    return rc ? 1 : 0;
+}
+
 static int cmd_show(const char *svc_q){
     if(!svc_q){ fprintf(stderr,"Usage: vault_aes show --service S\n"); return 1; }
-    char *pw = prompt_hidden("Master password: ");
-    if(!pw){ fprintf(stderr,"password input failed\n"); return 1; }
-    Lines L; load_vault(&L, pw);
+    Store *S = unlock_vault(0);
+    if(!S) return 1;
+    char *rec = store_get(S, svc_q);       /* decrypts the index and this one record */
+    store_close(S);
     int found=0;
-    for(size_t i=0;i<L.len;i++){
-        char buf[MAX_LINE]; strncpy(buf, L.rows[i], sizeof buf); buf[sizeof buf-1]=0;
-        char *svc = strtok(buf, "\t");
-        char *usr = strtok(NULL, "\t");
-        char *pwd = strtok(NULL, "\t");
-        if(svc && usr && pwd && strcmp(svc, svc_q)==0){
+    if(rec){
+        size_t n = strlen(rec);
+        char *save=NULL;
+        char *svc = strtok_r(rec, "\t", &save);
+        char *usr = strtok_r(NULL, "\t", &save);
+        char *pwd = strtok_r(NULL, "\t", &save);
+        if(svc && usr && pwd){
             printf("service : %s\nuser    : %s\npass    : %s\n", svc, usr, pwd);
-            found=1; break;
+            found=1;
         }
+        secure_bzero(rec, n); free(rec);
     }
     if(!found) fprintf(stderr, "No entry found for service: %s\n", svc_q);
-    secure_bzero(pw, strlen(pw)); free(pw);
-    lines_free(&L);
     return found?0:1;
 }
 
 /* ----- Phase 4 new commands ----- */
 
-/* Change master password (fresh salt/nonce; re-encrypt everything) */
-static int cmd_rekey(void){
+/* Change master password (fresh salt/nonces; re-encrypt everything) */
+static int cmd_rekey(const KdfOpts *ko, int kdf_given){
+    StoreKdf kdf;
+    if(kdf_given && resolve_kdf(ko, &kdf) != 0) return 1;
     char *oldpw = prompt_hidden("Current master password: ");
     if(!oldpw){ fprintf(stderr,"password input failed\n"); return 1; }
 
-    Lines L; load_vault(&L, oldpw); /* verifies old password & integrity */
+    Store *S = open_vault(oldpw, 1); /* verifies old password & integrity */
+    secure_bzero(oldpw, strlen(oldpw)); free(oldpw);
+    if(!S) return 1;
 
     char *new1 = prompt_hidden("New master password: ");
     char *new2 = prompt_hidden("Confirm new master password: ");
     if(!new1 || !new2){
         fprintf(stderr,"password input failed\n");
-        secure_bzero(oldpw, strlen(oldpw)); free(oldpw);
         if(new1){secure_bzero(new1,strlen(new1)); free(new1);}
         if(new2){secure_bzero(new2,strlen(new2)); free(new2);}
-        lines_free(&L);
+        store_close(S);
         return 1;
     }
     if(strcmp(new1,new2)!=0){
         fprintf(stderr,"Passwords do not match.\n");
-        secure_bzero(oldpw, strlen(oldpw)); free(oldpw);
         secure_bzero(new1, strlen(new1));   free(new1);
         secure_bzero(new2, strlen(new2));   free(new2);
-        lines_free(&L);
+        store_close(S);
         return 1;
     }
 
-    save_vault(&L, new1); /* fresh salt+nonce inside save */
+    int rc = store_rekey(S, new1, kdf_given ? &kdf : NULL); /* fresh salt, new keys, whole file rewritten */
 
-    secure_bzero(oldpw, strlen(oldpw)); free(oldpw);
     secure_bzero(new1, strlen(new1));   free(new1);
     secure_bzero(new2, strlen(new2));   free(new2);
-    lines_free(&L);
+    store_close(S);
+    if(rc != 0) return 1;
     printf("Rekey complete: vault re-encrypted with new master password.\n");
     return 0;
 }
 
+struct search_ctx { const char *q; int hits; };
+
+static int search_one(const char *line, void *ctx){
+    struct search_ctx *c = ctx;
+    char buf[MAX_LINE];
+    snprintf(buf, sizeof buf, "%.*s", (int)strcspn(line, "\t"), line);
+    if(contains_icase(buf, c->q)){ puts(buf); c->hits++; }
+    return 0;
+}
+
 /* Case-insensitive substring search on service names */
 static int cmd_search(const char *q){
     if(!q){ fprintf(stderr,"Usage: vault_aes search --q SUBSTRING\n"); return 1; }
-    char *pw = prompt_hidden("Master password: ");
-    if(!pw){ fprintf(stderr,"password input failed\n"); return 1; }
-    Lines L; load_vault(&L, pw);
-    int hits = 0;
-    for(size_t i=0;i<L.len;i++){
-        char buf[MAX_LINE]; strncpy(buf, L.rows[i], sizeof buf); buf[sizeof buf-1]=0;
-        char *svc = strtok(buf, "\t");
-        if(svc && contains_icase(svc, q)){ puts(svc); hits++; }
-    }
-    if(!hits) fprintf(stderr,"No matches for: %s\n", q);
-    secure_bzero(pw, strlen(pw)); free(pw);
-    lines_free(&L);
-    return hits?0:1;
+    Store *S = unlock_vault(0);
+    if(!S) return 1;
+    struct search_ctx c = { q, 0 };
+    store_foreach(S, search_one, &c);
+    store_close(S);
+    if(!c.hits) fprintf(stderr,"No matches for: %s\n", q);
+    return c.hits?0:1;
 }
 
 /* Remove a single service entry (exact match), confirm unless --yes */
 static int cmd_remove(const char *svc, int assume_yes){
     if(!svc){ fprintf(stderr,"Usage: vault_aes remove --service S [--yes]\n"); return 1; }
-    char *pw = prompt_hidden("Master password: ");
-    if(!pw){ fprintf(stderr,"password input failed\n"); return 1; }
-    Lines L; load_vault(&L, pw);
+    Store *S = unlock_vault(1);
+    if(!S) return 1;
 
-    ssize_t idx = -1;
-    for(size_t i=0;i<L.len;i++){
-        char buf[MAX_LINE]; strncpy(buf, L.rows[i], sizeof buf); buf[sizeof buf-1]=0;
-        char *s = strtok(buf,"\t");
-        if(s && strcmp(s, svc)==0){ idx = (ssize_t)i; break; }
-    }
-    if(idx < 0){
+    char *rec = store_get(S, svc);
+    if(!rec){
         fprintf(stderr,"No entry found for service: %s\n", svc);
-        secure_bzero(pw, strlen(pw)); free(pw);
-        lines_free(&L);
+        store_close(S);
         return 1;
     }
+    secure_bzero(rec, strlen(rec)); free(rec);
 
     if(!assume_yes){
         fprintf(stderr,"Delete service '%s'? Type YES to confirm: ", svc);
@@ -417,20 +542,68 @@ static int cmd_remove(const char *svc, int assume_yes){
         conf[strcspn(conf,"\r\n")] = 0;
         if(strcmp(conf,"YES")!=0){
             fprintf(stderr,"Aborted.\n");
-            secure_bzero(pw, strlen(pw)); free(pw);
-            lines_free(&L);
+            store_close(S);
             return 1;
         }
     }
 
-    free(L.rows[(size_t)idx]);
-    for(size_t j=(size_t)idx+1;j<L.len;j++) L.rows[j-1] = L.rows[j];
-    L.len--;
+    int rc = store_remove(S, svc);   /* journal entry appended, old record scrubbed */
+    store_close(S);
+    if(rc != 0) return 1;
+    printf("Removed entry: %s\n", svc);
+    return 0;
+}
 
-    save_vault(&L, pw);
+/* Unlock once and hand the derived key to a background agent */
+static int cmd_agent(unsigned ttl, int stop){
+    if(stop){
+        if(agent_stop() != 0){ fprintf(stderr,"No vault agent running.\n"); return 1; }
+        printf("Vault agent stopped; key wiped.\n");
+        return 0;
+    }
+    char *pw = prompt_hidden("Master password: ");
+    if(!pw){ fprintf(stderr,"password input failed\n"); return 1; }
+    Store *S = open_vault(pw, 0);
     secure_bzero(pw, strlen(pw)); free(pw);
-    lines_free(&L);
-    printf("Removed entry: %s\n", svc);
+    if(!S) return 1;
+
+    uint8_t salt[STORE_SALT_LEN], key[STORE_KEY_LEN];
+    store_key(S, salt, key);
+    store_close(S);
+    return agent_start(salt, key, ttl) == 0 ? 0 : 1;   /* agent_start wipes key */
+}
+
+/* Measure KDF cost on this host and suggest parameters for the target */
+static int cmd_bench_kdf(const KdfOpts *ko){
+    KdfOpts o = *ko;
+    if(!o.target_ms) o.target_ms = KDF_TARGET_MS;
+
+    StoreKdf k = { STORE_KDF_PBKDF2, { PBKDF2_ITERS, 0, 0 } };
+    double t = time_kdf(&k);
+    if(t < 0) return 1;
+    printf("PBKDF2-SHA256 %u iterations (current default): %.0f ms\n", PBKDF2_ITERS, t);
+
+    printf("scrypt r=%u, p=1:\n", SCRYPT_R);
+    for(unsigned mb = 16; mb <= 256; mb *= 2){
+        StoreKdf sk = scrypt_kdf(mb, 1);
+        double st = time_kdf(&sk);
+        if(st < 0){ printf("  %4u MiB: failed (out of memory?)\n", mb); break; }
+        printf("  %4u MiB: %.0f ms\n", mb, st);
+        if(st > 4.0 * o.target_ms) break;
+    }
+
+    double took;
+    printf("\nFor a %u ms unlock:\n", o.target_ms);
+    KdfOpts p = o; p.scrypt = 0;
+    if(calibrate(&p, &k, &took) != 0) return 1;
+    printf("  "); print_kdf(stdout, &k); printf(": %.0f ms\n", took);
+    printf("    vault_aes init --iters %u      (or: rekey --iters %u)\n", k.p[0], k.p[0]);
+    p.scrypt = 1;
+    if(calibrate(&p, &k, &took) != 0) return 1;
+    printf("  "); print_kdf(stdout, &k); printf(": %.0f ms\n", took);
+    printf("    vault_aes init --kdf scrypt --mem %llu --parallel %u\n",
+           (unsigned long long)(((uint64_t)128u * k.p[1] << k.p[0]) >> 20), k.p[2]);
+    printf("scrypt makes each guess cost the attacker that much memory too; prefer it.\n");
     return 0;
 }
 
@@ -439,17 +612,33 @@ int main(int argc, char **argv){
     if(argc < 2){
         fprintf(stderr,
             "Usage:\n"
-            "  vault_aes init\n"
+            "  vault_aes init    [KDF options]\n"
             "  vault_aes add     --service S --user U --pass P\n"
             "  vault_aes list\n"
             "  vault_aes show    --service S\n"
-            "  vault_aes rekey\n"
+            "  vault_aes rekey   [KDF options]\n"
             "  vault_aes search  --q SUBSTRING\n"
-            "  vault_aes remove  --service S [--yes]\n");
+            "  vault_aes remove  --service S [--yes]\n"
+            "  vault_aes agent   [--ttl SECONDS] [--stop]\n"
+            "  vault_aes bench-kdf [--target MS] [--mem MiB]\n"
+            "KDF options:\n"
+            "  --kdf pbkdf2|scrypt  --iters N  --mem MiB  --parallel P\n"
+            "  --target MS          calibrate to this unlock time on this host\n");
         return 1;
     }
 
-    if(strcmp(argv[1],"init")==0)  return cmd_init();
+    if(strcmp(argv[1],"init")==0 || strcmp(argv[1],"rekey")==0 || strcmp(argv[1],"bench-kdf")==0){
+        KdfOpts ko = {0};
+        int given = 0;
+        for(int i=2;i<argc;i++){
+            int r = parse_kdf_arg(argc, argv, &i, &ko);
+            if(r < 0) return 1;
+            given |= r;
+        }
+        if(argv[1][0]=='i') return cmd_init(&ko);
+        if(argv[1][0]=='r') return cmd_rekey(&ko, given);
+        return cmd_bench_kdf(&ko);
+    }
 
     if(strcmp(argv[1],"add")==0){
         const char *svc=NULL,*usr=NULL,*pwd=NULL;
@@ -470,7 +659,6 @@ int main(int argc, char **argv){
         return cmd_show(svc);
     }
 
-    if(strcmp(argv[1],"rekey")==0) return cmd_rekey();
 
     if(strcmp(argv[1],"search")==0){
         const char *q=NULL;
@@ -488,6 +676,19 @@ int main(int argc, char **argv){
         return cmd_remove(svc, yes);
     }
 
+    if(strcmp(argv[1],"agent")==0){
+        unsigned ttl=AGENT_DEFAULT_TTL; int stop=0;
+        for(int i=2;i<argc;i++){
+            if(strcmp(argv[i],"--ttl")==0 && i+1<argc){
+                char *end; unsigned long v=strtoul(argv[++i],&end,10);
+                if(*end || v==0 || v>86400){ fprintf(stderr,"--ttl wants 1..86400 seconds\n"); return 1; }
+                ttl=(unsigned)v;
+            }
+            else if(strcmp(argv[i],"--stop")==0) stop=1;
+        }
+        return cmd_agent(ttl, stop);
+    }
+
     fprintf(stderr,"Unknown command: %s\n", argv[1]);
     return 1;
 }
@@ -12,24 +12,39 @@
 // SecLog Scan — a tiny log analyzer (arrays, pointers, memory mgmt)
 // Build:  gcc -Wall -Wextra -Wpedantic -Wshadow -Wconversion -O2 \
 //             -fstack-protector-strong -D_FORTIFY_SOURCE=2 \
-//             -fsanitize=address,undefined \
-//             seclog_scan.c -o seclog_scan
+//             -fsanitize=address,undefined -pthread -IMiniSIEM \
+//             seclog_scan.c MiniSIEM/acmatch.c MiniSIEM/ingest.c \
+//             MiniSIEM/ipindex.c MiniSIEM/logtok.c MiniSIEM/topk.c \
+//             -o seclog_scan
 //
-// Usage:  ./seclog_scan access.log
+// Usage:  ./seclog_scan [--sigs=FILE] [-j N] [--top=K [--counters=M]] access.log
 //         cat access.log | ./seclog_scan
+//         --sigs=FILE adds one signature per line (case-insensitive)
+//         -j N splits a regular file into N newline-aligned shards parsed
+//         in parallel (-j 0 = one per online CPU); stdin stays serial
+//         --top=K prints only the K heaviest IPs per metric from fixed-size
+//         Space-Saving summaries (M counters each, default max(1024, 32K));
+//         every count is within the printed error of the truth
 //
 // Log format expected (loose): "IP - - [date] \"METHOD PATH ...\" STATUS ..."
-// Works with common Nginx/Apache styles. If parsing fails for a line, it is skipped safely.
+// Works with common and combined Nginx/Apache styles. If parsing fails for a line, it is skipped safely.
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <errno.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "acmatch.h"
+#include "ingest.h"
+#include "ipindex.h"
+#include "logtok.h"
+#include "topk.h"
 
 typedef struct {
-    char *ip;                 // dynamically owned
+    char *ip;                 // dynamically owned (NULL inside an IPIndex)
     unsigned total;           // total requests from this IP
     unsigned failed;          // 4xx/5xx
     unsigned suspicious;      // matched heuristic signatures
@@ -78,124 +93,242 @@ static void vec_free(Vec *v) {
     v->data = NULL; v->len = v->cap = 0;
 }
 
-// find IP in vector (linear search keeps code simple)
-static ssize_t find_ip(const Vec *v, const char *ip) {
-    for (size_t i = 0; i < v->len; i++) {
-        if (strcmp(v->data[i].ip, ip) == 0) return (ssize_t)i;
+// ---- parsing & detection ----
+// Lines are split by the shared zero-copy tokenizer (MiniSIEM/logtok.c):
+// one forward pass, every field a pointer + length into the mapped log.
+
+// very small heuristic signatures for demo purposes; matched case-insensitively
+// in one pass by the shared Aho-Corasick automaton (MiniSIEM/acmatch.c)
+static const char *const builtin_sigs[] = {
+    "union%20select", "union+select", "union select", "' or '1'='1",
+    "%27or%271%27%3d%271", "<script", "%3cscript", "../", "%2e%2e%2f",
+};
+
+static int is_suspicious_path(const ACMatcher *sigs, const char *path, size_t n) {
+    return ac_scan(sigs, path, n) != 0;
+}
+
+// ---- sharded aggregation ----
+// Every worker owns one newline-aligned slice of the mapped file and its own
+// IPIndex of IPStat, so the hot loop takes no locks. The matcher is read-only
+// after ac_compile() and shared by all of them.
+
+#define MAX_JOBS 256
+
+// --top mode keeps one Space-Saving summary per metric instead of the table
+enum { HH_SUSP, HH_FAILED, HH_TOTAL, HH_COUNT };
+
+typedef struct {
+    const char *beg, *end;
+    const ACMatcher *sigs;
+    size_t top_cap;           // counters per summary; 0 = exact per-IP table
+    IPIndex ips;              // ip -> IPStat (ip field unused)
+    SpaceSaving hh[HH_COUNT];
+} Shard;
+
+static void shard_init(Shard *sh, const ACMatcher *sigs, size_t top_cap) {
+    memset(sh, 0, sizeof *sh);
+    sh->sigs = sigs;
+    sh->top_cap = top_cap;
+    if (top_cap) for (int m = 0; m < HH_COUNT; m++) ss_init(&sh->hh[m], top_cap);
+    else ipidx_init(&sh->ips, sizeof(IPStat));
+}
+
+static void shard_free(Shard *sh) {
+    if (sh->top_cap) for (int m = 0; m < HH_COUNT; m++) ss_free(&sh->hh[m]);
+    else ipidx_free(&sh->ips);
+}
+
+static void account_line(Shard *sh, const char *line, size_t n) {
+    ClfLine f;
+    if (!clf_parse(line, n, &f) || f.host.n > LT_IP_MAX) return;
+    const char *ip = f.host.p;
+    size_t iplen = f.host.n;
+    int failed = (f.status >= 400 && f.status <= 599);
+    int susp   = f.path.n && is_suspicious_path(sh->sigs, f.path.p, f.path.n);
+
+    if (sh->top_cap) {
+        ss_add(&sh->hh[HH_TOTAL], ip, iplen);
+        if (failed) ss_add(&sh->hh[HH_FAILED], ip, iplen);
+        if (susp) ss_add(&sh->hh[HH_SUSP], ip, iplen);
+        return;
     }
-    return -1;
-}
-
-static void add_or_update(Vec *v, const char *ip, int failed, int suspicious) {
-    ssize_t idx = find_ip(v, ip);
-    if (idx < 0) {
-        vec_reserve(v, v->len + 1);
-        v->data[v->len].ip = xstrdup(ip);
-        v->data[v->len].total = 1u;
-        v->data[v->len].failed = failed ? 1u : 0u;
-        v->data[v->len].suspicious = suspicious ? 1u : 0u;
-        v->len++;
-    } else {
-        IPStat *s = &v->data[(size_t)idx];
-        s->total++;
-        if (failed) s->failed++;
-        if (suspicious) s->suspicious++;
+    IPStat *s = (IPStat *)ipidx_get(&sh->ips, ip, iplen, NULL);
+    s->total++;
+    if (failed) s->failed++;
+    if (susp) s->suspicious++;
+}
+
+static void *shard_main(void *arg) {
+    Shard *sh = (Shard *)arg;
+    const char *p = sh->beg;
+    while (p < sh->end) {
+        const char *nl = lr_find_nl(p, sh->end);
+        const char *e = nl ? nl : sh->end;
+        account_line(sh, p, (size_t)(e - p));
+        p = e + 1;
     }
+    return NULL;
 }
 
-// ---- parsing & detection ----
+// fold src into dst; dst keeps first-seen order, so shards merged in file
+// order rank exactly like a single-threaded pass
+static void merge_into(IPIndex *dst, const IPIndex *src) {
+    char key[64];
+    for (size_t i = 0; i < src->len; i++) {
+        const IPStat *s = (const IPStat *)ipidx_val(src, i);
+        ipidx_key(src, i, key, sizeof key);
+        IPStat *d = (IPStat *)ipidx_get(dst, key, strlen(key), NULL);
+        d->total += s->total;
+        d->failed += s->failed;
+        d->suspicious += s->suspicious;
+    }
+}
+
+// fold src into dst and release src
+static void shard_merge(Shard *dst, Shard *src) {
+    if (dst->top_cap) for (int m = 0; m < HH_COUNT; m++) ss_merge(&dst->hh[m], &src->hh[m]);
+    else merge_into(&dst->ips, &src->ips);
+    shard_free(src);
+}
 
-// extract first token (IP) from a line; returns 1 on success
-static int extract_ip(const char *line, char *out, size_t outsz) {
-    // skip leading spaces
-    while (*line && isspace((unsigned char)*line)) line++;
-    // copy until space
-    size_t i = 0;
-    while (line[i] && !isspace((unsigned char)line[i])) {
-        if (i + 1 >= outsz) return 0; // too long
-        out[i] = line[i];
-        i++;
+// split [map, map+len) into `jobs` slices ending on '\n', run them, merge
+static void scan_parallel(const char *map, size_t len, unsigned jobs,
+                          const ACMatcher *sigs, size_t top_cap, Shard *out) {
+    Shard *sh = (Shard *)xmalloc(jobs * sizeof *sh);
+    pthread_t *tid = (pthread_t *)xmalloc(jobs * sizeof *tid);
+    const char *end = map + len, *p = map;
+    unsigned n = 0;
+    for (unsigned j = 0; j < jobs && p < end; j++) {
+        const char *e = (j + 1 == jobs) ? end : map + len / jobs * (j + 1);
+        if (e < p) e = p;
+        if (e < end) {
+            const char *nl = lr_find_nl(e, end);
+            e = nl ? nl + 1 : end;
+        }
+        shard_init(&sh[n], sigs, top_cap);
+        sh[n].beg = p;
+        sh[n].end = e;
+        n++;
+        p = e;
     }
-    if (i == 0) return 0;
-    out[i] = '\0';
-    return 1;
-}
-
-// try to find `"METHOD PATH` segment to pull PATH (best-effort)
-static int extract_path(const char *line, char *out, size_t outsz) {
-    const char *q1 = strchr(line, '\"');
-    if (!q1) return 0;
-    q1++;
-    // METHOD ends at space
-    const char *sp = strchr(q1, ' ');
-    if (!sp) return 0;
-    // PATH starts after METHOD's space
-    const char *path = sp + 1;
-    // PATH ends at next space or quote
-    size_t i = 0;
-    while (path[i] && path[i] != ' ' && path[i] != '\"') {
-        if (i + 1 >= outsz) return 0;
-        out[i] = path[i];
-        i++;
+
+    unsigned started = 0;
+    for (unsigned j = 1; j < n; j++) {
+        if (pthread_create(&tid[j], NULL, shard_main, &sh[j]) != 0) break;
+        started = j;
     }
-    if (i == 0) return 0;
-    out[i] = '\0';
-    return 1;
-}
-
-static int extract_status(const char *line) {
-    // Find the closing quote of the request then the status code after it
-    const char *q2 = strrchr(line, '\"');
-    if (!q2) return -1;
-    const char *p = q2 + 1;
-    while (*p && isspace((unsigned char)*p)) p++;
-    // read int
-    char *end = NULL;
-    long val = strtol(p, &end, 10);
-    if (end == p || val < 0 || val > 999) return -1;
-    return (int)val;
+    (void)shard_main(&sh[0]);
+    for (unsigned j = started + 1; j < n; j++) (void)shard_main(&sh[j]);   // couldn't spawn: do it here
+    for (unsigned j = 1; j <= started; j++) pthread_join(tid[j], NULL);
+
+    if (n == 0) shard_init(out, sigs, top_cap);
+    else *out = sh[0];
+    for (unsigned j = 1; j < n; j++) shard_merge(out, &sh[j]);
+    free(tid);
+    free(sh);
+}
+
+static void print_top(const SpaceSaving *ss, const char *what, SSItem *buf, size_t k) {
+    size_t n = ss_top(ss, buf, k);
+    printf("\nTop %zu by %s (%llu events, max error %llu)\n", k, what,
+           (unsigned long long)ss->total, (unsigned long long)ss_bound(ss));
+    printf("%-18s %10s %10s\n", "IP", "Count", "Error");
+    printf("-----------------------------------------\n");
+    for (size_t i = 0; i < n; i++)
+        printf("%-18s %10llu %10llu\n", buf[i].key,
+               (unsigned long long)buf[i].count, (unsigned long long)buf[i].err);
+}
+
+// true count of each row lies in [Count - Error, Count]
+static void report_top(const Shard *sh, size_t k) {
+    SSItem *buf = (SSItem *)xmalloc(k * sizeof *buf);
+    printf("\n== SecLog Top-%zu Report (%zu counters per metric) ==\n", k, sh->top_cap);
+    print_top(&sh->hh[HH_SUSP], "suspicious", buf, k);
+    print_top(&sh->hh[HH_FAILED], "failed", buf, k);
+    print_top(&sh->hh[HH_TOTAL], "total", buf, k);
+    free(buf);
 }
 
-// very small heuristic signatures for demo purposes
-static int is_suspicious_path(const char *path) {
-    // lower-case copy (bounded)
-    char tmp[512];
-    size_t n = 0;
-    for (; path[n] && n < sizeof(tmp) - 1; n++) tmp[n] = (char)tolower((unsigned char)path[n]);
-    tmp[n] = '\0';
+static size_t parse_size(const char *opt, const char *s) {
+    char *end = NULL;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end || v < 1 || v > (1L << 24)) { fprintf(stderr, "bad %s value: %s\n", opt, s); exit(EXIT_FAILURE); }
+    return (size_t)v;
+}
 
-    return strstr(tmp, "union%20select") || strstr(tmp, "union+select") ||
-           strstr(tmp, "union select")   || strstr(tmp, "' or '1'='1")  ||
-           strstr(tmp, "%27or%271%27%3d%271") || strstr(tmp, "<script") ||
-           strstr(tmp, "%3cscript")      || strstr(tmp, "../")          ||
-           strstr(tmp, "%2e%2e%2f");
+static unsigned parse_jobs(const char *s) {
+    char *end = NULL;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end || v < 0) { fprintf(stderr, "bad -j value: %s\n", s); exit(EXIT_FAILURE); }
+    if (v == 0) v = sysconf(_SC_NPROCESSORS_ONLN);
+    if (v < 1) v = 1;
+    if (v > MAX_JOBS) v = MAX_JOBS;
+    return (unsigned)v;
 }
 
 // ---- main ----
 
 int main(int argc, char **argv) {
     const char *fname = NULL;
-    if (argc >= 2) fname = argv[1];
-    FILE *fp = fname ? fopen(fname, "r") : stdin;
-    if (!fp) { perror("fopen"); return EXIT_FAILURE; }
+    const char *sig_file = NULL;
+    unsigned jobs = 1;
+    size_t top_k = 0, top_cap = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--sigs=", 7) == 0) sig_file = argv[i] + 7;
+        else if (strncmp(argv[i], "--top=", 6) == 0) top_k = parse_size("--top", argv[i] + 6);
+        else if (strncmp(argv[i], "--counters=", 11) == 0) top_cap = parse_size("--counters", argv[i] + 11);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) jobs = parse_jobs(argv[++i]);
+        else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2]) jobs = parse_jobs(argv[i] + 2);
+        else fname = argv[i];
+    }
 
-    Vec stats = {0};
-    char line[2048];          // bounded read buffer
-    char ip[64];
-    char path[512];
+    ACMatcher sigs;
+    ac_init(&sigs, 1);
+    for (size_t i = 0; i < sizeof builtin_sigs / sizeof builtin_sigs[0]; i++)
+        ac_add(&sigs, builtin_sigs[i], strlen(builtin_sigs[i]), 1);
+    if (sig_file && ac_add_file(&sigs, sig_file, 1) < 0) { perror(sig_file); return EXIT_FAILURE; }
+    ac_compile(&sigs);
 
-    while (fgets(line, (int)sizeof line, fp)) {
-        if (!extract_ip(line, ip, sizeof ip)) continue;
-        int status = extract_status(line);
-        (void)extract_path(line, path, sizeof path);    // best-effort; OK if it fails
+    LineReader lr;
+    if (lr_open(&lr, fname) != 0) { perror(fname ? fname : "stdin"); return EXIT_FAILURE; }
 
-        int failed = (status >= 400 && status <= 599);
-        int susp   = (extract_path(line, path, sizeof path) && is_suspicious_path(path)) ? 1 : 0;
+    if (top_k && !top_cap) top_cap = top_k * 32 > 1024 ? top_k * 32 : 1024;
+    if (top_k > top_cap) top_cap = top_k;
+    if (!top_k) top_cap = 0;
 
-        add_or_update(&stats, ip, failed, susp);
+    Shard sh;
+    if (jobs > 1 && lr.map) {
+        scan_parallel(lr.map, lr.map_len, jobs, &sigs, top_cap, &sh);
+    } else {
+        // pipes can't be split up front; stream them on this thread
+        if (jobs > 1) fprintf(stderr, "note: -j needs a regular file, reading single-threaded\n");
+        shard_init(&sh, &sigs, top_cap);
+        const char *line;
+        size_t n;
+        int rc;
+        while ((rc = lr_next(&lr, &line, &n)) > 0) account_line(&sh, line, n);
+        if (rc < 0) perror("read");
+    }
+    lr_close(&lr);
+
+    if (top_k) {
+        report_top(&sh, top_k);
+        shard_free(&sh);
+        ac_free(&sigs);
+        return EXIT_SUCCESS;
     }
+    IPIndex ips = sh.ips;
 
-    if (fp != stdin) fclose(fp);
+    Vec stats = {0};
+    vec_reserve(&stats, ips.len);
+    char key[64];
+    for (size_t i = 0; i < ips.len; i++) {
+        IPStat s = *(const IPStat *)ipidx_val(&ips, i);
+        s.ip = xstrdup(ipidx_key(&ips, i, key, sizeof key));
+        stats.data[stats.len++] = s;
+    }
+    ipidx_free(&ips);
 
     // sort by suspicious desc, then failed desc (qsort + comparator)
     int cmp(const void *a, const void *b) {
@@ -220,6 +353,7 @@ int main(int argc, char **argv) {
     printf("Entries: %zu unique IPs\n", stats.len);
 
     vec_free(&stats);
+    ac_free(&sigs);
     return EXIT_SUCCESS;
 }
 
@@ -1,11 +1,31 @@
 /** Mini Project: System Resource Usage Tracker
- *  - Ask user for CPU, Memory, Disk usage readings
- *  - Store in arrays
- *  - Compute Avg / High / Low
- *  - Derive status (Normal / Warning / Critical) from average
+ *  - Sample CPU, Memory and Disk usage from /proc at a fixed interval
+ *  - Keep the last RING_CAP samples per metric in a ring buffer
+ *  - Track Avg / High / Low / EWMA as samples arrive (O(1) each)
+ *  - Derive status (Normal / Warning / Critical) from the EWMA, alert on changes
  *  Build: gcc -std=c99 "System Resource Usage Tracker.c" -o System_Tracker
+ *  Run:   ./System_Tracker [-i interval_ms] [-n samples] [-q]    (Ctrl-C stops)
+ *
+ *  The three /proc files are opened once and re-read with pread() at
+ *  offset 0 each sample: no open/close per reading.
+ *    CPU  = busy share of all cpu jiffies since the last sample (/proc/stat)
+ *    RAM  = 1 - MemAvailable / MemTotal                           (/proc/meminfo)
+ *    Disk = busiest device's io_ticks over the interval            (/proc/diskstats)
  */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RING_CAP    120          /* recent samples kept per metric */
+#define EWMA_ALPHA  0.2          /* weight of the newest sample */
+#define MAX_DISKS   64
 
 const char* status_from_avg(float x) {
     if (x < 60.0f)  return "NORMAL";
@@ -13,87 +33,244 @@ const char* status_from_avg(float x) {
     return "CRITICAL";
 }
 
-int main(void) {
-    int i;
+/* ---------- streaming statistics ---------- */
 
-    printf("=========================================\n");
-    printf("     SYSTEM RESOURCE USAGE TRACKER\n");
-    printf("=========================================\n");
+struct metric {
+    const char *name;
+    float ring[RING_CAP];        /* last RING_CAP samples, oldest at head when full */
+    unsigned head, len;
+    double win_sum;              /* sum of what is in the ring */
+    unsigned long n;             /* every sample ever pushed */
+    double sum, ewma;
+    float hi, lo;
+    const char *status;          /* level of the last alert */
+};
 
-    /* ---------- CPU ---------- */
-    int cpu_n;
-    printf("\nEnter number of readings to record\n");
-    scanf("%d", &cpu_n);
+static void metric_push(struct metric *m, float x) {
+    if (m->len == RING_CAP) {
+        m->win_sum -= m->ring[m->head];           /* evict the oldest */
+        m->ring[m->head] = x;
+        m->head = (m->head + 1) % RING_CAP;
+    } else {
+        m->ring[(m->head + m->len) % RING_CAP] = x;
+        m->len++;
+    }
+    m->win_sum += x;
 
-    int cpu[cpu_n];
-    printf("\n--- Enter CPU usage readings (%%):\n");
-    for (i = 0; i < cpu_n; i++) {
-        printf("Reading %d: ", i + 1);
-        scanf("%d", &cpu[i]);
+    if (m->n == 0) { m->hi = m->lo = x; m->ewma = x; }
+    else {
+        if (x > m->hi) m->hi = x;
+        if (x < m->lo) m->lo = x;
+        m->ewma += EWMA_ALPHA * (x - m->ewma);
     }
+    m->sum += x;
+    m->n++;
+}
+
+static float metric_avg(const struct metric *m) { return m->n ? (float)(m->sum / (double)m->n) : 0.0f; }
+static float metric_win(const struct metric *m) { return m->len ? (float)(m->win_sum / m->len) : 0.0f; }
+
+/* ---------- /proc readers ---------- */
+
+static char buf[1 << 16];
+
+/* whole file from offset 0 into buf, NUL-terminated; -1 on error */
+static int read_proc(int fd) {
+    size_t got = 0;
+    for (;;) {
+        ssize_t r = pread(fd, buf + got, sizeof buf - 1 - got, (off_t)got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (r == 0 || (got += (size_t)r) == sizeof buf - 1) break;
+    }
+    buf[got] = '\0';
+    return 0;
+}
+
+static unsigned long long cpu_busy_prev, cpu_total_prev;
+
+static int sample_cpu(int fd, float *out) {
+    unsigned long long v[8] = {0};
+    if (read_proc(fd) != 0) return -1;
+    if (sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 4) return -1;
+    unsigned long long total = 0;
+    for (int i = 0; i < 8; i++) total += v[i];
+    unsigned long long busy = total - v[3] - v[4];            /* minus idle and iowait */
+
+    unsigned long long dt = total - cpu_total_prev, db = busy - cpu_busy_prev;
+    *out = dt ? 100.0f * (float)db / (float)dt : 0.0f;
+    cpu_total_prev = total;
+    cpu_busy_prev = busy;
+    return 0;
+}
+
+static int sample_mem(int fd, float *out) {
+    unsigned long long total = 0, avail = 0;
+    if (read_proc(fd) != 0) return -1;
+    const char *p = strstr(buf, "MemTotal:"), *q = strstr(buf, "MemAvailable:");
+    if (!p || !q || sscanf(p, "MemTotal: %llu", &total) != 1 ||
+        sscanf(q, "MemAvailable: %llu", &avail) != 1 || total == 0) return -1;
+    *out = 100.0f * (float)(total - avail) / (float)total;
+    return 0;
+}
+
+static struct { char name[32]; unsigned long long ticks; } disks[MAX_DISKS];
+static int ndisks;
+
+/* *fresh is set for a device not seen before: it has no previous sample yet */
+static unsigned long long *disk_prev(const char *name, int *fresh) {
+    *fresh = 0;
+    for (int i = 0; i < ndisks; i++)
+        if (strcmp(disks[i].name, name) == 0) return &disks[i].ticks;
+    if (ndisks == MAX_DISKS) return NULL;
+    *fresh = 1;
+    snprintf(disks[ndisks].name, sizeof disks[ndisks].name, "%s", name);
+    disks[ndisks].ticks = 0;
+    return &disks[ndisks++].ticks;
+}
 
-    /* ---------- Memory ---------- */
-    int mem_n;
-    printf("Enter number of MEM readings to record\n");
-    scanf("%d", &mem_n);
+/* io_ticks is milliseconds the device had I/O in flight: busy% = delta / elapsed */
+static int sample_disk(int fd, double elapsed_ms, int first, float *out) {
+    if (read_proc(fd) != 0) return -1;
+    float best = 0.0f;
+    for (char *line = buf, *next; line && *line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
 
-    int Mem[mem_n];
-    printf("\n--- Enter Memory usage readings (%%):\n");
-    for (i = 0; i < mem_n; i++) {
-        printf("Reading %d: ", i + 1);
-        scanf("%d", &Mem[i]);        // FIXED: was cpu[i]
+        char name[32];
+        unsigned long long f[10];
+        if (sscanf(line, " %*u %*u %31s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   name, &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8], &f[9]) != 11) continue;
+        if (!strncmp(name, "loop", 4) || !strncmp(name, "ram", 3)) continue;
+
+        int fresh;
+        unsigned long long *prev = disk_prev(name, &fresh);
+        if (!prev) continue;
+        if (!first && !fresh && elapsed_ms > 0) {        /* hot-plugged: delta from the next sample on */
+            float u = 100.0f * (float)((double)(f[9] - *prev) / elapsed_ms);
+            if (u > best) best = u;
+        }
+        *prev = f[9];
     }
+    *out = best > 100.0f ? 100.0f : best;
+    return 0;
+}
+
+/* ---------- main loop ---------- */
 
-    /* ---------- Disk ---------- */
-    int disk_n;
-    printf("Enter number of Disk readings to record\n");
-    scanf("%d", &disk_n);
+static volatile sig_atomic_t stop;
+static void on_int(int sig) { (void)sig; stop = 1; }
 
-    int Disk[disk_n];
-    printf("\n--- Enter Disk  usage readings (%%):\n");
-    for (i = 0; i < disk_n; i++) {
-        printf("Reading %d: ", i + 1);
-        scanf("%d", &Disk[i]);       // FIXED: was cpu[i]
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static void check_alert(struct metric *m) {
+    const char *s = status_from_avg((float)m->ewma);
+    if (s != m->status) {
+        if (m->status || s[0] != 'N')
+            printf("ALERT %-4s %s -> %s (ewma %.1f%%)\n", m->name,
+                   m->status ? m->status : "START", s, m->ewma);
+        m->status = s;
     }
+}
 
-    /* ---------- Compute stats ---------- */
-    // CPU
-    int cpu_hi = cpu[0], cpu_lo = cpu[0]; long cpu_sum = 0;
-    for (i = 0; i < cpu_n; i++) {
-        if (cpu[i] > cpu_hi) cpu_hi = cpu[i];
-        if (cpu[i] < cpu_lo) cpu_lo = cpu[i];
-        cpu_sum += cpu[i];
+static void report(const struct metric *m) {
+    printf("%-5s -> Avg: %.1f%%   High: %.1f%%   Low: %.1f%%   EWMA: %.1f%%   Last %u: %.1f%%   Status: %s\n",
+           m->name, metric_avg(m), m->hi, m->lo, m->ewma, m->len, metric_win(m),
+           status_from_avg(metric_avg(m)));
+}
+
+int main(int argc, char **argv) {
+    long interval_ms = 1000, want = 0;
+    int quiet = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) interval_ms = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc) want = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-q")) quiet = 1;
+        else {
+            fprintf(stderr, "usage: %s [-i interval_ms] [-n samples] [-q]\n", argv[0]);
+            return 1;
+        }
     }
-    float cpu_avg = (float)cpu_sum / (float)cpu_n;
-
-    // Memory
-    int mem_hi = Mem[0], mem_lo = Mem[0]; long mem_sum = 0;
-    for (i = 0; i < mem_n; i++) {
-        if (Mem[i] > mem_hi) mem_hi = Mem[i];
-        if (Mem[i] < mem_lo) mem_lo = Mem[i];
-        mem_sum += Mem[i];
+    if (interval_ms < 10 || want < 0) {
+        fprintf(stderr, "interval must be at least 10 ms, samples >= 0 (0 = until Ctrl-C)\n");
+        return 1;
     }
-    float mem_avg = (float)mem_sum / (float)mem_n;
-
-    // Disk
-    int disk_hi = Disk[0], disk_lo = Disk[0]; long disk_sum = 0;
-    for (i = 0; i < disk_n; i++) {
-        if (Disk[i] > disk_hi) disk_hi = Disk[i];
-        if (Disk[i] < disk_lo) disk_lo = Disk[i];
-        disk_sum += Disk[i];
+
+    int fd_stat = open("/proc/stat", O_RDONLY);
+    int fd_mem  = open("/proc/meminfo", O_RDONLY);
+    int fd_disk = open("/proc/diskstats", O_RDONLY);
+    if (fd_stat < 0 || fd_mem < 0 || fd_disk < 0) { perror("open /proc"); return 1; }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_int;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    static struct metric cpu = { .name = "CPU" }, mem = { .name = "RAM" }, disk = { .name = "Disk" };
+
+    printf("=========================================\n");
+    printf("     SYSTEM RESOURCE USAGE TRACKER\n");
+    printf("=========================================\n");
+    printf("Sampling every %ld ms%s\n\n", interval_ms, want ? "" : " (Ctrl-C for the summary)");
+
+    /* baseline for the delta counters (cpu jiffies, io_ticks) */
+    float c, r, d;
+    if (sample_cpu(fd_stat, &c) != 0 || sample_disk(fd_disk, 0, 1, &d) != 0) {
+        fprintf(stderr, "cannot parse /proc/stat or /proc/diskstats\n");
+        return 1;
+    }
+    double last = now_ms();
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (long k = 0; !stop && (want == 0 || k < want); k++) {
+        /* absolute deadlines: the interval doesn't drift by the time spent sampling */
+        next.tv_sec  += interval_ms / 1000;
+        next.tv_nsec += (interval_ms % 1000) * 1000000L;
+        if (next.tv_nsec >= 1000000000L) { next.tv_sec++; next.tv_nsec -= 1000000000L; }
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) != 0 && stop) break;
+
+        double t = now_ms();
+        if (sample_cpu(fd_stat, &c) != 0 || sample_mem(fd_mem, &r) != 0 ||
+            sample_disk(fd_disk, t - last, 0, &d) != 0) {
+            fprintf(stderr, "sample %ld: cannot read /proc\n", k + 1);
+            break;
+        }
+        last = t;
+
+        metric_push(&cpu, c);
+        metric_push(&mem, r);
+        metric_push(&disk, d);
+        if (!quiet)
+            printf("#%-5ld CPU %5.1f%% (ewma %5.1f)   RAM %5.1f%% (ewma %5.1f)   Disk %5.1f%% (ewma %5.1f)\n",
+                   k + 1, c, cpu.ewma, r, mem.ewma, d, disk.ewma);
+        check_alert(&cpu);
+        check_alert(&mem);
+        check_alert(&disk);
+        fflush(stdout);
     }
-    float disk_avg = (float)disk_sum / (float)disk_n;
+
+    close(fd_stat);
+    close(fd_mem);
+    close(fd_disk);
+
+    if (cpu.n == 0) { printf("\nNo samples taken.\n"); return 0; }
 
     /* ---------- Report ---------- */
     printf("\n=========================================\n");
-    printf("             USAGE SUMMARY\n");
+    printf("          USAGE SUMMARY (%lu samples)\n", cpu.n);
     printf("=========================================\n");
-    printf("CPU   -> Avg: %.1f%%   High: %d%%   Low: %d%%   Status: %s\n",
-           cpu_avg, cpu_hi, cpu_lo, status_from_avg(cpu_avg));
-    printf("RAM   -> Avg: %.1f%%   High: %d%%   Low: %d%%   Status: %s\n",
-           mem_avg, mem_hi, mem_lo, status_from_avg(mem_avg));
-    printf("Disk  -> Avg: %.1f%%   High: %d%%   Low: %d%%   Status: %s\n",
-           disk_avg, disk_hi, disk_lo, status_from_avg(disk_avg));
+    report(&cpu);
+    report(&mem);
+    report(&disk);
 
     printf("\nLegend:\n");
     printf("- NORMAL:   < 60%%\n");
@@ -104,4 +281,3 @@ int main(void) {
 
     return 0;
 }
-